@@ -0,0 +1,351 @@
+/*
+Tests and measures the driver's associative containers against each other:
+the red-black Set / Map, the sorted-array FlatSet / FlatMap, and the
+open-addressing HashSet / HashMap, with 64-bit keys and WString paths.
+Everything is built from copies of the driver headers on the user-mode slab
+allocator, so footprints are the bytes the containers ask krnl_std::Alloc
+for (their kSetTag / kMapTag counters), WString buffers not included.
+
+Checks, exiting non-zero on the first failure:
+  - random insert / erase / find sequences give the same answers on all
+    three kinds, with heavy erasing to exercise HashTable's backward shift
+  - iteration visits every key once (in order for the tree and flat kinds)
+  - EraseIf, copy and move
+  - an allocation failure leaves the container unchanged and usable
+
+Then times insert, find (hit and miss) and erase of n random keys, and
+reports bytes per key.
+
+Usage: container_bench [max_n]
+
+Kept free of the C++ library, like kernel_set_adapter.cpp: the driver's
+headers declare their own namespace std.
+*/
+#include "kstd/set/set.h"
+#include "kstd/map/map.h"
+#include "kstd/set/flat_set.h"
+#include "kstd/map/flat_map.h"
+#include "kstd/set/hash_set.h"
+#include "kstd/map/hash_map.h"
+#include "kstd_shim/slab_user.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+namespace {
+	constexpr unsigned int kSetTag = 0x7465534b;    // 'teSK', as in the shim
+	constexpr unsigned int kMapTag = 0x70614d4b;    // 'paMK'
+
+	int failures = 0;
+
+	void Check(bool ok, const char* what)
+	{
+		if (!ok) {
+			fprintf(stderr, "FAIL: %s\n", what);
+			failures++;
+		}
+	}
+
+	double NowNs()
+	{
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1e9 + ts.tv_nsec;
+	}
+
+	unsigned long long LiveBytes()
+	{
+		return krnl_std::GetSlabTagStats(kSetTag).bytes + krnl_std::GetSlabTagStats(kMapTag).bytes;
+	}
+
+	struct Rng
+	{
+		unsigned long long s;
+
+		unsigned long long Next()
+		{
+			s ^= s << 13;
+			s ^= s >> 7;
+			s ^= s << 17;
+			return s;
+		}
+	};
+
+	// Paths like the filter sees, distinct for distinct i.
+	std::WString MakePath(unsigned long long i)
+	{
+		std::WString p(u"\\Device\\HarddiskVolume3\\Users\\someone\\Documents\\");
+		p += std::ToWString(i % 97);
+		p += u"\\file_";
+		p += std::ToWString(i);
+		p += u".docx";
+		return p;
+	}
+
+	// Uniform calls over the three kinds: sets take the key, maps a value too.
+	template <typename C, typename K>
+	auto PutKey(C& c, const K& key, int) -> decltype(c.Insert(key, typename C::mapped_type()).second)
+	{
+		return c.Insert(key, typename C::mapped_type()).second;
+	}
+
+	template <typename C, typename K>
+	bool PutKey(C& c, const K& key, long)
+	{
+		return c.Insert(key).second;
+	}
+
+	template <typename C, typename K>
+	bool Put(C& c, const K& key)
+	{
+		return PutKey(c, key, 0);
+	}
+
+	template <typename C, typename K>
+	bool Has(const C& c, const K& key)
+	{
+		return c.Find(key) != c.End();
+	}
+
+	template <typename C>
+	unsigned long long Walk(const C& c)
+	{
+		unsigned long long n = 0;
+		for (auto it = c.Begin(); it != c.End(); ++it) {
+			n++;
+		}
+		return n;
+	}
+
+	// ================= Checks =================
+
+	template <typename K, typename MakeKey>
+	void CheckAgree(const char* name, MakeKey make_key, unsigned long long ops, unsigned long long key_space)
+	{
+		Set<K> tree;
+		FlatSet<K> flat;
+		HashSet<K> hash;
+		Rng rng{ 0x9e3779b97f4a7c15ULL };
+		bool agree = true;
+
+		for (unsigned long long i = 0; i < ops && agree; i++) {
+			K key = make_key(rng.Next() % key_space);
+			unsigned long long op = rng.Next() % 8;
+			if (op < 4) {
+				bool a = tree.Insert(key).second;
+				bool b = flat.Insert(key).second;
+				bool c = hash.Insert(key).second;
+				agree = a == b && b == c;
+			}
+			else if (op < 7) {
+				unsigned long long a = tree.Erase(key);
+				unsigned long long b = flat.Erase(key);
+				unsigned long long c = hash.Erase(key);
+				agree = a == b && b == c;
+			}
+			else {
+				bool a = Has(tree, key);
+				agree = a == Has(flat, key) && a == Has(hash, key);
+			}
+			agree = agree && tree.Size() == flat.Size() && flat.Size() == hash.Size();
+		}
+		char what[128];
+		snprintf(what, sizeof(what), "%s: Set, FlatSet and HashSet agree", name);
+		Check(agree, what);
+
+		snprintf(what, sizeof(what), "%s: iteration visits every key once", name);
+		bool visited = Walk(flat) == flat.Size() && Walk(hash) == hash.Size();
+		for (auto it = hash.Begin(); it != hash.End() && visited; ++it) {
+			visited = Has(tree, *it);
+		}
+		Check(visited, what);
+
+		snprintf(what, sizeof(what), "%s: FlatSet iterates in order", name);
+		bool ordered = true;
+		auto prev = flat.Begin();
+		for (auto it = flat.Begin(); it != flat.End(); ++it) {
+			ordered = ordered && (it == flat.Begin() || *prev < *it);
+			prev = it;
+		}
+		Check(ordered, what);
+	}
+
+	void CheckMaps()
+	{
+		Map<unsigned long long, unsigned long long> tree;
+		FlatMap<unsigned long long, unsigned long long> flat;
+		HashMap<unsigned long long, unsigned long long> hash;
+		Rng rng{ 12345 };
+		bool agree = true;
+		for (int i = 0; i < 200000 && agree; i++) {
+			unsigned long long key = (rng.Next() % 4096) * 4;     // pid-like
+			unsigned long long val = rng.Next();
+			if (i % 3 != 2) {
+				tree.Insert(key, val);
+				flat.Insert(key, val);
+				hash.Insert(key, val);
+			}
+			else {
+				tree.Erase(key);
+				flat.Erase(key);
+				hash.Erase(key);
+			}
+			auto t = tree.Find(key);
+			auto f = flat.Find(key);
+			auto h = hash.Find(key);
+			bool in_tree = t != tree.End();
+			agree = in_tree == (f != flat.End()) && in_tree == (h != hash.End()) &&
+				(!in_tree || (t->second == f->second && t->second == h->second)) &&
+				tree.Size() == flat.Size() && tree.Size() == hash.Size();
+		}
+		Check(agree, "Map, FlatMap and HashMap agree, Insert replaces");
+
+		HashMap<unsigned long long, unsigned long long> copy(hash);
+		Check(copy.Size() == hash.Size() && Walk(copy) == copy.Size(), "HashMap copy");
+		unsigned long long erased = copy.EraseIf([](const HashMapEntry<unsigned long long, unsigned long long>& e) {
+			return (e.first & 8) != 0;
+		});
+		bool kept = true;
+		for (auto it = copy.Begin(); it != copy.End(); ++it) {
+			kept = kept && (it->first & 8) == 0 && hash.Find(it->first)->second == it->second;
+		}
+		Check(kept && copy.Size() + erased == hash.Size(), "HashMap EraseIf");
+
+		HashMap<unsigned long long, unsigned long long> moved(Move(copy));
+		Check(copy.Size() == 0 && copy.Begin() == copy.End() && Walk(moved) == moved.Size(), "HashMap move");
+
+		FlatMap<unsigned long long, unsigned long long> flat_copy;
+		flat_copy = flat;
+		bool same = flat_copy.Size() == flat.Size();
+		for (auto it = flat.Begin(); it != flat.End() && same; ++it) {
+			same = flat_copy.Find(it->first)->second == it->second;
+		}
+		Check(same, "FlatMap copy");
+	}
+
+	void CheckAllocFailure()
+	{
+		HashSet<unsigned long long> hash;
+		FlatSet<unsigned long long> flat;
+		for (unsigned long long i = 0; i < 12; i++) {
+			hash.Insert(i);
+			flat.Insert(i);
+		}
+		// Both are full up to their next growth, which now fails.
+		krnl_std::SetSlabFailAfter(0);
+		unsigned long long hash_fails = 0;
+		unsigned long long flat_fails = 0;
+		bool reported = true;
+		for (unsigned long long i = 12; i < 40; i++) {
+			auto h = hash.Insert(i);
+			auto f = flat.Insert(i);
+			hash_fails += h.second ? 0 : 1;
+			flat_fails += f.second ? 0 : 1;
+			reported = reported && (h.second || h.first == hash.End()) && (f.second || f.first == flat.End());
+		}
+		krnl_std::SetSlabFailAfter(-1);
+		bool intact = Walk(hash) == hash.Size() && Walk(flat) == flat.Size();
+		for (unsigned long long i = 0; i < 40; i++) {
+			intact = intact && hash.Contains(i) == (i < hash.Size()) && flat.Contains(i) == (i < flat.Size());
+		}
+		Check(hash_fails != 0 && flat_fails != 0 && reported && intact, "failed growth leaves the container unchanged");
+		Check(hash.Insert(100).second && flat.Insert(100).second, "usable after a failed growth");
+	}
+
+	// ================= Bench =================
+
+	template <typename C, typename K>
+	void Time(const char* kind, const char* name, const K* keys, const K* misses, unsigned long long n)
+	{
+		unsigned long long reps = (1ULL << 18) / n + 1;
+		double insert_ns = 0, hit_ns = 0, miss_ns = 0, erase_ns = 0;
+		unsigned long long bytes = 0;
+		unsigned long long sink = 0;
+
+		for (unsigned long long r = 0; r < reps; r++) {
+			unsigned long long before = LiveBytes();
+			C c;
+			double t0 = NowNs();
+			for (unsigned long long i = 0; i < n; i++) {
+				sink += Put(c, keys[i]);
+			}
+			double t1 = NowNs();
+			for (unsigned long long i = 0; i < n; i++) {
+				sink += Has(c, keys[(i * 7) % n]);
+			}
+			double t2 = NowNs();
+			for (unsigned long long i = 0; i < n; i++) {
+				sink += Has(c, misses[i]);
+			}
+			double t3 = NowNs();
+			bytes = LiveBytes() - before;
+			for (unsigned long long i = 0; i < n; i++) {
+				sink += c.Erase(keys[i]);
+			}
+			double t4 = NowNs();
+			insert_ns += t1 - t0;
+			hit_ns += t2 - t1;
+			miss_ns += t3 - t2;
+			erase_ns += t4 - t3;
+		}
+		double ops = (double)reps * n;
+		printf("  %-8s %-10s %7llu %9.1f %9.1f %9.1f %9.1f %9.1f\n", kind, name, n,
+			insert_ns / ops, hit_ns / ops, miss_ns / ops, erase_ns / ops, (double)bytes / n);
+		Check(sink == 3 * reps * n, "bench answers");
+	}
+
+	void Bench(unsigned long long max_n)
+	{
+		Rng rng{ 42 };
+		unsigned long long* keys = (unsigned long long*)malloc(max_n * sizeof(unsigned long long));
+		unsigned long long* misses = (unsigned long long*)malloc(max_n * sizeof(unsigned long long));
+		std::WString* paths = new std::WString[max_n];
+		std::WString* path_misses = new std::WString[max_n];
+		for (unsigned long long i = 0; i < max_n; i++) {
+			keys[i] = rng.Next() | 1;       // odd: hits
+			misses[i] = rng.Next() & ~1ULL; // even: misses
+			paths[i] = MakePath(2 * i);
+			path_misses[i] = MakePath(2 * i + 1);
+		}
+
+		printf("  %-8s %-10s %7s %9s %9s %9s %9s %9s\n", "keys", "container", "n",
+			"insert", "find", "miss", "erase", "bytes/key");
+		for (unsigned long long n = 64; n <= max_n; n *= 16) {
+			Time<Set<unsigned long long>>("u64", "Set", keys, misses, n);
+			Time<FlatSet<unsigned long long>>("u64", "FlatSet", keys, misses, n);
+			Time<HashSet<unsigned long long>>("u64", "HashSet", keys, misses, n);
+			Time<Map<unsigned long long, unsigned long long>>("u64", "Map", keys, misses, n);
+			Time<FlatMap<unsigned long long, unsigned long long>>("u64", "FlatMap", keys, misses, n);
+			Time<HashMap<unsigned long long, unsigned long long>>("u64", "HashMap", keys, misses, n);
+			Time<Set<std::WString>>("path", "Set", paths, path_misses, n);
+			Time<FlatSet<std::WString>>("path", "FlatSet", paths, path_misses, n);
+			Time<HashSet<std::WString>>("path", "HashSet", paths, path_misses, n);
+		}
+
+		delete[] paths;
+		delete[] path_misses;
+		free(keys);
+		free(misses);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned long long max_n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 16384;
+
+	CheckAgree<unsigned long long>("u64", [](unsigned long long i) { return i; }, 300000, 2048);
+	CheckAgree<std::WString>("path", [](unsigned long long i) { return MakePath(i); }, 60000, 512);
+	CheckMaps();
+	CheckAllocFailure();
+	Check(LiveBytes() == 0, "every container block freed");
+	if (failures != 0) {
+		fprintf(stderr, "%d check(s) failed\n", failures);
+		return 1;
+	}
+	printf("container checks passed\n");
+
+	Bench(max_n);
+	Check(LiveBytes() == 0, "every container block freed after bench");
+	return failures != 0;
+}
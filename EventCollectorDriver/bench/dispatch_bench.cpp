@@ -0,0 +1,246 @@
+/*
+Model of MiniFsPreOperation / MiniFsPostOperation before and after the
+per-major dispatch table (template/register.h).
+
+  old  new reg::Context + two Vectors sized to every registered callback,
+       linear scan of all callbacks comparing the major in the pre-op, the
+       same scan again in the post-op, then three deletes
+  new  kFltDispatchIndex[major] -> one callback passed straight through;
+       majors with several callbacks take a Context from a free list
+       standing in for the lookaside list
+
+The eight registrations are the collector's; the I/O mix is weighted
+towards reads and writes like a busy volume, and 3% of the operations fail.
+The old post-op skipped failed operations, so PreReadFile's handle context
+reference was never released; the new one hands them to the post callback
+like FltMgr does. Both variants must make the same pre calls, the new one
+one more post call per failed operation that wanted one, and it must
+release every read reference.
+
+Usage: dispatch_bench [ops]
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+	enum : unsigned char {
+		kCreate = 0x00, kClose = 0x02, kRead = 0x03, kWrite = 0x04, kSetInformation = 0x06,
+		kQueryInformation = 0x05, kDirectoryControl = 0x0c, kFileSystemControl = 0x0d,
+		kCleanup = 0x12, kAcquireForSectionSync = 0xff,
+	};
+
+	enum PreStatus { kWithCallback, kNoCallback, kComplete };
+
+	unsigned long long pre_calls = 0;
+	unsigned long long post_calls = 0;
+	long long read_refs = 0;    // handle context references PreReadFile passed on
+
+	// Creates and reads want a post-op, like PreFileCreate / PreReadFile.
+	// A read passes a context reference that its post callback releases
+	// first, whether the read failed or not.
+	PreStatus Pre(unsigned char major, void** context)
+	{
+		pre_calls++;
+		if (major == kRead) {
+			read_refs++;
+			*context = &read_refs;
+			return kWithCallback;
+		}
+		if (major == kCreate) {
+			*context = &post_calls;
+			return kWithCallback;
+		}
+		return kNoCallback;
+	}
+
+	void Post(void* context)
+	{
+		post_calls++;
+		if (context == &read_refs) {
+			read_refs--;
+		}
+	}
+
+	struct Func {
+		unsigned long long major;
+		PreStatus (*pre)(unsigned char, void**);
+		void (*post)(void*);
+	};
+
+	const Func kRegistered[] = {
+		{ kCreate, Pre, Post }, { kClose, Pre, Post }, { kCleanup, Pre, Post }, { kWrite, Pre, Post },
+		{ kRead, Pre, Post }, { kAcquireForSectionSync, Pre, Post }, { kFileSystemControl, Pre, Post },
+		{ kSetInformation, Pre, Post },
+	};
+	constexpr size_t kFuncs = sizeof(kRegistered) / sizeof(kRegistered[0]);
+
+	// ===== Old =====
+
+	struct OldContext {
+		std::vector<PreStatus>* status;
+		std::vector<void*>* completion_context;
+	};
+
+	void OldDispatch(unsigned char major, bool failed)
+	{
+		OldContext* p = new OldContext();
+		p->status = new std::vector<PreStatus>(kFuncs);
+		p->completion_context = new std::vector<void*>(kFuncs);
+
+		for (size_t i = 0; i < kFuncs; i++) {
+			if (major == kRegistered[i].major) {
+				void* tmp = nullptr;
+				(*p->status)[i] = kRegistered[i].pre(major, &tmp);
+				(*p->completion_context)[i] = tmp;
+			}
+		}
+		// Always WITH_CALLBACK, so the post-op runs for every I/O, but
+		// returned early for failed ones without calling anything.
+		for (size_t i = 0; i < kFuncs && !failed; i++) {
+			if (major == kRegistered[i].major && (*p->status)[i] == kWithCallback) {
+				kRegistered[i].post((*p->completion_context)[i]);
+			}
+		}
+		delete p->completion_context;
+		delete p->status;
+		delete p;
+	}
+
+	// ===== New =====
+
+	constexpr int kMaxFuncsPerMj = 4;
+
+	struct Dispatch {
+		unsigned int count;
+		Func func[kMaxFuncsPerMj];
+	};
+
+	struct NewContext {
+		PreStatus status[kMaxFuncsPerMj];
+		void* completion_context[kMaxFuncsPerMj];
+		NewContext* next;
+	};
+
+	unsigned char dispatch_index[256];
+	Dispatch dispatch[16];
+	NewContext* free_contexts = nullptr;
+
+	void Register()
+	{
+		unsigned int used = 0;
+		for (const Func& f : kRegistered) {
+			unsigned char& index = dispatch_index[f.major];
+			if (index == 0) {
+				index = (unsigned char)++used;
+			}
+			Dispatch& d = dispatch[index - 1];
+			d.func[d.count++] = f;
+		}
+	}
+
+	void NewDispatch(unsigned char major)
+	{
+		unsigned char index = dispatch_index[major];
+		if (index == 0) {
+			return;
+		}
+		const Dispatch& d = dispatch[index - 1];
+		if (d.count == 1) {
+			void* context = nullptr;
+			if (d.func[0].pre(major, &context) == kWithCallback) {
+				d.func[0].post(context);
+			}
+			return;
+		}
+
+		NewContext* p = free_contexts != nullptr ? free_contexts : new NewContext();
+		free_contexts = p->next;
+		bool need_post = false;
+		for (unsigned int i = 0; i < d.count; i++) {
+			p->status[i] = d.func[i].pre(major, &p->completion_context[i]);
+			need_post |= p->status[i] == kWithCallback;
+		}
+		if (need_post) {
+			for (unsigned int i = 0; i < d.count; i++) {
+				if (p->status[i] == kWithCallback) {
+					d.func[i].post(p->completion_context[i]);
+				}
+			}
+		}
+		p->next = free_contexts;
+		free_contexts = p;
+	}
+
+	double Ns(std::chrono::steady_clock::time_point start)
+	{
+		return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t ops = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 5000000;
+
+	// Weights per major: reads and writes dominate, then opens/closes.
+	const struct { unsigned char major; int weight; } mix[] = {
+		{ kRead, 35 }, { kWrite, 25 }, { kCreate, 8 }, { kCleanup, 8 }, { kClose, 8 },
+		{ kQueryInformation, 6 }, { kSetInformation, 3 }, { kDirectoryControl, 3 },
+		{ kAcquireForSectionSync, 3 }, { kFileSystemControl, 1 },
+	};
+	std::vector<unsigned char> table;
+	for (const auto& m : mix) {
+		table.insert(table.end(), m.weight, m.major);
+	}
+	std::mt19937_64 rng(20042003);
+	std::vector<unsigned char> majors(ops);
+	std::vector<bool> failed(ops);
+	unsigned long long failed_posts = 0;
+	for (size_t i = 0; i < ops; i++) {
+		majors[i] = table[rng() % table.size()];
+		failed[i] = rng() % 100 < 3;
+		failed_posts += failed[i] && (majors[i] == kCreate || majors[i] == kRead);
+	}
+
+	Register();
+
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < ops; i++) {
+		OldDispatch(majors[i], failed[i]);
+	}
+	double old_ns = Ns(start);
+	unsigned long long old_pre = pre_calls, old_post = post_calls;
+	long long old_refs = read_refs;
+
+	// The new post-op does not look at the status, the callbacks do.
+	pre_calls = post_calls = 0;
+	read_refs = 0;
+	start = std::chrono::steady_clock::now();
+	for (unsigned char m : majors) {
+		NewDispatch(m);
+	}
+	double new_ns = Ns(start);
+
+	printf("# %zu operations, %zu registered callbacks\n", ops, kFuncs);
+	printf("%-6s %10s %12s %12s %12s\n", "path", "ns/op", "pre calls", "post calls", "leaked refs");
+	printf("%-6s %10.1f %12llu %12llu %12lld\n", "old", old_ns / ops, old_pre, old_post, old_refs);
+	printf("%-6s %10.1f %12llu %12llu %12lld\n", "new", new_ns / ops, pre_calls, post_calls, read_refs);
+
+	while (free_contexts != nullptr) {
+		NewContext* next = free_contexts->next;
+		delete free_contexts;
+		free_contexts = next;
+	}
+
+	if (old_pre != pre_calls || old_post + failed_posts != post_calls) {
+		fprintf(stderr, "callback counts differ\n");
+		return 1;
+	}
+	if (read_refs != 0) {
+		fprintf(stderr, "%lld read context references leaked\n", read_refs);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,244 @@
+/*
+Cost of one handle summary in collector::LogFileEvent: the old wide-char
+"O," line (same format string, glibc swprintf standing in for
+RtlStringCbVPrintfExW) against filling evt::EventHandleSummary in place.
+
+Also round-trips a synthetic log (text, P, F and O records) through
+tools/evtlog and checks that every O line comes back identical to what the
+old format string produced.
+
+Usage: event_record_bench [events]
+Exits non-zero on a round-trip mismatch.
+*/
+#include "../com/event_record.h"
+#include "../tools/evtlog/event_log_reader.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <random>
+#include <vector>
+
+namespace {
+	// The HANDLE_CONTEXT fields LogFileEvent reads.
+	struct Context {
+		unsigned int requestor_pid;
+		long long file_size;
+		bool is_read, is_modified;
+		double read_entropy[3];
+		long long first_read_timestamp, last_read_timestamp, read_cnt_bytes, read_cnt_times;
+		double write_entropy[3];
+		long long first_write_timestamp, last_write_timestamp, write_cnt_bytes, write_cnt_times;
+		bool is_renamed;
+		bool is_created, is_deleted;
+		bool is_alloc, is_eof, is_fvdli, is_fs_ow, is_fs_wre, is_fs_szd, is_mmap_open, is_mmap_modified;
+		unsigned long long hf, hfn;
+	};
+
+	Context RandomContext(std::mt19937_64& rng)
+	{
+		Context c = {};
+		long long now = 133500000000000000LL + (long long)(rng() % 10000000000ULL);
+		c.requestor_pid = (unsigned int)(rng() % 40000) * 4;
+		c.file_size = (long long)(rng() % (64ULL << 20));
+		c.is_read = rng() & 1;
+		c.is_modified = rng() & 1;
+		for (int i = 0; i < 3; i++) {
+			c.read_entropy[i] = (double)(rng() % 80000) / 10000.0;
+			c.write_entropy[i] = (double)(rng() % 80000) / 10000.0;
+		}
+		c.first_read_timestamp = now;
+		c.last_read_timestamp = now + (long long)(rng() % 100000000);
+		c.read_cnt_bytes = (long long)(rng() % (64ULL << 20));
+		c.read_cnt_times = (long long)(rng() % 5000);
+		c.first_write_timestamp = now + 1;
+		c.last_write_timestamp = now + (long long)(rng() % 100000000);
+		c.write_cnt_bytes = (long long)(rng() % (64ULL << 20));
+		c.write_cnt_times = (long long)(rng() % 5000);
+		unsigned long long bits = rng();
+		c.is_renamed = bits & 1;
+		c.is_created = bits & 2;
+		c.is_deleted = bits & 4;
+		c.is_alloc = bits & 8;
+		c.is_eof = bits & 16;
+		c.is_fvdli = bits & 32;
+		c.is_fs_ow = bits & 64;
+		c.is_fs_wre = bits & 128;
+		c.is_fs_szd = bits & 256;
+		c.is_mmap_open = bits & 512;
+		c.is_mmap_modified = bits & 1024;
+		c.hf = rng();
+		c.hfn = rng();
+		return c;
+	}
+
+	// The format string LogFileEvent used before the binary record.
+	int FormatText(wchar_t* buf, size_t cap, const Context& c)
+	{
+		return swprintf(buf, cap,
+			L"O,"
+			L"%lu,"        // pid
+			L"%llu,"       // path hash
+			L"%lld,"       // file size
+			L"%d,%d,"      // is_read,is_modified
+			L"%lld,%lld,%lld,%lld,%lld,"
+			L"%lld,%lld,%lld,%lld,%lld,"
+			L"%d,%llu,"
+			L"%d,%d,"
+			L"%d,%d,%d,%d,%d,%d,%d,%d,"
+			L"%lld,%lld,%lld,%lld\n",
+			(unsigned long)c.requestor_pid, c.hf, c.file_size,
+			c.is_read, c.is_modified,
+			(long long)(c.read_entropy[0] * 10000), c.first_read_timestamp, c.last_read_timestamp, c.read_cnt_bytes, c.read_cnt_times,
+			(long long)(c.write_entropy[0] * 10000), c.first_write_timestamp, c.last_write_timestamp, c.write_cnt_bytes, c.write_cnt_times,
+			c.is_renamed, c.hfn,
+			c.is_created, c.is_deleted,
+			c.is_alloc, c.is_eof, c.is_fvdli, c.is_fs_ow, c.is_fs_wre, c.is_fs_szd, c.is_mmap_open, c.is_mmap_modified,
+			(long long)(c.read_entropy[1] * 10000), (long long)(c.read_entropy[2] * 10000),
+			(long long)(c.write_entropy[1] * 10000), (long long)(c.write_entropy[2] * 10000));
+	}
+
+	// Same as the record filling in LogFileEvent.
+	void FillRecord(evt::EventHandleSummary* rec, const Context& c)
+	{
+		evt::InitEventHeader(rec->header, evt::kHandleSummary, sizeof(evt::EventHandleSummary));
+		rec->pid = c.requestor_pid;
+		rec->path_hash = c.hf;
+		rec->new_path_hash = c.hfn;
+		rec->file_size = c.file_size;
+
+		unsigned int flags = 0;
+		flags |= c.is_read ? (unsigned int)evt::kFlagRead : 0u;
+		flags |= c.is_modified ? (unsigned int)evt::kFlagModified : 0u;
+		flags |= c.is_renamed ? (unsigned int)evt::kFlagRenamed : 0u;
+		flags |= c.is_created ? (unsigned int)evt::kFlagCreated : 0u;
+		flags |= c.is_deleted ? (unsigned int)evt::kFlagDeleted : 0u;
+		flags |= c.is_alloc ? (unsigned int)evt::kFlagAlloc : 0u;
+		flags |= c.is_eof ? (unsigned int)evt::kFlagEof : 0u;
+		flags |= c.is_fvdli ? (unsigned int)evt::kFlagFvdli : 0u;
+		flags |= c.is_fs_ow ? (unsigned int)evt::kFlagFsOw : 0u;
+		flags |= c.is_fs_wre ? (unsigned int)evt::kFlagFsWre : 0u;
+		flags |= c.is_fs_szd ? (unsigned int)evt::kFlagFsSzd : 0u;
+		flags |= c.is_mmap_open ? (unsigned int)evt::kFlagMmapOpen : 0u;
+		flags |= c.is_mmap_modified ? (unsigned int)evt::kFlagMmapModified : 0u;
+		rec->flags = flags;
+
+		rec->first_read_timestamp = c.first_read_timestamp;
+		rec->last_read_timestamp = c.last_read_timestamp;
+		rec->read_cnt_bytes = c.read_cnt_bytes;
+		rec->read_cnt_times = c.read_cnt_times;
+		rec->first_write_timestamp = c.first_write_timestamp;
+		rec->last_write_timestamp = c.last_write_timestamp;
+		rec->write_cnt_bytes = c.write_cnt_bytes;
+		rec->write_cnt_times = c.write_cnt_times;
+		for (int i = 0; i < evt::kEntropyCount; i++) {
+			rec->read_entropy[i] = evt::EntropyToFixed(c.read_entropy[i]);
+			rec->write_entropy[i] = evt::EntropyToFixed(c.write_entropy[i]);
+		}
+	}
+
+	std::u16string ToU16(const wchar_t* s, int n)
+	{
+		std::u16string out;
+		for (int i = 0; i < n; i++) {
+			out.push_back((char16_t)s[i]);
+		}
+		return out;
+	}
+
+	void AppendPath(std::vector<unsigned char>& log, evt::EventRecordType type, unsigned long long key, const std::u16string& path)
+	{
+		evt::EventPathRecord rec = {};
+		unsigned int size = (unsigned int)(sizeof(rec) + path.size() * 2);
+		evt::InitEventHeader(rec.header, type, size);
+		rec.key = key;
+		rec.chars = (unsigned int)path.size();
+		log.insert(log.end(), (unsigned char*)&rec, (unsigned char*)(&rec + 1));
+		log.insert(log.end(), (const unsigned char*)path.data(), (const unsigned char*)(path.data() + path.size()));
+	}
+
+	double Ns(std::chrono::steady_clock::time_point start)
+	{
+		return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t events = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 200000;
+	std::mt19937_64 rng(20042003);
+	std::vector<Context> contexts;
+	contexts.reserve(events);
+	for (size_t i = 0; i < events; i++) {
+		contexts.push_back(RandomContext(rng));
+	}
+
+	// Text: format into a 4096-WCHAR line buffer, as PushToLogQueue did.
+	std::vector<wchar_t> line(4096);
+	unsigned long long text_bytes = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (const auto& c : contexts) {
+		int n = FormatText(line.data(), line.size(), c);
+		text_bytes += (unsigned long long)n * 2;    // UTF-16 on Windows
+	}
+	double text_ns = Ns(start);
+
+	// Binary: fill the record in place.
+	std::vector<evt::EventHandleSummary> records(events);
+	start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < events; i++) {
+		FillRecord(&records[i], contexts[i]);
+	}
+	double bin_ns = Ns(start);
+	unsigned long long bin_bytes = events * sizeof(evt::EventHandleSummary);
+
+	// Round trip through the decoder.
+	std::vector<unsigned char> log;
+	{
+		std::u16string hello = u"EventCollectorDriver started\n";
+		evt::EventRecordHeader h;
+		evt::InitEventHeader(h, evt::kText, (unsigned int)(sizeof(h) + hello.size() * 2));
+		log.insert(log.end(), (unsigned char*)&h, (unsigned char*)(&h + 1));
+		log.insert(log.end(), (const unsigned char*)hello.data(), (const unsigned char*)(hello.data() + hello.size()));
+		AppendPath(log, evt::kProcessPath, 4, u"\\Device\\HarddiskVolume3\\Windows\\System32\\notepad.exe");
+		AppendPath(log, evt::kFilePath, 12345, u"\\Device\\HarddiskVolume3\\Users\\u\\Documents\\résumé.docx");
+	}
+	for (const auto& r : records) {
+		log.insert(log.end(), (const unsigned char*)&r, (const unsigned char*)(&r + 1));
+	}
+
+	size_t mismatches = 0;
+	size_t summaries = 0;
+	size_t other = 0;
+	start = std::chrono::steady_clock::now();
+	evt::EventLogReader reader(log.data(), log.size());
+	evt::EventView view;
+	while (reader.Next(&view)) {
+		std::u16string decoded = evt::FormatRecord(view);
+		if (view.type != evt::kHandleSummary) {
+			other++;
+			continue;
+		}
+		int n = FormatText(line.data(), line.size(), contexts[summaries]);
+		if (decoded != ToU16(line.data(), n)) {
+			mismatches++;
+		}
+		summaries++;
+	}
+	double decode_ns = Ns(start);
+
+	printf("# %zu handle summaries\n", events);
+	printf("%-8s %10s %10s\n", "format", "bytes/evt", "ns/evt");
+	printf("%-8s %10.1f %10.1f\n", "text", (double)text_bytes / events, text_ns / events);
+	printf("%-8s %10.1f %10.1f\n", "binary", (double)bin_bytes / events, bin_ns / events);
+	printf("decode+format (host side, incl. text compare): %.1f ns/evt\n", decode_ns / events);
+
+	if (mismatches != 0 || summaries != events || other != 3 || reader.SkippedBytes() != 0) {
+		fprintf(stderr, "round trip failed: %zu mismatches, %zu/%zu summaries, %zu other, %llu skipped\n",
+			mismatches, summaries, events, other, reader.SkippedBytes());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,238 @@
+/*
+Simulator for com/flush_policy.h, the wake-up batching of the driver ->
+service event channel.
+
+Discrete-event replay in 100ns ticks, like KeQueryInterruptTime. File
+events arrive as a Poisson stream; a small share is urgent (rename that
+changes the extension). The producer side is EventChannel::WritePathEvent
+and its flush timer; the consumer is DriverChannel::DrainLoop with a fixed
+wake-up cost, a per-record cost and the 100ms idle timeout.
+
+For each load and policy it reports
+  msgs/s      wake-ups the driver caused (KeSetEvent on a sleeping service),
+  batch       records drained per wake-up,
+  mean/p99    latency from publish to drain, in microseconds.
+"immediate" (target 1, what the channel did before batching) is the
+baseline for the added latency.
+
+Usage: flush_policy_sim [seconds_per_load]
+*/
+#include "../com/flush_policy.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <queue>
+#include <random>
+#include <vector>
+
+namespace {
+	typedef unsigned long long Tick;
+	constexpr Tick kUs = 10;
+	constexpr Tick kMs = 1000 * kUs;
+	constexpr Tick kSecond = 1000 * kMs;
+
+	// Consumer costs, roughly a thread wake-up and one PushFileEventSync.
+	constexpr Tick kWakeCost = 30 * kUs;
+	constexpr Tick kRecordCost = 2 * kUs;
+	constexpr Tick kIdleTimeout = 100 * kMs;
+	constexpr double kUrgentShare = 0.001;
+
+	struct Policy {
+		const char* name;
+		unsigned int min_batch, max_batch;
+		Tick deadline;
+	};
+
+	struct Load {
+		const char* name;
+		double rate;            // events per second
+		double burst_rate;      // during bursts, 0 for none
+		Tick burst_len, burst_every;
+	};
+
+	enum EventKind { kArrival, kFlushTimer, kConsumerWake, kConsumerDone, kIdleWake };
+
+	struct Event {
+		Tick time;
+		EventKind kind;
+		unsigned long long gen;
+		bool operator>(const Event& o) const { return time > o.time; }
+	};
+
+	struct Stats {
+		unsigned long long records = 0;
+		unsigned long long messages = 0;
+		unsigned long long wakeups = 0;
+		std::vector<Tick> latency;
+	};
+
+	Stats Run(const Policy& pol, const Load& load, Tick duration, unsigned int seed)
+	{
+		std::mt19937_64 rng(seed), urgent_rng(seed + 1);
+		std::uniform_real_distribution<double> uni(0.0, 1.0);
+		std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+
+		shm::FlushPolicy flush;
+		shm::InitFlushPolicy(flush, pol.min_batch, pol.max_batch, pol.deadline);
+
+		std::deque<Tick> ring;              // publish times of undrained records
+		bool waiting = true;                // consumer_waiting
+		bool event_set = false;
+		unsigned long long timer_gen = 0, idle_gen = 0;
+		Stats st;
+
+		auto rate_at = [&](Tick t) {
+			if (load.burst_rate != 0 && t % load.burst_every < load.burst_len) {
+				return load.burst_rate;
+			}
+			return load.rate;
+		};
+		auto next_arrival = [&](Tick t) {
+			double gap = -std::log(1.0 - uni(rng)) / rate_at(t) * kSecond;
+			return t + 1 + (Tick)gap;
+		};
+		auto signal = [&](Tick t, shm::FlushReason reason) {
+			if (!event_set) {
+				event_set = true;
+				st.messages++;
+				events.push({ t + kWakeCost, kConsumerWake, 0 });
+			}
+			shm::OnFlush(flush, t, reason);
+		};
+		auto drain = [&](Tick t) {
+			// Everything published so far, one record at a time.
+			Tick done = t;
+			while (!ring.empty()) {
+				done += kRecordCost;
+				st.latency.push_back(done - ring.front());
+				ring.pop_front();
+			}
+			events.push({ done, kConsumerDone, 0 });
+		};
+
+		events.push({ next_arrival(0), kArrival, 0 });
+		events.push({ kIdleTimeout, kIdleWake, idle_gen });
+
+		while (!events.empty()) {
+			Event e = events.top();
+			events.pop();
+			if (e.time > duration && e.kind == kArrival) {
+				continue;
+			}
+			if (e.time > duration + kSecond) {
+				break;
+			}
+
+			switch (e.kind)
+			{
+			case kArrival:
+			{
+				st.records++;
+				ring.push_back(e.time);
+				if (!waiting) {
+					shm::ClearFlushPolicy(flush);
+				}
+				else {
+					bool urgent = uni(urgent_rng) < kUrgentShare;
+					shm::FlushReason reason = shm::AddFlushRecord(flush, e.time, urgent);
+					if (reason != shm::kFlushNone) {
+						signal(e.time, reason);
+					}
+					else if (flush.pending == 1) {
+						events.push({ e.time + pol.deadline, kFlushTimer, ++timer_gen });
+					}
+				}
+				events.push({ next_arrival(e.time), kArrival, 0 });
+				break;
+			}
+			case kFlushTimer:
+				// KeSetTimer re-arms, so only the latest timer counts.
+				if (e.gen == timer_gen && waiting && flush.pending != 0) {
+					signal(e.time, shm::kFlushDeadline);
+				}
+				break;
+			case kConsumerWake:
+			case kIdleWake:
+				if (e.kind == kIdleWake && (e.gen != idle_gen || !waiting || event_set)) {
+					break;
+				}
+				// FinishSharedRingWait, then drain.
+				event_set = false;
+				waiting = false;
+				st.wakeups++;
+				drain(e.time);
+				break;
+			case kConsumerDone:
+				if (!ring.empty()) {
+					drain(e.time);
+				}
+				else {
+					// PrepareSharedRingWait found nothing: sleep.
+					waiting = true;
+					events.push({ e.time + kIdleTimeout, kIdleWake, ++idle_gen });
+				}
+				break;
+			}
+		}
+		return st;
+	}
+
+	double PercentileUs(std::vector<Tick>& v, double q)
+	{
+		if (v.empty()) {
+			return 0;
+		}
+		size_t k = (size_t)(q * (v.size() - 1));
+		std::nth_element(v.begin(), v.begin() + k, v.end());
+		return (double)v[k] / kUs;
+	}
+
+	double MeanUs(const std::vector<Tick>& v)
+	{
+		double sum = 0;
+		for (Tick t : v) {
+			sum += (double)t;
+		}
+		return v.empty() ? 0 : sum / v.size() / kUs;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Tick seconds = argc > 1 ? (Tick)atoi(argv[1]) : 20;
+	Tick duration = seconds * kSecond;
+
+	const Policy policies[] = {
+		{ "immediate", 1, 1, 2 * kMs },
+		{ "fixed32", 32, 32, 2 * kMs },
+		{ "adaptive", 1, 256, 2 * kMs },     // the channel's settings
+	};
+	const Load loads[] = {
+		{ "idle", 20, 0, 0, 1 },
+		{ "desktop", 500, 0, 0, 1 },
+		{ "build", 20000, 0, 0, 1 },
+		{ "bursty", 200, 100000, 300 * kMs, 3 * kSecond },
+		{ "encrypt", 150000, 0, 0, 1 },
+	};
+
+	printf("# %llu s per load, wake %llu us, %llu us/record, deadline 2 ms\n",
+		seconds, kWakeCost / kUs, kRecordCost / kUs);
+	printf("%-8s %-10s %10s %10s %8s %10s %10s %10s\n", "load", "policy", "events/s", "msgs/s", "batch", "mean_us", "p99_us", "added_us");
+	for (const Load& load : loads) {
+		double base_mean = 0;
+		for (const Policy& pol : policies) {
+			Stats st = Run(pol, load, duration, 20042003);
+			double mean = MeanUs(st.latency);
+			if (&pol == &policies[0]) {
+				base_mean = mean;
+			}
+			printf("%-8s %-10s %10.0f %10.1f %8.1f %10.1f %10.1f %10.1f\n", load.name, pol.name,
+				(double)st.records / seconds, (double)st.messages / seconds,
+				st.wakeups ? (double)st.latency.size() / st.wakeups : 0.0,
+				mean, PercentileUs(st.latency, 0.99), mean - base_mean);
+		}
+	}
+	return 0;
+}
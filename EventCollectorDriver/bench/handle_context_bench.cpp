@@ -0,0 +1,387 @@
+/*
+Bytes per open handle for the collector's HANDLE_CONTEXT, before and after
+the compact layout with deferred allocation (function/collector.h,
+function/colletor.cpp).
+
+  before   every successful open allocates a context: two std::WString
+           paths, ten LONGLONGs and fourteen bools, zeroed with memset.
+           Paths over kInlineCapacity characters go to the heap, and
+           nothing ever runs the WString destructors.
+  after    a context is allocated at the first read, write, rename, delete,
+           FSCTL or section map, or at create for new files and
+           delete-on-close opens. Flags are one word, counters are grouped
+           by direction, and both paths are references to interned entries
+           (std/map/path_table.h), shared by every handle on the file.
+
+A fixed population of handles is opened on files picked with a hot set
+(most opens land on a few files), each one doing nothing, reading,
+writing, creating, renaming or deleting in the given proportions. Bytes
+are the context sizes plus what the driver's own allocator holds for
+paths (the slab allocator on the user-mode backend), counted while every
+handle is open and again after they are all closed. FltMgr's per-context
+header and the lazily allocated byte histograms are the same for a
+context in both layouts and are not counted.
+
+Also runs threads interning and releasing the same few paths through the
+real path table under PushLock, as function/path_cache.cpp does, and
+checks that every entry is freed once.
+
+Checks, exiting non-zero on failure: after closing, the new layout holds
+no path bytes and the table is empty; the stress test leaves nothing.
+
+Usage: handle_context_bench [handles] [files] [idle-percent]
+
+Kept free of the C++ library, like wstring_test.cpp: the driver's headers
+declare their own namespace std.
+*/
+#include "kstd/string/wstring.h"
+#include "kstd/algo/hash.h"
+#include "kstd/map/path_table.h"
+#include "kstd/sync/ex_push_lock.h"
+#include "kstd_shim/slab_user.h"
+
+#include <new>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace {
+	constexpr unsigned int kStringTag = 0x7274534b;   // 'rtSK', as in the shim
+	constexpr unsigned int kPathTag = 0x6874504b;     // 'htPK'
+
+	int failures = 0;
+
+	void Check(bool ok, const char* what)
+	{
+		if (!ok) {
+			fprintf(stderr, "FAIL: %s\n", what);
+			failures++;
+		}
+	}
+
+	unsigned long long TagBytes(unsigned int tag)
+	{
+		return krnl_std::GetSlabTagStats(tag).bytes;
+	}
+
+	// ===== The two layouts, with Windows type sizes =====
+
+	struct OldContext {
+		unsigned int requestor_pid;
+		void* process;
+		std::WString path;
+		long long file_size;
+		bool is_read;
+		bool is_modified;
+		long long first_write_timestamp;
+		long long last_write_timestamp;
+		long long write_cnt_bytes;
+		long long write_cnt_times;
+		void* write_stats;
+		long long first_read_timestamp;
+		long long last_read_timestamp;
+		long long read_cnt_bytes;
+		long long read_cnt_times;
+		void* read_stats;
+		bool is_renamed;
+		std::WString new_path;
+		bool is_created;
+		bool is_deleted;
+		bool is_alloc;
+		bool is_eof;
+		bool is_fvdli;
+		bool is_fs_ow;
+		bool is_fs_wre;
+		bool is_fs_szd;
+		bool is_mmap_open;
+		bool is_mmap_modified;
+	};
+
+	struct IoCounters {
+		long long first_timestamp;
+		long long last_timestamp;
+		long long cnt_bytes;
+		long long cnt_times;
+		void* stats;
+		unsigned long long lock;    // KSPIN_LOCK
+	};
+
+	struct NewContext {
+		krnl_std::PathEntry* path;
+		krnl_std::PathEntry* new_path;
+		void* process;
+		unsigned int requestor_pid;
+		volatile int flags;
+		long long file_size;
+		IoCounters write;
+		IoCounters read;
+	};
+
+	// ===== function/path_cache.cpp =====
+
+	PushLock path_lock;
+	krnl_std::PathTable path_table;
+
+	krnl_std::PathEntry* InternPath(const std::WStringView& path)
+	{
+		unsigned long long key = HashWstring(path);
+		{
+			PushLock::AutoShared lock(path_lock);
+			krnl_std::PathEntry* e = krnl_std::FindPathEntry(path_table, key, path);
+			if (e != nullptr) {
+				return e;
+			}
+		}
+		krnl_std::PathEntry* e = (krnl_std::PathEntry*)krnl_std::Alloc(krnl_std::PathEntryBytes(path.Size()), kPathTag);
+		if (e == nullptr) {
+			return nullptr;
+		}
+		krnl_std::InitPathEntry(e, key, path);
+		krnl_std::PathEntry* existing = nullptr;
+		{
+			PushLock::AutoExclusive lock(path_lock);
+			existing = krnl_std::InsertPathEntry(path_table, e);
+		}
+		if (existing != nullptr) {
+			krnl_std::Free(e);
+			return existing;
+		}
+		return e;
+	}
+
+	void ReleasePath(krnl_std::PathEntry* e)
+	{
+		if (e == nullptr || krnl_std::DereferencePathEntryShared(e)) {
+			return;
+		}
+		bool is_last = false;
+		{
+			PushLock::AutoExclusive lock(path_lock);
+			is_last = krnl_std::DereferencePathEntryLocked(path_table, e);
+		}
+		if (is_last) {
+			krnl_std::Free(e);
+		}
+	}
+
+	// ===== Workload =====
+
+	unsigned long long rng_state = 0x9e3779b97f4a7c15ull;
+
+	unsigned long long Next(unsigned long long& x)
+	{
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		return x;
+	}
+
+	void AppendAscii(std::WString& s, const char* a)
+	{
+		for (; *a != 0; a++) {
+			s.PushBack((WCHAR)*a);
+		}
+	}
+
+	void AppendNumber(std::WString& s, unsigned long long n)
+	{
+		char buf[24];
+		snprintf(buf, sizeof(buf), "%llu", n);
+		AppendAscii(s, buf);
+	}
+
+	// Paths of 50 to 120 characters under a few user directories.
+	std::WString MakePath(unsigned long long i)
+	{
+		static const char* dirs[] = {
+			"\\Device\\HarddiskVolume3\\Users\\someone\\Documents\\",
+			"\\Device\\HarddiskVolume3\\Users\\someone\\Desktop\\Projects\\quarterly-report\\",
+			"\\Device\\HarddiskVolume3\\Users\\someone\\Pictures\\2026\\Holiday\\",
+			"\\Device\\HarddiskVolume3\\Users\\someone\\AppData\\Local\\Vendor\\Product\\cache\\",
+		};
+		static const char* exts[] = { ".docx", ".xlsx", ".jpg", ".pdf", ".txt", ".dat" };
+		std::WString s;
+		AppendAscii(s, dirs[i % 4]);
+		AppendAscii(s, "file_");
+		AppendNumber(s, i);
+		AppendAscii(s, exts[(i / 4) % 6]);
+		return s;
+	}
+
+	enum Action { kIdle, kRead, kWrite, kCreate, kRename, kDelete };
+
+	// idle_pct of the handles do nothing; the rest split 60/25/8/4/3 across
+	// read, write, create, rename, delete.
+	Action PickAction(unsigned long long r, unsigned int idle_pct)
+	{
+		unsigned int p = (unsigned int)(r % 1000);
+		if (p < idle_pct * 10) {
+			return kIdle;
+		}
+		unsigned int q = (unsigned int)((r / 1000) % 100);
+		if (q < 60) return kRead;
+		if (q < 85) return kWrite;
+		if (q < 93) return kCreate;
+		if (q < 97) return kRename;
+		return kDelete;
+	}
+
+	struct Handle {
+		unsigned int file;
+		Action action;
+		OldContext* old_ctx;
+		NewContext* new_ctx;
+	};
+
+	struct Totals {
+		unsigned long long contexts;
+		unsigned long long context_bytes;
+		unsigned long long path_bytes;
+		unsigned long long path_bytes_after_close;
+	};
+
+	void Report(const char* name, const Totals& t, unsigned int handles)
+	{
+		unsigned long long total = t.context_bytes + t.path_bytes;
+		printf("  %-7s %9llu %12llu %12llu %10.1f %14llu\n", name, t.contexts, t.context_bytes, t.path_bytes,
+			(double)total / handles, t.path_bytes_after_close);
+	}
+
+	// ===== Interning under concurrent opens and closes =====
+
+	constexpr unsigned int kStressPaths = 64;
+	constexpr unsigned int kStressHeld = 32;
+	std::WString* stress_paths;
+
+	void* StressThread(void* arg)
+	{
+		unsigned long long x = 0x2545f4914f6cdd1dull * ((unsigned long long)(size_t)arg + 1);
+		krnl_std::PathEntry* held[kStressHeld] = {};
+		for (unsigned int i = 0; i < 200000; i++) {
+			unsigned int slot = (unsigned int)(Next(x) % kStressHeld);
+			ReleasePath(held[slot]);
+			const std::WString& p = stress_paths[Next(x) % kStressPaths];
+			held[slot] = InternPath(p);
+			if (held[slot] == nullptr || krnl_std::PathText(held[slot]) != p) {
+				__atomic_fetch_add(&failures, 1, __ATOMIC_RELAXED);
+			}
+		}
+		for (unsigned int i = 0; i < kStressHeld; i++) {
+			ReleasePath(held[i]);
+		}
+		return nullptr;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int handles = argc > 1 ? (unsigned int)strtoul(argv[1], nullptr, 10) : 32768;
+	unsigned int files = argc > 2 ? (unsigned int)strtoul(argv[2], nullptr, 10) : 4096;
+	unsigned int idle_pct = argc > 3 ? (unsigned int)strtoul(argv[3], nullptr, 10) : 70;
+	if (handles == 0 || files == 0 || idle_pct > 100) {
+		fprintf(stderr, "usage: handle_context_bench [handles] [files] [idle-percent]\n");
+		return 2;
+	}
+
+	path_lock.Create();
+	krnl_std::InitPathTable(path_table);
+
+	std::WString* paths = new std::WString[files];
+	std::WString* renamed = new std::WString[files];
+	for (unsigned int i = 0; i < files; i++) {
+		paths[i] = MakePath(i);
+		renamed[i] = paths[i];
+		AppendAscii(renamed[i], ".locked");
+	}
+
+	// 80% of the opens go to a hot fifth of the files.
+	Handle* hs = (Handle*)calloc(handles, sizeof(Handle));
+	unsigned int hot = files / 5 != 0 ? files / 5 : 1;
+	for (unsigned int i = 0; i < handles; i++) {
+		unsigned long long r = Next(rng_state);
+		hs[i].file = (r % 10 < 8) ? (unsigned int)((r >> 8) % hot) : (unsigned int)((r >> 8) % files);
+		hs[i].action = PickAction(Next(rng_state), idle_pct);
+	}
+
+	// Before: PostFileCreate allocated and memset a context for every open.
+	Totals before = {};
+	unsigned long long strings_base = TagBytes(kStringTag);
+	for (unsigned int i = 0; i < handles; i++) {
+		Handle& h = hs[i];
+		// Value-initialized: zeroed like the memset, without writing over
+		// the WStrings' representation.
+		h.old_ctx = new (malloc(sizeof(OldContext))) OldContext();
+		std::WString current_path(paths[h.file]);
+		h.old_ctx->path = Move(current_path);
+		if (h.action == kRename) {
+			h.old_ctx->is_renamed = true;
+			h.old_ctx->new_path = renamed[h.file];
+		}
+		before.contexts++;
+		before.context_bytes += sizeof(OldContext);
+	}
+	before.path_bytes = TagBytes(kStringTag) - strings_base;
+	for (unsigned int i = 0; i < handles; i++) {
+		// FltMgr frees the context; the WStrings inside are never destroyed.
+		free(hs[i].old_ctx);
+	}
+	before.path_bytes_after_close = TagBytes(kStringTag) - strings_base;
+
+	// After: a context only for handles that do something.
+	Totals after = {};
+	unsigned long long interned_base = TagBytes(kPathTag);
+	for (unsigned int i = 0; i < handles; i++) {
+		Handle& h = hs[i];
+		if (h.action == kIdle) {
+			continue;
+		}
+		h.new_ctx = (NewContext*)malloc(sizeof(NewContext));
+		memset(h.new_ctx, 0, sizeof(NewContext));
+		h.new_ctx->path = InternPath(paths[h.file]);
+		if (h.action == kRename) {
+			h.new_ctx->new_path = InternPath(renamed[h.file]);
+		}
+		after.contexts++;
+		after.context_bytes += sizeof(NewContext);
+	}
+	after.path_bytes = TagBytes(kPathTag) - interned_base;
+	for (unsigned int i = 0; i < handles; i++) {
+		// ContextCleanup.
+		if (hs[i].new_ctx != nullptr) {
+			ReleasePath(hs[i].new_ctx->path);
+			ReleasePath(hs[i].new_ctx->new_path);
+			free(hs[i].new_ctx);
+		}
+	}
+	after.path_bytes_after_close = TagBytes(kPathTag) - interned_base;
+	Check(after.path_bytes_after_close == 0, "interned paths freed after every handle closed");
+	Check(path_table.count == 0, "path table empty after every handle closed");
+
+	printf("handle contexts: %u open handles on %u files, %u%% idle\n", handles, files, idle_pct);
+	printf("  sizeof: before %zu, after %zu bytes\n", sizeof(OldContext), sizeof(NewContext));
+	printf("  %-7s %9s %12s %12s %10s %14s\n", "layout", "contexts", "ctx bytes", "path bytes", "B/handle", "leaked bytes");
+	Report("before", before, handles);
+	Report("after", after, handles);
+
+	// Interning under contention.
+	stress_paths = new std::WString[kStressPaths];
+	for (unsigned int i = 0; i < kStressPaths; i++) {
+		stress_paths[i] = MakePath(i * 7919);
+	}
+	unsigned long long stress_base = TagBytes(kPathTag);
+	pthread_t threads[4];
+	for (size_t t = 0; t < 4; t++) {
+		pthread_create(&threads[t], nullptr, StressThread, (void*)t);
+	}
+	for (size_t t = 0; t < 4; t++) {
+		pthread_join(threads[t], nullptr);
+	}
+	Check(TagBytes(kPathTag) == stress_base && path_table.count == 0, "concurrent intern/release frees every entry once");
+	printf("  intern/release stress: 4 threads x 200000, %llu entries left\n", path_table.count);
+
+	delete[] stress_paths;
+	delete[] paths;
+	delete[] renamed;
+	free(hs);
+	return failures != 0;
+}
@@ -0,0 +1,207 @@
+/*
+Measures the per-IO cost of the write/read entropy in PreWriteFile /
+PostReadFile, using the same headers the driver compiles.
+
+Counting (per IO, table cleared each time):
+  baseline : new LONGLONG[256] + scalar count + Taylor Log2 entropy + delete
+  scalar32 : reused 32-bit table + scalar count
+  split32  : CountByteHistogram (4 interleaved tables, SSE2 loads on x64)
+
+Entropy (per 256-bin table):
+  taylor   : old per-bin math::Log2 path
+  table    : InitEntropyTables() + n*log2(n) lookup
+  both are compared against std::log2 as the reference.
+
+Usage: histogram_bench [iterations_scale]
+Exits non-zero if the counting variants disagree or the table entropy drifts
+more than 1e-6 bits from std::log2.
+*/
+#include "../std/algo/entropy.h"
+#include "../std/algo/histogram.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+	struct Sizes {
+		unsigned int bytes;
+		unsigned int iterations;
+	};
+
+	// Typical IRP sizes: small appends, 4 KB pages, 64 KB cached I/O, 1 MB copies.
+	const Sizes kSizes[] = {
+		{ 512, 200000 },
+		{ 4096, 50000 },
+		{ 65536, 4000 },
+		{ 1 << 20, 250 },
+	};
+
+	constexpr double kMaxEntropyError = 1e-6;
+
+	double ReferenceEntropy(const long long* freq, long long total)
+	{
+		double entropy = 0.0;
+		for (int i = 0; i < 256; i++) {
+			if (freq[i] == 0) {
+				continue;
+			}
+			double p = (double)freq[i] / (double)total;
+			entropy -= p * std::log2(p);
+		}
+		return entropy;
+	}
+
+	double TaylorEntropy(const long long* freq, long long total)
+	{
+		bool ready = math::g_IsEntropyTableInit;
+		math::g_IsEntropyTableInit = false;
+		double e = math::ComputeByteEntropyFromFreq(freq, total);
+		math::g_IsEntropyTableInit = ready;
+		return e;
+	}
+
+	double BaselineIo(const unsigned char* buf, unsigned int len)
+	{
+		auto freq = new long long[math::kByteHistogramBins];
+		memset(freq, 0, sizeof(long long) * math::kByteHistogramBins);
+		math::AccumulateByteHistogram(buf, len, freq);
+		double e = TaylorEntropy(freq, len);
+		delete[] freq;
+		return e;
+	}
+
+	template <typename Fn>
+	double NsPerCall(unsigned int iterations, double* sink, Fn fn)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < iterations; i++) {
+			*sink += fn();
+		}
+		auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		return (double)ns / iterations;
+	}
+
+	double GbPerSec(unsigned int bytes, double ns)
+	{
+		return bytes / ns;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	double scale = argc >= 2 ? atof(argv[1]) : 1.0;
+	if (scale <= 0) {
+		scale = 1.0;
+	}
+
+	math::InitEntropyTables();
+
+	std::mt19937 rng(20042003);
+	std::vector<unsigned char> random_data(1 << 20);
+	std::vector<unsigned char> text_data(1 << 20);
+	std::vector<unsigned char> zero_data(1 << 20, 0);
+	const char* words = "the quick brown fox jumps over the lazy dog 0123456789\r\n";
+	size_t words_len = strlen(words);
+	for (size_t i = 0; i < random_data.size(); i++) {
+		random_data[i] = (unsigned char)rng();
+		text_data[i] = (unsigned char)words[rng() % words_len];
+	}
+
+	struct Input {
+		const char* name;
+		const unsigned char* data;
+	} inputs[] = {
+		{ "random", random_data.data() },
+		{ "text", text_data.data() },
+		{ "zeros", zero_data.data() },
+	};
+
+	int failures = 0;
+	double sink = 0;
+	math::ByteHistogram32 freq32;
+	math::ByteHistogramScratch32 scratch;
+
+	printf("# counting, ns per IO (GB/s)\n");
+	printf("%-7s %8s %20s %20s %20s\n", "input", "bytes", "baseline", "scalar32", "split32");
+	for (const auto& in : inputs) {
+		for (const auto& sz : kSizes) {
+			unsigned int iterations = (unsigned int)(sz.iterations * scale);
+			if (iterations == 0) {
+				iterations = 1;
+			}
+
+			memset(freq32, 0, sizeof(freq32));
+			math::AccumulateByteHistogram(in.data, sz.bytes, freq32);
+			const unsigned int* split = math::CountByteHistogram(in.data, sz.bytes, scratch);
+			if (memcmp(freq32, split, sizeof(freq32)) != 0) {
+				fprintf(stderr, "histogram mismatch (%s, %u)\n", in.name, sz.bytes);
+				failures++;
+			}
+
+			double base_ns = NsPerCall(iterations, &sink, [&] { return BaselineIo(in.data, sz.bytes); });
+			double scalar_ns = NsPerCall(iterations, &sink, [&] {
+				memset(freq32, 0, sizeof(freq32));
+				math::AccumulateByteHistogram(in.data, sz.bytes, freq32);
+				return (double)freq32[in.data[0]];
+				});
+			double split_ns = NsPerCall(iterations, &sink, [&] {
+				return (double)math::CountByteHistogram(in.data, sz.bytes, scratch)[in.data[0]];
+				});
+			printf("%-7s %8u %11.1f (%5.2f) %11.1f (%5.2f) %11.1f (%5.2f)\n", in.name, sz.bytes,
+				base_ns, GbPerSec(sz.bytes, base_ns),
+				scalar_ns, GbPerSec(sz.bytes, scalar_ns),
+				split_ns, GbPerSec(sz.bytes, split_ns));
+		}
+	}
+
+	// Error against std::log2 over skewed and uniform-ish tables of many sizes.
+	double max_err_table = 0, max_err_taylor = 0;
+	long long freq64[256];
+	for (int trial = 0; trial < 20000; trial++) {
+		long long total = 0;
+		unsigned int spread = 1 + rng() % 256;
+		unsigned int max_bits = 1 + rng() % 31;
+		for (int i = 0; i < 256; i++) {
+			// Per-bin magnitudes vary too, so tables mix tiny and huge counts.
+			unsigned int bits = 1 + rng() % max_bits;
+			freq64[i] = (unsigned int)i < spread ? (long long)(rng() & ((1u << bits) - 1)) : 0;
+			total += freq64[i];
+		}
+		if (total == 0) {
+			continue;
+		}
+		double ref = ReferenceEntropy(freq64, total);
+		max_err_table = (std::max)(max_err_table, std::fabs(math::ComputeByteEntropyFromFreq(freq64, total) - ref));
+		max_err_taylor = (std::max)(max_err_taylor, std::fabs(TaylorEntropy(freq64, total) - ref));
+	}
+
+	printf("# entropy, ns per table (4 KB of input) / max abs error vs std::log2 (bits)\n");
+	printf("%-7s %10s %10s %10s\n", "input", "taylor", "table", "chi2");
+	unsigned int entropy_iterations = (unsigned int)(200000 * scale) + 1;
+	for (const auto& in : inputs) {
+		memset(freq64, 0, sizeof(freq64));
+		math::AccumulateByteHistogram(in.data, 4096, freq64);
+		double taylor_ns = NsPerCall(entropy_iterations, &sink, [&] { return TaylorEntropy(freq64, 4096); });
+		double table_ns = NsPerCall(entropy_iterations, &sink, [&] { return math::ComputeByteEntropyFromFreq(freq64, 4096); });
+		double chi_ns = NsPerCall(entropy_iterations, &sink, [&] { return math::ComputeByteChiSquareFromFreq(freq64, 4096); });
+		printf("%-7s %10.1f %10.1f %10.1f  chi2=%.1f\n", in.name, taylor_ns, table_ns, chi_ns,
+			math::ComputeByteChiSquareFromFreq(freq64, 4096));
+	}
+	printf("max_error taylor %.3g table %.3g\n", max_err_taylor, max_err_table);
+
+	if (max_err_table > kMaxEntropyError) {
+		fprintf(stderr, "table entropy error %.3g above %.3g\n", max_err_table, kMaxEntropyError);
+		failures++;
+	}
+
+	// Keeps the timed loops from being optimized away.
+	if (sink < 0) {
+		printf("%f\n", sink);
+	}
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,21 @@
+// Compiled against the driver's std/set/set.h and std/map/map.h (copied next
+// to the shim memory.h at configure time), so the benchmarks measure the real
+// containers.
+// Kept in its own translation unit: the driver headers cannot share one with
+// the C++ standard library.
+#include "kstd/set/set.h"
+#include "kstd/map/map.h"
+
+void* KernelSetCreate() { return new Set<ull>(); }
+void KernelSetDestroy(void* s) { delete (Set<ull>*)s; }
+bool KernelSetContains(void* s, ull key) { return ((Set<ull>*)s)->Find(key) != ((Set<ull>*)s)->End(); }
+bool KernelSetInsert(void* s, ull key) { return ((Set<ull>*)s)->Insert(key).second; }
+void KernelSetErase(void* s, ull key) { ((Set<ull>*)s)->Erase(key); }
+ull KernelSetSize(void* s) { return ((Set<ull>*)s)->Size(); }
+void KernelSetClear(void* s) { ((Set<ull>*)s)->Clear(); }
+
+void* KernelMapCreate() { return new Map<ull, ull>(); }
+void KernelMapDestroy(void* m) { delete (Map<ull, ull>*)m; }
+bool KernelMapInsert(void* m, ull key, ull value) { return ((Map<ull, ull>*)m)->Insert(key, value).second; }
+void KernelMapErase(void* m, ull key) { ((Map<ull, ull>*)m)->Erase(key); }
+ull KernelMapSize(void* m) { return ((Map<ull, ull>*)m)->Size(); }
@@ -0,0 +1,74 @@
+#pragma once
+
+// Stand-in for std/memory/memory.h when the driver's containers are built in
+// user mode (see CMakeLists.txt). Only what std/set/set.h, std/map/map.h and
+// std/string/wstring.h need: C headers only, the driver's `namespace std`
+// cannot share a translation unit with the C++ library. krnl_std::Alloc and
+// Free are the slab allocator on the user-mode backend (slab_user.cpp).
+
+typedef unsigned long long ull;
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wctype.h>
+
+#include "../ulti/def.h"
+
+// The few WDK types and routines wstring.h uses. WCHAR is UTF-16 as in the
+// driver, so tests write u"" literals.
+typedef char16_t WCHAR;
+typedef unsigned short USHORT;
+typedef unsigned long ULONG;
+typedef void* PVOID;
+typedef long NTSTATUS;
+
+typedef struct _UNICODE_STRING
+{
+    USHORT Length;
+    USHORT MaximumLength;
+    WCHAR* Buffer;
+} UNICODE_STRING, *PUNICODE_STRING;
+
+#define UNICODE_STRING_MAX_BYTES ((USHORT)65534)
+#define STATUS_INSUFFICIENT_RESOURCES ((NTSTATUS)0xC000009AL)
+#define STATUS_NAME_TOO_LONG ((NTSTATUS)0xC0000106L)
+
+#define __forceinline inline __attribute__((always_inline))
+
+[[noreturn]] inline void ExRaiseStatus(NTSTATUS) { abort(); }
+[[noreturn]] inline void ExRaiseAccessViolation() { abort(); }
+inline WCHAR RtlUpcaseUnicodeChar(WCHAR c) { return (WCHAR)towupper(c); }
+inline WCHAR RtlDowncaseUnicodeChar(WCHAR c) { return (WCHAR)towlower(c); }
+
+#define max(X, Y) (((X) > (Y)) ? (X) : (Y))
+#define min(X, Y) (((X) < (Y)) ? (X) : (Y))
+
+#define ULL_MAX 0xFFFFFFFFFFFFFFFF
+
+namespace krnl_std
+{
+    constexpr unsigned int kPoolTag = 0x22042003;
+    // The driver's multi-character tags, spelled out so GCC does not warn.
+    constexpr unsigned int kStringTag = 0x7274534b;  // 'rtSK'
+    constexpr unsigned int kSetTag = 0x7465534b;     // 'teSK'
+    constexpr unsigned int kMapTag = 0x70614d4b;     // 'paMK'
+    constexpr unsigned int kTrieTag = 0x6972544b;    // 'irTK'
+    constexpr unsigned int kPathTag = 0x6874504b;    // 'htPK'
+
+    struct retry_t {};
+    constexpr retry_t retry;
+
+    void* Alloc(ull n, unsigned int tag = kPoolTag);
+    void Free(void* p);
+
+    // The driver's backs off between attempts; here a failure injected for
+    // good would spin, which no test does.
+    inline void* AllocRetry(ull n, unsigned int tag = kPoolTag)
+    {
+        void* p;
+        while ((p = Alloc(n, tag)) == nullptr) {
+        }
+        return p;
+    }
+}
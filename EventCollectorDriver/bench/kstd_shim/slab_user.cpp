@@ -0,0 +1,160 @@
+// malloc-backed stand-in for the driver's lookaside lists: one free list per
+// class under a mutex, holding at most kDepth blocks like a lookaside list.
+
+#include "slab_user.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+
+namespace krnl_std
+{
+    namespace
+    {
+        constexpr unsigned int kDepth = 256;
+
+        std::atomic<long long> fail_after{ -1 };
+        std::atomic<unsigned long long> tag_mismatches{ 0 };
+
+        bool InjectFailure()
+        {
+            long long left = fail_after.load(std::memory_order_relaxed);
+            while (left >= 0) {
+                if (left == 0) {
+                    return true;
+                }
+                if (fail_after.compare_exchange_weak(left, left - 1, std::memory_order_relaxed)) {
+                    return false;
+                }
+            }
+            return false;
+        }
+
+        struct FreeBlock
+        {
+            FreeBlock* next;
+        };
+
+        struct UserSlabBackend
+        {
+            struct List
+            {
+                std::mutex lock;
+                FreeBlock* head = nullptr;
+                unsigned int depth = 0;
+            } lists[kSlabClassCount];
+
+            void* Get(unsigned int cls)
+            {
+                if (InjectFailure()) {
+                    return nullptr;
+                }
+                List& l = lists[cls];
+                {
+                    std::lock_guard<std::mutex> g(l.lock);
+                    if (l.head != nullptr) {
+                        FreeBlock* b = l.head;
+                        l.head = b->next;
+                        l.depth--;
+                        return b;
+                    }
+                }
+                return aligned_alloc(16, SlabClassBytes(cls));
+            }
+
+            void Put(unsigned int cls, void* block)
+            {
+                List& l = lists[cls];
+                {
+                    std::lock_guard<std::mutex> g(l.lock);
+                    if (l.depth < kDepth) {
+                        FreeBlock* b = (FreeBlock*)block;
+                        b->next = l.head;
+                        l.head = b;
+                        l.depth++;
+                        return;
+                    }
+                }
+                free(block);
+            }
+
+            void* GetLarge(unsigned long long bytes, unsigned int tag)
+            {
+                if (InjectFailure()) {
+                    return nullptr;
+                }
+                // Page-aligned like a pool allocation of a page or more.
+                void* block = aligned_alloc(4096, (bytes + 4095) & ~4095ULL);
+                // ExFreePoolWithTag checks the tag; the slack in front of the
+                // header is the backend's to keep it in.
+                if (block != nullptr) {
+                    *(unsigned int*)block = tag;
+                }
+                return block;
+            }
+
+            void PutLarge(void* block, unsigned int tag)
+            {
+                if (*(unsigned int*)block != tag) {
+                    tag_mismatches.fetch_add(1, std::memory_order_relaxed);
+                }
+                free(block);
+            }
+        };
+
+        SlabAllocator<UserSlabBackend>& Allocator()
+        {
+            static SlabAllocator<UserSlabBackend>* a = [] {
+                auto* p = new SlabAllocator<UserSlabBackend>();
+                InitSlabAllocator(*p);
+                return p;
+            }();
+            return *a;
+        }
+    }
+
+    void* Alloc(unsigned long long n, unsigned int tag)
+    {
+        return SlabAlloc(Allocator(), n, tag);
+    }
+
+    void Free(void* p)
+    {
+        SlabFree(Allocator(), p);
+    }
+
+    SlabTagStats GetSlabTagStats(unsigned int tag)
+    {
+        SlabTagStats out = {};
+        for (const SlabTagStats& s : Allocator().tags) {
+            if (s.tag == tag) {
+                out.tag = s.tag;
+                out.allocs = s.allocs;
+                out.frees = s.frees;
+                out.bytes = s.bytes;
+                out.failures = s.failures;
+            }
+        }
+        return out;
+    }
+
+    void SetSlabFailAfter(long long after)
+    {
+        fail_after.store(after, std::memory_order_relaxed);
+    }
+
+    unsigned long long SlabLargeTagMismatches()
+    {
+        return tag_mismatches.load(std::memory_order_relaxed);
+    }
+
+    unsigned long long SlabCachedBlocks()
+    {
+        unsigned long long n = 0;
+        for (auto& l : Allocator().backend.lists) {
+            std::lock_guard<std::mutex> g(l.lock);
+            n += l.depth;
+        }
+        return n;
+    }
+}
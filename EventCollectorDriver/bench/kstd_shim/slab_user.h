@@ -0,0 +1,27 @@
+#pragma once
+
+// User-mode backend for std/memory/slab.h: the allocator behind
+// krnl_std::Alloc / Free when the driver's containers are built on Linux,
+// plus the hooks bench/slab_bench.cpp needs to test it.
+
+#include "../../std/memory/slab.h"
+
+namespace krnl_std
+{
+    void* Alloc(unsigned long long n, unsigned int tag);
+    void Free(void* p);
+
+    // Counters of `tag`, all zero if it was never used.
+    SlabTagStats GetSlabTagStats(unsigned int tag);
+
+    // The next `after` backend requests succeed, then every one fails until
+    // called again with a negative value.
+    void SetSlabFailAfter(long long after);
+
+    // Large blocks handed back with a tag other than the one they were
+    // allocated with; a bugcheck in the driver.
+    unsigned long long SlabLargeTagMismatches();
+
+    // Blocks parked on the class free lists.
+    unsigned long long SlabCachedBlocks();
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+// Stand-in for the WDK's <ntddk.h> when std/sync/ex_push_lock.h is built in
+// user mode (see CMakeLists.txt): the push lock routines it calls, on one
+// atomic word, and no-op SAL annotations and critical regions.
+//
+// The word holds an exclusive bit, a writer-waiting bit and a count of shared
+// holders. New shared acquires back off while a writer waits, so a stream of
+// readers cannot starve the writer, as with the kernel's push lock. Waiters
+// spin briefly and then yield; there is no wait queue.
+
+#include <sched.h>
+
+typedef unsigned char UCHAR;
+typedef long NTSTATUS;
+typedef void VOID;
+
+#define STATUS_SUCCESS ((NTSTATUS)0x00000000L)
+#define APC_LEVEL 1
+
+#define _IRQL_requires_max_(irql)
+#define _Acquires_exclusive_lock_(lock)
+#define _Acquires_shared_lock_(lock)
+#define _Releases_exclusive_lock_(lock)
+#define _Releases_shared_lock_(lock)
+#define _Releases_lock_(lock)
+
+typedef struct _EX_PUSH_LOCK
+{
+    unsigned long long Value;
+} EX_PUSH_LOCK, *PEX_PUSH_LOCK;
+
+#define EX_PUSH_LOCK_EXCLUSIVE 1ull
+#define EX_PUSH_LOCK_WAITING 2ull
+#define EX_PUSH_LOCK_SHARE_INC 4ull
+
+inline void KeEnterCriticalRegion() {}
+inline void KeLeaveCriticalRegion() {}
+
+inline void ExInitializePushLock(PEX_PUSH_LOCK lock)
+{
+    __atomic_store_n(&lock->Value, 0, __ATOMIC_RELEASE);
+}
+
+inline void ExPushLockBackOff(unsigned int& spins)
+{
+    if (++spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+    else {
+        sched_yield();
+    }
+}
+
+inline void ExAcquirePushLockExclusive(PEX_PUSH_LOCK lock)
+{
+    unsigned int spins = 0;
+    for (;;) {
+        unsigned long long v = __atomic_load_n(&lock->Value, __ATOMIC_RELAXED);
+        if ((v & ~EX_PUSH_LOCK_WAITING) == 0) {
+            // Taking it clears the waiting bit; other writers set it again.
+            if (__atomic_compare_exchange_n(&lock->Value, &v, EX_PUSH_LOCK_EXCLUSIVE, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                return;
+            }
+            continue;
+        }
+        if ((v & EX_PUSH_LOCK_WAITING) == 0) {
+            __atomic_fetch_or(&lock->Value, EX_PUSH_LOCK_WAITING, __ATOMIC_RELAXED);
+        }
+        ExPushLockBackOff(spins);
+    }
+}
+
+inline void ExAcquirePushLockShared(PEX_PUSH_LOCK lock)
+{
+    unsigned int spins = 0;
+    for (;;) {
+        unsigned long long v = __atomic_load_n(&lock->Value, __ATOMIC_RELAXED);
+        if ((v & (EX_PUSH_LOCK_EXCLUSIVE | EX_PUSH_LOCK_WAITING)) == 0) {
+            if (__atomic_compare_exchange_n(&lock->Value, &v, v + EX_PUSH_LOCK_SHARE_INC, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                return;
+            }
+            continue;
+        }
+        ExPushLockBackOff(spins);
+    }
+}
+
+inline void ExReleasePushLockExclusive(PEX_PUSH_LOCK lock)
+{
+    __atomic_fetch_and(&lock->Value, EX_PUSH_LOCK_WAITING, __ATOMIC_RELEASE);
+}
+
+inline void ExReleasePushLockShared(PEX_PUSH_LOCK lock)
+{
+    __atomic_fetch_sub(&lock->Value, EX_PUSH_LOCK_SHARE_INC, __ATOMIC_RELEASE);
+}
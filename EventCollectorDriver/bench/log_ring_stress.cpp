@@ -0,0 +1,344 @@
+/*
+Stress test for std/sync/log_ring.h, the per-processor log rings behind
+PushToLogQueue.
+
+Producer threads format lines straight into the rings, switching ring at
+random to mimic a thread migrating between processors, and now and then
+abort a reservation. One consumer drains all rings the way LogWorkerThread
+does and checks every line:
+  - the payload is intact (per-line checksum),
+  - no line is duplicated, and received + dropped == produced per producer,
+  - lines of one producer come out of one ring in the order they were pushed.
+
+Before that, a single-threaded check that payload bytes compacted over old
+headers cannot pass for a committed header on the next lap.
+
+Afterwards the same load goes through the previous design (one allocation
+per line, appended to an array under a lock) for comparison.
+
+Usage: log_ring_stress [producers] [lines_per_producer] [rings] [ring_kb]
+Exits non-zero on any mismatch.
+*/
+#include "../std/sync/log_ring.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+	constexpr unsigned long long kMaxLine = 512;
+
+	struct ProducerState {
+		unsigned long long produced = 0;
+		unsigned long long dropped = 0;
+		std::vector<unsigned char> seen;
+		std::vector<unsigned long long> last_seq;   // per ring, seq + 1
+	};
+
+	unsigned int Checksum(const char* s, size_t n)
+	{
+		unsigned int h = 2166136261u;
+		for (size_t i = 0; i < n; i++) {
+			h = (h ^ (unsigned char)s[i]) * 16777619u;
+		}
+		return h;
+	}
+
+	// "<producer>,<seq>,<filler>,<checksum of the part before>\n"
+	size_t FormatLine(char* out, size_t cap, unsigned int producer, unsigned long long seq, std::mt19937& rng)
+	{
+		int n = snprintf(out, cap, "%u,%llu,", producer, seq);
+		size_t filler = rng() % 300;
+		for (size_t i = 0; i < filler; i++) {
+			out[n++] = (char)('a' + (seq + i) % 26);
+		}
+		out[n++] = ',';
+		unsigned int sum = Checksum(out, n);
+		n += snprintf(out + n, cap - n, "%08x\n", sum);
+		return (size_t)n;
+	}
+
+	struct Checker {
+		std::vector<ProducerState>* producers;
+		unsigned long long lines = 0;
+		unsigned long long errors = 0;
+
+		void Line(unsigned int ring, const char* s, size_t n)
+		{
+			unsigned int producer = 0;
+			unsigned long long seq = 0;
+			int consumed = 0;
+			if (n < 10 || sscanf(s, "%u,%llu,%n", &producer, &seq, &consumed) < 2 || producer >= producers->size()) {
+				errors++;
+				return;
+			}
+			size_t body = n - 9;    // checksum + '\n'
+			unsigned int sum = (unsigned int)strtoul(std::string(s + body, 8).c_str(), nullptr, 16);
+			if (sum != Checksum(s, body)) {
+				errors++;
+				return;
+			}
+			ProducerState& p = (*producers)[producer];
+			if (seq >= p.seen.size() || p.seen[seq] != 0 || seq + 1 <= p.last_seq[ring]) {
+				errors++;
+				return;
+			}
+			p.seen[seq] = 1;
+			p.last_seq[ring] = seq + 1;
+			lines++;
+		}
+
+		void Run(unsigned int ring, const unsigned char* data, unsigned long long len)
+		{
+			const char* s = (const char*)data;
+			size_t start = 0;
+			for (size_t i = 0; i < len; i++) {
+				if (s[i] == '\n') {
+					Line(ring, s + start, i + 1 - start);
+					start = i + 1;
+				}
+			}
+			if (start != len) {
+				errors++;   // a run always ends on a whole record
+			}
+		}
+	};
+
+	// Lays out a payload that, once compacted to offset 0, reads as committed
+	// headers for every slot of the second lap, then reserves the first slot of
+	// that lap without committing it. The drain must not move past it.
+	bool ForgedStampIgnored()
+	{
+		constexpr unsigned long long kBytes = 4096;
+		std::unique_ptr<unsigned char[]> memory(new unsigned char[kBytes]);
+		krnl_std::LogRing ring;
+		krnl_std::InitLogRing(ring, memory.get(), kBytes);
+		auto ignore = [](const unsigned char*, unsigned long long) {};
+
+		krnl_std::LogReservation res;
+		if (!krnl_std::ReserveLogRecord(ring, kBytes / 4, &res)) {
+			return false;
+		}
+		unsigned long long forged = kBytes / 4;
+		for (unsigned long long off = 0; off < forged; off += krnl_std::kLogRecordAlign) {
+			krnl_std::LogRecordHeader h = { kBytes + off + 1, (unsigned int)krnl_std::kLogRecordAlign, 0 };
+			memcpy(res.data + off, &h, sizeof(h));
+		}
+		krnl_std::CommitLogRecord(res, forged);
+		krnl_std::DrainLogRing(ring, ignore);
+
+		// Walk the rest of the first lap with empty records.
+		while (ring.reserve < kBytes) {
+			if (!krnl_std::ReserveLogRecord(ring, 0, &res)) {
+				return false;
+			}
+			krnl_std::CommitLogRecord(res, 0);
+			krnl_std::DrainLogRing(ring, ignore);
+		}
+		if (ring.reserve != kBytes || !krnl_std::ReserveLogRecord(ring, 0, &res) || res.pos != kBytes) {
+			return false;
+		}
+		krnl_std::DrainLogRing(ring, ignore);
+		bool held = ring.read == kBytes;
+		krnl_std::CommitLogRecord(res, 0);
+		krnl_std::DrainLogRing(ring, ignore);
+		return held && krnl_std::LogRingPending(ring) == 0;
+	}
+
+	double Seconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int producer_count = argc > 1 ? (unsigned int)atoi(argv[1]) : 8;
+	unsigned long long lines = argc > 2 ? strtoull(argv[2], nullptr, 10) : 200000;
+	unsigned int ring_count = argc > 3 ? (unsigned int)atoi(argv[3]) : 4;
+	unsigned long long ring_bytes = (argc > 4 ? strtoull(argv[4], nullptr, 10) : 64) * 1024;
+	if (producer_count == 0 || ring_count == 0 || (ring_bytes & (ring_bytes - 1)) != 0 || ring_bytes < 4 * kMaxLine) {
+		fprintf(stderr, "ring_kb must be a power of two >= %llu\n", 4 * kMaxLine / 1024);
+		return 1;
+	}
+
+	if (!ForgedStampIgnored()) {
+		fprintf(stderr, "FAILED: stale payload bytes read as a committed header\n");
+		return 1;
+	}
+
+	std::vector<ProducerState> producers(producer_count);
+	for (auto& p : producers) {
+		p.seen.assign(lines, 0);
+		p.last_seq.assign(ring_count, 0);
+	}
+
+	std::vector<std::unique_ptr<unsigned char[]>> memory;
+	std::unique_ptr<krnl_std::LogRing[]> rings(new krnl_std::LogRing[ring_count]);
+	for (unsigned int i = 0; i < ring_count; i++) {
+		memory.emplace_back(new unsigned char[ring_bytes]);
+		krnl_std::InitLogRing(rings[i], memory.back().get(), ring_bytes);
+	}
+
+	Checker checker{ &producers };
+	std::atomic<unsigned int> running(producer_count);
+	unsigned long long drained_bytes = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (unsigned int t = 0; t < producer_count; t++) {
+		threads.emplace_back([&, t]() {
+			std::mt19937 rng(20042003 + t);
+			ProducerState& p = producers[t];
+			unsigned int ring = t % ring_count;
+			for (unsigned long long seq = 0; seq < lines; seq++) {
+				if (rng() % 16 == 0) {
+					ring = rng() % ring_count;
+				}
+				p.produced++;
+				krnl_std::LogReservation res;
+				if (!krnl_std::ReserveLogRecord(rings[ring], kMaxLine, &res)) {
+					p.dropped++;
+					std::this_thread::yield();
+					continue;
+				}
+				if (rng() % 64 == 0) {
+					krnl_std::AbortLogRecord(res);
+					p.dropped++;
+					continue;
+				}
+				size_t n = FormatLine((char*)res.data, (size_t)res.cap, t, seq, rng);
+				krnl_std::CommitLogRecord(res, n);
+			}
+			running--;
+			});
+	}
+
+	std::thread consumer([&]() {
+		for (;;) {
+			bool last = running.load() == 0;
+			for (unsigned int i = 0; i < ring_count; i++) {
+				drained_bytes += krnl_std::DrainLogRing(rings[i], [&](const unsigned char* data, unsigned long long len) {
+					checker.Run(i, data, len);
+					});
+			}
+			if (last) {
+				break;
+			}
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+		});
+
+	for (auto& t : threads) {
+		t.join();
+	}
+	consumer.join();
+	double ring_sec = Seconds(start);
+
+	unsigned long long produced = 0;
+	unsigned long long dropped = 0;
+	unsigned long long missing = 0;
+	for (auto& p : producers) {
+		produced += p.produced;
+		dropped += p.dropped;
+		unsigned long long received = 0;
+		for (unsigned char s : p.seen) {
+			received += s;
+		}
+		if (received + p.dropped != p.produced) {
+			missing += p.produced - p.dropped - received;
+		}
+	}
+	unsigned long long ring_full = 0;
+	unsigned long long ring_format = 0;
+	for (unsigned int i = 0; i < ring_count; i++) {
+		ring_full += rings[i].dropped_full;
+		ring_format += rings[i].dropped_format;
+		if (krnl_std::LogRingPending(rings[i]) != 0) {
+			checker.errors++;
+		}
+	}
+
+	printf("# producers %u, lines %llu, rings %u x %llu KB\n", producer_count, lines, ring_count, ring_bytes / 1024);
+	printf("ring     : %llu lines, %llu dropped (%llu full, %llu aborted), %.1f MB, %.2f M lines/s\n",
+		checker.lines, dropped, ring_full, ring_format, drained_bytes / 1048576.0, produced / ring_sec / 1e6);
+
+	// Previous design: one allocation per line, appended under a lock, the
+	// consumer swaps the array out and copies everything once more.
+	{
+		std::mutex lock;
+		std::vector<std::pair<char*, size_t>> active;
+		active.reserve(5000);
+		std::atomic<unsigned int> left(producer_count);
+		std::vector<std::thread> old_threads;
+		auto old_start = std::chrono::steady_clock::now();
+		for (unsigned int t = 0; t < producer_count; t++) {
+			old_threads.emplace_back([&, t]() {
+				std::mt19937 rng(20042003 + t);
+				for (unsigned long long seq = 0; seq < lines; seq++) {
+					char* line = new char[8192]();
+					size_t n = FormatLine(line, 8192, t, seq, rng);
+					std::lock_guard<std::mutex> guard(lock);
+					if (active.size() >= 5000) {
+						delete[] line;
+						continue;
+					}
+					active.emplace_back(line, n);
+				}
+				left--;
+				});
+		}
+		unsigned long long old_bytes = 0;
+		unsigned long long old_lines = 0;
+		std::thread old_consumer([&]() {
+			std::vector<std::pair<char*, size_t>> work;
+			for (;;) {
+				bool last = left.load() == 0;
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					work.swap(active);
+				}
+				size_t total = 0;
+				for (auto& w : work) {
+					total += w.second;
+				}
+				std::unique_ptr<char[]> big(new char[total + 1]);
+				size_t off = 0;
+				for (auto& w : work) {
+					memcpy(big.get() + off, w.first, w.second);
+					off += w.second;
+					delete[] w.first;
+				}
+				old_bytes += off;
+				old_lines += work.size();
+				work.clear();
+				if (last) {
+					break;
+				}
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+			}
+			});
+		for (auto& t : old_threads) {
+			t.join();
+		}
+		old_consumer.join();
+		double old_sec = Seconds(old_start);
+		printf("old      : %llu lines, %llu dropped, %.1f MB, %.2f M lines/s\n",
+			old_lines, produced - old_lines, old_bytes / 1048576.0, produced / old_sec / 1e6);
+	}
+
+	if (checker.errors != 0 || missing != 0 || ring_full + ring_format != dropped) {
+		fprintf(stderr, "FAILED: %llu bad lines, %llu missing, drop counters %llu vs %llu\n",
+			checker.errors, missing, ring_full + ring_format, dropped);
+		return 1;
+	}
+	return 0;
+}
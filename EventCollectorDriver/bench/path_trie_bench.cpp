@@ -0,0 +1,310 @@
+/*
+Tests and measures PathTrie (std/algo/path_trie.h), the compiled form of
+SelfDefenseKernel's protected directory and file lists, built from a copy of
+the driver sources on the user-mode slab allocator.
+
+Checks, exiting non-zero on the first failure:
+  - prefix entries match strictly longer paths only, path entries match
+    exactly, both case-insensitively, on hand-picked edge cases
+  - on generated lists of thousands of entries, the trie agrees with the
+    list scan IsProtectedFile used to do, for hits, misses and near misses
+  - an allocation failure in Compile is reported, matches nothing, and a
+    later Compile succeeds; every kTrieTag block is freed
+
+Then times, per lookup, the old scan (_wcsnicmp over every entry, without
+stopping at a match), the same scan stopping at the first match, and the
+trie, for a mix of queries where most opens miss.
+
+Usage: path_trie_bench [entries-per-list] [iterations]
+
+Kept free of the C++ library, like kernel_set_adapter.cpp: the driver's
+headers declare their own namespace std.
+*/
+#include "kstd/algo/path_trie.h"
+#include "kstd_shim/slab_user.h"
+
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+namespace {
+	constexpr unsigned int kTrieTag = 0x6972544b;   // 'irTK', as in the shim
+
+	int failures = 0;
+
+	void Check(bool ok, const char* what)
+	{
+		if (!ok) {
+			fprintf(stderr, "FAIL: %s\n", what);
+			failures++;
+		}
+	}
+
+	unsigned long long TrieLive()
+	{
+		krnl_std::SlabTagStats s = krnl_std::GetSlabTagStats(kTrieTag);
+		return s.allocs - s.frees;
+	}
+
+	double NowNs()
+	{
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1e9 + ts.tv_nsec;
+	}
+
+	// printf into a WString; the generated paths are ASCII.
+	template <typename... Args>
+	std::WString Path(const char* format, Args... args)
+	{
+		char buf[512];
+		int n = snprintf(buf, sizeof(buf), format, args...);
+		std::WString s;
+		for (int i = 0; i < n; i++) {
+			s.PushBack((WCHAR)buf[i]);
+		}
+		return s;
+	}
+
+	// The kernel's _wcsnicmp, which folds ASCII only.
+	int WcsNiCmp(const WCHAR* a, const WCHAR* b, size_t n)
+	{
+		for (size_t i = 0; i < n; i++) {
+			WCHAR x = (a[i] >= u'A' && a[i] <= u'Z') ? (WCHAR)(a[i] + 32) : a[i];
+			WCHAR y = (b[i] >= u'A' && b[i] <= u'Z') ? (WCHAR)(b[i] + 32) : b[i];
+			if (x != y) {
+				return x < y ? -1 : 1;
+			}
+			if (x == 0) {
+				return 0;
+			}
+		}
+		return 0;
+	}
+
+	struct Lists {
+		std::WString* dirs = nullptr;
+		std::WString* files = nullptr;
+		unsigned long long dir_count = 0;
+		unsigned long long file_count = 0;
+	};
+
+	// IsProtectedFile before the trie: every entry, no early exit.
+	bool OldScan(const Lists& l, const std::WString& path)
+	{
+		bool is_protected = false;
+		for (unsigned long long i = 0; i < l.dir_count; i++) {
+			const std::WString& d = l.dirs[i];
+			if (d.Size() < path.Size() && WcsNiCmp(d.Data(), path.Data(), d.Size()) == 0) {
+				is_protected = true;
+			}
+		}
+		for (unsigned long long i = 0; i < l.file_count; i++) {
+			const std::WString& f = l.files[i];
+			if (f.Size() == path.Size() && WcsNiCmp(f.Data(), path.Data(), f.Size()) == 0) {
+				is_protected = true;
+			}
+		}
+		return is_protected;
+	}
+
+	// The fallback IsProtectedFile keeps for when the trie cannot be built.
+	bool Scan(const Lists& l, const std::WString& path)
+	{
+		for (unsigned long long i = 0; i < l.dir_count; i++) {
+			if (l.dirs[i].Size() < path.Size() && l.dirs[i].IsCiPrefixOf(path)) {
+				return true;
+			}
+		}
+		for (unsigned long long i = 0; i < l.file_count; i++) {
+			if (l.files[i].EqualCi(path)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void TestEdges()
+	{
+		PathTrie t;
+		Check(t.AddPrefix(u"\\Device\\HarddiskVolume3\\Program Files\\Vendor\\"), "AddPrefix");
+		Check(t.AddPrefix(u"\\Device\\Harddisk0\\DR0"), "AddPrefix without separator");
+		Check(t.AddPath(u"\\Device\\HarddiskVolume3\\Windows\\System32\\lsass.exe"), "AddPath");
+		Check(t.AddPath(u"\\Device\\HarddiskVolume3\\Windows\\System32\\lsass.exe"), "AddPath twice");
+		Check(!t.Match(u"\\Device\\HarddiskVolume3\\Program Files\\Vendor\\a.exe"), "nothing matches before Compile");
+		Check(t.Compile() && t.Compiled() && t.Size() == 3, "Compile");
+		Check(!t.AddPath(u"\\late"), "Add after Compile fails");
+
+		Check(t.Match(u"\\device\\harddiskvolume3\\PROGRAM FILES\\vendor\\a.exe"), "prefix, other case");
+		Check(t.Match(u"\\Device\\HarddiskVolume3\\Program Files\\Vendor\\x"), "prefix, one more char");
+		Check(!t.Match(u"\\Device\\HarddiskVolume3\\Program Files\\Vendor\\"), "prefix does not match itself");
+		Check(!t.Match(u"\\Device\\HarddiskVolume3\\Program Files\\Vendor"), "prefix minus separator");
+		Check(!t.Match(u"\\Device\\HarddiskVolume3\\Program Files\\Vendor2\\a.exe"), "sibling directory");
+		Check(t.Match(u"\\Device\\Harddisk0\\DR01"), "prefix without separator covers longer names");
+		Check(t.Match(u"\\DEVICE\\HARDDISKVOLUME3\\WINDOWS\\SYSTEM32\\LSASS.EXE"), "path, other case");
+		Check(!t.Match(u"\\Device\\HarddiskVolume3\\Windows\\System32\\lsass.ex"), "path minus a char");
+		Check(!t.Match(u"\\Device\\HarddiskVolume3\\Windows\\System32\\lsass.exe.bak"), "path plus a suffix");
+		Check(!t.Match(u"\\Device\\HarddiskVolume3\\Windows\\System32\\"), "inside a run");
+		Check(!t.Match(u"") && !t.Match(u"\\"), "empty and root");
+
+		PathTrie empty;
+		Check(empty.Compile() && !empty.Match(u"\\a") && !empty.Match(u""), "empty trie");
+
+		PathTrie all;
+		Check(all.AddPrefix(u"") && all.Compile() && all.Match(u"x") && !all.Match(u""), "empty prefix");
+
+		PathTrie wide;
+		Check(wide.AddPath(u"\\Données\\ÉTÉ.txt") && wide.Compile() && wide.Match(u"\\DONNÉES\\été.TXT"), "non-ASCII folding");
+	}
+
+	// Directories and files the way GetDefaultProtected* produce them, scaled
+	// up: `n` of each under a handful of roots.
+	Lists MakeLists(unsigned long long n)
+	{
+		Lists l;
+		l.dirs = new std::WString[n];
+		l.files = new std::WString[n];
+		l.dir_count = n;
+		l.file_count = n;
+		const char* roots[] = { "Program Files", "Program Files (x86)", "ProgramData", "Windows\\System32\\drivers" };
+		for (unsigned long long i = 0; i < n; i++) {
+			l.dirs[i] = Path("\\Device\\HarddiskVolume%llu\\%s\\Vendor%05llu\\", 3 + i % 2, roots[i % 3], i);
+			l.files[i] = Path("\\Device\\HarddiskVolume3\\%s\\drv%05llu.sys", roots[3], i);
+		}
+		return l;
+	}
+
+	// Queries in the mix a filter sees: mostly user files nowhere near a
+	// protected entry, some inside protected directories, some protected
+	// files, and near misses that share all but the last characters.
+	std::WString* MakeQueries(unsigned long long n, unsigned long long count)
+	{
+		std::WString* q = new std::WString[count];
+		for (unsigned long long i = 0; i < count; i++) {
+			unsigned long long k = (i * 2654435761ull) % n;
+			switch (i % 8) {
+			case 0:
+				q[i] = Path("\\Device\\HarddiskVolume%llu\\%s\\VENDOR%05llu\\bin\\app.exe", 3 + k % 2,
+					k % 3 == 0 ? "program files" : (k % 3 == 1 ? "Program Files (x86)" : "ProgramData"), k);
+				break;
+			case 1:
+				q[i] = Path("\\Device\\HarddiskVolume3\\Windows\\System32\\drivers\\DRV%05llu.SYS", k);
+				break;
+			case 2:
+				q[i] = Path("\\Device\\HarddiskVolume3\\Windows\\System32\\drivers\\drv%05llu.sys.bak", k);
+				break;
+			case 3:
+				q[i] = Path("\\Device\\HarddiskVolume3\\Program Files\\Vendor%05llux\\a.dll", k);
+				break;
+			default:
+				q[i] = Path("\\Device\\HarddiskVolume3\\Users\\someone\\Documents\\report%05llu.docx", k);
+				break;
+			}
+		}
+		return q;
+	}
+
+	void TestAgreement(const Lists& l, const PathTrie& t, const std::WString* q, unsigned long long count)
+	{
+		unsigned long long hits = 0;
+		bool agree = true;
+		for (unsigned long long i = 0; i < count; i++) {
+			bool expect = OldScan(l, q[i]);
+			agree = agree && Scan(l, q[i]) == expect && t.Match(q[i]) == expect;
+			hits += expect ? 1 : 0;
+		}
+		for (unsigned long long i = 0; i < l.dir_count; i++) {
+			agree = agree && !t.Match(l.dirs[i]) && t.Match(l.files[i]);
+		}
+		Check(agree, "trie agrees with the list scan");
+		Check(hits > count / 8 && hits < count / 2, "query mix has hits and misses");
+	}
+
+	void TestAllocFailure(const Lists& l)
+	{
+		PathTrie t;
+		bool added = true;
+		for (unsigned long long i = 0; i < l.dir_count; i++) {
+			added = added && t.AddPrefix(l.dirs[i]);
+		}
+		krnl_std::SetSlabFailAfter(0);
+		bool compiled = t.Compile();
+		krnl_std::SetSlabFailAfter(-1);
+		Check(added && !compiled && !t.Compiled(), "Compile reports allocation failure");
+		Check(!t.Match(std::WString()) && !t.Match(Path("\\Device\\HarddiskVolume3\\Program Files\\Vendor00000\\a")),
+			"failed trie matches nothing");
+		Check(t.Compile() && t.Match(Path("\\Device\\HarddiskVolume3\\Program Files\\Vendor00000\\a")), "Compile after a failure");
+	}
+
+	template <typename Fn>
+	void Time(const char* name, unsigned long long iters, Fn&& fn)
+	{
+		volatile unsigned long long sink = 0;
+		double t0 = NowNs();
+		for (unsigned long long i = 0; i < iters; i++) {
+			sink = sink + fn(i);
+		}
+		double t1 = NowNs();
+		printf("  %-34s %10.1f ns/lookup\n", name, (t1 - t0) / iters);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned long long n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 4096;
+	unsigned long long iters = argc > 2 ? strtoull(argv[2], nullptr, 10) : 200000;
+	// RtlUpcaseUnicodeChar is towupper here, which needs a Unicode locale.
+	setlocale(LC_CTYPE, "C.UTF-8");
+
+	TestEdges();
+	Check(TrieLive() == 0, "edge-case tries freed");
+
+	Lists l = MakeLists(n);
+	const unsigned long long kQueries = 4096;
+	std::WString* q = MakeQueries(n, kQueries);
+
+	double t0 = NowNs();
+	PathTrie* t = new PathTrie();
+	for (unsigned long long i = 0; i < l.dir_count; i++) {
+		t->AddPrefix(l.dirs[i]);
+	}
+	for (unsigned long long i = 0; i < l.file_count; i++) {
+		t->AddPath(l.files[i]);
+	}
+	Check(t->Compile(), "Compile generated lists");
+	double t1 = NowNs();
+
+	TestAgreement(l, *t, q, kQueries);
+	TestAllocFailure(l);
+	if (failures != 0) {
+		fprintf(stderr, "%d check(s) failed\n", failures);
+		return 1;
+	}
+	printf("path trie checks passed\n");
+
+	unsigned long long chars = 0;
+	for (unsigned long long i = 0; i < n; i++) {
+		chars += l.dirs[i].Size() + l.files[i].Size();
+	}
+	printf("%llu dirs + %llu files (%llu chars): compiled in %.2f ms, %llu bytes\n",
+		l.dir_count, l.file_count, chars, (t1 - t0) / 1e6, t->Bytes());
+
+	unsigned long long scan_iters = iters / (n / 64 + 1) + 1;
+	Time("old scan, every entry", scan_iters, [&](unsigned long long i) {
+		return (unsigned long long)OldScan(l, q[i % kQueries]);
+	});
+	Time("scan, first match", scan_iters, [&](unsigned long long i) {
+		return (unsigned long long)Scan(l, q[i % kQueries]);
+	});
+	Time("trie", iters, [&](unsigned long long i) {
+		return (unsigned long long)t->Match(q[i % kQueries]);
+	});
+
+	delete t;
+	delete[] q;
+	delete[] l.dirs;
+	delete[] l.files;
+	Check(TrieLive() == 0, "every trie block freed");
+	return failures != 0;
+}
@@ -0,0 +1,467 @@
+/*
+Model of SelfDefenseKernel's PreObCallback verdicts (std/map/pid_flags.h)
+against what it did before on every process and thread handle open: query
+both image names, compare the source with services.exe, the target with
+the guarded names, and check the source against the protected lists.
+
+The kernel calls are stood in for by their memory traffic, as in
+process_cache_bench.cpp:
+  GetProcessImageName   lookup in a pid map under a shared lock + copy
+  IsProtectedFile       case-insensitive scan of a few protected entries
+with EX_PUSH_LOCK replaced by std::shared_mutex / std::mutex.
+
+Checks, exiting non-zero on failure:
+  - table basics: colliding pids, a full probe window, removal at the end
+    of a run and in the middle of one, Clear
+  - old and new decisions agree for every (source, target) pair
+  - after openers race a thread that starts and ends processes, reusing
+    the pids of ended ones as soon as nothing holds them, every cached
+    verdict of a live process is the one its image name gives, and no
+    ended process still has one
+
+Usage: pid_verdict_bench [opens] [threads] [processes]
+*/
+#include "kstd/map/pid_flags.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+	constexpr unsigned int kTrustedSource = 1;
+	constexpr unsigned int kGuardedTarget = 2;
+
+	int failures = 0;
+
+	void Check(bool ok, const char* what)
+	{
+		if (!ok) {
+			fprintf(stderr, "FAIL: %s\n", what);
+			failures++;
+		}
+	}
+
+	char16_t Fold(char16_t c)
+	{
+		return (c >= u'a' && c <= u'z') ? (char16_t)(c - 32) : c;
+	}
+
+	bool EqualCi(const std::u16string& a, const std::u16string& b)
+	{
+		if (a.size() != b.size()) {
+			return false;
+		}
+		for (size_t i = 0; i < a.size(); i++) {
+			if (Fold(a[i]) != Fold(b[i])) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool HasCiPrefix(const std::u16string& s, const std::u16string& p)
+	{
+		return s.size() >= p.size() && EqualCi(s.substr(0, p.size()), p);
+	}
+
+	bool HasCiSuffix(const std::u16string& s, const std::u16string& p)
+	{
+		return s.size() >= p.size() && EqualCi(s.substr(s.size() - p.size()), p);
+	}
+
+	const std::u16string kServices = u"\\Device\\HarddiskVolume3\\Windows\\System32\\services.exe";
+
+	const char16_t* kProtectedDirs[] = {
+		u"\\Device\\HarddiskVolume3\\Program Files\\RansomDetector\\",
+		u"\\Device\\HarddiskVolume3\\ProgramData\\RansomDetector\\",
+		u"\\Device\\HarddiskVolume3\\Program Files\\VMware\\VMware Tools\\",
+		u"\\Device\\HarddiskVolume4\\hieunt210330\\",
+	};
+	const char16_t* kProtectedFiles[] = {
+		u"\\Device\\HarddiskVolume3\\Windows\\System32\\vm3dservice.exe",
+		u"\\Device\\HarddiskVolume3\\Windows\\System32\\lsass.exe",
+		u"\\Device\\HarddiskVolume3\\Windows\\System32\\csrss.exe",
+	};
+
+	bool IsProtectedFile(const std::u16string& path)
+	{
+		for (const char16_t* d : kProtectedDirs) {
+			std::u16string dir(d);
+			if (dir.size() < path.size() && HasCiPrefix(path, dir)) {
+				return true;
+			}
+		}
+		for (const char16_t* f : kProtectedFiles) {
+			if (EqualCi(path, f)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Images the processes run, in the proportions of a desktop: mostly
+	// ordinary programs, a few guarded or trusted ones.
+	const char16_t* kImages[] = {
+		u"\\Device\\HarddiskVolume3\\Windows\\explorer.exe",
+		u"\\Device\\HarddiskVolume3\\Windows\\System32\\svchost.exe",
+		u"\\Device\\HarddiskVolume3\\Windows\\System32\\Taskmgr.exe",
+		u"\\Device\\HarddiskVolume3\\Program Files\\Google\\Chrome\\Application\\chrome.exe",
+		u"\\Device\\HarddiskVolume3\\Program Files\\Microsoft Office\\root\\Office16\\WINWORD.EXE",
+		u"\\Device\\HarddiskVolume3\\ProgramData\\Microsoft\\Windows Defender\\Platform\\MsMpEng.exe",
+		u"\\Device\\HarddiskVolume3\\Windows\\System32\\services.exe",
+		u"\\Device\\HarddiskVolume3\\Windows\\System32\\lsass.exe",
+		u"\\Device\\HarddiskVolume3\\Program Files\\RansomDetector\\RansomDetectorService.exe",
+		u"\\Device\\HarddiskVolume3\\Program Files\\VMware\\VMware Tools\\vmtoolsd.exe",
+		u"\\Device\\HarddiskVolume3\\Users\\someone\\Downloads\\VMwareUpdate.exe",
+		u"\\Device\\HarddiskVolume3\\Windows\\System32\\RuntimeBroker.exe",
+	};
+	constexpr unsigned int kImageCount = sizeof(kImages) / sizeof(kImages[0]);
+
+	// An EPROCESS: `exiting` is its exit status leaving STATUS_PENDING,
+	// and a shared_ptr copy is a reference, which keeps its pid in use.
+	struct Process {
+		std::u16string image;
+		std::atomic<bool> exiting{ false };
+
+		explicit Process(const std::u16string& i) : image(i) {}
+	};
+	using ProcessRef = std::shared_ptr<Process>;
+
+	// The kernel's process table.
+	struct Processes {
+		std::shared_mutex lock;
+		std::unordered_map<unsigned long long, ProcessRef> table;
+
+		// PsLookupProcessByProcessId: nullptr when the pid is free.
+		ProcessRef Lookup(unsigned long long pid)
+		{
+			std::shared_lock<std::shared_mutex> l(lock);
+			auto it = table.find(pid);
+			return it != table.end() ? it->second : nullptr;
+		}
+
+		// GetProcessImageName: empty when the process is gone.
+		std::u16string ImageName(unsigned long long pid)
+		{
+			ProcessRef p = Lookup(pid);
+			return p != nullptr ? p->image : std::u16string();
+		}
+
+		void Start(unsigned long long pid, const std::u16string& image)
+		{
+			std::unique_lock<std::shared_mutex> l(lock);
+			table[pid] = std::make_shared<Process>(image);
+		}
+	};
+
+	unsigned int ComputeVerdict(const std::u16string& path)
+	{
+		unsigned int verdict = 0;
+		if (EqualCi(path, kServices) || IsProtectedFile(path)) {
+			verdict |= kTrustedSource;
+		}
+		if (HasCiSuffix(path, u"RansomDetectorService.exe") || path.find(u"VMware") != std::u16string::npos) {
+			verdict |= kGuardedTarget;
+		}
+		return verdict;
+	}
+
+	// PreObCallback before: true when rights are stripped.
+	bool OldStrips(Processes& procs, unsigned long long source, unsigned long long target)
+	{
+		std::u16string source_path = procs.ImageName(source);
+		if (EqualCi(source_path, kServices)) {
+			return false;
+		}
+		std::u16string target_path = procs.ImageName(target);
+		if (!HasCiSuffix(target_path, u"RansomDetectorService.exe") && target_path.find(u"VMware") == std::u16string::npos) {
+			return false;
+		}
+		return !IsProtectedFile(source_path);
+	}
+
+	struct Verdicts {
+		krnl_std::PidFlagsTable table;
+		std::mutex writer;
+		volatile unsigned long long generation = 0;
+
+		Verdicts() { krnl_std::InitPidFlags(table); }
+
+		void Cache(const Process& p, unsigned long long pid, unsigned int verdict, unsigned long long gen)
+		{
+			std::lock_guard<std::mutex> l(writer);
+			if (generation == gen && !p.exiting.load()) {
+				krnl_std::SetPidFlags(table, pid, verdict);
+			}
+		}
+
+		void Remove(unsigned long long pid)
+		{
+			std::lock_guard<std::mutex> l(writer);
+			krnl_std::RemovePidFlags(table, pid);
+		}
+
+		unsigned int Get(Processes& procs, unsigned long long pid)
+		{
+			unsigned int verdict = 0;
+			if (krnl_std::FindPidFlags(table, pid, &verdict)) {
+				return verdict;
+			}
+			ProcessRef p = procs.Lookup(pid);
+			if (p == nullptr) {
+				return ComputeVerdict(std::u16string());
+			}
+			unsigned long long gen = krnl_std::ring_atomic::Load(&generation);
+			std::u16string path = procs.ImageName(pid);
+			verdict = ComputeVerdict(path);
+			if (!path.empty()) {
+				Cache(*p, pid, verdict, gen);
+			}
+			return verdict;
+		}
+	};
+
+	// PreObCallback now.
+	bool NewStrips(Verdicts& v, Processes& procs, unsigned long long source, unsigned long long target)
+	{
+		if ((v.Get(procs, target) & kGuardedTarget) == 0) {
+			return false;
+		}
+		return (v.Get(procs, source) & kTrustedSource) == 0;
+	}
+
+	void TestTable()
+	{
+		static krnl_std::PidFlagsTable t;
+		krnl_std::InitPidFlags(t);
+		const unsigned long long stride = 4ull * krnl_std::kPidFlagsSlots;   // same home slot
+		unsigned int f = 0;
+
+		Check(!krnl_std::FindPidFlags(t, 8, &f), "empty table");
+		bool all = true;
+		for (unsigned long long i = 0; i < krnl_std::kPidFlagsProbe; i++) {
+			all = all && krnl_std::SetPidFlags(t, 8 + i * stride, (unsigned int)i & krnl_std::kPidFlagsMask);
+		}
+		Check(all, "a full probe window of colliding pids");
+		Check(!krnl_std::SetPidFlags(t, 8 + krnl_std::kPidFlagsProbe * stride, 1), "one more does not fit");
+		bool found = true;
+		for (unsigned long long i = 0; i < krnl_std::kPidFlagsProbe; i++) {
+			found = found && krnl_std::FindPidFlags(t, 8 + i * stride, &f) && f == i;
+		}
+		Check(found, "every colliding pid found with its flags");
+		Check(krnl_std::SetPidFlags(t, 8 + 3 * stride, 0x7f) && krnl_std::FindPidFlags(t, 8 + 3 * stride, &f) && f == 0x7f,
+			"Set replaces in place");
+		Check(krnl_std::SetPidFlags(t, 12, 0) && krnl_std::FindPidFlags(t, 12, &f) && f == 0, "zero flags are an entry too");
+
+		krnl_std::RemovePidFlags(t, 8 + 2 * stride);
+		Check(!krnl_std::FindPidFlags(t, 8 + 2 * stride, &f), "removed");
+		Check(krnl_std::FindPidFlags(t, 8 + 5 * stride, &f) && f == 5, "found past a removed slot");
+		Check(krnl_std::SetPidFlags(t, 8 + 20 * stride, 0) && krnl_std::FindPidFlags(t, 8 + 20 * stride, &f) && f == 0,
+			"a removed slot is reused");
+
+		krnl_std::ClearPidFlags(t);
+		bool empty = true;
+		for (unsigned int i = 0; i < krnl_std::kPidFlagsSlots; i++) {
+			empty = empty && t.slot[i] == 0;
+		}
+		Check(empty && !krnl_std::FindPidFlags(t, 12, &f), "Clear");
+
+		krnl_std::SetPidFlags(t, 400, 1);
+		krnl_std::RemovePidFlags(t, 400);
+		Check(t.slot[krnl_std::PidFlagsHome(400)] == 0, "removing the end of a run leaves no tombstone");
+	}
+
+	void Populate(Processes& procs, unsigned int count)
+	{
+		for (unsigned long long i = 0; i < count; i++) {
+			procs.Start(4 * (i + 1), kImages[i % kImageCount]);
+		}
+	}
+
+	void TestAgreement(unsigned int count)
+	{
+		Processes procs;
+		Populate(procs, count);
+		Verdicts v;
+		unsigned long long strips = 0;
+		bool agree = true;
+		for (int pass = 0; pass < 2; pass++) {   // misses, then hits
+			for (unsigned long long s = 0; s <= count; s++) {
+				for (unsigned long long t = 0; t <= count; t++) {
+					bool old_strips = OldStrips(procs, 4 * s, 4 * t);
+					agree = agree && NewStrips(v, procs, 4 * s, 4 * t) == old_strips;
+					strips += old_strips ? 1 : 0;
+				}
+			}
+		}
+		Check(agree, "old and new decisions agree");
+		Check(strips != 0, "some opens are stripped");
+	}
+
+	void TestRace(unsigned int threads, unsigned int count)
+	{
+		Processes procs;
+		Populate(procs, count);
+		Verdicts v;
+		std::vector<unsigned long long> live;
+		for (unsigned long long i = 0; i < count; i++) {
+			live.push_back(4 * (i + 1));
+		}
+		std::atomic<bool> stop{ false };
+		std::vector<std::thread> openers;
+		for (unsigned int r = 0; r < threads; r++) {
+			openers.emplace_back([&, r]() {
+				unsigned long long x = 0x9e3779b97f4a7c15ull * (r + 1);
+				volatile unsigned long long sink = 0;
+				while (!stop.load(std::memory_order_relaxed)) {
+					x ^= x << 13;
+					x ^= x >> 7;
+					x ^= x << 17;
+					// Pids from the whole range ever used: some are gone.
+					unsigned long long hi = 4ull * (count * 8);
+					sink = sink + NewStrips(v, procs, 4 + (x % hi) / 4 * 4, 4 + ((x >> 20) % hi) / 4 * 4);
+				}
+			});
+		}
+		// Ending a process: exit status, exit notification, then the pid
+		// leaves the table. It is free again once no opener still holds the
+		// process, and the next start takes the lowest free pid, as Windows
+		// tends to, so pids are reused quickly.
+		std::vector<ProcessRef> ended;
+		std::vector<unsigned long long> ended_pids;
+		unsigned long long next = 4ull * (count + 1);
+		unsigned long long reused = 0;
+		for (unsigned int i = 0; i < count * 6; i++) {
+			size_t k = i % live.size();
+			unsigned long long gone = live[k];
+			ProcessRef p = procs.Lookup(gone);
+			p->exiting = true;
+			v.Remove(gone);
+			{
+				std::unique_lock<std::shared_mutex> l(procs.lock);
+				procs.table.erase(gone);
+			}
+			ended.push_back(p);
+			ended_pids.push_back(gone);
+
+			// The last round reuses nothing, leaving ended pids to check.
+			unsigned long long pid = 0;
+			for (size_t e = 0; i < count * 5 && e < ended.size(); e++) {
+				if (ended[e].use_count() == 1 && (pid == 0 || ended_pids[e] < pid)) {
+					pid = ended_pids[e];
+				}
+			}
+			if (pid != 0) {
+				for (size_t e = 0; e < ended.size(); e++) {
+					if (ended_pids[e] == pid) {
+						ended.erase(ended.begin() + e);
+						ended_pids.erase(ended_pids.begin() + e);
+						break;
+					}
+				}
+				reused++;
+			}
+			else {
+				pid = next;
+				next += 4;
+			}
+
+			unsigned long long gen = krnl_std::ring_atomic::Load(&v.generation);
+			std::u16string image = kImages[(i * 7) % kImageCount];
+			procs.Start(pid, image);
+			v.Cache(*procs.Lookup(pid), pid, ComputeVerdict(image), gen);
+			live[k] = pid;
+			if (i % 64 == 0) {
+				std::this_thread::yield();
+			}
+		}
+		stop = true;
+		for (auto& t : openers) {
+			t.join();
+		}
+
+		bool correct = true;
+		unsigned long long cached = 0;
+		for (unsigned long long pid : live) {
+			unsigned int f = 0;
+			if (krnl_std::FindPidFlags(v.table, pid, &f)) {
+				cached++;
+				correct = correct && f == ComputeVerdict(procs.ImageName(pid));
+			}
+		}
+		Check(correct, "cached verdicts of live processes are current");
+		// Whatever an opener stored for these would go to the next process
+		// given the pid.
+		bool none_ended = true;
+		for (unsigned long long pid : ended_pids) {
+			unsigned int f = 0;
+			none_ended = none_ended && !krnl_std::FindPidFlags(v.table, pid, &f);
+		}
+		Check(none_ended, "no verdict cached for an ended process");
+		printf("race: %u openers, %u processes started and ended, %llu pids reused, %llu of %zu live cached\n",
+			threads, count * 6, reused, cached, live.size());
+	}
+
+	template <typename Fn>
+	double TimeOpens(unsigned long long opens, unsigned int threads, Fn&& fn)
+	{
+		auto t0 = std::chrono::steady_clock::now();
+		std::vector<std::thread> ts;
+		for (unsigned int r = 0; r < threads; r++) {
+			ts.emplace_back([&, r]() {
+				unsigned long long x = 0x9e3779b97f4a7c15ull * (r + 1);
+				volatile unsigned long long sink = 0;
+				for (unsigned long long i = 0; i < opens; i++) {
+					x ^= x << 13;
+					x ^= x >> 7;
+					x ^= x << 17;
+					sink = sink + fn(x);
+				}
+			});
+		}
+		for (auto& t : ts) {
+			t.join();
+		}
+		auto t1 = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::nano>(t1 - t0).count() / (opens * threads);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned long long opens = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+	unsigned int threads = argc > 2 ? (unsigned int)strtoul(argv[2], nullptr, 10) : 2;
+	unsigned int count = argc > 3 ? (unsigned int)strtoul(argv[3], nullptr, 10) : 300;
+
+	TestTable();
+	TestAgreement(64);
+	TestRace(threads, count);
+	if (failures != 0) {
+		fprintf(stderr, "%d check(s) failed\n", failures);
+		return 1;
+	}
+	printf("pid verdict checks passed\n");
+
+	Processes procs;
+	Populate(procs, count);
+	Verdicts v;
+	auto pick = [&](unsigned long long x) { return 4 * (x % count + 1); };
+	double old_ns = TimeOpens(opens, threads, [&](unsigned long long x) {
+		return (unsigned long long)OldStrips(procs, pick(x), pick(x >> 24));
+	});
+	double new_ns = TimeOpens(opens, threads, [&](unsigned long long x) {
+		return (unsigned long long)NewStrips(v, procs, pick(x), pick(x >> 24));
+	});
+	printf("%u processes, %u opener thread(s), %llu opens each\n", count, threads, opens);
+	printf("  %-34s %8.1f ns/open\n", "names + compares per open", old_ns);
+	printf("  %-34s %8.1f ns/open\n", "cached verdicts", new_ns);
+	return failures != 0;
+}
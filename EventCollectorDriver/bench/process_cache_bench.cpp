@@ -0,0 +1,315 @@
+/*
+Model of the collector's process image-name cache (function/process_cache.cpp
+on std/map/pid_table.h) against what PostFileCreate did before: query the
+image name on every open and keep a private copy in the handle context.
+
+The kernel calls are stood in for by their memory traffic:
+  PsLookupProcessByProcessId   lookup in a pid map under a shared lock
+  SeLocateProcessImageName     pool allocation + copy of the name
+  WString copy                 second allocation + copy, first one freed
+  ContextCleanup               frees the copy (baseline) / drops the reference
+with EX_PUSH_LOCK replaced by std::shared_mutex. Opener threads pick a pid
+from a pool of live processes; one thread keeps creating and exiting
+processes. A process exits in two steps, like in the kernel: its exit
+status is set, then the exit notification removes its entry. At the end
+every entry must be freed exactly once, and no entry may be left for a
+process that has exited ("stale").
+
+"gone" counts opens whose process had already exited.
+
+Usage: process_cache_bench [opens_per_thread] [threads] [processes]
+*/
+#include "../std/map/pid_table.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+	std::atomic<long long> live_infos{ 0 };
+
+	struct ProcessInfo {
+		krnl_std::PidEntry entry;
+		std::u16string image_name;
+	};
+
+	std::u16string ImageName(unsigned long long pid)
+	{
+		std::u16string s = u"\\Device\\HarddiskVolume3\\Program Files\\Vendor\\Product\\bin\\app";
+		s += (char16_t)(u'0' + pid % 10);
+		s += u".exe";
+		return s;
+	}
+
+	// The kernel's process table, for both variants.
+	struct Processes {
+		std::shared_mutex lock;
+		std::unordered_map<unsigned long long, std::u16string> names;
+		std::unordered_set<unsigned long long> exiting;
+	};
+
+	// PsGetProcessExitStatus(process) != STATUS_PENDING
+	bool HasExited(Processes& procs, unsigned long long pid)
+	{
+		std::shared_lock<std::shared_mutex> l(procs.lock);
+		return procs.exiting.count(pid) != 0 || procs.names.count(pid) == 0;
+	}
+
+	// ===== Baseline: query + copy per open =====
+
+	char16_t* QueryImageName(Processes& procs, unsigned long long pid, size_t* chars)
+	{
+		std::shared_lock<std::shared_mutex> l(procs.lock);
+		auto it = procs.names.find(pid);
+		if (it == procs.names.end()) {
+			return nullptr;
+		}
+		// SeLocateProcessImageName hands back a fresh UNICODE_STRING.
+		char16_t* buf = (char16_t*)malloc(it->second.size() * 2);
+		memcpy(buf, it->second.data(), it->second.size() * 2);
+		*chars = it->second.size();
+		return buf;
+	}
+
+	// ===== Cache =====
+
+	struct Cache {
+		std::shared_mutex lock;
+		krnl_std::PidTable table;
+		Cache() { krnl_std::InitPidTable(table); }
+	};
+
+	ProcessInfo* NewInfo(Processes& procs, unsigned long long pid)
+	{
+		size_t chars = 0;
+		char16_t* name = QueryImageName(procs, pid, &chars);
+		if (name == nullptr) {
+			return nullptr;
+		}
+		ProcessInfo* info = new ProcessInfo();
+		krnl_std::InitPidEntry(info->entry, pid);
+		info->image_name.assign(name, chars);
+		free(name);
+		live_infos++;
+		return info;
+	}
+
+	void Release(ProcessInfo* info)
+	{
+		if (info != nullptr && krnl_std::DereferencePidEntry(&info->entry)) {
+			live_infos--;
+			delete info;
+		}
+	}
+
+	ProcessInfo* Add(Cache& c, Processes& procs, unsigned long long pid)
+	{
+		ProcessInfo* info = NewInfo(procs, pid);
+		if (info == nullptr) {
+			return nullptr;
+		}
+		krnl_std::ReferencePidEntry(&info->entry);
+		krnl_std::PidEntry* stale;
+		{
+			std::unique_lock<std::shared_mutex> l(c.lock);
+			stale = krnl_std::RemovePidEntry(c.table, pid);
+			krnl_std::InsertPidEntry(c.table, &info->entry);
+		}
+		Release((ProcessInfo*)stale);
+		return info;
+	}
+
+	void Remove(Cache& c, unsigned long long pid)
+	{
+		krnl_std::PidEntry* e;
+		{
+			std::unique_lock<std::shared_mutex> l(c.lock);
+			e = krnl_std::RemovePidEntry(c.table, pid);
+		}
+		Release((ProcessInfo*)e);
+	}
+
+	ProcessInfo* Reference(Cache& c, Processes& procs, unsigned long long pid)
+	{
+		{
+			std::shared_lock<std::shared_mutex> l(c.lock);
+			if (krnl_std::PidEntry* e = krnl_std::FindPidEntry(c.table, pid)) {
+				return (ProcessInfo*)e;
+			}
+		}
+		ProcessInfo* info = NewInfo(procs, pid);
+		if (info == nullptr) {
+			return nullptr;
+		}
+		krnl_std::PidEntry* existing = nullptr;
+		bool exited;
+		{
+			std::unique_lock<std::shared_mutex> l(c.lock);
+			exited = HasExited(procs, pid);
+			if (!exited) {
+				krnl_std::ReferencePidEntry(&info->entry);
+				existing = krnl_std::InsertPidEntry(c.table, &info->entry);
+			}
+		}
+		if (exited) {
+			return info;
+		}
+		if (existing != nullptr) {
+			live_infos--;
+			delete info;
+			return (ProcessInfo*)existing;
+		}
+		return info;
+	}
+
+	// Churn: exit a random live process and start one with a new pid.
+	template <typename OnCreate, typename OnExit>
+	void Churn(Processes& procs, std::vector<std::atomic<unsigned long long>>& live, std::atomic<bool>& stop,
+		OnCreate&& on_create, OnExit&& on_exit)
+	{
+		std::mt19937_64 rng(99);
+		unsigned long long next_pid = 1000000;
+		while (!stop) {
+			size_t slot = rng() % live.size();
+			unsigned long long old_pid = live[slot];
+			unsigned long long pid = (next_pid += 4);
+			{
+				std::unique_lock<std::shared_mutex> l(procs.lock);
+				procs.exiting.insert(old_pid);
+			}
+			on_exit(old_pid);
+			{
+				std::unique_lock<std::shared_mutex> l(procs.lock);
+				procs.names.erase(old_pid);
+				procs.exiting.erase(old_pid);
+				procs.names[pid] = ImageName(pid);
+			}
+			on_create(pid);
+			live[slot] = pid;
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+	}
+
+	struct Result {
+		double ns_per_open;
+		unsigned long long misses;
+	};
+
+	template <typename Open>
+	Result RunOpens(unsigned int threads, size_t opens, std::vector<std::atomic<unsigned long long>>& live, Open&& open)
+	{
+		std::atomic<unsigned long long> misses{ 0 };
+		std::vector<std::thread> t;
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < threads; i++) {
+			t.emplace_back([&, i] {
+				std::mt19937_64 rng(i + 1);
+				unsigned long long local = 0;
+				for (size_t n = 0; n < opens; n++) {
+					local += open(live[rng() % live.size()].load()) ? 0 : 1;
+				}
+				misses += local;
+			});
+		}
+		for (auto& x : t) {
+			x.join();
+		}
+		double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return { s * 1e9 * threads / ((double)opens * threads), misses };
+	}
+
+	void Populate(Processes& procs, std::vector<std::atomic<unsigned long long>>& live)
+	{
+		procs.names.clear();
+		for (size_t i = 0; i < live.size(); i++) {
+			live[i] = 4 * (i + 100);
+			procs.names[live[i]] = ImageName(live[i]);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t opens = argc > 1 ? (size_t)atoll(argv[1]) : 1000000;
+	unsigned int threads = argc > 2 ? (unsigned int)atoi(argv[2]) : 4;
+	size_t processes = argc > 3 ? (size_t)atoll(argv[3]) : 300;
+
+	Processes procs;
+	std::vector<std::atomic<unsigned long long>> live(processes);
+
+	// Baseline.
+	Populate(procs, live);
+	std::atomic<bool> stop{ false };
+	std::thread churn([&] { Churn(procs, live, stop, [](unsigned long long) {}, [](unsigned long long) {}); });
+	Result base = RunOpens(threads, opens, live, [&](unsigned long long pid) {
+		size_t chars = 0;
+		char16_t* name = QueryImageName(procs, pid, &chars);
+		if (name == nullptr) {
+			return false;
+		}
+		std::u16string copy(name, chars);       // HANDLE_CONTEXT::process_path
+		free(name);
+		volatile size_t keep = copy.size();     // freed at ContextCleanup
+		(void)keep;
+		return true;
+	});
+	stop = true;
+	churn.join();
+
+	// Cache, filled at "process create" like ProcessNotifyCallback.
+	Populate(procs, live);
+	Cache cache;
+	for (auto& pid : live) {
+		Release(Add(cache, procs, pid));
+	}
+	stop = false;
+	churn = std::thread([&] {
+		Churn(procs, live, stop,
+			[&](unsigned long long pid) { Release(Add(cache, procs, pid)); },
+			[&](unsigned long long pid) { Remove(cache, pid); });
+	});
+	Result cached = RunOpens(threads, opens, live, [&](unsigned long long pid) {
+		ProcessInfo* info = Reference(cache, procs, pid);     // PostFileCreate
+		if (info == nullptr) {
+			return false;
+		}
+		volatile size_t keep = info->image_name.size();
+		(void)keep;
+		Release(info);                                        // ContextCleanup
+		return true;
+	});
+	stop = true;
+	churn.join();
+
+	// UninitProcessCache.
+	unsigned long long stale = 0;
+	for (;;) {
+		krnl_std::PidEntry* e;
+		{
+			std::unique_lock<std::shared_mutex> l(cache.lock);
+			e = krnl_std::PopPidEntry(cache.table);
+		}
+		if (e == nullptr) {
+			break;
+		}
+		stale += procs.names.count(e->pid) == 0 ? 1 : 0;
+		Release((ProcessInfo*)e);
+	}
+
+	printf("# %u threads x %zu opens, %zu live processes, churn every 200 us\n", threads, opens, processes);
+	printf("%-14s %12s %10s\n", "variant", "cpu_ns/open", "gone");
+	printf("%-14s %12.1f %10llu\n", "query+copy", base.ns_per_open, base.misses);
+	printf("%-14s %12.1f %10llu\n", "cache", cached.ns_per_open, cached.misses);
+	printf("leaked entries: %lld, stale entries: %llu\n", live_infos.load(), stale);
+	return live_infos.load() == 0 && stale == 0 ? 0 : 1;
+}
@@ -0,0 +1,231 @@
+/*
+Contention test for PushLock (std/sync/ex_push_lock.h), built unchanged on
+the user-mode push lock in kstd_shim/wdk/ntddk.h.
+
+Models SelfDefenseKernel's process map: reader threads look a pid up, as
+IsProtectedProcess does on every create, while one thread inserts and
+erases pids as processes start and exit. Three ways to guard it:
+  exclusive   every lookup takes the lock exclusive, as the KGUARDED_MUTEX
+              (std/sync/mutex.h) did
+  shared      lookups take PushLock shared, changes take it exclusive
+  shared_mutex  std::shared_mutex, for reference
+
+Checks, exiting non-zero on failure: two threads hold the lock shared at
+once, and a writer gets it after they release; the writer changes two
+counters under the exclusive lock, and no reader holding the lock may see
+them differ.
+
+Usage: push_lock_bench [readers] [milliseconds] [writer-pause-us]
+*/
+#include "kstd/sync/ex_push_lock.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+	enum class Guard { kExclusive, kShared, kSharedMutex };
+
+	struct State {
+		PushLock lock;
+		std::shared_mutex rw;
+		std::map<unsigned long long, bool> processes;
+		unsigned long long changes_a = 0;
+		unsigned long long changes_b = 0;
+	};
+
+	struct Result {
+		unsigned long long lookups = 0;
+		unsigned long long changes = 0;
+		unsigned long long torn = 0;
+		double seconds = 0;
+	};
+
+	// One lookup under the chosen guard; counts reads that saw a half-made change.
+	bool Lookup(State& s, Guard guard, unsigned long long pid, unsigned long long& torn)
+	{
+		bool is_protected = false;
+		auto read = [&]() {
+			auto it = s.processes.find(pid);
+			if (it != s.processes.end()) {
+				is_protected = it->second;
+			}
+			if (s.changes_a != s.changes_b) {
+				torn++;
+			}
+		};
+		switch (guard) {
+		case Guard::kExclusive: {
+			PushLock::AutoExclusive lock(s.lock);
+			read();
+			break;
+		}
+		case Guard::kShared: {
+			PushLock::AutoShared lock(s.lock);
+			read();
+			break;
+		}
+		case Guard::kSharedMutex: {
+			std::shared_lock<std::shared_mutex> lock(s.rw);
+			read();
+			break;
+		}
+		}
+		return is_protected;
+	}
+
+	template <typename Fn>
+	void Write(State& s, Guard guard, Fn&& fn)
+	{
+		if (guard == Guard::kSharedMutex) {
+			std::unique_lock<std::shared_mutex> lock(s.rw);
+			fn();
+		}
+		else {
+			PushLock::AutoExclusive lock(s.lock);
+			fn();
+		}
+	}
+
+	template <typename Flag>
+	bool WaitFor(const Flag& flag)
+	{
+		for (int i = 0; i < 2000 && !flag; i++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return flag;
+	}
+
+	// A second shared holder gets in while the first holds the lock, and
+	// once both have released, a writer gets it. A thread that never gets
+	// the lock is left behind; the process exits with the failure.
+	bool SharedHoldersOverlap()
+	{
+		static PushLock lock;
+		static std::atomic<bool> second_in{ false };
+		static std::atomic<bool> writer_in{ false };
+		lock.LockShared();
+		std::thread second([]() {
+			PushLock::AutoShared shared(lock);
+			second_in = true;
+		});
+		bool overlapped = WaitFor(second_in);
+		lock.Unlock(PushLock::Mode::Shared);
+		if (!overlapped) {
+			second.detach();
+			return false;
+		}
+		second.join();
+		std::thread writer([]() {
+			PushLock::AutoExclusive exclusive(lock);
+			writer_in = true;
+		});
+		if (!WaitFor(writer_in)) {
+			writer.detach();
+			return false;
+		}
+		writer.join();
+		return true;
+	}
+
+	Result Run(Guard guard, unsigned int readers, unsigned int ms, unsigned int pause_us)
+	{
+		State s;
+		s.lock.Create();
+		for (unsigned long long pid = 4; pid < 4 * 512; pid += 4) {
+			s.processes[pid] = pid % 40 == 0;
+		}
+
+		std::atomic<bool> stop{ false };
+		std::atomic<unsigned long long> lookups{ 0 };
+		std::atomic<unsigned long long> torn{ 0 };
+		std::vector<std::thread> threads;
+		for (unsigned int r = 0; r < readers; r++) {
+			threads.emplace_back([&, r]() {
+				unsigned long long n = 0;
+				unsigned long long bad = 0;
+				unsigned long long x = 0x9e3779b97f4a7c15ull * (r + 1);
+				volatile unsigned long long sink = 0;
+				while (!stop.load(std::memory_order_relaxed)) {
+					for (int i = 0; i < 64; i++) {
+						x ^= x << 13;
+						x ^= x >> 7;
+						x ^= x << 17;
+						sink = sink + Lookup(s, guard, (x % 1024) * 4, bad);
+					}
+					n += 64;
+				}
+				lookups += n;
+				torn += bad;
+			});
+		}
+
+		unsigned long long changes = 0;
+		std::thread writer([&]() {
+			unsigned long long next = 4 * 512;
+			while (!stop.load(std::memory_order_relaxed)) {
+				Write(s, guard, [&]() {
+					s.changes_a++;
+					s.processes.erase(next - 4 * 511);
+					s.processes[next] = next % 40 == 0;
+					s.changes_b++;
+				});
+				next += 4;
+				changes++;
+				if (pause_us != 0) {
+					std::this_thread::sleep_for(std::chrono::microseconds(pause_us));
+				}
+			}
+		});
+
+		auto t0 = std::chrono::steady_clock::now();
+		std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+		stop = true;
+		for (auto& t : threads) {
+			t.join();
+		}
+		writer.join();
+		auto t1 = std::chrono::steady_clock::now();
+
+		Result result;
+		result.lookups = lookups;
+		result.changes = changes;
+		result.torn = torn;
+		result.seconds = std::chrono::duration<double>(t1 - t0).count();
+		return result;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int readers = argc > 1 ? (unsigned int)strtoul(argv[1], nullptr, 10) : 4;
+	unsigned int ms = argc > 2 ? (unsigned int)strtoul(argv[2], nullptr, 10) : 500;
+	unsigned int pause_us = argc > 3 ? (unsigned int)strtoul(argv[3], nullptr, 10) : 100;
+
+	int failures = 0;
+	if (!SharedHoldersOverlap()) {
+		fprintf(stderr, "FAIL: shared holders do not overlap, or the lock is not free after they leave\n");
+		failures++;
+	}
+
+	printf("push lock: %u readers, 1 writer (pause %u us), %u ms, %u cpu(s)\n",
+		readers, pause_us, ms, std::thread::hardware_concurrency());
+	printf("  %-14s %14s %12s %10s\n", "guard", "lookups/s", "changes/s", "torn");
+	const char* names[] = { "exclusive", "shared", "shared_mutex" };
+	Guard guards[] = { Guard::kExclusive, Guard::kShared, Guard::kSharedMutex };
+	for (int g = 0; g < 3; g++) {
+		Result r = Run(guards[g], readers, ms, pause_us);
+		printf("  %-14s %14.0f %12.0f %10llu\n", names[g], r.lookups / r.seconds, r.changes / r.seconds, r.torn);
+		if (r.torn != 0 || r.lookups == 0 || r.changes == 0) {
+			fprintf(stderr, "FAIL: %s: %llu torn reads, %llu lookups, %llu changes\n", names[g], r.torn, r.lookups, r.changes);
+			failures++;
+		}
+	}
+	return failures != 0;
+}
@@ -0,0 +1,464 @@
+/*
+Tests and measures RuleSet (std/algo/rule_set.h), the collector's exclusion
+rules as PreFileCreate and ContextCleanup check them, built from a copy of the
+driver sources on the user-mode slab allocator.
+
+Checks, exiting non-zero on the first failure:
+  - prefixes, extensions (with or without the '.') and process images match
+    what they should, case-insensitively, on hand-picked edge cases
+  - a kChannelSetRules payload (com/shared_ring.h) written by WriteFilterRule
+    parses back into the same rules; truncated, empty and unknown-kind rules
+    reject the whole payload, the way collector::SetFilterRules does
+  - on generated rule lists and queries, RuleSet agrees with evaluating
+    every rule in turn, and the bloom filters turn away most misses before
+    the tries are searched
+  - an allocation failure in Compile is reported; every kTrieTag block is
+    freed
+
+Then times, per lookup: the five HasCiPrefix calls ContextCleanup made, the
+same rules plus the generated ones evaluated one by one, and RuleSet; and for
+images, a scan of the list against RuleSet::MatchImage with the key the
+process cache computes once per process.
+
+Usage: rule_set_bench [rules-per-kind] [iterations]
+
+Kept free of the C++ library, like kernel_set_adapter.cpp: the driver's
+headers declare their own namespace std.
+*/
+#include "kstd/algo/rule_set.h"
+#include "kstd_shim/slab_user.h"
+#include "../com/shared_ring.h"
+
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+namespace {
+	constexpr unsigned int kTrieTag = 0x6972544b;   // 'irTK', as in the shim
+
+	int failures = 0;
+
+	void Check(bool ok, const char* what)
+	{
+		if (!ok) {
+			fprintf(stderr, "FAIL: %s\n", what);
+			failures++;
+		}
+	}
+
+	unsigned long long TrieLive()
+	{
+		krnl_std::SlabTagStats s = krnl_std::GetSlabTagStats(kTrieTag);
+		return s.allocs - s.frees;
+	}
+
+	double NowNs()
+	{
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1e9 + ts.tv_nsec;
+	}
+
+	// printf into a WString; the generated paths are ASCII.
+	template <typename... Args>
+	std::WString Path(const char* format, Args... args)
+	{
+		char buf[512];
+		int n = snprintf(buf, sizeof(buf), format, args...);
+		std::WString s;
+		for (int i = 0; i < n; i++) {
+			s.PushBack((WCHAR)buf[i]);
+		}
+		return s;
+	}
+
+	// The prefix chain ContextCleanup had, and the defaults InitFilterRules
+	// compiles in its place.
+	const char16_t* kDefaultPrefixes[] = {
+		u"\\device\\harddiskvolume3\\windows\\",
+		u"\\device\\harddiskvolume3\\program files\\",
+		u"\\device\\harddiskvolume3\\program files (x86)\\",
+		u"\\device\\harddiskvolume3\\users\\hieu\\appdata\\",
+		u"\\device\\harddiskvolume3\\programdata\\",
+	};
+
+	bool OldChain(const std::WStringView& path)
+	{
+		return path.HasCiPrefix(u"\\device\\harddiskvolume3\\windows\\") == true
+			|| path.HasCiPrefix(u"\\device\\harddiskvolume3\\program files\\") == true
+			|| path.HasCiPrefix(u"\\device\\harddiskvolume3\\program files (x86)\\") == true
+			|| path.HasCiPrefix(u"\\device\\harddiskvolume3\\users\\hieu\\appdata\\") == true
+			|| path.HasCiPrefix(u"\\device\\harddiskvolume3\\programdata\\") == true;
+	}
+
+	struct Rules {
+		std::WString* prefixes = nullptr;
+		std::WString* extensions = nullptr;     // with the '.'
+		std::WString* images = nullptr;
+		unsigned long long prefix_count = 0;
+		unsigned long long extension_count = 0;
+		unsigned long long image_count = 0;
+	};
+
+	// What RuleSet replaces: each rule in turn, the way the HasCiPrefix
+	// chains did it.
+	bool ScanPath(const Rules& r, const std::WStringView& path)
+	{
+		for (unsigned long long i = 0; i < r.prefix_count; i++) {
+			if (r.prefixes[i].Size() < path.Size() && path.HasCiPrefix(r.prefixes[i])) {
+				return true;
+			}
+		}
+		std::WStringView ext = RuleSet::Extension(path);
+		for (unsigned long long i = 0; i < r.extension_count; i++) {
+			if (ext.EqualCi(r.extensions[i])) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool ScanImage(const Rules& r, const std::WStringView& image)
+	{
+		for (unsigned long long i = 0; i < r.image_count; i++) {
+			if (image.EqualCi(r.images[i])) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void TestEdges()
+	{
+		RuleSet s;
+		Check(s.Add(RuleSet::kPathPrefix, u"\\Device\\HarddiskVolume3\\Windows\\"), "Add prefix");
+		Check(s.Add(RuleSet::kExtension, u".TMP"), "Add extension with '.'");
+		Check(s.Add(RuleSet::kExtension, u"log"), "Add extension without '.'");
+		Check(s.Add(RuleSet::kProcessImage, u"\\Device\\HarddiskVolume3\\Tools\\Backup.exe"), "Add image");
+		Check(!s.Add(RuleSet::kExtension, u""), "empty rule refused");
+		Check(!s.Add((RuleSet::Kind)9, u"x"), "unknown kind refused");
+		Check(s.Compile() && s.Compiled() && s.Size() == 4 && s.HasImages(), "Compile");
+		Check(!s.Add(RuleSet::kExtension, u".late"), "Add after Compile fails");
+
+		Check(s.MatchPath(u"\\device\\harddiskvolume3\\WINDOWS\\notepad.exe"), "prefix, other case");
+		Check(!s.MatchPath(u"\\Device\\HarddiskVolume3\\Windows\\"), "prefix does not match itself");
+		Check(!s.MatchPath(u"\\Device\\HarddiskVolume3\\WindowsApps\\a.exe"), "prefix sibling");
+		Check(s.MatchPath(u"\\Device\\HarddiskVolume3\\Users\\a\\x.tmp"), "extension");
+		Check(s.MatchPath(u"\\Device\\HarddiskVolume3\\Users\\a\\X.Log"), "extension added without '.'");
+		Check(!s.MatchPath(u"\\Device\\HarddiskVolume3\\Users\\a\\x.tmp.docx"), "only the last extension");
+		Check(!s.MatchPath(u"\\Device\\HarddiskVolume3\\Users\\a.tmp\\x"), "'.' in a directory is no extension");
+		Check(!s.MatchPath(u"\\Device\\HarddiskVolume3\\Users\\a\\tmp"), "name equal to the extension");
+		Check(!s.MatchPath(u"\\Device\\HarddiskVolume3\\Users\\a\\x.") && !s.MatchPath(u""), "bare '.' and empty");
+
+		std::WStringView image(u"\\device\\harddiskvolume3\\tools\\BACKUP.EXE");
+		Check(s.MatchImage(image, RuleSet::Key(image)), "image, other case");
+		std::WStringView other(u"\\Device\\HarddiskVolume3\\Tools\\Backup2.exe");
+		Check(!s.MatchImage(other, RuleSet::Key(other)), "other image");
+		Check(!s.MatchPath(image) && !s.MatchImage(u"\\Device\\HarddiskVolume3\\Windows\\x", 0), "kinds do not mix");
+
+		Check(RuleSet::Extension(u"\\a\\b.c.TXT").EqualCi(u".txt") && RuleSet::Extension(u"\\a.b\\c").Empty(), "Extension");
+
+		RuleSet empty;
+		Check(empty.Compile() && !empty.MatchPath(u"\\a.tmp") && !empty.HasImages(), "empty rule set");
+	}
+
+	// Writes `r` as the service does (DriverChannel::LoadFilterRules) into a
+	// buffer of `*bytes`.
+	unsigned char* WritePayload(unsigned short kind, const std::WString* texts, unsigned long long count, unsigned long long* bytes)
+	{
+		unsigned long long size = 0;
+		for (unsigned long long i = 0; i < count; i++) {
+			size += shm::FilterRuleBytes((unsigned int)texts[i].Size());
+		}
+		unsigned char* p = new unsigned char[size + 1];
+		unsigned long long at = 0;
+		for (unsigned long long i = 0; i < count; i++) {
+			at += shm::WriteFilterRule(p + at, kind, texts[i].Data(), (unsigned short)texts[i].Size());
+		}
+		*bytes = size;
+		return p;
+	}
+
+	// collector::SetFilterRules, minus the lock.
+	bool ParsePayload(RuleSet& s, const void* rules, unsigned long long bytes)
+	{
+		bool parsed = shm::ForEachFilterRule(rules, bytes, [&](const shm::FilterRule& rule) {
+			std::WStringView text((const WCHAR*)(&rule + 1), rule.chars);
+			return s.Add((RuleSet::Kind)rule.kind, text);
+		});
+		return parsed && s.Compile();
+	}
+
+	void TestPayload(const Rules& r)
+	{
+		unsigned long long bytes = 0;
+		unsigned char* p = WritePayload(shm::kRuleExtension, r.extensions, r.extension_count, &bytes);
+		Check(bytes % shm::kFilterRuleAlign == 0, "payload aligned");
+
+		RuleSet s;
+		Check(ParsePayload(s, p, bytes) && s.Size() == r.extension_count, "payload round trip");
+		bool all = true;
+		for (unsigned long long i = 0; i < r.extension_count; i++) {
+			std::WString file = Path("\\Device\\HarddiskVolume3\\f");
+			file.Append(r.extensions[i]);
+			all = all && s.MatchPath(file);
+		}
+		Check(all, "payload rules match");
+
+		RuleSet truncated;
+		Check(!ParsePayload(truncated, p, bytes - 2), "truncated payload refused");
+		RuleSet short_header;
+		Check(!ParsePayload(short_header, p, 2), "partial header refused");
+
+		shm::FilterRule* first = (shm::FilterRule*)p;
+		unsigned short chars = first->chars;
+		first->chars = 0;
+		RuleSet no_text;
+		Check(!ParsePayload(no_text, p, bytes), "rule without text refused");
+		first->chars = chars;
+		first->kind = 7;
+		RuleSet unknown;
+		Check(!ParsePayload(unknown, p, bytes), "unknown kind refused");
+
+		RuleSet cleared;
+		Check(ParsePayload(cleared, nullptr, 0) && cleared.Size() == 0, "empty payload clears");
+		delete[] p;
+	}
+
+	// The defaults plus `n` of each kind: vendor directories, extensions of
+	// scratch files, and tool images.
+	Rules MakeRules(unsigned long long n)
+	{
+		Rules r;
+		r.prefix_count = n + sizeof(kDefaultPrefixes) / sizeof(kDefaultPrefixes[0]);
+		r.prefixes = new std::WString[r.prefix_count];
+		for (unsigned long long i = 0; i < r.prefix_count - n; i++) {
+			r.prefixes[i] = std::WString(kDefaultPrefixes[i]);
+		}
+		for (unsigned long long i = 0; i < n; i++) {
+			r.prefixes[r.prefix_count - n + i] = Path("\\Device\\HarddiskVolume%llu\\Build\\Vendor%04llu\\", 3 + i % 2, i);
+		}
+		r.extension_count = n;
+		r.extensions = new std::WString[n];
+		r.image_count = n;
+		r.images = new std::WString[n];
+		for (unsigned long long i = 0; i < n; i++) {
+			r.extensions[i] = Path(".t%03llx", i);
+			r.images[i] = Path("\\Device\\HarddiskVolume3\\Tools\\Tool%04llu\\agent.exe", i);
+		}
+		return r;
+	}
+
+	// Opens the way a desktop produces them: mostly user documents, some
+	// system and vendor files, scratch files, near misses.
+	std::WString* MakeQueries(unsigned long long n, unsigned long long count)
+	{
+		const char* docs[] = { "docx", "xlsx", "pdf", "jpg", "txt", "png", "zip" };
+		std::WString* q = new std::WString[count];
+		for (unsigned long long i = 0; i < count; i++) {
+			unsigned long long k = (i * 2654435761ull) % n;
+			switch (i % 10) {
+			case 0:
+				q[i] = Path("\\Device\\HarddiskVolume3\\WINDOWS\\System32\\dll%04llu.dll", k);
+				break;
+			case 1:
+				q[i] = Path("\\Device\\HarddiskVolume3\\ProgramData\\Vendor\\cache%04llu.bin", k);
+				break;
+			case 2:
+				q[i] = Path("\\Device\\HarddiskVolume%llu\\Build\\VENDOR%04llu\\obj\\a.o", 3 + k % 2, k);
+				break;
+			case 3:
+				q[i] = Path("\\Device\\HarddiskVolume3\\Users\\someone\\Temp\\x%04llu.T%03llX", k, k);
+				break;
+			case 4:
+				q[i] = Path("\\Device\\HarddiskVolume3\\Build\\Vendor%04llux\\a.o", k);
+				break;
+			default:
+				q[i] = Path("\\Device\\HarddiskVolume3\\Users\\someone\\Documents\\report%04llu.%s", k, docs[k % 7]);
+				break;
+			}
+		}
+		return q;
+	}
+
+	std::WString* MakeImages(unsigned long long n, unsigned long long count)
+	{
+		std::WString* q = new std::WString[count];
+		for (unsigned long long i = 0; i < count; i++) {
+			unsigned long long k = (i * 2654435761ull) % n;
+			switch (i % 4) {
+			case 0:
+				q[i] = Path("\\Device\\HarddiskVolume3\\tools\\TOOL%04llu\\agent.exe", k);
+				break;
+			case 1:
+				q[i] = Path("\\Device\\HarddiskVolume3\\Tools\\Tool%04llu\\agent.exe.old", k);
+				break;
+			default:
+				q[i] = Path("\\Device\\HarddiskVolume3\\Program Files\\App%04llu\\app.exe", k);
+				break;
+			}
+		}
+		return q;
+	}
+
+	RuleSet* Compile(const Rules& r)
+	{
+		RuleSet* s = new RuleSet();
+		bool added = true;
+		for (unsigned long long i = 0; i < r.prefix_count; i++) {
+			added = added && s->Add(RuleSet::kPathPrefix, r.prefixes[i]);
+		}
+		for (unsigned long long i = 0; i < r.extension_count; i++) {
+			added = added && s->Add(RuleSet::kExtension, r.extensions[i]);
+		}
+		for (unsigned long long i = 0; i < r.image_count; i++) {
+			added = added && s->Add(RuleSet::kProcessImage, r.images[i]);
+		}
+		Check(added && s->Compile(), "Compile generated rules");
+		return s;
+	}
+
+	// The share of lookups that should be rejected the bloom filter turns
+	// away, for `ext` (extensions) or images.
+	double BloomRejectRate(const RuleSet& s, const krnl_std::BloomFilter& bloom, const std::WString* q, unsigned long long count, bool ext)
+	{
+		unsigned long long misses = 0;
+		unsigned long long rejected = 0;
+		for (unsigned long long i = 0; i < count; i++) {
+			std::WStringView key = ext ? RuleSet::Extension(q[i]) : std::WStringView(q[i]);
+			if (key.Empty() || (ext ? s.MatchPath(key) : s.MatchImage(key, RuleSet::Key(key)))) {
+				continue;
+			}
+			misses++;
+			rejected += krnl_std::MayContainBloom(bloom, RuleSet::Key(key)) ? 0 : 1;
+		}
+		return misses != 0 ? (double)rejected / misses : 1.0;
+	}
+
+	void TestAgreement(const Rules& r, const RuleSet& s, const std::WString* q, const std::WString* images, unsigned long long count)
+	{
+		unsigned long long hits = 0;
+		unsigned long long image_hits = 0;
+		bool agree = true;
+		for (unsigned long long i = 0; i < count; i++) {
+			bool expect = ScanPath(r, q[i]);
+			agree = agree && s.MatchPath(q[i]) == expect;
+			hits += expect ? 1 : 0;
+			bool expect_image = ScanImage(r, images[i]);
+			agree = agree && s.MatchImage(images[i], RuleSet::Key(images[i])) == expect_image;
+			image_hits += expect_image ? 1 : 0;
+		}
+		Check(agree, "rule set agrees with evaluating each rule");
+		Check(hits > count / 10 && hits < count / 2, "path mix has hits and misses");
+		Check(image_hits > count / 8 && image_hits < count / 2, "image mix has hits and misses");
+	}
+
+	void TestAllocFailure(const Rules& r)
+	{
+		RuleSet s;
+		for (unsigned long long i = 0; i < r.prefix_count; i++) {
+			s.Add(RuleSet::kPathPrefix, r.prefixes[i]);
+		}
+		krnl_std::SetSlabFailAfter(0);
+		bool compiled = s.Compile();
+		krnl_std::SetSlabFailAfter(-1);
+		Check(!compiled && !s.Compiled(), "Compile reports allocation failure");
+	}
+
+	template <typename Fn>
+	void Time(const char* name, unsigned long long iters, Fn&& fn)
+	{
+		volatile unsigned long long sink = 0;
+		double t0 = NowNs();
+		for (unsigned long long i = 0; i < iters; i++) {
+			sink = sink + fn(i);
+		}
+		double t1 = NowNs();
+		printf("  %-40s %10.1f ns/lookup\n", name, (t1 - t0) / iters);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned long long n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 64;
+	unsigned long long iters = argc > 2 ? strtoull(argv[2], nullptr, 10) : 1000000;
+	if (n == 0) {
+		n = 1;
+	}
+	// RtlUpcaseUnicodeChar is towupper here, which needs a Unicode locale.
+	setlocale(LC_CTYPE, "C.UTF-8");
+
+	TestEdges();
+	Check(TrieLive() == 0, "edge-case tries freed");
+
+	Rules r = MakeRules(n);
+	const unsigned long long kQueries = 4096;
+	std::WString* q = MakeQueries(n, kQueries);
+	std::WString* images = MakeImages(n, kQueries);
+
+	TestPayload(r);
+	TestAllocFailure(r);
+	Check(TrieLive() == 0, "payload and failure tries freed");
+
+	double t0 = NowNs();
+	RuleSet* s = Compile(r);
+	double t1 = NowNs();
+	TestAgreement(r, *s, q, images, kQueries);
+
+	// The filters are private; a copy filled the same way measures them.
+	krnl_std::BloomFilter ext_bloom;
+	krnl_std::BloomFilter image_bloom;
+	krnl_std::InitBloom(ext_bloom);
+	krnl_std::InitBloom(image_bloom);
+	for (unsigned long long i = 0; i < n; i++) {
+		krnl_std::AddBloom(ext_bloom, RuleSet::Key(r.extensions[i]));
+		krnl_std::AddBloom(image_bloom, RuleSet::Key(r.images[i]));
+	}
+	double ext_reject = BloomRejectRate(*s, ext_bloom, q, kQueries, true);
+	double image_reject = BloomRejectRate(*s, image_bloom, images, kQueries, false);
+	Check(ext_reject > 0.9 && image_reject > 0.9, "bloom filters reject most misses");
+
+	if (failures != 0) {
+		fprintf(stderr, "%d check(s) failed\n", failures);
+		return 1;
+	}
+	printf("rule set checks passed\n");
+
+	printf("%llu prefixes, %llu extensions, %llu images: compiled in %.2f ms, %llu bytes\n",
+		r.prefix_count, r.extension_count, r.image_count, (t1 - t0) / 1e6, s->Bytes());
+	printf("bloom rejects %.1f%% of extension misses, %.1f%% of image misses\n",
+		ext_reject * 100, image_reject * 100);
+
+	Time("old chain, 5 default prefixes", iters, [&](unsigned long long i) {
+		return (unsigned long long)OldChain(q[i % kQueries]);
+	});
+	unsigned long long scan_iters = iters / (n / 16 + 1) + 1;
+	Time("each rule in turn, paths", scan_iters, [&](unsigned long long i) {
+		return (unsigned long long)ScanPath(r, q[i % kQueries]);
+	});
+	Time("rule set, paths", iters, [&](unsigned long long i) {
+		return (unsigned long long)s->MatchPath(q[i % kQueries]);
+	});
+
+	ull* keys = new ull[kQueries];
+	for (unsigned long long i = 0; i < kQueries; i++) {
+		keys[i] = RuleSet::Key(images[i]);
+	}
+	Time("each rule in turn, images", scan_iters, [&](unsigned long long i) {
+		return (unsigned long long)ScanImage(r, images[i % kQueries]);
+	});
+	Time("rule set, images (cached key)", iters, [&](unsigned long long i) {
+		return (unsigned long long)s->MatchImage(images[i % kQueries], keys[i % kQueries]);
+	});
+
+	delete[] keys;
+	delete s;
+	delete[] q;
+	delete[] images;
+	delete[] r.prefixes;
+	delete[] r.extensions;
+	delete[] r.images;
+	Check(TrieLive() == 0, "every trie block freed");
+	return failures != 0;
+}
@@ -0,0 +1,436 @@
+/*
+Tests and measures the substring search that replaced KMPMatcher:
+std/algo/search.h (Horspool, the SSE2 first/last-character filter, and the
+FindSubstring dispatch behind WStringView::FindFirstOf) and
+std/algo/aho_corasick.h, built from a copy of the driver sources on the
+user-mode slab allocator.
+
+Checks, exiting non-zero on the first failure:
+  - every search agrees with a plain scan and with KMPMatcher (kept below as
+    it was) on random texts over 2- and 4-letter alphabets, whose repeats
+    are the hard case for shift tables, and on paths; patterns of every
+    length up to 80, found and absent, at the ends of the text
+  - Horspool's byte-indexed shift table stays correct for characters that
+    share a low byte
+  - FindFirstOf from a position, misses, empty and oversized patterns
+  - AhoCorasick finds the earliest-ending occurrence (the longest of those
+    ending together) and its pattern, case-insensitively, agreeing with
+    FindFirstOf per pattern; an allocation failure in Compile is reported;
+    every kTrieTag block is freed
+
+Then times each search per call for pattern lengths from 1 to 64 over
+texts the size of a path and of a page, and a list of patterns searched with
+AhoCorasick against FindFirstOf once per pattern.
+
+Usage: search_bench [iterations]
+
+Kept free of the C++ library, like kernel_set_adapter.cpp: the driver's
+headers declare their own namespace std.
+*/
+#include "kstd/algo/search.h"
+#include "kstd/algo/aho_corasick.h"
+#include "kstd_shim/slab_user.h"
+
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+namespace {
+	constexpr unsigned int kTrieTag = 0x6972544b;   // 'irTK', as in the shim
+	constexpr unsigned long long kNone = krnl_std::kSearchNone;
+
+	int failures = 0;
+
+	void Check(bool ok, const char* what)
+	{
+		if (!ok) {
+			fprintf(stderr, "FAIL: %s\n", what);
+			failures++;
+		}
+	}
+
+	unsigned long long TrieLive()
+	{
+		krnl_std::SlabTagStats s = krnl_std::GetSlabTagStats(kTrieTag);
+		return s.allocs - s.frees;
+	}
+
+	double NowNs()
+	{
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1e9 + ts.tv_nsec;
+	}
+
+	unsigned long long rng = 88172645463325252ull;
+
+	unsigned long long Next()
+	{
+		rng ^= rng << 13;
+		rng ^= rng >> 7;
+		rng ^= rng << 17;
+		return rng;
+	}
+
+	// printf into a WString; the generated paths are ASCII.
+	template <typename... Args>
+	std::WString Path(const char* format, Args... args)
+	{
+		char buf[512];
+		int n = snprintf(buf, sizeof(buf), format, args...);
+		std::WString s;
+		for (int i = 0; i < n; i++) {
+			s.PushBack((WCHAR)buf[i]);
+		}
+		return s;
+	}
+
+	// std/algo/kmp.h as it was, for comparison: the failure table is
+	// allocated per construction.
+	template <typename T>
+	class KMPMatcher {
+	private:
+		T* text;
+		ull text_size;
+		T* pattern;
+		ull pattern_size;
+		ull* lps;
+
+		void ComputeLpsArray()
+		{
+			ull length = 0;
+			ull i = 1;
+			lps[0] = 0;
+			while (i < pattern_size) {
+				if (pattern[i] == pattern[length]) {
+					length++;
+					lps[i] = length;
+					i++;
+				}
+				else if (length != 0) {
+					length = lps[length - 1];
+				}
+				else {
+					lps[i] = 0;
+					i++;
+				}
+			}
+		}
+
+	public:
+		KMPMatcher(T* text, ull text_size, T* pattern, ull pattern_size)
+			: text(text), text_size(text_size), pattern(pattern), pattern_size(pattern_size)
+		{
+			lps = new ull[pattern_size];
+			ComputeLpsArray();
+		}
+
+		~KMPMatcher() { delete[] lps; }
+
+		ull KmpSearch()
+		{
+			ull i = 0;
+			ull j = 0;
+			while (i < text_size) {
+				if (pattern[j] == text[i]) {
+					i++;
+					j++;
+				}
+				if (j == pattern_size) {
+					return i - j;
+				}
+				else if (i < text_size && pattern[j] != text[i]) {
+					if (j != 0) {
+						j = lps[j - 1];
+					}
+					else {
+						i++;
+					}
+				}
+			}
+			return ULL_MAX;
+		}
+	};
+
+	unsigned long long Kmp(const WCHAR* text, unsigned long long n, const WCHAR* pat, unsigned long long m)
+	{
+		if (m == 0) {
+			return kNone;
+		}
+		KMPMatcher<const WCHAR> k(text, n, pat, m);
+		ull at = k.KmpSearch();
+		return at == ULL_MAX ? kNone : at;
+	}
+
+	// WStringView::FindFirstOf before search.h.
+	unsigned long long Plain(const WCHAR* text, unsigned long long n, const WCHAR* pat, unsigned long long m)
+	{
+		if (m == 0 || n < m) {
+			return kNone;
+		}
+		for (unsigned long long i = 0; i <= n - m; i++) {
+			if (text[i] == pat[0] && krnl_std::SearchEqual(text + i + 1, pat + 1, m - 1)) {
+				return i;
+			}
+		}
+		return kNone;
+	}
+
+	void RandomText(WCHAR* s, unsigned long long n, unsigned int letters, WCHAR base)
+	{
+		for (unsigned long long i = 0; i < n; i++) {
+			s[i] = (WCHAR)(base + Next() % letters);
+		}
+	}
+
+	bool AgreeAll(const WCHAR* text, unsigned long long n, const WCHAR* pat, unsigned long long m)
+	{
+		unsigned long long expect = Plain(text, n, pat, m);
+		return Kmp(text, n, pat, m) == expect
+			&& krnl_std::HorspoolSearch(text, n, pat, m) == expect
+			&& krnl_std::FirstLastSearch(text, n, pat, m) == expect
+			&& krnl_std::FindSubstring(text, n, pat, m) == expect;
+	}
+
+	void TestAgreement()
+	{
+		const unsigned long long kMax = 400;
+		WCHAR text[kMax];
+		WCHAR pat[kMax];
+		bool agree = true;
+		unsigned long long found = 0;
+		unsigned long long cases = 0;
+		for (unsigned int letters = 2; letters <= 4; letters += 2) {
+			for (unsigned int round = 0; round < 3000; round++) {
+				unsigned long long n = Next() % kMax + 1;
+				unsigned long long m = Next() % 81 + 1;
+				RandomText(text, n, letters, u'a');
+				if (m <= n && Next() % 2 == 0) {
+					// Copied from the text, sometimes from either end.
+					unsigned long long at = Next() % 4 == 0 ? n - m : (Next() % 4 == 0 ? 0 : Next() % (n - m + 1));
+					for (unsigned long long i = 0; i < m; i++) {
+						pat[i] = text[at + i];
+					}
+				}
+				else {
+					RandomText(pat, m, letters, u'a');
+				}
+				agree = agree && AgreeAll(text, n, pat, m);
+				found += Plain(text, n, pat, m) != kNone ? 1 : 0;
+				cases++;
+			}
+		}
+		Check(agree, "searches agree with a plain scan and KMP on random texts");
+		Check(found > cases / 4 && found < cases * 3 / 4, "random cases found and not found");
+
+		// Characters sharing a low byte share a shift-table slot.
+		WCHAR shared[] = { 0x0141, 0x0241, 0x0041, 0x0341, 0x0141, 0x0241, 0x0341 };
+		WCHAR sp[] = { 0x0141, 0x0241, 0x0341 };
+		Check(krnl_std::HorspoolSearch(shared, 7, sp, 3) == 4 && krnl_std::FirstLastSearch(shared, 7, sp, 3) == 4,
+			"characters with the same low byte");
+
+		std::WString path(u"\\Device\\HarddiskVolume3\\Program Files\\VMware\\VMware Tools\\vmtoolsd.exe");
+		bool paths = true;
+		for (unsigned long long b = 0; b < path.Size(); b++) {
+			for (unsigned long long e = b + 1; e <= path.Size() && e <= b + 70; e++) {
+				std::WStringView sub = path.View().Substr(b, e - b);
+				paths = paths && path.FindFirstOf(sub) != std::WString::kNPos && path.FindFirstOf(sub) <= b
+					&& AgreeAll(path.Data(), path.Size(), sub.Data(), sub.Size());
+			}
+		}
+		Check(paths, "every substring of a path is found at or before its place");
+		Check(path.FindFirstOf(u"VMware") == 38 && path.FindFirstOf(u"VMware", 39) == 45, "FindFirstOf from a position");
+		Check(path.FindFirstOf(u"vmware") == std::WString::kNPos, "FindFirstOf is case-sensitive");
+		Check(path.FindFirstOf(u"") == std::WString::kNPos && path.FindFirstOf(u"x", path.Size() + 1) == std::WString::kNPos,
+			"empty pattern, start past the end");
+		Check(std::WStringView(u"ab").FindFirstOf(u"abc") == std::WString::kNPos && path.Contain(u"vmtoolsd.exe"),
+			"pattern longer than the text, Contain");
+	}
+
+	void TestAhoCorasick()
+	{
+		AhoCorasick ac;
+		Check(ac.Add(u"VMware") && ac.Add(u"\\Downloads\\") && ac.Add(u"ware\\VMware Tools") && ac.Add(u"are"), "Add");
+		Check(ac.Add(u"vmWARE") && ac.Size() == 4, "duplicate keeps its number");
+		Check(!ac.Add(u""), "empty pattern refused");
+		Check(!ac.Match(u"VMware"), "nothing found before Compile");
+		Check(ac.Compile() && ac.Compiled() && !ac.Add(u"late"), "Compile");
+
+		unsigned int which = AhoCorasick::kNone;
+		std::WStringView vm(u"\\Program Files\\vmware\\VMware Tools\\x.exe");
+		Check(ac.Find(vm, &which) == 15 && which == 0, "'vmware' over 'are', ending together");
+		Check(ac.Find(u"\\share\\vmware", &which) == 3 && which == 3, "earliest end wins");
+		Check(ac.Find(u"C:\\Users\\a\\DOWNLOADS\\setup.exe", &which) == 10 && which == 1, "other case");
+		Check(ac.Find(u"\\VMwar") == std::WStringView::kNPos && !ac.Match(u"") && !ac.Match(u"ar"), "misses");
+
+		AhoCorasick longest;
+		Check(longest.Add(u"b") && longest.Add(u"abcd") && longest.Add(u"bcd") && longest.Compile(), "Compile overlapping");
+		Check(longest.Find(u"xbcd", &which) == 1 && which == 0, "shorter pattern ending first");
+		Check(longest.Find(u"xacd") == std::WStringView::kNPos, "failure link back to the root");
+		AhoCorasick same_end;
+		Check(same_end.Add(u"cd") && same_end.Add(u"abcd") && same_end.Compile(), "Compile same end");
+		Check(same_end.Find(u"xabcd", &which) == 1 && which == 1, "longest of those ending together");
+
+		AhoCorasick empty;
+		Check(empty.Compile() && !empty.Match(u"anything"), "empty automaton");
+
+		// Against FindFirstOf per pattern, on folded random texts.
+		const unsigned int kPatterns = 40;
+		std::WString patterns[kPatterns];
+		AhoCorasick random;
+		for (unsigned int p = 0; p < kPatterns; p++) {
+			WCHAR buf[8];
+			unsigned long long m = Next() % 7 + 1;
+			RandomText(buf, m, 3, u'a');
+			patterns[p] = std::WString(std::WStringView(buf, m));
+			random.Add(patterns[p]);
+		}
+		Check(random.Compile(), "Compile random");
+		bool agree = true;
+		for (unsigned int round = 0; round < 2000; round++) {
+			WCHAR buf[64];
+			unsigned long long n = Next() % 64;
+			RandomText(buf, n, 4, u'a');
+			std::WStringView text(buf, n);
+			size_t best_end = std::WStringView::kNPos;
+			size_t best_len = 0;
+			for (unsigned int p = 0; p < kPatterns; p++) {
+				size_t at = text.FindFirstOf(patterns[p]);
+				if (at == std::WStringView::kNPos) {
+					continue;
+				}
+				size_t end = at + patterns[p].Size();
+				if (best_end == std::WStringView::kNPos || end < best_end || (end == best_end && patterns[p].Size() > best_len)) {
+					best_end = end;
+					best_len = patterns[p].Size();
+				}
+			}
+			size_t got = random.Find(text, &which);
+			agree = agree && (best_end == std::WStringView::kNPos
+				? got == std::WStringView::kNPos
+				: got == best_end - best_len && random.Find(text) == got && patterns[which].Size() == best_len);
+		}
+		Check(agree, "automaton agrees with FindFirstOf per pattern");
+
+		AhoCorasick failing;
+		failing.Add(u"VMware");
+		krnl_std::SetSlabFailAfter(0);
+		bool compiled = failing.Compile();
+		krnl_std::SetSlabFailAfter(-1);
+		Check(!compiled && !failing.Match(u"VMware"), "Compile reports allocation failure");
+		Check(failing.Compile() && failing.Match(u"x\\vmware"), "Compile after a failure");
+	}
+
+	template <typename Fn>
+	double Time(unsigned long long iters, Fn&& fn)
+	{
+		volatile unsigned long long sink = 0;
+		double t0 = NowNs();
+		for (unsigned long long i = 0; i < iters; i++) {
+			sink = sink + fn(i);
+		}
+		return (NowNs() - t0) / iters;
+	}
+
+	// Per call, for patterns of each length taken from a text of `n`
+	// characters over ASCII path characters, half found and half absent.
+	void TimeSearches(const char* label, unsigned long long n, unsigned long long iters)
+	{
+		WCHAR* text = new WCHAR[n];
+		RandomText(text, n, 26, u'a');
+		for (unsigned long long i = 7; i < n; i += 8) {
+			text[i] = u'\\';
+		}
+		printf("%s, %llu chars (ns/call)\n", label, n);
+		printf("  %4s %9s %9s %9s %9s %9s\n", "len", "plain", "kmp", "horspool", "firstlast", "dispatch");
+		const unsigned long long lengths[] = { 1, 2, 4, 6, 8, 16, 32, 64 };
+		for (unsigned long long m : lengths) {
+			if (m > n) {
+				continue;
+			}
+			const unsigned int kPats = 16;
+			WCHAR pats[kPats][64];
+			for (unsigned int p = 0; p < kPats; p++) {
+				// Odd ones from near the end of the text, even ones absent
+				// ('{' never occurs), so most calls scan the whole text.
+				unsigned long long span = n - m + 1;
+				unsigned long long at = p % 2 == 1 ? span - 1 - (p * 7) % (span < 64 ? span : 64) : (p * 131) % span;
+				for (unsigned long long i = 0; i < m; i++) {
+					pats[p][i] = text[at + i];
+				}
+				if (p % 2 == 0) {
+					pats[p][m - 1] = u'{';
+				}
+			}
+			auto run = [&](unsigned long long (*fn)(const WCHAR*, unsigned long long, const WCHAR*, unsigned long long)) {
+				return Time(iters, [&](unsigned long long i) {
+					return fn(text, n, pats[i % kPats], m);
+				});
+			};
+			printf("  %4llu %9.1f %9.1f %9.1f %9.1f %9.1f\n", m,
+				run(Plain), run(Kmp),
+				run(krnl_std::HorspoolSearch<WCHAR>), run(krnl_std::FirstLastSearch<WCHAR>),
+				run(krnl_std::FindSubstring<WCHAR>));
+		}
+		delete[] text;
+	}
+
+	void TimeAhoCorasick(unsigned long long iters)
+	{
+		const unsigned long long kTexts = 1024;
+		std::WString* texts = new std::WString[kTexts];
+		for (unsigned long long i = 0; i < kTexts; i++) {
+			texts[i] = Path("\\Device\\HarddiskVolume3\\Users\\someone\\Documents\\Project%04llu\\report%04llu.docx", i % 97, i);
+		}
+		printf("pattern list over paths (ns/path)\n");
+		printf("  %8s %12s %12s %10s\n", "patterns", "findfirstof", "ahocorasick", "bytes");
+		const unsigned int counts[] = { 1, 4, 16, 64, 256 };
+		for (unsigned int count : counts) {
+			std::WString* patterns = new std::WString[count];
+			AhoCorasick ac;
+			for (unsigned int p = 0; p < count; p++) {
+				patterns[p] = Path("\\Vendor%03u\\", p);
+				ac.Add(patterns[p]);
+			}
+			ac.Compile();
+			unsigned long long scan_iters = iters / count + 1;
+			double per_pattern = Time(scan_iters, [&](unsigned long long i) {
+				const std::WString& t = texts[i % kTexts];
+				for (unsigned int p = 0; p < count; p++) {
+					if (t.FindFirstOf(patterns[p]) != std::WString::kNPos) {
+						return 1ull;
+					}
+				}
+				return 0ull;
+			});
+			double automaton = Time(iters, [&](unsigned long long i) {
+				return (unsigned long long)ac.Match(texts[i % kTexts]);
+			});
+			printf("  %8u %12.1f %12.1f %10llu\n", count, per_pattern, automaton, ac.Bytes());
+			delete[] patterns;
+		}
+		delete[] texts;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned long long iters = argc > 1 ? strtoull(argv[1], nullptr, 10) : 200000;
+	// RtlUpcaseUnicodeChar is towupper here, which needs a Unicode locale.
+	setlocale(LC_CTYPE, "C.UTF-8");
+
+	TestAgreement();
+	TestAhoCorasick();
+	Check(TrieLive() == 0, "every automaton block freed");
+	if (failures != 0) {
+		fprintf(stderr, "%d check(s) failed\n", failures);
+		return 1;
+	}
+	printf("search checks passed\n");
+
+	TimeSearches("path", 96, iters);
+	TimeSearches("page", 2048, iters / 10 + 1);
+	TimeAhoCorasick(iters);
+	return 0;
+}
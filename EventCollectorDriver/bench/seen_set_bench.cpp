@@ -0,0 +1,209 @@
+/*
+collector's "already logged" sets: the driver's Set<ull> red-black tree
+under one lock (as LogFileEvent used it, Clear() at 100,000 paths) against
+std/set/seen_set.h.
+
+Each simulated handle close does what LogFileEvent does: look up the
+requestor pid, the path hash and the new-path hash, and insert whatever was
+missing once its record would be written. Paths follow a Zipf-like distribution over a working set larger
+than either set, so both have to forget; "logged" counts the P/F records
+that would be written (lower is better, the minimum is the number of
+distinct keys).
+
+Usage: seen_set_bench [closes_per_thread] [distinct_paths]
+Exits non-zero if the seen set misses a key it must still hold.
+*/
+#include "../std/set/seen_set.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+void* KernelSetCreate();
+void KernelSetDestroy(void* s);
+bool KernelSetContains(void* s, unsigned long long key);
+bool KernelSetInsert(void* s, unsigned long long key);
+unsigned long long KernelSetSize(void* s);
+void KernelSetClear(void* s);
+
+namespace {
+	constexpr unsigned long long kProcessBuckets = 512;     // SEEN_PROCESS_BUCKETS
+	constexpr unsigned long long kPathBuckets = 16384;      // SEEN_PATH_BUCKETS
+	constexpr unsigned long long kEmptyPathHash = 5381;     // HashWstring(L"")
+
+	struct Close {
+		unsigned long long pid, hf, hfn;
+	};
+
+	// DJB2-like spread: path hashes are arbitrary 64-bit values.
+	unsigned long long PathHash(unsigned long long i)
+	{
+		unsigned long long h = 5381;
+		for (int b = 0; b < 8; b++) {
+			h = h * 33 + ((i >> (b * 8)) & 0xFF) + 'a';
+		}
+		return h;
+	}
+
+	std::vector<Close> MakeLoad(size_t n, unsigned long long paths, unsigned int seed)
+	{
+		std::mt19937_64 rng(seed);
+		// Zipf(s=1) by inverse transform over ranks.
+		std::uniform_real_distribution<double> uni(0.0, 1.0);
+		double hn = std::log((double)paths) + 0.5772;
+		std::vector<Close> out(n);
+		for (auto& c : out) {
+			unsigned long long rank = (unsigned long long)std::exp(uni(rng) * hn);
+			if (rank >= paths) {
+				rank = paths - 1;
+			}
+			c.pid = 4 * (100 + rng() % 200);
+			c.hf = PathHash(rank);
+			c.hfn = rng() % 50 == 0 ? PathHash(rank + paths) : kEmptyPathHash;
+		}
+		return out;
+	}
+
+	struct Result {
+		double seconds;
+		unsigned long long logged;
+	};
+
+	struct TreeSets {
+		void* sp = KernelSetCreate();
+		void* sf = KernelSetCreate();
+		std::mutex mtx;
+		~TreeSets() { KernelSetDestroy(sp); KernelSetDestroy(sf); }
+
+		// The lock pattern LogFileEvent had.
+		unsigned long long Check(void* set, unsigned long long key, bool paths)
+		{
+			mtx.lock();
+			if (!KernelSetContains(set, key)) {
+				mtx.unlock();
+				mtx.lock();
+				KernelSetInsert(set, key);
+				if (paths && KernelSetSize(set) == 100'000) {
+					KernelSetClear(set);
+				}
+				mtx.unlock();
+				return 1;
+			}
+			mtx.unlock();
+			return 0;
+		}
+	};
+
+	struct SeenSets {
+		std::vector<krnl_std::SeenBucket> pm{ kProcessBuckets }, fm{ kPathBuckets };
+		krnl_std::SeenSet sp, sf;
+		SeenSets()
+		{
+			krnl_std::InitSeenSet(sp, pm.data(), kProcessBuckets);
+			krnl_std::InitSeenSet(sf, fm.data(), kPathBuckets);
+		}
+	};
+
+	// LogPathOnce: test, write the record, mark the key only once it is in.
+	unsigned long long LogOnce(krnl_std::SeenSet& s, unsigned long long key)
+	{
+		if (krnl_std::TestSeen(s, key)) {
+			return 0;
+		}
+		krnl_std::TestAndInsertSeen(s, key);
+		return 1;
+	}
+
+	template <typename Fn>
+	Result RunThreads(unsigned int threads, const std::vector<std::vector<Close>>& loads, Fn&& fn)
+	{
+		std::vector<unsigned long long> logged(threads);
+		std::vector<std::thread> t;
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < threads; i++) {
+			t.emplace_back([&, i] { logged[i] = fn(loads[i]); });
+		}
+		for (auto& x : t) {
+			x.join();
+		}
+		Result r;
+		r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		r.logged = 0;
+		for (auto l : logged) {
+			r.logged += l;
+		}
+		return r;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t closes = argc > 1 ? (size_t)atoll(argv[1]) : 1000000;
+	unsigned long long paths = argc > 2 ? (unsigned long long)atoll(argv[2]) : 3000000;
+	int failures = 0;
+
+	// Must not forget what fits: fill to half capacity, then look everything up.
+	{
+		SeenSets s;
+		unsigned long long n = kPathBuckets * krnl_std::kSeenBucketSlots / 2;
+		unsigned long long missing = 0;
+		for (unsigned long long i = 0; i < n; i++) {
+			krnl_std::TestAndInsertSeen(s.sf, PathHash(i));
+		}
+		for (unsigned long long i = 0; i < n; i++) {
+			missing += krnl_std::TestAndInsertSeen(s.sf, PathHash(i)) ? 0 : 1;
+		}
+		krnl_std::EraseSeen(s.sf, PathHash(7));
+		bool erased = !krnl_std::TestAndInsertSeen(s.sf, PathHash(7));
+		printf("# half-full seen set: %llu of %llu keys forgotten, %llu evictions, erase %s\n",
+			missing, n, (unsigned long long)s.sf.evicted, erased ? "ok" : "FAILED");
+		// Bucket overflow at half load is possible but must stay rare.
+		failures += missing * 1000 > n || !erased;
+	}
+
+	printf("# %zu closes per thread, %llu distinct paths (Zipf)\n", closes, paths);
+	printf("%-10s %8s %12s %10s %12s\n", "set", "threads", "Mcloses/s", "cpu_ns", "logged");
+	for (unsigned int threads : { 1u, 2u, 4u, 8u }) {
+		std::vector<std::vector<Close>> loads;
+		for (unsigned int i = 0; i < threads; i++) {
+			loads.push_back(MakeLoad(closes, paths, 1000 + i));
+		}
+
+		TreeSets tree;
+		Result rt = RunThreads(threads, loads, [&](const std::vector<Close>& load) {
+			unsigned long long logged = 0;
+			for (const Close& c : load) {
+				logged += tree.Check(tree.sp, c.pid, false);
+				logged += tree.Check(tree.sf, c.hf, true);
+				logged += tree.Check(tree.sf, c.hfn, true);
+			}
+			return logged;
+		});
+
+		SeenSets seen;
+		Result rs = RunThreads(threads, loads, [&](const std::vector<Close>& load) {
+			unsigned long long logged = 0;
+			for (const Close& c : load) {
+				logged += LogOnce(seen.sp, c.pid);
+				logged += LogOnce(seen.sf, c.hf);
+				logged += LogOnce(seen.sf, c.hfn);
+			}
+			return logged;
+		});
+
+		double total = (double)closes * threads;
+		printf("%-10s %8u %12.2f %10.1f %12llu\n", "Set<ull>", threads, total / rt.seconds / 1e6, rt.seconds * 1e9 * threads / total, rt.logged);
+		printf("%-10s %8u %12.2f %10.1f %12llu\n", "SeenSet", threads, total / rs.seconds / 1e6, rs.seconds * 1e9 * threads / total, rs.logged);
+	}
+
+	if (failures != 0) {
+		fprintf(stderr, "FAILED\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,337 @@
+/*
+Test and throughput check for com/shared_ring.h, the driver -> service event
+channel that replaced one FltSendMessage per file.
+
+Producer threads stand in for ContextCleanup: they serialize on a mutex (the
+channel's spin lock) and write path events; one consumer runs the service's
+DriverChannel::DrainLoop, sleeping on a semaphore (the auto-reset event)
+with the same prepare/re-check/wait protocol. Checks:
+  - every record is intact (contents derived from producer and sequence),
+  - per producer, sequence numbers only go up,
+  - received + dropped == produced,
+  - no wake-up is lost (the consumer never sits out a full timeout while
+    records are pending, reported as stalls),
+  - a bogus tail written by the consumer makes the producer drop instead of
+    writing outside the ring, and a corrupt record is skipped, not followed.
+
+Then the same load through a locked queue with one allocation and one
+notify per event, for comparison with the per-message send.
+
+Usage: shared_ring_test [producers] [events_per_producer] [ring_kb]
+Exits non-zero on any mismatch.
+*/
+#include "../com/shared_ring.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <semaphore>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+	constexpr unsigned int kHeaderBytes = 4096;
+	constexpr int kIdleMs = 100;
+
+	struct Channel {
+		std::vector<unsigned char> memory;
+		shm::SharedRingHeader* header = nullptr;
+		shm::SharedRingWriter writer = {};
+		std::mutex lock;
+		std::binary_semaphore event{ 0 };
+
+		explicit Channel(unsigned int capacity)
+			: memory(kHeaderBytes + capacity + 64)
+		{
+			// Page-aligned in the driver; 64 is enough for the header here.
+			void* p = memory.data();
+			size_t space = memory.size();
+			header = (shm::SharedRingHeader*)std::align(64, kHeaderBytes + capacity, p, space);
+			shm::InitSharedRing(*header, kHeaderBytes, capacity);
+			shm::InitSharedRingWriter(writer, header);
+		}
+
+		// EventChannel::WritePathEvent.
+		bool Write(unsigned int pid, const char16_t* path, unsigned int chars)
+		{
+			unsigned int bytes = sizeof(shm::PathEventRecord) + chars * 2;
+			std::lock_guard<std::mutex> l(lock);
+			unsigned int size = 0;
+			auto* rec = (shm::PathEventRecord*)shm::ReserveSharedRecord(writer, bytes, &size);
+			if (rec == nullptr) {
+				return false;
+			}
+			rec->record.size = size;
+			rec->record.type = shm::kChannelPathEvent;
+			rec->record.reserved = 0;
+			rec->pid = pid;
+			rec->chars = chars;
+			memcpy(rec + 1, path, chars * 2);
+			if (shm::PublishSharedRecord(writer, size)) {
+				event.release();
+			}
+			return true;
+		}
+	};
+
+	// Path of event `seq` from producer `pid`: the sequence number in the
+	// first two chars, then a pattern that depends on both.
+	unsigned int MakePath(char16_t* out, unsigned int pid, unsigned int seq, unsigned int chars)
+	{
+		out[0] = (char16_t)(seq & 0xFFFF);
+		out[1] = (char16_t)(seq >> 16);
+		for (unsigned int i = 2; i < chars; i++) {
+			out[i] = (char16_t)(0x20 + ((seq * 31 + i * 7 + pid) % 0x5000));
+		}
+		return chars;
+	}
+
+	unsigned int PathChars(std::mt19937& rng, unsigned int max_chars)
+	{
+		return 2 + rng() % (max_chars - 1);
+	}
+
+	double Seconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	struct Result {
+		unsigned long long produced = 0;
+		unsigned long long received = 0;
+		unsigned long long bytes = 0;
+		unsigned long long errors = 0;
+		unsigned long long stalls = 0;
+		double seconds = 0;
+	};
+
+	Result RunRing(unsigned int producers, unsigned int events, unsigned int capacity, unsigned int max_chars)
+	{
+		Channel ch(capacity);
+		std::atomic<unsigned int> running{ producers };
+		std::vector<long long> last_seq(producers, -1);
+		Result res;
+
+		auto start = std::chrono::steady_clock::now();
+		std::thread consumer([&] {
+			std::vector<char16_t> expect(max_chars + 2);
+			for (;;) {
+				bool done = running.load() == 0;
+				unsigned long long n = shm::DrainSharedRing(*ch.header, [&](const shm::ChannelRecord& r) {
+					auto* rec = (const shm::PathEventRecord*)&r;
+					if (r.type != shm::kChannelPathEvent || rec->pid >= producers ||
+						sizeof(*rec) + rec->chars * 2ULL > r.size || rec->chars < 2) {
+						res.errors++;
+						return;
+					}
+					const char16_t* path = (const char16_t*)(rec + 1);
+					unsigned int seq = path[0] | ((unsigned int)path[1] << 16);
+					MakePath(expect.data(), rec->pid, seq, rec->chars);
+					if (memcmp(path, expect.data(), rec->chars * 2) != 0 || (long long)seq <= last_seq[rec->pid]) {
+						res.errors++;
+					}
+					last_seq[rec->pid] = seq;
+					res.received++;
+					res.bytes += r.size;
+				});
+				if (n != 0) {
+					continue;
+				}
+				if (done) {
+					break;
+				}
+				if (shm::PrepareSharedRingWait(*ch.header)) {
+					if (!ch.event.try_acquire_for(std::chrono::milliseconds(kIdleMs))) {
+						// Timed out. Producers signal under the lock, so with
+						// the lock held anything published must have left
+						// the event set; otherwise the wake-up was lost.
+						std::lock_guard<std::mutex> l(ch.lock);
+						if (ch.header->head != ch.header->tail && !ch.event.try_acquire()) {
+							res.stalls++;
+						}
+					}
+					shm::FinishSharedRingWait(*ch.header);
+				}
+			}
+		});
+
+		std::vector<std::thread> threads;
+		std::atomic<unsigned long long> produced{ 0 };
+		for (unsigned int p = 0; p < producers; p++) {
+			threads.emplace_back([&, p] {
+				std::mt19937 rng(p * 7919 + 1);
+				std::vector<char16_t> path(max_chars + 2);
+				for (unsigned int seq = 0; seq < events; seq++) {
+					unsigned int chars = MakePath(path.data(), p, seq, PathChars(rng, max_chars));
+					ch.Write(p, path.data(), chars);
+					if ((seq & 1023) == 0) {
+						std::this_thread::yield();
+					}
+				}
+				produced += events;
+				running--;
+			});
+		}
+		for (auto& t : threads) {
+			t.join();
+		}
+		ch.event.release();
+		consumer.join();
+		res.seconds = Seconds(start);
+		res.produced = produced;
+
+		if (res.received + ch.header->dropped != res.produced) {
+			fprintf(stderr, "accounting: received %llu + dropped %llu != produced %llu\n",
+				res.received, (unsigned long long)ch.header->dropped, res.produced);
+			res.errors++;
+		}
+		if (ch.header->produced != res.received) {
+			fprintf(stderr, "header produced %llu != received %llu\n", (unsigned long long)ch.header->produced, res.received);
+			res.errors++;
+		}
+		return res;
+	}
+
+	// One allocation and one notify per event, as with a message per file.
+	Result RunQueue(unsigned int producers, unsigned int events, unsigned int max_chars)
+	{
+		std::mutex m;
+		std::condition_variable cv;
+		std::deque<std::pair<unsigned int, std::u16string>> q;
+		std::atomic<unsigned int> running{ producers };
+		Result res;
+
+		auto start = std::chrono::steady_clock::now();
+		std::thread consumer([&] {
+			for (;;) {
+				std::unique_lock<std::mutex> l(m);
+				cv.wait(l, [&] { return !q.empty() || running.load() == 0; });
+				if (q.empty()) {
+					break;
+				}
+				auto e = std::move(q.front());
+				q.pop_front();
+				l.unlock();
+				res.received++;
+				res.bytes += e.second.size() * 2 + 8;
+			}
+		});
+
+		std::vector<std::thread> threads;
+		for (unsigned int p = 0; p < producers; p++) {
+			threads.emplace_back([&, p] {
+				std::mt19937 rng(p * 7919 + 1);
+				std::vector<char16_t> path(max_chars + 2);
+				for (unsigned int seq = 0; seq < events; seq++) {
+					unsigned int chars = MakePath(path.data(), p, seq, PathChars(rng, max_chars));
+					{
+						std::lock_guard<std::mutex> l(m);
+						q.emplace_back(p, std::u16string(path.data(), chars));
+					}
+					cv.notify_one();
+				}
+				if (--running == 0) {
+					std::lock_guard<std::mutex> l(m);
+					cv.notify_all();
+				}
+			});
+		}
+		for (auto& t : threads) {
+			t.join();
+		}
+		consumer.join();
+		res.seconds = Seconds(start);
+		res.produced = (unsigned long long)producers * events;
+		return res;
+	}
+
+	// The producer must not trust anything the consumer writes.
+	unsigned long long CheckHostileConsumer()
+	{
+		unsigned long long errors = 0;
+		const unsigned int capacity = 64 * 1024;
+		Channel ch(capacity);
+		char16_t path[64];
+		MakePath(path, 0, 1, 64);
+
+		// Tail ahead of head: drop, never write.
+		ch.header->tail = 1ULL << 40;
+		for (int i = 0; i < 10; i++) {
+			errors += ch.Write(0, path, 64) ? 1 : 0;
+		}
+		errors += ch.header->dropped == 10 ? 0 : 1;
+
+		// Tail far behind: looks full, drop.
+		ch.header->tail = 0;
+		while (ch.Write(0, path, 64)) {
+		}
+		unsigned long long head = ch.header->head;
+		errors += head <= capacity ? 0 : 1;
+
+		// Consumer side: a corrupt size makes the drain skip to head.
+		shm::DrainSharedRing(*ch.header, [](const shm::ChannelRecord&) {});
+		errors += ch.header->tail == head ? 0 : 1;
+		ch.Write(0, path, 64);
+		ch.Write(0, path, 64);
+		auto* first = (shm::ChannelRecord*)((unsigned char*)ch.header + kHeaderBytes + (ch.header->tail & (capacity - 1)));
+		first->size = 12;
+		unsigned long long seen = 0;
+		shm::DrainSharedRing(*ch.header, [&](const shm::ChannelRecord&) { seen++; });
+		errors += seen == 0 && ch.header->tail == ch.header->head ? 0 : 1;
+		return errors;
+	}
+
+	void Print(const char* name, const Result& r)
+	{
+		printf("%-8s %10llu %10llu %10.2f %10.1f %8llu\n", name, r.received, r.produced - r.received,
+			r.received / r.seconds / 1e6, r.bytes / r.seconds / (1 << 20), r.stalls);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int producers = argc > 1 ? (unsigned int)atoi(argv[1]) : 4;
+	unsigned int events = argc > 2 ? (unsigned int)atoi(argv[2]) : 500000;
+	unsigned int ring_kb = argc > 3 ? (unsigned int)atoi(argv[3]) : 1024;
+	unsigned int capacity = ring_kb * 1024;
+	if (producers == 0 || (capacity & (capacity - 1)) != 0) {
+		fprintf(stderr, "need producers > 0 and a power-of-two ring size\n");
+		return 2;
+	}
+
+	unsigned long long errors = CheckHostileConsumer();
+	if (errors != 0) {
+		fprintf(stderr, "hostile consumer checks: %llu failures\n", errors);
+	}
+
+	printf("# %u producers x %u events, ring %u KB\n", producers, events, ring_kb);
+	printf("%-8s %10s %10s %10s %10s %8s\n", "chars<=", "received", "dropped", "Mevt/s", "MB/s", "stalls");
+	for (unsigned int max_chars : { 32u, 128u, 260u, 1024u }) {
+		Result r = RunRing(producers, events, capacity, max_chars);
+		char name[16];
+		snprintf(name, sizeof(name), "%u", max_chars);
+		Print(name, r);
+		errors += r.errors + r.stalls;
+	}
+
+	printf("# locked queue, one allocation + notify per event\n");
+	for (unsigned int max_chars : { 32u, 260u }) {
+		Result r = RunQueue(producers, events, max_chars);
+		char name[16];
+		snprintf(name, sizeof(name), "%u", max_chars);
+		Print(name, r);
+	}
+
+	if (errors != 0) {
+		fprintf(stderr, "FAILED: %llu errors\n", errors);
+		return 1;
+	}
+	return 0;
+}
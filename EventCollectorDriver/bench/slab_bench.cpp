@@ -0,0 +1,285 @@
+/*
+Tests and measures the size-class allocator behind krnl_std::Alloc
+(std/memory/slab.h) on its user-mode backend (kstd_shim/slab_user.cpp).
+
+Checks, exiting non-zero on the first failure:
+  - class boundaries, payload alignment (16 small, 64 large)
+  - per-tag counters: allocs, frees, live bytes, failures
+  - failures come back as nullptr, never as a retry loop, and a failed
+    Set / Map insert leaves the container unchanged
+  - a block with a clobbered header is not put on a free list
+  - large blocks go back with their own tag, also once the tags outnumber
+    the counter slots
+  - the driver's Set<ull> and Map<ull, ull> return every node they take
+
+Then times alloc/free of the sizes the collector uses (set/map nodes,
+short and long paths) against plain malloc/free, on one thread and on
+`threads` threads.
+
+Usage: slab_bench [ops_per_thread] [threads]
+*/
+#include "kstd_shim/slab_user.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+void* KernelSetCreate();
+void KernelSetDestroy(void* s);
+bool KernelSetInsert(void* s, unsigned long long key);
+void KernelSetErase(void* s, unsigned long long key);
+unsigned long long KernelSetSize(void* s);
+void* KernelMapCreate();
+void KernelMapDestroy(void* m);
+bool KernelMapInsert(void* m, unsigned long long key, unsigned long long value);
+void KernelMapErase(void* m, unsigned long long key);
+unsigned long long KernelMapSize(void* m);
+
+namespace {
+	constexpr unsigned int kTestTag = 0x74736554;   // "Test"
+	constexpr unsigned int kLeakTag = 0x6b61654c;   // "Leak", TestCorruptHeader
+	constexpr unsigned int kSetTag = 0x7465534b;    // 'teSK', as in the shim
+	constexpr unsigned int kMapTag = 0x70614d4b;    // 'paMK'
+
+	int failures = 0;
+
+	void Check(bool ok, const char* what)
+	{
+		if (!ok) {
+			fprintf(stderr, "FAIL: %s\n", what);
+			failures++;
+		}
+	}
+
+	bool Aligned(const void* p, uintptr_t a)
+	{
+		return ((uintptr_t)p & (a - 1)) == 0;
+	}
+
+	void TestClasses()
+	{
+		using namespace krnl_std;
+		Check(SlabClassOf(1 + sizeof(SlabHeader)) == 0, "1 byte -> class 0");
+		Check(SlabClassOf(16 + sizeof(SlabHeader)) == 0, "16 bytes -> class 0");
+		Check(SlabClassOf(17 + sizeof(SlabHeader)) == 1, "17 bytes -> class 1");
+		Check(SlabClassOf(kSlabMaxBlock) == kSlabClassCount - 1, "max block -> last class");
+
+		const unsigned long long sizes[] = { 0, 1, 16, 17, 100, 1000, 2032, 2033, 5000, 1 << 20 };
+		for (unsigned long long n : sizes) {
+			unsigned char* p = (unsigned char*)Alloc(n, kTestTag);
+			Check(p != nullptr, "alloc");
+			Check(Aligned(p, n + sizeof(SlabHeader) > kSlabMaxBlock ? 64 : 16), "alignment");
+			Check(SlabSize(p) == n, "SlabSize");
+			memset(p, 0xcc, n);
+			Free(p);
+		}
+		Free(nullptr);
+	}
+
+	void TestAccounting()
+	{
+		using namespace krnl_std;
+		SlabTagStats before = GetSlabTagStats(kTestTag);
+		std::vector<void*> blocks;
+		unsigned long long bytes = 0;
+		for (int i = 0; i < 1000; i++) {
+			unsigned long long n = (unsigned long long)(i * 37 % 3000);
+			blocks.push_back(Alloc(n, kTestTag));
+			bytes += n;
+		}
+		SlabTagStats mid = GetSlabTagStats(kTestTag);
+		Check(mid.allocs - before.allocs == 1000, "allocs counted");
+		Check(mid.bytes - before.bytes == bytes, "live bytes counted");
+		for (void* p : blocks) {
+			Free(p);
+		}
+		SlabTagStats after = GetSlabTagStats(kTestTag);
+		Check(after.frees - before.frees == 1000, "frees counted");
+		Check(after.bytes == before.bytes, "live bytes back to zero");
+	}
+
+	void TestFailures()
+	{
+		using namespace krnl_std;
+		SlabTagStats before = GetSlabTagStats(kTestTag);
+		SetSlabFailAfter(0);
+		Check(Alloc(64, kTestTag) == nullptr, "small alloc fails");
+		Check(Alloc(1 << 16, kTestTag) == nullptr, "large alloc fails");
+		Check(Alloc(~0ULL - 4, kTestTag) == nullptr, "size overflow fails");
+		SetSlabFailAfter(-1);
+		SlabTagStats after = GetSlabTagStats(kTestTag);
+		Check(after.failures - before.failures == 3, "failures counted");
+		Check(after.allocs == before.allocs, "failed allocs not counted as allocs");
+
+		// Containers on top: a failed node allocation is a failed insert.
+		void* s = KernelSetCreate();
+		Check(KernelSetInsert(s, 1), "set insert");
+		SetSlabFailAfter(0);
+		Check(!KernelSetInsert(s, 2), "set insert fails");
+		SetSlabFailAfter(-1);
+		Check(KernelSetSize(s) == 1, "set unchanged after failure");
+		KernelSetDestroy(s);
+
+		void* m = KernelMapCreate();
+		Check(KernelMapInsert(m, 1, 10), "map insert");
+		SetSlabFailAfter(0);
+		Check(!KernelMapInsert(m, 2, 20), "map insert fails");
+		SetSlabFailAfter(-1);
+		Check(KernelMapSize(m) == 1, "map unchanged after failure");
+		KernelMapDestroy(m);
+	}
+
+	void TestCorruptHeader()
+	{
+		using namespace krnl_std;
+		unsigned char* p = (unsigned char*)Alloc(40, kLeakTag);
+		unsigned long long cached = SlabCachedBlocks();
+		((SlabHeader*)p - 1)->magic = 0;
+		Free(p);
+		Check(SlabCachedBlocks() == cached, "clobbered block kept off the free lists");
+	}
+
+	// More tags than counter slots: the extra ones share the last slot, but
+	// each large block must still be freed with its own tag.
+	void TestOverflowTags()
+	{
+		using namespace krnl_std;
+		unsigned long long before = SlabLargeTagMismatches();
+		std::vector<void*> blocks;
+		for (unsigned int i = 0; i < kSlabMaxTags + 4; i++) {
+			unsigned int tag = 0x30304f00 + i;
+			blocks.push_back(Alloc(1 << 14, tag));
+			blocks.push_back(Alloc(64, tag));
+		}
+		for (void* p : blocks) {
+			Check(p != nullptr, "overflow tag alloc");
+			Free(p);
+		}
+		Check(SlabLargeTagMismatches() == before, "large blocks freed with their own tag");
+	}
+
+	void TestContainers()
+	{
+		using namespace krnl_std;
+		SlabTagStats set_before = GetSlabTagStats(kSetTag);
+		SlabTagStats map_before = GetSlabTagStats(kMapTag);
+		std::mt19937_64 rng(20042003);
+
+		void* s = KernelSetCreate();
+		void* m = KernelMapCreate();
+		for (int i = 0; i < 100000; i++) {
+			unsigned long long key = rng() % 50000;
+			if (rng() % 3 == 0) {
+				KernelSetErase(s, key);
+				KernelMapErase(m, key);
+			}
+			else {
+				KernelSetInsert(s, key);
+				KernelMapInsert(m, key, key * 2);
+			}
+		}
+		SlabTagStats set_mid = GetSlabTagStats(kSetTag);
+		Check(set_mid.allocs - set_before.allocs >= KernelSetSize(s), "set nodes come from the slab");
+		Check(GetSlabTagStats(kMapTag).allocs - map_before.allocs >= KernelMapSize(m), "map nodes come from the slab");
+		KernelSetDestroy(s);
+		KernelMapDestroy(m);
+
+		SlabTagStats set_after = GetSlabTagStats(kSetTag);
+		SlabTagStats map_after = GetSlabTagStats(kMapTag);
+		Check(set_after.allocs - set_before.allocs == set_after.frees - set_before.frees, "set frees every node");
+		Check(map_after.allocs - map_before.allocs == map_after.frees - map_before.frees, "map frees every node");
+		Check(set_after.bytes == set_before.bytes && map_after.bytes == map_before.bytes, "no live container bytes");
+	}
+
+	// ===== Timing =====
+
+	// Node-sized blocks dominate; paths are a few hundred bytes.
+	std::vector<unsigned int> Sizes(size_t n, unsigned long long seed)
+	{
+		std::mt19937_64 rng(seed);
+		std::vector<unsigned int> sizes(n);
+		for (auto& s : sizes) {
+			unsigned int r = (unsigned int)(rng() % 100);
+			s = r < 60 ? 48 : r < 90 ? 64 + (unsigned int)(rng() % 200) : 256 + (unsigned int)(rng() % 1200);
+		}
+		return sizes;
+	}
+
+	// Keeps a window of live blocks, so the free lists see reuse at a
+	// distance rather than alloc/free of the same block.
+	template <typename AllocFn, typename FreeFn>
+	void Churn(const std::vector<unsigned int>& sizes, AllocFn alloc, FreeFn free_fn)
+	{
+		constexpr size_t kWindow = 64;
+		void* live[kWindow] = {};
+		for (size_t i = 0; i < sizes.size(); i++) {
+			void*& slot = live[i % kWindow];
+			free_fn(slot);
+			slot = alloc(sizes[i]);
+			((unsigned char*)slot)[0] = 1;
+		}
+		for (void* p : live) {
+			free_fn(p);
+		}
+	}
+
+	template <typename AllocFn, typename FreeFn>
+	double Run(size_t ops, int threads, AllocFn alloc, FreeFn free_fn)
+	{
+		std::vector<std::vector<unsigned int>> sizes;
+		for (int t = 0; t < threads; t++) {
+			sizes.push_back(Sizes(ops, 1000 + t));
+		}
+		auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; t++) {
+			workers.emplace_back([&, t] { Churn(sizes[t], alloc, free_fn); });
+		}
+		for (auto& w : workers) {
+			w.join();
+		}
+		double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		return ns / ((double)ops * threads);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t ops = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 2000000;
+	int threads = argc > 2 ? atoi(argv[2]) : 4;
+
+	TestClasses();
+	TestAccounting();
+	TestFailures();
+	TestCorruptHeader();
+	TestOverflowTags();
+	TestContainers();
+	if (failures != 0) {
+		return 1;
+	}
+	printf("# allocator checks passed\n");
+
+	auto slab_alloc = [](unsigned int n) { return krnl_std::Alloc(n, kTestTag); };
+	auto slab_free = [](void* p) { krnl_std::Free(p); };
+	auto libc_alloc = [](unsigned int n) { return malloc(n); };
+	auto libc_free = [](void* p) { free(p); };
+
+	printf("# %zu alloc+free per thread\n", ops);
+	printf("%-8s %8s %10s\n", "alloc", "threads", "ns/op");
+	printf("%-8s %8d %10.1f\n", "malloc", 1, Run(ops, 1, libc_alloc, libc_free));
+	printf("%-8s %8d %10.1f\n", "slab", 1, Run(ops, 1, slab_alloc, slab_free));
+	printf("%-8s %8d %10.1f\n", "malloc", threads, Run(ops, threads, libc_alloc, libc_free));
+	printf("%-8s %8d %10.1f\n", "slab", threads, Run(ops, threads, slab_alloc, slab_free));
+
+	krnl_std::SlabTagStats s = krnl_std::GetSlabTagStats(kTestTag);
+	if (s.bytes != 0 || s.allocs != s.frees) {
+		fprintf(stderr, "leak: %llu allocs, %llu frees, %llu bytes\n", s.allocs, s.frees, s.bytes);
+		return 1;
+	}
+	return 0;
+}
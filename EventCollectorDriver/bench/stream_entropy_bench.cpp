@@ -0,0 +1,216 @@
+/*
+Replays handle-sized IO streams through math::AddToByteStreamStats the way
+PreWriteFile / PostReadFile feed it, and compares the cleanup-time values
+with an exact 64-bit model of the same stream.
+
+Streams (each cut into IOs of mixed sizes, 512 B .. 4 MB):
+  text            plain text
+  random          uniform random bytes
+  encrypt_in_place text head, random tail (in-place encryption of a file)
+  small_random    many small random IOs plus a few large zero IOs, where the
+                  old per-call mean overstates the entropy of the content
+
+Reported per stream:
+  whole / head / tail  value at cleanup and |error| against the exact model
+  old_mean             previous HANDLE_CONTEXT value (mean of per-IO entropy)
+  ns/IO, ns/KB         cost of SampleByteHistogram + AddToByteStreamStats
+
+Usage: stream_entropy_bench
+Exits non-zero if an unsampled stream drifts more than 1e-3 bits from the
+exact model.
+*/
+#include "../std/algo/entropy_sampling.h"
+#include "../std/algo/stream_entropy.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Same defaults as function/collector.h.
+#define ENTROPY_SAMPLE_MIN_BYTES (256 * 1024)
+#define ENTROPY_SAMPLE_BLOCK_BYTES 4096
+#define ENTROPY_SAMPLE_MAX_BLOCKS 16
+
+namespace {
+	struct Io {
+		size_t offset;
+		size_t len;
+	};
+
+	struct Stream {
+		std::string name;
+		std::vector<unsigned char> data;
+		std::vector<Io> ios;
+	};
+
+	double Entropy(const unsigned long long* freq)
+	{
+		unsigned long long total = 0;
+		for (int b = 0; b < 256; b++) {
+			total += freq[b];
+		}
+		if (total == 0) {
+			return 0.0;
+		}
+		double e = 0.0;
+		for (int b = 0; b < 256; b++) {
+			if (freq[b] != 0) {
+				double p = (double)freq[b] / (double)total;
+				e -= p * std::log2(p);
+			}
+		}
+		return e;
+	}
+
+	// Exact counts with the same head / tail window rules as ByteStreamStats.
+	math::ByteStreamEntropy Exact(const Stream& s)
+	{
+		unsigned long long whole[256] = {};
+		unsigned long long head[256] = {};
+		unsigned long long head_total = 0;
+		std::deque<std::vector<unsigned long long>> windows;
+		std::deque<unsigned long long> window_totals;
+
+		for (const auto& io : s.ios) {
+			const unsigned char* buf = s.data.data() + io.offset;
+			bool fill_head = head_total < math::kStreamWindowBytes;
+			if (windows.empty() || window_totals.back() >= math::kStreamWindowBytes) {
+				windows.emplace_back(256, 0);
+				window_totals.push_back(0);
+				if (windows.size() > 2) {
+					windows.pop_front();
+					window_totals.pop_front();
+				}
+			}
+			for (size_t i = 0; i < io.len; i++) {
+				whole[buf[i]]++;
+				windows.back()[buf[i]]++;
+				if (fill_head) {
+					head[buf[i]]++;
+				}
+			}
+			window_totals.back() += io.len;
+			if (fill_head) {
+				head_total += io.len;
+			}
+		}
+
+		unsigned long long tail[256] = {};
+		for (const auto& w : windows) {
+			for (int b = 0; b < 256; b++) {
+				tail[b] += w[b];
+			}
+		}
+		return { Entropy(whole), Entropy(head), Entropy(tail) };
+	}
+
+	std::vector<Stream> MakeStreams(std::mt19937_64& rng)
+	{
+		const size_t kSize = 48 << 20;
+		const char* words = "the quick brown fox jumps over the lazy dog 0123456789\r\n";
+		size_t words_len = strlen(words);
+		const size_t kSizes[] = { 512, 4096, 16 << 10, 64 << 10, 256 << 10, 1 << 20, 4 << 20 };
+
+		std::vector<Stream> streams(4);
+		streams[0].name = "text";
+		streams[1].name = "random";
+		streams[2].name = "encrypt_in_place";
+		streams[3].name = "small_random";
+		for (int k = 0; k < 3; k++) {
+			auto& s = streams[k];
+			s.data.resize(kSize);
+			for (size_t i = 0; i < kSize; i++) {
+				unsigned char r = (unsigned char)rng();
+				unsigned char t = (unsigned char)words[rng() % words_len];
+				s.data[i] = k == 0 ? t : k == 1 ? r : (i < kSize / 2 ? t : r);
+			}
+			for (size_t off = 0; off < kSize;) {
+				size_t len = (std::min)(kSizes[rng() % 7], kSize - off);
+				s.ios.push_back({ off, len });
+				off += len;
+			}
+		}
+
+		// 4000 random 512 B IOs, then 8 x 4 MB of zeros: about 2% of the bytes
+		// are random, but 99.8% of the calls are.
+		auto& s = streams[3];
+		const size_t small = 4000 * 512;
+		s.data.resize(small + (32 << 20));
+		for (size_t i = 0; i < small; i++) {
+			s.data[i] = (unsigned char)rng();
+		}
+		for (size_t off = 0; off < small; off += 512) {
+			s.ios.push_back({ off, 512 });
+		}
+		for (size_t off = small; off < s.data.size(); off += 4 << 20) {
+			s.ios.push_back({ off, 4 << 20 });
+		}
+		return streams;
+	}
+}
+
+int main()
+{
+	math::InitEntropyTables();
+
+	math::EntropySampling cfg = { ENTROPY_SAMPLE_MIN_BYTES, ENTROPY_SAMPLE_BLOCK_BYTES, ENTROPY_SAMPLE_MAX_BLOCKS };
+	math::EntropySampling full_cfg = { ~0ULL, ENTROPY_SAMPLE_BLOCK_BYTES, ENTROPY_SAMPLE_MAX_BLOCKS };
+	std::mt19937_64 rng(20042003);
+	auto scratch = std::make_unique<math::EntropySamplingScratch32>();
+	auto stats = std::make_unique<math::ByteStreamStats>();
+	bool ok = true;
+
+	printf("# sizeof(ByteStreamStats) %zu, window %u\n", sizeof(math::ByteStreamStats), math::kStreamWindowBytes);
+	printf("%-17s %-8s %7s %7s %7s %7s %7s %7s %8s %8s %8s\n", "stream", "mode",
+		"whole", "err", "head", "err", "tail", "err", "old_mean", "ns/IO", "ns/KB");
+
+	for (const auto& s : MakeStreams(rng)) {
+		math::ByteStreamEntropy exact = Exact(s);
+
+		for (int sampled = 0; sampled < 2; sampled++) {
+			const math::EntropySampling& c = sampled ? cfg : full_cfg;
+			math::ResetByteStreamStats(*stats);
+			double old_mean = 0.0;
+			unsigned long long calls = 0;
+			unsigned long long bytes = 0;
+			double ns = 0.0;
+
+			for (const auto& io : s.ios) {
+				const unsigned char* buf = s.data.data() + io.offset;
+				unsigned long long counted = 0;
+				auto start = std::chrono::steady_clock::now();
+				const unsigned int* freq = math::SampleByteHistogram(buf, io.len, c, rng() | 1, *scratch, &counted);
+				math::AddToByteStreamStats(*stats, freq, counted, io.len);
+				ns += (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+				double e = math::ComputeByteEntropyFromFreq(freq, (long long)counted);
+				old_mean = (old_mean * calls + e) / (calls + 1);
+				calls++;
+				bytes += io.len;
+			}
+
+			math::ByteStreamEntropy got = math::ComputeByteStreamEntropy(*stats);
+			double whole_err = std::fabs(got.whole - exact.whole);
+			double head_err = std::fabs(got.head - exact.head);
+			double tail_err = std::fabs(got.tail - exact.tail);
+			printf("%-17s %-8s %7.4f %7.4f %7.4f %7.4f %7.4f %7.4f %8.4f %8.0f %8.1f\n", s.name.c_str(),
+				sampled ? "sampled" : "full", got.whole, whole_err, got.head, head_err, got.tail, tail_err,
+				old_mean, ns / calls, ns / ((double)bytes / 1024.0));
+			if (!sampled && (whole_err > 1e-3 || head_err > 1e-3 || tail_err > 1e-3)) {
+				ok = false;
+			}
+		}
+	}
+
+	if (!ok) {
+		fprintf(stderr, "unsampled stream entropy drifted from the exact model\n");
+		return 1;
+	}
+	return 0;
+}
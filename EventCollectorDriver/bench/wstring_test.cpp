@@ -0,0 +1,272 @@
+/*
+Tests and measures std::WString / std::WStringView (std/string/wstring.h),
+built from a copy of the driver sources on the user-mode slab allocator.
+
+Checks, exiting non-zero on the first failure:
+  - short strings stay inline (no kStringTag allocation), long ones do not
+  - copy, move (steals heap buffers), self-append, Reserve, Resize,
+    ShrinkToFit, and a zeroed object (as in a memset HANDLE_CONTEXT)
+  - prefix / suffix / find / compare, case-sensitive and not, against
+    WString, C-String and UNICODE_STRING arguments, none of which allocate
+  - ToWString over the integer ranges
+
+Then times the comparisons the filter runs per create (extension check,
+case-insensitive prefix, equality) the old way, through upcased copies,
+and through the views; and copying short and long paths.
+
+Usage: wstring_test [iterations]
+
+Kept free of the C++ library, like kernel_set_adapter.cpp: the driver's
+headers declare their own namespace std.
+*/
+#include "kstd/string/wstring.h"
+#include "kstd_shim/slab_user.h"
+
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+namespace {
+	constexpr unsigned int kStringTag = 0x7274534b;   // 'rtSK', as in the shim
+
+	int failures = 0;
+
+	void Check(bool ok, const char* what)
+	{
+		if (!ok) {
+			fprintf(stderr, "FAIL: %s\n", what);
+			failures++;
+		}
+	}
+
+	unsigned long long StringAllocs()
+	{
+		return krnl_std::GetSlabTagStats(kStringTag).allocs;
+	}
+
+	unsigned long long StringLive()
+	{
+		krnl_std::SlabTagStats s = krnl_std::GetSlabTagStats(kStringTag);
+		return s.allocs - s.frees;
+	}
+
+	double NowNs()
+	{
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1e9 + ts.tv_nsec;
+	}
+
+	UNICODE_STRING MakeUni(const WCHAR* s, size_t n)
+	{
+		UNICODE_STRING u;
+		u.Length = (USHORT)(n * sizeof(WCHAR));
+		u.MaximumLength = u.Length;
+		u.Buffer = (WCHAR*)s;
+		return u;
+	}
+
+	const WCHAR kLongPath[] = u"\\Device\\HarddiskVolume3\\Users\\someone\\Documents\\report.docx";
+
+	void TestStorage()
+	{
+		unsigned long long before = StringAllocs();
+		{
+			std::WString a(u"report.docx");
+			std::WString b(a);
+			std::WString c = std::ToWString(-1234567890ll);
+			b += u".bak";
+			Check(a.Capacity() == std::WString::kInlineCapacity, "short string inline");
+			Check(b == u"report.docx.bak", "inline append");
+			Check(c == u"-1234567890", "ToWString inline");
+		}
+		Check(StringAllocs() == before, "short strings do not allocate");
+
+		std::WString p(kLongPath);
+		Check(StringAllocs() == before + 1, "long string allocates once");
+		const WCHAR* buf = p.Data();
+		std::WString q(Move(p));
+		Check(q.Data() == buf && StringAllocs() == before + 1, "move steals heap buffer");
+		Check(p.Empty() && p.Data() != nullptr && p.Data()[0] == 0, "moved-from is empty");
+		std::WString r;
+		r = Move(q);
+		Check(r.Data() == buf && q.Empty(), "move assignment steals heap buffer");
+		std::WString other(kLongPath);
+		Check(r == kLongPath && other.Data() != buf && StringLive() == 2, "moved buffer stays owned");
+
+		std::WString s(u"abc");
+		std::WString t(Move(s));
+		Check(t == u"abc" && s.Empty(), "move of inline copies");
+
+		std::WString self(u"0123456789");
+		self.Append(self);
+		self.Append(self.View().Substr(5, 3));
+		Check(self == u"01234567890123456789567", "self append");
+
+		std::WString res;
+		res.Reserve(100);
+		Check(res.Size() == 0 && res.Capacity() >= 100, "Reserve keeps size");
+		res.Append(u"x");
+		Check(res == u"x", "append after Reserve");
+		res.Resize(3, u'y');
+		Check(res == u"xyy" && res.Data()[3] == 0, "Resize pads and terminates");
+		res.ShrinkToFit();
+		Check(res.Capacity() == std::WString::kInlineCapacity && res == u"xyy", "ShrinkToFit back inline");
+
+		for (int i = 0; i < 40; i++) {
+			res.PushBack(u'z');
+		}
+		Check(res.Size() == 43 && res.Back() == u'z', "PushBack grows");
+		res.PopBack();
+		Check(res.Size() == 42, "PopBack");
+
+		alignas(std::WString) unsigned char raw[sizeof(std::WString)];
+		memset(raw, 0, sizeof(raw));
+		std::WString& zeroed = *(std::WString*)raw;
+		Check(zeroed.Empty() && zeroed == u"", "zeroed object reads as empty");
+		UNICODE_STRING zu = zeroed.UniStr();
+		Check(zu.Buffer == nullptr && zu.Length == 0, "zeroed UniStr");
+		zeroed = u"short";
+		Check(zeroed == u"short", "assign into zeroed object");
+		zeroed.~WString();
+	}
+
+	void TestCompare()
+	{
+		std::WString path(kLongPath);
+		UNICODE_STRING uni = MakeUni(kLongPath, sizeof(kLongPath) / sizeof(WCHAR) - 1);
+		unsigned long long before = StringAllocs();
+
+		Check(path == uni && path.EqualCi(uni), "equal to UNICODE_STRING");
+		Check(path.HasCiPrefix(u"\\DEVICE\\harddiskvolume3"), "ci prefix");
+		Check(!path.HasPrefix(u"\\DEVICE"), "prefix is case sensitive");
+		Check(path.HasCiSuffix(u".DOCX") && path.HasSuffix(u".docx"), "suffix");
+		Check(!path.HasSuffix(u"x.docx.docx.docx.docx.docx.docx.docx.docx.docx.docx.docx"), "suffix longer than string");
+		Check(std::WString(u"\\device").IsCiPrefixOf(uni), "IsCiPrefixOf");
+		Check(std::WString(u"report.docx").IsSuffixOf(path), "IsSuffixOf");
+		Check(path.FindFirstOf(u"Users") == 24, "FindFirstOf");
+		Check(path.FindFirstOf(u"\\", 1) == 7, "FindFirstOf from position");
+		Check(path.FindFirstOf(u"nope") == std::WString::kNPos, "FindFirstOf miss");
+		Check(path.Contain(u"someone") && !path.Contain(u""), "Contain");
+		Check(std::WString(u"abc") < u"abd" && std::WString(u"ab") < u"abc" && std::WString(u"b") > u"abc", "ordering");
+		Check(std::WStringView(u"ABC").CompareCi(u"abd") < 0 && std::WStringView(u"abc").CompareCi(u"ABC") == 0, "CompareCi");
+		Check(std::WStringView(u"ÉTÉ").EqualCi(u"été"), "non-ASCII case folding");
+		Check(std::WStringView(u"a\0b", 3) != std::WStringView(u"a\0c", 3), "compare past embedded null");
+		Check(std::WStringView(nullptr).Empty() && std::WStringView() == u"", "null view is empty");
+		Check(StringAllocs() == before, "comparisons do not allocate");
+	}
+
+	void TestToWString()
+	{
+		Check(std::ToWString(0) == u"0", "ToWString 0");
+		Check(std::ToWString((short)-32768) == u"-32768", "ToWString short min");
+		Check(std::ToWString(4294967295u) == u"4294967295", "ToWString uint max");
+		Check(std::ToWString(-9223372036854775807ll - 1) == u"-9223372036854775808", "ToWString ll min");
+		Check(std::ToWString(18446744073709551615ull) == u"18446744073709551615", "ToWString ull max");
+	}
+
+	// What the old EqualCi / HasCiPrefix did: upcased copies of both sides.
+	bool OldEqualCi(const std::WString& a, const std::WString& b)
+	{
+		return a.GetUpcase() == b.GetUpcase();
+	}
+
+	bool OldHasCiPrefix(const std::WString& s, const std::WString& prefix)
+	{
+		if (s.Size() < prefix.Size()) {
+			return false;
+		}
+		std::WString head(s.View().Substr(0, prefix.Size()));
+		return head.GetUpcase() == prefix.GetUpcase();
+	}
+
+	template <typename Fn>
+	void Time(const char* name, unsigned long long iters, Fn&& fn)
+	{
+		unsigned long long allocs = StringAllocs();
+		volatile unsigned long long sink = 0;
+		double t0 = NowNs();
+		for (unsigned long long i = 0; i < iters; i++) {
+			sink = sink + fn(i);
+		}
+		double t1 = NowNs();
+		printf("  %-34s %8.1f ns/op %6.2f allocs/op\n", name, (t1 - t0) / iters,
+			(double)(StringAllocs() - allocs) / iters);
+	}
+
+	void Bench(unsigned long long iters)
+	{
+		const WCHAR* names[] = {
+			kLongPath,
+			u"\\Device\\HarddiskVolume3\\Windows\\System32\\ntdll.dll",
+			u"\\Device\\HarddiskVolume3\\Users\\someone\\AppData\\Local\\Temp\\~tmp12.TMP",
+			u"\\Device\\HarddiskVolume3\\ProgramData\\app\\cache\\0001.bin",
+		};
+		std::WString paths[4];
+		for (int i = 0; i < 4; i++) {
+			paths[i] = names[i];
+		}
+		std::WString ext(u".DOCX");
+		std::WString prefix(u"\\device\\harddiskvolume3\\users\\");
+		std::WString other(paths[0].GetDowncase());
+
+		printf("wstring (%llu iterations)\n", iters);
+		Time("EqualCi, upcased copies", iters, [&](unsigned long long i) {
+			return (unsigned long long)OldEqualCi(paths[i & 3], other);
+		});
+		Time("EqualCi, view", iters, [&](unsigned long long i) {
+			return (unsigned long long)paths[i & 3].EqualCi(other);
+		});
+		Time("HasCiPrefix, upcased copies", iters, [&](unsigned long long i) {
+			return (unsigned long long)OldHasCiPrefix(paths[i & 3], prefix);
+		});
+		Time("HasCiPrefix, view", iters, [&](unsigned long long i) {
+			return (unsigned long long)paths[i & 3].HasCiPrefix(prefix);
+		});
+		Time("extension, upcased copies", iters, [&](unsigned long long i) {
+			const std::WString& p = paths[i & 3];
+			std::WString tail(p.View().Substr(p.Size() - 5));
+			return (unsigned long long)(tail.GetUpcase() == ext);
+		});
+		Time("extension, view", iters, [&](unsigned long long i) {
+			return (unsigned long long)paths[i & 3].HasCiSuffix(ext);
+		});
+		Time("copy short name", iters, [&](unsigned long long i) {
+			std::WString s(u"ntdll.dll");
+			return (unsigned long long)s.Size();
+		});
+		Time("copy path", iters, [&](unsigned long long i) {
+			std::WString s(paths[i & 3]);
+			return (unsigned long long)s.Size();
+		});
+		Time("copy path, then move twice", iters, [&](unsigned long long i) {
+			std::WString s(paths[i & 3]);
+			std::WString t(Move(s));
+			std::WString u;
+			u = Move(t);
+			return (unsigned long long)u.Size();
+		});
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned long long iters = argc > 1 ? strtoull(argv[1], nullptr, 10) : 2000000;
+	// RtlUpcaseUnicodeChar is towupper here, which needs a Unicode locale.
+	setlocale(LC_CTYPE, "C.UTF-8");
+
+	TestStorage();
+	TestCompare();
+	TestToWString();
+	Check(StringLive() == 0, "every string block freed");
+	if (failures != 0) {
+		fprintf(stderr, "%d check(s) failed\n", failures);
+		return 1;
+	}
+	printf("wstring checks passed\n");
+
+	Bench(iters);
+	Check(StringLive() == 0, "every string block freed after bench");
+	return failures != 0;
+}
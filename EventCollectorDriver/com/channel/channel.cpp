@@ -0,0 +1,216 @@
+#include "channel.h"
+#include "../../template/debug.h"
+
+namespace com
+{
+	NTSTATUS EventChannel::Create()
+	{
+		ULONG header_bytes = PAGE_SIZE;
+		ring_size_ = header_bytes + CHANNEL_RING_BYTES;
+		ring_ = (shm::SharedRingHeader*)ExAllocatePool2(POOL_FLAG_NON_PAGED, ring_size_, CHANNEL_TAG);
+		if (ring_ == nullptr) {
+			return STATUS_INSUFFICIENT_RESOURCES;
+		}
+
+		mdl_ = IoAllocateMdl(ring_, ring_size_, FALSE, FALSE, nullptr);
+		if (mdl_ == nullptr) {
+			ExFreePoolWithTag(ring_, CHANNEL_TAG);
+			ring_ = nullptr;
+			return STATUS_INSUFFICIENT_RESOURCES;
+		}
+		MmBuildMdlForNonPagedPool(mdl_);
+
+		KeInitializeSpinLock(&lock_);
+		KeInitializeTimer(&flush_timer_);
+		KeInitializeDpc(&flush_dpc_, FlushDpc, nullptr);
+		shm::InitSharedRing(*ring_, header_bytes, CHANNEL_RING_BYTES);
+		DebugMessage("EventChannel created, %d bytes", ring_size_);
+		return STATUS_SUCCESS;
+	}
+
+	void EventChannel::Close()
+	{
+		// FltUnregisterFilter has closed the client port, which detaches, but
+		// the pool must never go while a service still has a view of it.
+		Detach();
+		if (ring_ != nullptr) {
+			KeCancelTimer(&flush_timer_);
+			KeFlushQueuedDpcs();
+		}
+		if (mdl_ != nullptr) {
+			IoFreeMdl(mdl_);
+			mdl_ = nullptr;
+		}
+		if (ring_ != nullptr) {
+			ExFreePoolWithTag(ring_, CHANNEL_TAG);
+			ring_ = nullptr;
+		}
+	}
+
+	NTSTATUS EventChannel::Attach(HANDLE event, shm::ChannelAttachReply* reply)
+	{
+		PAGED_CODE();
+
+		if (ring_ == nullptr) {
+			return STATUS_DEVICE_NOT_READY;
+		}
+
+		KIRQL irql;
+		KeAcquireSpinLock(&lock_, &irql);
+		if (attaching_ || user_base_ != nullptr) {
+			KeReleaseSpinLock(&lock_, irql);
+			return STATUS_ALREADY_REGISTERED;
+		}
+		attaching_ = true;
+		KeReleaseSpinLock(&lock_, irql);
+
+		PKEVENT kevent = nullptr;
+		NTSTATUS status = ObReferenceObjectByHandle(event, EVENT_MODIFY_STATE, *ExEventObjectType, UserMode, (PVOID*)&kevent, nullptr);
+		if (!NT_SUCCESS(status)) {
+			KeAcquireSpinLock(&lock_, &irql);
+			attaching_ = false;
+			KeReleaseSpinLock(&lock_, irql);
+			return status;
+		}
+
+		PVOID base = nullptr;
+		__try {
+			base = MmMapLockedPagesSpecifyCache(mdl_, UserMode, MmCached, nullptr, FALSE, NormalPagePriority | MdlMappingNoExecute);
+		}
+		__except (EXCEPTION_EXECUTE_HANDLER) {
+			base = nullptr;
+		}
+		if (base == nullptr) {
+			ObDereferenceObject(kevent);
+			KeAcquireSpinLock(&lock_, &irql);
+			attaching_ = false;
+			KeReleaseSpinLock(&lock_, irql);
+			return STATUS_INSUFFICIENT_RESOURCES;
+		}
+
+		// Start over: whatever the previous consumer left is stale.
+		KeAcquireSpinLock(&lock_, &irql);
+		shm::InitSharedRing(*ring_, ring_->header_bytes, CHANNEL_RING_BYTES);
+		shm::InitSharedRingWriter(writer_, ring_);
+		shm::InitFlushPolicy(flush_, CHANNEL_MIN_BATCH, CHANNEL_MAX_BATCH, CHANNEL_FLUSH_DEADLINE);
+		event_ = kevent;
+		// Held until Detach, which may have to unmap from another process.
+		process_ = PsGetCurrentProcess();
+		ObReferenceObject(process_);
+		user_base_ = base;
+		attached_ = true;
+		attaching_ = false;
+		KeReleaseSpinLock(&lock_, irql);
+
+		reply->base = (unsigned long long)base;
+		reply->size = ring_size_;
+		DebugMessage("EventChannel attached, pid %d, base %p", (ULONG)(ULONG_PTR)PsGetCurrentProcessId(), base);
+		return STATUS_SUCCESS;
+	}
+
+	void EventChannel::Detach()
+	{
+		PAGED_CODE();
+
+		KIRQL irql;
+		KeAcquireSpinLock(&lock_, &irql);
+		bool attached = attached_;
+		PKEVENT kevent = event_;
+		PEPROCESS process = process_;
+		PVOID base = user_base_;
+		attached_ = false;
+		event_ = nullptr;
+		process_ = nullptr;
+		user_base_ = nullptr;
+		KeReleaseSpinLock(&lock_, irql);
+
+		if (!attached) {
+			return;
+		}
+		// The DPC checks attached_, but must not still be running when the
+		// event goes away.
+		KeCancelTimer(&flush_timer_);
+		KeFlushQueuedDpcs();
+		// User mappings must be torn down in the owning process. Port
+		// callbacks usually run there, but on unload FltUnregisterFilter
+		// disconnects from the unloading thread's process.
+		if (process == PsGetCurrentProcess()) {
+			MmUnmapLockedPages(base, mdl_);
+		}
+		else {
+			KAPC_STATE apc_state;
+			KeStackAttachProcess(process, &apc_state);
+			MmUnmapLockedPages(base, mdl_);
+			KeUnstackDetachProcess(&apc_state);
+		}
+		ObDereferenceObject(process);
+		ObDereferenceObject(kevent);
+		DebugMessage("EventChannel detached, %llu events, %llu dropped", ring_->produced, ring_->dropped);
+	}
+
+	bool EventChannel::WritePathEvent(ULONG pid, const WCHAR* path, ULONG chars, bool urgent)
+	{
+		if (ring_ == nullptr || attached_ == false) {
+			return false;
+		}
+
+		ULONG bytes = sizeof(shm::PathEventRecord) + chars * sizeof(WCHAR);
+		KIRQL irql;
+		KeAcquireSpinLock(&lock_, &irql);
+		if (attached_ == false) {
+			KeReleaseSpinLock(&lock_, irql);
+			return false;
+		}
+
+		unsigned int size = 0;
+		shm::PathEventRecord* rec = (shm::PathEventRecord*)shm::ReserveSharedRecord(writer_, bytes, &size);
+		if (rec != nullptr) {
+			rec->record.size = size;
+			rec->record.type = shm::kChannelPathEvent;
+			rec->record.reserved = 0;
+			rec->pid = pid;
+			rec->chars = chars;
+			RtlCopyMemory(rec + 1, path, chars * sizeof(WCHAR));
+			if (shm::PublishSharedRecord(writer_, size) == false) {
+				// The service is draining and will pick this up.
+				shm::ClearFlushPolicy(flush_);
+			}
+			else {
+				shm::FlushReason reason = shm::AddFlushRecord(flush_, KeQueryInterruptTime(), urgent);
+				if (reason != shm::kFlushNone) {
+					Wake(reason);
+				}
+				else if (flush_.pending == 1) {
+					LARGE_INTEGER due;
+					due.QuadPart = -(LONGLONG)CHANNEL_FLUSH_DEADLINE;
+					KeSetTimer(&flush_timer_, due, &flush_dpc_);
+				}
+			}
+		}
+		KeReleaseSpinLock(&lock_, irql);
+		return rec != nullptr;
+	}
+
+	// Called with lock_ held.
+	void EventChannel::Wake(shm::FlushReason reason)
+	{
+		KeSetEvent(event_, IO_NO_INCREMENT, FALSE);
+		shm::OnFlush(flush_, KeQueryInterruptTime(), reason);
+	}
+
+	void EventChannel::FlushDpc(PKDPC dpc, PVOID context, PVOID arg1, PVOID arg2)
+	{
+		UNREFERENCED_PARAMETER(dpc);
+		UNREFERENCED_PARAMETER(context);
+		UNREFERENCED_PARAMETER(arg1);
+		UNREFERENCED_PARAMETER(arg2);
+
+		KeAcquireSpinLockAtDpcLevel(&lock_);
+		// Anything that woke the service since the timer was armed has
+		// already cleared the batch.
+		if (attached_ == true && flush_.pending != 0) {
+			Wake(shm::kFlushDeadline);
+		}
+		KeReleaseSpinLockFromDpcLevel(&lock_);
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <fltKernel.h>
+
+#include "../shared_ring.h"
+#include "../flush_policy.h"
+
+// Driver side of the shared-memory channel to the service (see
+// com/shared_ring.h). The ring lives in non-paged pool for the life of the
+// driver; Attach maps it into the calling process, Detach unmaps it.
+
+#define CHANNEL_RING_BYTES (1024 * 1024)
+#define CHANNEL_TAG 'hCfR'
+
+// Wake-up batching, see com/flush_policy.h. Deadline in 100ns units.
+#define CHANNEL_MIN_BATCH 1
+#define CHANNEL_MAX_BATCH 256
+#define CHANNEL_FLUSH_DEADLINE (2 * 10000)
+
+namespace com
+{
+	class EventChannel
+	{
+	private:
+		inline static shm::SharedRingHeader* ring_ = nullptr;
+		inline static ULONG ring_size_ = 0;
+		inline static PMDL mdl_ = nullptr;
+
+		// Owned by the attached service; guarded by lock_. process_ is
+		// referenced while attached.
+		inline static KSPIN_LOCK lock_ = 0;
+		inline static bool attached_ = false;
+		// Claimed by Attach before it maps the ring, so concurrent attach
+		// messages cannot both map it.
+		inline static bool attaching_ = false;
+		inline static shm::SharedRingWriter writer_ = {};
+		inline static PKEVENT event_ = nullptr;
+		inline static PEPROCESS process_ = nullptr;
+		inline static PVOID user_base_ = nullptr;
+		inline static shm::FlushPolicy flush_ = {};
+		inline static KTIMER flush_timer_ = {};
+		inline static KDPC flush_dpc_ = {};
+
+		static KDEFERRED_ROUTINE FlushDpc;
+		static void Wake(shm::FlushReason reason);
+
+	public:
+		static NTSTATUS Create();
+		static void Close();
+
+		// Attach runs in the context of the service process (comport
+		// messages). Detach may run from any process at PASSIVE_LEVEL: it
+		// attaches to the service's to unmap the ring.
+		static NTSTATUS Attach(HANDLE event, shm::ChannelAttachReply* reply);
+		static void Detach();
+
+		// Any IRQL <= DISPATCH_LEVEL. false when nobody is attached or the
+		// ring is full. Urgent events wake the service without batching.
+		static bool WritePathEvent(ULONG pid, const WCHAR* path, ULONG chars, bool urgent = false);
+	};
+}
@@ -1,4 +1,7 @@
 #include "comport.h"
+#include "../channel/channel.h"
+#include "../../function/filter_rules.h"
+#include "../../std/memory/memory.h"
 #include "../../template/debug.h"
 
 namespace com
@@ -99,6 +102,10 @@ namespace com
 	{
 		UNREFERENCED_PARAMETER(connection_cookie);
 
+		// Usually the service's context, but on unload the unloading thread's;
+		// Detach handles both.
+		EventChannel::Detach();
+
 		FltCloseClientPort(p_filter_handle_, &client_port_);
 
 		// DebugMessage("Disonnected");
@@ -109,30 +116,25 @@ namespace com
 	}
 
 	// The Filter Manager calls this routine, at IRQL = PASSIVE_LEVEL, whenever a user-mode application calls FilterSendMessage to send a message to the minifilter driver through the client port. 
+	// The messages are the EventChannel attach/detach requests and the filter rules (com/shared_ring.h).
 	NTSTATUS ComPort::SendRecvHandler(PVOID port_cookie, PVOID input_buffer, ULONG input_buffer_length, PVOID output_buffer, ULONG output_buffer_length, PULONG return_output_buffer_length)
 	{
 		UNREFERENCED_PARAMETER(port_cookie);
-		UNREFERENCED_PARAMETER(input_buffer);
-		UNREFERENCED_PARAMETER(input_buffer_length);
-		UNREFERENCED_PARAMETER(output_buffer);
-		UNREFERENCED_PARAMETER(output_buffer_length);
-		UNREFERENCED_PARAMETER(return_output_buffer_length);
-
-		NTSTATUS status = STATUS_SUCCESS;
 
 		PAGED_CODE();
 
-		DebugMessage("output_buffer_length %d", output_buffer_length);
+		*return_output_buffer_length = 0;
 
-		if (!IS_ALIGNED(output_buffer, sizeof(char)))
+		shm::ChannelControl control;
+		if (input_buffer == nullptr || input_buffer_length < sizeof(control))
 		{
-			status = STATUS_DATATYPE_MISALIGNMENT;
-			return status;
+			return STATUS_INVALID_PARAMETER;
 		}
 
 		__try {
 
-			ProbeForWrite(output_buffer, output_buffer_length, TYPE_ALIGNMENT(char));
+			ProbeForRead(input_buffer, sizeof(control), TYPE_ALIGNMENT(char));
+			RtlCopyMemory(&control, input_buffer, sizeof(control));
 
 		}
 		__except (EXCEPTION_EXECUTE_HANDLER) {
@@ -140,23 +142,93 @@ namespace com
 			return GetExceptionCode();
 		}
 
-		PCHAR msg = (char*)"";
+		if (control.version != shm::kChannelVersion)
+		{
+			DebugMessage("Channel version %d, expected %d", control.version, shm::kChannelVersion);
+			return STATUS_REVISION_MISMATCH;
+		}
 
-		RtlCopyMemory(&output_buffer, msg, sizeof(msg));
+		if (control.command == shm::kChannelDetach)
+		{
+			EventChannel::Detach();
+			return STATUS_SUCCESS;
+		}
+		if (control.command == shm::kChannelSetRules)
+		{
+			return SetFilterRules(input_buffer, input_buffer_length);
+		}
+		if (control.command != shm::kChannelAttach)
+		{
+			return STATUS_INVALID_PARAMETER;
+		}
+
+		if (output_buffer == nullptr || output_buffer_length < sizeof(shm::ChannelAttachReply))
+		{
+			return STATUS_BUFFER_TOO_SMALL;
+		}
+
+		shm::ChannelAttachReply reply = { 0 };
+		reply.status = EventChannel::Attach((HANDLE)(ULONG_PTR)control.event, &reply);
 
 		__try {
 
-			ProbeForRead(input_buffer, input_buffer_length, TYPE_ALIGNMENT(char));
+			ProbeForWrite(output_buffer, sizeof(reply), TYPE_ALIGNMENT(char));
+			RtlCopyMemory(output_buffer, &reply, sizeof(reply));
 
 		}
 		__except (EXCEPTION_EXECUTE_HANDLER) {
 
+			if (NT_SUCCESS(reply.status))
+			{
+				EventChannel::Detach();
+			}
 			return GetExceptionCode();
 		}
 
+		*return_output_buffer_length = sizeof(reply);
 		return STATUS_SUCCESS;
 	}
 
+	// Copies the rules out of the caller's buffer before anything parses them.
+	NTSTATUS ComPort::SetFilterRules(PVOID input_buffer, ULONG input_buffer_length)
+	{
+		ULONG bytes = input_buffer_length - sizeof(shm::ChannelControl);
+		if (bytes > shm::kFilterRulesMaxBytes)
+		{
+			return STATUS_INVALID_BUFFER_SIZE;
+		}
+		if (bytes == 0)
+		{
+			return collector::SetFilterRules(nullptr, 0);
+		}
+
+		void* rules = krnl_std::Alloc(bytes);
+		if (rules == nullptr)
+		{
+			return STATUS_INSUFFICIENT_RESOURCES;
+		}
+
+		// No defer: __try does not mix with objects that need unwinding.
+		NTSTATUS status = STATUS_SUCCESS;
+		__try {
+
+			ProbeForRead(input_buffer, input_buffer_length, TYPE_ALIGNMENT(char));
+			RtlCopyMemory(rules, (const unsigned char*)input_buffer + sizeof(shm::ChannelControl), bytes);
+
+		}
+		__except (EXCEPTION_EXECUTE_HANDLER) {
+
+			status = GetExceptionCode();
+		}
+
+		if (NT_SUCCESS(status))
+		{
+			status = collector::SetFilterRules(rules, bytes);
+		}
+		krnl_std::Free(rules);
+		return status;
+	}
+
 	void ComPort::SetPfltFilter(PFLT_FILTER p_filter_handle)
 	{
 		p_filter_handle_ = p_filter_handle;
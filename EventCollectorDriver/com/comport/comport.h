@@ -43,6 +43,8 @@ namespace com
 			PULONG return_output_buffer_length
 		);
 
+		static NTSTATUS SetFilterRules(PVOID input_buffer, ULONG input_buffer_length);
+
 		static void SetPfltFilter(PFLT_FILTER p_filter_handle);
 		static PFLT_FILTER GetPfltFilter();
 
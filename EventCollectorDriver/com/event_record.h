@@ -0,0 +1,116 @@
+#ifndef EVENT_RECORD_H
+#define EVENT_RECORD_H
+
+// Binary layout of the collector log (LOG_PATH). Every record starts with
+// EventRecordHeader; the file is a plain concatenation of records, written
+// through the log rings (template/debug.cpp). Shared with the user-mode
+// decoder in tools/evtlog, so only fixed-width fields and no kernel headers.
+// All fields are little-endian.
+//
+// The text form the decoder produces is the one the driver used to write:
+//   P,<pid>,<process path>
+//   F,<path hash>,<path>
+//   O,<pid>,<path hash>,<file size>,... (see FormatHandleSummary in tools/evtlog)
+
+namespace evt
+{
+    constexpr unsigned short kEventMagic = 0xEC5A;   // not a plausible UTF-16 log character
+    constexpr unsigned char kEventVersion = 1;
+
+    enum EventRecordType : unsigned char
+    {
+        kText = 1,              // UTF-16 text, as passed to PushToLogQueue
+        kProcessPath = 2,       // EventPathRecord, key = pid
+        kFilePath = 3,          // EventPathRecord, key = HashWstring(path)
+        kHandleSummary = 4,     // EventHandleSummary
+    };
+
+    struct EventRecordHeader
+    {
+        unsigned short magic;
+        unsigned char type;
+        unsigned char version;
+        unsigned int size;      // whole record, header included
+    };
+
+    // Interned path, written once per key; handle summaries only carry the key.
+    struct EventPathRecord
+    {
+        EventRecordHeader header;
+        unsigned long long key;
+        unsigned int chars;     // UTF-16 code units following the struct, no terminator
+        unsigned int reserved;
+    };
+
+    enum EventHandleFlags : unsigned int
+    {
+        kFlagRead = 1u << 0,
+        kFlagModified = 1u << 1,
+        kFlagRenamed = 1u << 2,
+        kFlagCreated = 1u << 3,
+        kFlagDeleted = 1u << 4,
+        kFlagAlloc = 1u << 5,
+        kFlagEof = 1u << 6,
+        kFlagFvdli = 1u << 7,
+        kFlagFsOw = 1u << 8,
+        kFlagFsWre = 1u << 9,
+        kFlagFsSzd = 1u << 10,
+        kFlagMmapOpen = 1u << 11,
+        kFlagMmapModified = 1u << 12,
+    };
+
+    // Entropy fields are bits per byte * kEntropyScale, truncated, as in the
+    // text log.
+    constexpr unsigned int kEntropyScale = 10000;
+
+    enum EventEntropyIndex
+    {
+        kEntropyWhole = 0,
+        kEntropyHead = 1,
+        kEntropyTail = 2,
+        kEntropyCount = 3,
+    };
+
+    // One per closed handle (collector::LogFileEvent).
+    struct EventHandleSummary
+    {
+        EventRecordHeader header;
+        unsigned int pid;
+        unsigned int flags;                 // EventHandleFlags
+        unsigned long long path_hash;
+        unsigned long long new_path_hash;
+        long long file_size;
+
+        long long first_read_timestamp;
+        long long last_read_timestamp;
+        long long read_cnt_bytes;
+        long long read_cnt_times;
+
+        long long first_write_timestamp;
+        long long last_write_timestamp;
+        long long write_cnt_bytes;
+        long long write_cnt_times;
+
+        unsigned int read_entropy[kEntropyCount];
+        unsigned int write_entropy[kEntropyCount];
+    };
+
+    static_assert(sizeof(EventRecordHeader) == 8, "EventRecordHeader layout");
+    static_assert(sizeof(EventPathRecord) == 24, "EventPathRecord layout");
+    static_assert(sizeof(EventHandleSummary) == 128, "EventHandleSummary layout");
+
+    inline void InitEventHeader(EventRecordHeader& h, EventRecordType type, unsigned int size)
+    {
+        h.magic = kEventMagic;
+        h.type = type;
+        h.version = kEventVersion;
+        h.size = size;
+    }
+
+    inline unsigned int EntropyToFixed(double e)
+    {
+        return e <= 0.0 ? 0 : (unsigned int)(e * kEntropyScale);
+    }
+}
+
+#endif
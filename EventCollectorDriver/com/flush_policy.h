@@ -0,0 +1,93 @@
+#ifndef FLUSH_POLICY_H
+#define FLUSH_POLICY_H
+
+// When to wake the channel consumer (com/shared_ring.h). Records are visible
+// in the ring as soon as they are published; this only decides when the
+// sleeping service is told about them, so a burst of file events costs one
+// wake-up instead of one per event. A batch is flushed when it reaches the
+// current target, when its oldest record is `deadline` old (the caller arms
+// a timer for that), or at once for urgent records.
+//
+// The target adapts: a batch that filled within a quarter deadline of the
+// previous flush doubles it, a batch that had to wait for the deadline
+// halves it. At low rates every record goes out on its own; under load the
+// batches grow up to max_batch. Times are in any monotonic unit (100ns in
+// the driver).
+//
+// Header-only, no kernel dependencies; bench/flush_policy_sim.cpp replays
+// synthetic loads through it.
+
+namespace shm
+{
+    enum FlushReason : unsigned int
+    {
+        kFlushNone = 0,
+        kFlushSize,         // target reached
+        kFlushDeadline,     // oldest record waited `deadline`
+        kFlushUrgent,       // e.g. a rename that changes the extension
+    };
+
+    struct FlushPolicy
+    {
+        unsigned int min_batch;
+        unsigned int max_batch;
+        unsigned long long deadline;
+
+        unsigned int target;
+        unsigned int pending;                   // records since the last flush
+        unsigned long long first_pending;       // time of the oldest of them
+        unsigned long long last_flush;
+    };
+
+    inline void InitFlushPolicy(FlushPolicy& p, unsigned int min_batch, unsigned int max_batch, unsigned long long deadline)
+    {
+        p.min_batch = min_batch;
+        p.max_batch = max_batch;
+        p.deadline = deadline;
+        p.target = min_batch;
+        p.pending = 0;
+        p.first_pending = 0;
+        p.last_flush = 0;
+    }
+
+    // The consumer is awake and will see everything published so far.
+    inline void ClearFlushPolicy(FlushPolicy& p)
+    {
+        p.pending = 0;
+    }
+
+    // Called after a record was published while the consumer sleeps. Returns
+    // the reason to wake it now, or kFlushNone; in that case, if this was the
+    // first pending record, the caller arms its timer for `deadline`.
+    inline FlushReason AddFlushRecord(FlushPolicy& p, unsigned long long now, bool urgent)
+    {
+        if (p.pending++ == 0) {
+            p.first_pending = now;
+        }
+        if (urgent) {
+            return kFlushUrgent;
+        }
+        if (p.pending >= p.target) {
+            return kFlushSize;
+        }
+        if (now - p.first_pending >= p.deadline) {
+            return kFlushDeadline;
+        }
+        return kFlushNone;
+    }
+
+    // Records the flush the caller just made (it woke the consumer).
+    inline void OnFlush(FlushPolicy& p, unsigned long long now, FlushReason reason)
+    {
+        if (reason == kFlushSize && now - p.last_flush < p.deadline / 4) {
+            p.target = p.target * 2 > p.max_batch ? p.max_batch : p.target * 2;
+        }
+        else if (reason == kFlushDeadline) {
+            p.target = p.target / 2 < p.min_batch ? p.min_batch : p.target / 2;
+        }
+        p.pending = 0;
+        p.last_flush = now;
+    }
+}
+
+#endif
@@ -0,0 +1,276 @@
+#ifndef SHARED_RING_H
+#define SHARED_RING_H
+
+// Single-producer / single-consumer ring shared between the driver and the
+// service. The driver allocates it from non-paged pool and maps it into the
+// service on kChannelAttach (com/channel); the comport only carries these
+// control messages. Header-only with no kernel dependencies, so the service
+// and the user-mode harness (bench/shared_ring_test.cpp) use the same code.
+//
+// Memory layout: SharedRingHeader, padded to header_bytes, then `capacity`
+// bytes of records. head/tail are absolute byte positions.
+//
+// The consumer is a user process, so the producer never trusts anything it
+// reads back from the shared page: it only ever reads `tail` and
+// `consumer_waiting`, keeps its own copy of `head`, and a bogus tail makes
+// the ring look full rather than letting a write leave the data area.
+
+#include "../std/sync/ring_atomic.h"
+
+namespace shm
+{
+    constexpr unsigned int kChannelMagic = 0x43444652;    // "RFDC"
+    constexpr unsigned int kChannelVersion = 1;
+    constexpr unsigned int kChannelRecordAlign = 8;
+
+    struct SharedRingHeader
+    {
+        unsigned int magic;
+        unsigned int version;
+        unsigned int header_bytes;      // offset of the data area
+        unsigned int capacity;          // data bytes, power of two
+        alignas(64) volatile unsigned long long head;       // producer
+        volatile unsigned long long produced;               // producer
+        volatile unsigned long long dropped;                // producer
+        alignas(64) volatile unsigned long long tail;       // consumer
+        volatile unsigned long long consumer_waiting;       // consumer
+    };
+
+    enum ChannelRecordType : unsigned short
+    {
+        kChannelPad = 0,
+        kChannelPathEvent = 1,
+    };
+
+    struct ChannelRecord
+    {
+        unsigned int size;              // whole record, multiple of kChannelRecordAlign
+        unsigned short type;            // ChannelRecordType
+        unsigned short reserved;
+    };
+
+    // A file the service should look at (was one FltSendMessage per file).
+    struct PathEventRecord
+    {
+        ChannelRecord record;
+        unsigned int pid;
+        unsigned int chars;             // UTF-16 code units following, no terminator
+    };
+
+    static_assert(sizeof(ChannelRecord) == 8, "ChannelRecord layout");
+    static_assert(sizeof(PathEventRecord) == 16, "PathEventRecord layout");
+
+    // ===== Control messages (comport) =====
+
+    enum ChannelCommand : unsigned int
+    {
+        kChannelAttach = 1,             // map the ring into the caller, signal `event`
+        kChannelDetach = 2,
+        kChannelSetRules = 3,           // replace the exclusion rules, FilterRules follow
+    };
+
+    struct ChannelControl
+    {
+        unsigned int command;           // ChannelCommand
+        unsigned int version;           // kChannelVersion
+        unsigned long long event;       // HANDLE of an auto-reset event (attach)
+    };
+
+    struct ChannelAttachReply
+    {
+        unsigned long long base;        // user address of the SharedRingHeader
+        unsigned long long size;        // bytes mapped
+        int status;                     // NTSTATUS
+        unsigned int reserved;
+    };
+
+    // kChannelSetRules: the ChannelControl is followed by FilterRule
+    // entries up to the end of the message, each padded to kFilterRuleAlign.
+    // They replace the driver's exclusion rules as a whole (an empty list
+    // clears them); see std/algo/rule_set.h for what each kind matches.
+    enum FilterRuleKind : unsigned short
+    {
+        kRulePathPrefix = 1,            // NT path, "\device\harddiskvolume3\windows\"
+        kRuleExtension = 2,             // ".tmp" or "tmp"
+        kRuleProcessImage = 3,          // NT image path
+    };
+
+    struct FilterRule
+    {
+        unsigned short kind;            // FilterRuleKind
+        unsigned short chars;           // UTF-16 code units following, no terminator
+    };
+
+    static_assert(sizeof(FilterRule) == 4, "FilterRule layout");
+
+    constexpr unsigned int kFilterRuleAlign = 4;
+    constexpr unsigned int kFilterRulesMaxBytes = 1024 * 1024;
+
+    inline unsigned int FilterRuleBytes(unsigned int chars)
+    {
+        return (unsigned int)(sizeof(FilterRule) + chars * 2 + kFilterRuleAlign - 1) & ~(kFilterRuleAlign - 1);
+    }
+
+    // Writes one rule at `at`, which has FilterRuleBytes(chars) bytes, and
+    // returns that size.
+    inline unsigned int WriteFilterRule(void* at, unsigned short kind, const void* text, unsigned short chars)
+    {
+        FilterRule* r = (FilterRule*)at;
+        r->kind = kind;
+        r->chars = chars;
+        unsigned int size = FilterRuleBytes(chars);
+        const unsigned char* src = (const unsigned char*)text;
+        unsigned char* dst = (unsigned char*)(r + 1);
+        for (unsigned int i = 0; i < size - sizeof(FilterRule); i++) {
+            dst[i] = i < chars * 2u ? src[i] : 0;
+        }
+        return size;
+    }
+
+    // Calls fn(rule) for each rule of a kChannelSetRules payload, the text
+    // following the FilterRule. Stops and returns false at a malformed
+    // rule or when fn returns false. The payload must be a copy the caller
+    // owns: it is read more than once.
+    template <typename Fn>
+    inline bool ForEachFilterRule(const void* rules, unsigned long long bytes, Fn&& fn)
+    {
+        const unsigned char* at = (const unsigned char*)rules;
+        unsigned long long pos = 0;
+        while (pos < bytes) {
+            if (bytes - pos < sizeof(FilterRule)) {
+                return false;
+            }
+            const FilterRule* r = (const FilterRule*)(at + pos);
+            unsigned int size = FilterRuleBytes(r->chars);
+            if (r->chars == 0 || size > bytes - pos || fn(*r) == false) {
+                return false;
+            }
+            pos += size;
+        }
+        return true;
+    }
+
+    // ===== Producer =====
+
+    inline void InitSharedRing(SharedRingHeader& h, unsigned int header_bytes, unsigned int capacity)
+    {
+        h.magic = kChannelMagic;
+        h.version = kChannelVersion;
+        h.header_bytes = header_bytes;
+        h.capacity = capacity;
+        h.head = 0;
+        h.produced = 0;
+        h.dropped = 0;
+        h.tail = 0;
+        h.consumer_waiting = 0;
+    }
+
+    struct SharedRingWriter
+    {
+        SharedRingHeader* header;
+        unsigned char* data;
+        unsigned long long capacity;    // private copies, see above
+        unsigned long long head;
+    };
+
+    inline void InitSharedRingWriter(SharedRingWriter& w, SharedRingHeader* h)
+    {
+        w.header = h;
+        w.data = (unsigned char*)h + h->header_bytes;
+        w.capacity = h->capacity;
+        w.head = 0;
+    }
+
+    inline unsigned int AlignChannelRecord(unsigned int n)
+    {
+        return (n + kChannelRecordAlign - 1) & ~(kChannelRecordAlign - 1);
+    }
+
+    // Room for a record of `bytes`, or nullptr (counted as dropped) when the
+    // consumer is behind. Fill it, then call PublishSharedRecord.
+    inline void* ReserveSharedRecord(SharedRingWriter& w, unsigned int bytes, unsigned int* size)
+    {
+        unsigned long long total = AlignChannelRecord(bytes);
+        unsigned long long mask = w.capacity - 1;
+        unsigned long long room = w.capacity - (w.head & mask);
+        unsigned long long pad = total > room ? room : 0;
+        unsigned long long tail = krnl_std::ring_atomic::Load(&w.header->tail);
+        if (total > w.capacity / 2 || tail > w.head || w.head + pad + total - tail > w.capacity) {
+            krnl_std::ring_atomic::Add(&w.header->dropped, 1);
+            return nullptr;
+        }
+
+        if (pad != 0) {
+            ChannelRecord* r = (ChannelRecord*)(w.data + (w.head & mask));
+            r->size = (unsigned int)pad;
+            r->type = kChannelPad;
+            r->reserved = 0;
+            w.head += pad;
+        }
+        *size = (unsigned int)total;
+        return w.data + (w.head & mask);
+    }
+
+    // Makes the record visible. Returns true when the consumer is asleep and
+    // needs its event set.
+    inline bool PublishSharedRecord(SharedRingWriter& w, unsigned int size)
+    {
+        w.head += size;
+        krnl_std::ring_atomic::Store(&w.header->head, w.head);
+        krnl_std::ring_atomic::Add(&w.header->produced, 1);
+        return krnl_std::ring_atomic::Load(&w.header->consumer_waiting) != 0;
+    }
+
+    // ===== Consumer =====
+
+    // Calls fn(const ChannelRecord&) for every published record and releases
+    // the space. A malformed record (only possible if the producer is broken)
+    // discards everything up to head. Returns the number of records.
+    template <typename Fn>
+    inline unsigned long long DrainSharedRing(SharedRingHeader& h, Fn&& fn)
+    {
+        const unsigned char* data = (const unsigned char*)&h + h.header_bytes;
+        unsigned long long mask = (unsigned long long)h.capacity - 1;
+        unsigned long long head = krnl_std::ring_atomic::Load(&h.head);
+        unsigned long long tail = h.tail;
+        unsigned long long n = 0;
+
+        while (tail < head) {
+            unsigned long long idx = tail & mask;
+            const ChannelRecord* r = (const ChannelRecord*)(data + idx);
+            unsigned int size = r->size;
+            if (size < sizeof(ChannelRecord) || size % kChannelRecordAlign != 0 ||
+                idx + size > h.capacity || tail + size > head) {
+                tail = head;
+                break;
+            }
+            if (r->type != kChannelPad) {
+                fn(*r);
+                n++;
+            }
+            tail += size;
+        }
+        krnl_std::ring_atomic::Store(&h.tail, tail);
+        return n;
+    }
+
+    // Wait protocol: announce, re-check, then sleep. The producer publishes
+    // head before it reads consumer_waiting, so one of the two sides always
+    // sees the other.
+    inline bool PrepareSharedRingWait(SharedRingHeader& h)
+    {
+        krnl_std::ring_atomic::Store(&h.consumer_waiting, 1);
+        if (krnl_std::ring_atomic::Load(&h.head) != h.tail) {
+            krnl_std::ring_atomic::Store(&h.consumer_waiting, 0);
+            return false;
+        }
+        return true;
+    }
+
+    inline void FinishSharedRingWait(SharedRingHeader& h)
+    {
+        krnl_std::ring_atomic::Store(&h.consumer_waiting, 0);
+    }
+}
+
+#endif
@@ -12,48 +12,72 @@
 
 #define HIEUNT_MAX_PATH 1024
 
+// Reads/writes larger than ENTROPY_SAMPLE_MIN_BYTES get their entropy from
+// ENTROPY_SAMPLE_MAX_BLOCKS blocks of ENTROPY_SAMPLE_BLOCK_BYTES instead of
+// every byte. collector::kEntropySampling holds the values in use.
+#define ENTROPY_SAMPLE_MIN_BYTES (256 * 1024)
+#define ENTROPY_SAMPLE_BLOCK_BYTES 4096
+#define ENTROPY_SAMPLE_MAX_BLOCKS 16
+
+// Seen-set sizes in 64-byte buckets of 8 keys (std/set/seen_set.h):
+// 4096 processes in 32 KB, 128K paths in 1 MB, 16K excluded handles in
+// 128 KB.
+#define SEEN_PROCESS_BUCKETS 512
+#define SEEN_PATH_BUCKETS 16384
+#define EXCLUDED_HANDLE_BUCKETS 2048
+
+namespace math
+{
+    struct ByteStreamStats;
+}
+
+namespace krnl_std
+{
+    struct PathEntry;
+}
+
 namespace collector
 {
+    struct ProcessInfo;
+    typedef krnl_std::PathEntry PathInfo;
+
+    // What one direction of IO did through the handle, kept together so an
+    // IO touches one run of the context.
+    struct HANDLE_IO_COUNTERS
+    {
+        LONGLONG first_timestamp;
+        LONGLONG last_timestamp;
+        LONGLONG cnt_bytes;
+        LONGLONG cnt_times;
+        // Cumulative byte histogram, allocated on the first IO
+        math::ByteStreamStats* stats;
+        // Guards the fields above against concurrent IOs in this direction.
+        // A spin lock since PostReadFile can run at DISPATCH_LEVEL; zeroed
+        // means initialized.
+        KSPIN_LOCK lock;
+    };
+
+    // Allocated on the first operation worth recording (see
+    // GetHandleContext in colletor.cpp), not at create, so handles that are
+    // opened and closed without one cost nothing. Plain data: zeroed on
+    // allocation, and ContextCleanup drops the references.
     typedef struct _HANDLE_CONTEXT
     {
-        ULONG requestor_pid = 0;
-        std::WString process_path;
-
-        std::WString path;
-
-        LONGLONG file_size = 0;
-
-        bool is_read = false;
-        bool is_modified = false;
-
-        LONGLONG first_write_timestamp = 0;
-        LONGLONG last_write_timestamp = 0;
-        LONGLONG write_cnt_bytes = 0;
-        LONGLONG write_cnt_times = 0;
-        double write_entropy = 0.0;
-
-        LONGLONG first_read_timestamp = 0;
-        LONGLONG last_read_timestamp = 0;
-        LONGLONG read_cnt_bytes = 0;
-        LONGLONG read_cnt_times = 0;
-        double read_entropy = 0.0;
-
-        bool is_renamed = false;
-        std::WString new_path;
-
-        bool is_created = false;
-        
-        bool is_deleted = false;
-        
-        bool is_alloc = false;
-        bool is_eof = false;
-        bool is_fvdli = false;
-        bool is_fs_ow = false;
-        bool is_fs_wre = false;
-        bool is_fs_szd = false;
-
-        bool is_mmap_open = false;
-        bool is_mmap_modified = false;
+        // Referenced entries of the path cache; new_path is nullptr until a rename
+        PathInfo* path;
+        PathInfo* new_path;
+        // Referenced entry of the process cache, may be nullptr
+        ProcessInfo* process;
+
+        ULONG requestor_pid;
+        // evt::EventHandleFlags, set with SetHandleFlags: IOs on the same
+        // handle can run concurrently.
+        volatile LONG flags;
+
+        LONGLONG file_size;
+
+        HANDLE_IO_COUNTERS write;
+        HANDLE_IO_COUNTERS read;
     } HANDLE_CONTEXT, * PHANDLE_CONTEXT;
 
     void DrvRegister();
@@ -1,31 +1,318 @@
 ﻿#include "collector.h"
+#include "process_cache.h"
+#include "path_cache.h"
+#include "filter_rules.h"
 #include "../std/file/file.h"   
-#include "../std/algo/entropy.h"
+#include "../std/algo/entropy_sampling.h"
+#include "../std/algo/stream_entropy.h"
+#include "../com/event_record.h"
 #include "../std/algo/hash.h"
 #include "../template/common.h"
-#include "../std/set/set.h"
+#include "../std/set/seen_set.h"
 #include "../std/sync/mutex.h"
 
+#include <bcrypt.h>
+
 namespace collector
 {
-    bool kIsProcessNotifyCallbackRegistered = false;
-    bool kIsObCallbackRegistered = false;
+    bool g_IsProcessNotifyCallbackRegistered = false;
+    bool g_IsObCallbackRegistered = false;
+
+    // Processes and paths whose P/F record is already in the log, so handle
+    // summaries can refer to them by key. Lock-free; a forgotten entry is
+    // just logged again.
+    static krnl_std::SeenSet g_SeenProcesses;
+    static krnl_std::SeenSet g_SeenPaths;
+
+    // File objects of opens the filter rules exclude, so their IO does not
+    // go back to GetHandleContext's name lookup. Keyed by address: erased on
+    // close, and again by the next create at that address, since a failed
+    // create frees the object without one. A forgotten entry only costs
+    // that lookup again.
+    static krnl_std::SeenSet g_ExcludedHandles;
+
+    // Scratch byte histograms for PreWriteFile / PostReadFile. Lookaside lists
+    // keep per-processor free lists, so a read or write does not go to the pool.
+    // A true per-CPU buffer would need DISPATCH_LEVEL, which is not allowed while
+    // touching a pageable user buffer.
+    static LOOKASIDE_LIST_EX g_HistogramLookaside;
+    static bool g_IsHistogramLookasideInit = false;
+
+    // Large reads/writes are entropy-sampled, see ENTROPY_SAMPLE_*.
+    const math::EntropySampling kEntropySampling = {
+        ENTROPY_SAMPLE_MIN_BYTES,
+        ENTROPY_SAMPLE_BLOCK_BYTES,
+        ENTROPY_SAMPLE_MAX_BLOCKS,
+    };
+
+    // Which blocks get sampled must not be predictable by the writer, so the
+    // seeds come from a key drawn from the system RNG in DrvRegister, mixed
+    // with a per-IO counter (splitmix64).
+    static ull g_SampleKey = 0;
+    static volatile LONG64 g_SampleCounter = 0;
+
+    static void InitSampleKey()
+    {
+        NTSTATUS status = BCryptGenRandom(nullptr, (PUCHAR)&g_SampleKey, sizeof(g_SampleKey), BCRYPT_USE_SYSTEM_PREFERRED_RNG);
+        if (!NT_SUCCESS(status))
+        {
+            DebugMessage("Fail to get a sampling key from BCryptGenRandom: %x", status);
+            ULONG seed = (ULONG)KeQueryInterruptTime();
+            g_SampleKey = ((ull)RtlRandomEx(&seed) << 32) | RtlRandomEx(&seed);
+        }
+    }
+
+    static ull SampleSeed()
+    {
+        ull z = g_SampleKey + (ull)InterlockedIncrement64(&g_SampleCounter) * 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        z ^= z >> 31;
+        // 0 would sample the start of every stripe.
+        return z != 0 ? z : 1;
+    }
+
+    static math::EntropySamplingScratch32* AllocHistogram()
+    {
+        if (g_IsHistogramLookasideInit == false) {
+            return nullptr;
+        }
+        return (math::EntropySamplingScratch32*)ExAllocateFromLookasideListEx(&g_HistogramLookaside);
+    }
+
+    static void FreeHistogram(math::EntropySamplingScratch32* scratch)
+    {
+        ExFreeToLookasideListEx(&g_HistogramLookaside, scratch);
+    }
+
+    // Per-handle cumulative histograms, allocated on the first read/write of
+    // that direction and freed in ContextCleanup.
+    static LOOKASIDE_LIST_EX g_StreamStatsLookaside;
+    static bool g_IsStreamStatsLookasideInit = false;
+
+    static math::ByteStreamStats* GetStreamStats(math::ByteStreamStats** slot)
+    {
+        auto stats = *slot;
+        if (stats != nullptr || g_IsStreamStatsLookasideInit == false) {
+            return stats;
+        }
+        stats = (math::ByteStreamStats*)ExAllocateFromLookasideListEx(&g_StreamStatsLookaside);
+        if (stats == nullptr) {
+            return nullptr;
+        }
+        math::ResetByteStreamStats(*stats);
+        // Two IOs on the same handle can race here; keep whichever won.
+        auto prev = InterlockedCompareExchangePointer((PVOID*)slot, stats, nullptr);
+        if (prev != nullptr) {
+            ExFreeToLookasideListEx(&g_StreamStatsLookaside, stats);
+            return (math::ByteStreamStats*)prev;
+        }
+        return stats;
+    }
+
+    static void FreeStreamStats(HANDLE_CONTEXT* p_hc)
+    {
+        if (p_hc->write.stats != nullptr) {
+            ExFreeToLookasideListEx(&g_StreamStatsLookaside, p_hc->write.stats);
+            p_hc->write.stats = nullptr;
+        }
+        if (p_hc->read.stats != nullptr) {
+            ExFreeToLookasideListEx(&g_StreamStatsLookaside, p_hc->read.stats);
+            p_hc->read.stats = nullptr;
+        }
+    }
+
+    static void SetHandleFlags(HANDLE_CONTEXT* p_hc, LONG flags)
+    {
+        if ((p_hc->flags & flags) != flags) {
+            InterlockedOr(&p_hc->flags, flags);
+        }
+    }
+
+    // freq is this IO's own histogram; only the merge into the handle's
+    // totals happens under io.lock.
+    static void AddIo(HANDLE_IO_COUNTERS& io, ULONG length, const unsigned int* freq, ull counted)
+    {
+        auto stats = GetStreamStats(&io.stats);
+        auto t = GetNtSystemTime();
+
+        KIRQL irql;
+        KeAcquireSpinLock(&io.lock, &irql);
+        io.cnt_bytes += length;
+        if (stats != nullptr) {
+            math::AddToByteStreamStats(*stats, freq, counted, length);
+        }
+        io.cnt_times += 1;
+        if (io.first_timestamp == 0) {
+            io.first_timestamp = t;
+        }
+        io.last_timestamp = t;
+        KeReleaseSpinLock(&io.lock, irql);
+    }
 
-    Set<ull>* sp = nullptr;
-    Set<ull>* sf = nullptr;
-    static Mutex mtx;
+    // A zeroed context of `type` for the file `path`, referenced once. The
+    // caller sets it on the file object or releases it; ContextCleanup
+    // drops what it references either way.
+    static PHANDLE_CONTEXT NewHandleContext(PFLT_CALLBACK_DATA data, PCFLT_RELATED_OBJECTS flt_objects, FLT_CONTEXT_TYPE type, const std::WStringView& path)
+    {
+        PathInfo* path_info = InternPath(path);
+        if (path_info == nullptr) {
+            return nullptr;
+        }
+
+        PHANDLE_CONTEXT p_hc = nullptr;
+        NTSTATUS status = FltAllocateContext(flt_objects->Filter, type, sizeof(HANDLE_CONTEXT), NonPagedPool, reinterpret_cast<PFLT_CONTEXT*>(&p_hc));
+        if (!NT_SUCCESS(status)) {
+            ReleasePathInfo(path_info);
+            return nullptr;
+        }
+
+        RtlZeroMemory(p_hc, sizeof(HANDLE_CONTEXT));
+        p_hc->path = path_info;
+        p_hc->requestor_pid = FltGetRequestorProcessId(data);
+        p_hc->process = ReferenceProcessInfo((HANDLE)p_hc->requestor_pid);
+        return p_hc;
+    }
+
+    // Sets a new stream handle context on the file object and returns it
+    // referenced. When another IO on the handle set one first, returns that
+    // one instead.
+    static PHANDLE_CONTEXT SetHandleContext(PCFLT_RELATED_OBJECTS flt_objects, PHANDLE_CONTEXT p_hc)
+    {
+        LARGE_INTEGER li_file_size = { 0, 0 };
+        FsRtlGetFileSize(flt_objects->FileObject, &li_file_size);
+        p_hc->file_size = li_file_size.QuadPart;
+
+        PHANDLE_CONTEXT existing = nullptr;
+        NTSTATUS status = FltSetStreamHandleContext(flt_objects->Instance, flt_objects->FileObject, FLT_SET_CONTEXT_KEEP_IF_EXISTS, reinterpret_cast<PFLT_CONTEXT>(p_hc), reinterpret_cast<PFLT_CONTEXT*>(&existing));
+        if (NT_SUCCESS(status)) {
+            return p_hc;
+        }
+        FltReleaseContext(p_hc);
+        return status == STATUS_FLT_CONTEXT_ALREADY_DEFINED ? existing : nullptr;
+    }
+
+    // Referenced stream handle context of the handle. PostFileCreate only
+    // allocates one for creates and delete-on-close opens; every other
+    // handle gets its context here, from its first user read or write,
+    // rename, delete, allocation/EOF/VDL change or write FSCTL (the majors
+    // in kCallbacks), so handles opened and closed without one cost nothing.
+    // nullptr for handles the collector does not follow.
+    static PHANDLE_CONTEXT GetHandleContext(PFLT_CALLBACK_DATA data, PCFLT_RELATED_OBJECTS flt_objects)
+    {
+        PHANDLE_CONTEXT p_hc = nullptr;
+        NTSTATUS status = FltGetStreamHandleContext(flt_objects->Instance, flt_objects->FileObject, reinterpret_cast<PFLT_CONTEXT*>(&p_hc));
+        if (NT_SUCCESS(status)) {
+            return p_hc;
+        }
+        if (status != STATUS_NOT_FOUND) {
+            return nullptr;
+        }
+
+        // What PreFileCreate would have skipped.
+        if (FlagOn(flt_objects->FileObject->Flags, FO_VOLUME_OPEN) ||
+            !FltSupportsStreamHandleContexts(flt_objects->FileObject)) {
+            return nullptr;
+        }
+        BOOLEAN is_directory = FALSE;
+        status = FltIsDirectory(flt_objects->FileObject, flt_objects->Instance, &is_directory);
+        if (!NT_SUCCESS(status) || is_directory == TRUE) {
+            return nullptr;
+        }
+        if (krnl_std::TestSeen(g_ExcludedHandles, (ull)flt_objects->FileObject)) {
+            return nullptr;
+        }
+        std::WString current_path = flt::GetFileFullPathName(data);
+        if (current_path.Size() == 0 || current_path.HasCiSuffix(L"\\EventCollectorDriver.log")) {
+            return nullptr;
+        }
+        // PreFileCreate matched the opened name; this is the normalized one,
+        // and the handle may have been opened before the rules changed.
+        if (IsExcludedFile(current_path) || IsExcludedProcess((HANDLE)FltGetRequestorProcessId(data))) {
+            krnl_std::TestAndInsertSeen(g_ExcludedHandles, (ull)flt_objects->FileObject);
+            return nullptr;
+        }
+
+        p_hc = NewHandleContext(data, flt_objects, FLT_STREAMHANDLE_CONTEXT, current_path);
+        if (p_hc == nullptr) {
+            return nullptr;
+        }
+        return SetHandleContext(flt_objects, p_hc);
+    }
+
+    // Interns a path in the log: handle summaries only carry `key`. false
+    // when the ring had no room, so the caller does not mark it as logged.
+    static bool LogPathRecord(evt::EventRecordType type, ull key, const std::WStringView& path)
+    {
+        ULONG chars = (ULONG)min(path.Size(), (size_t)LOG_LINE_MAX_CHARS);
+        ULONG size = sizeof(evt::EventPathRecord) + chars * sizeof(WCHAR);
+
+        krnl_std::LogReservation res;
+        if (!BeginLogRecord(size, &res)) {
+            return false;
+        }
+        evt::EventPathRecord* rec = (evt::EventPathRecord*)res.data;
+        evt::InitEventHeader(rec->header, type, size);
+        rec->key = key;
+        rec->chars = chars;
+        rec->reserved = 0;
+        RtlCopyMemory(rec + 1, path.Data(), chars * sizeof(WCHAR));
+        EndLogRecord(&res, size);
+        return true;
+    }
+
+    // Logs the path record for `key` unless one already was. The key goes
+    // into `seen` only once its record is committed, so a dropped record is
+    // retried by the next summary instead of being referred to forever.
+    static void LogPathOnce(krnl_std::SeenSet& seen, evt::EventRecordType type, ull key, const std::WStringView& path)
+    {
+        if (krnl_std::TestSeen(seen, key) == false && LogPathRecord(type, key, path) == true) {
+            krnl_std::TestAndInsertSeen(seen, key);
+        }
+    }
 
     // Register process and thread callbacks.
     void DrvRegister()
     {
         DebugMessage("%ws", __FUNCTIONW__);
 
-        sp = new Set<ull>();
-        sf = new Set<ull>();
-        mtx.Create();
+        krnl_std::InitSeenSet(g_SeenProcesses, krnl_std::Alloc(krnl_std::SeenSetBytes(SEEN_PROCESS_BUCKETS)), SEEN_PROCESS_BUCKETS);
+        krnl_std::InitSeenSet(g_SeenPaths, krnl_std::Alloc(krnl_std::SeenSetBytes(SEEN_PATH_BUCKETS)), SEEN_PATH_BUCKETS);
+        krnl_std::InitSeenSet(g_ExcludedHandles, krnl_std::Alloc(krnl_std::SeenSetBytes(EXCLUDED_HANDLE_BUCKETS)), EXCLUDED_HANDLE_BUCKETS);
+        if (g_SeenProcesses.buckets == nullptr || g_SeenPaths.buckets == nullptr)
+        {
+            DebugMessage("Fail to allocate seen sets, every path will be logged");
+        }
+        math::InitEntropyTables();
+        InitSampleKey();
+        InitProcessCache();
+        InitPathCache();
+        InitFilterRules();
+
+        NTSTATUS status = ExInitializeLookasideListEx(&g_HistogramLookaside, nullptr, nullptr, NonPagedPoolNx, 0,
+            sizeof(math::EntropySamplingScratch32), 0x22042003, 0);
+        if (!NT_SUCCESS(status))
+        {
+            DebugMessage("Fail to initialize histogram lookaside list: %x", status);
+        }
+        else
+        {
+            g_IsHistogramLookasideInit = true;
+        }
+
+        status = ExInitializeLookasideListEx(&g_StreamStatsLookaside, nullptr, nullptr, NonPagedPoolNx, 0,
+            sizeof(math::ByteStreamStats), 0x22042003, 0);
+        if (!NT_SUCCESS(status))
+        {
+            DebugMessage("Fail to initialize stream stats lookaside list: %x", status);
+        }
+        else
+        {
+            g_IsStreamStatsLookasideInit = true;
+        }
 
         // Register process creation and termination callback
-        NTSTATUS status = PsSetCreateProcessNotifyRoutineEx(ProcessNotifyCallback, FALSE);
+        status = PsSetCreateProcessNotifyRoutineEx(ProcessNotifyCallback, FALSE);
         if (!NT_SUCCESS(status))
         {
             DebugMessage("Fail to register process notify callback: %x", status);
@@ -33,7 +320,7 @@ namespace collector
         else
         {
             DebugMessage("Process notify callback registered");
-            kIsProcessNotifyCallbackRegistered = true;
+            g_IsProcessNotifyCallbackRegistered = true;
         }
     }
 
@@ -42,16 +329,34 @@ namespace collector
     {
         DebugMessage("%ws", __FUNCTIONW__);
 
-        if (kIsProcessNotifyCallbackRegistered == true)
+        if (g_IsProcessNotifyCallbackRegistered == true)
         {
             PsSetCreateProcessNotifyRoutineEx(ProcessNotifyCallback, TRUE);
-            kIsProcessNotifyCallbackRegistered = false;
+            g_IsProcessNotifyCallbackRegistered = false;
         }
 
-        delete sp;
-        delete sf;
-        sp = nullptr;
-        sf = nullptr;
+        UninitProcessCache();
+        UninitPathCache();
+        UninitFilterRules();
+
+        krnl_std::Free(g_SeenProcesses.buckets);
+        krnl_std::Free(g_SeenPaths.buckets);
+        krnl_std::Free(g_ExcludedHandles.buckets);
+        krnl_std::InitSeenSet(g_SeenProcesses, nullptr, 0);
+        krnl_std::InitSeenSet(g_SeenPaths, nullptr, 0);
+        krnl_std::InitSeenSet(g_ExcludedHandles, nullptr, 0);
+
+        if (g_IsHistogramLookasideInit == true)
+        {
+            ExDeleteLookasideListEx(&g_HistogramLookaside);
+            g_IsHistogramLookasideInit = false;
+        }
+
+        if (g_IsStreamStatsLookasideInit == true)
+        {
+            ExDeleteLookasideListEx(&g_StreamStatsLookaside);
+            g_IsStreamStatsLookasideInit = false;
+        }
     }
 
     // Process notification callback
@@ -61,17 +366,18 @@ namespace collector
         PPS_CREATE_NOTIFY_INFO create_info
     )
     {
-        const std::WString& process_path = GetProcessImageName(pid);
         if (create_info) {
-            PushToLogQueue(L"P,%llu,%ws\n", (ull)pid, process_path.Data());
-            mtx.Lock();
-            sp->Insert((ull)pid);
-            mtx.Unlock();
+            ProcessInfo* info = AddProcessInfo(pid);
+            if (info != nullptr) {
+                if (LogPathRecord(evt::kProcessPath, (ull)pid, info->image_name) == true) {
+                    krnl_std::TestAndInsertSeen(g_SeenProcesses, (ull)pid);
+                }
+                ReleaseProcessInfo(info);
+            }
         }
         else {
-            mtx.Lock();
-            sp->Erase((ull)pid);
-            mtx.Unlock();
+            RemoveProcessInfo(pid);
+            krnl_std::EraseSeen(g_SeenProcesses, (ull)pid);
         }
     }
 
@@ -79,14 +385,14 @@ namespace collector
     {
         //DebugMessage("%ws", __FUNCTIONW__);
 
-        reg::kFltFuncVector->PushBack({ IRP_MJ_CREATE, PreFileCreate, PostFileCreate });
-        reg::kFltFuncVector->PushBack({ IRP_MJ_CLOSE, PreFileClose, PostFileClose });
-        reg::kFltFuncVector->PushBack({ IRP_MJ_CLEANUP, PreFileClose, PostFileClose });
-        reg::kFltFuncVector->PushBack({ IRP_MJ_WRITE, PreWriteFile, PostFileWrite });
-        reg::kFltFuncVector->PushBack({ IRP_MJ_READ, PreReadFile, PostReadFile });
-        reg::kFltFuncVector->PushBack({ IRP_MJ_ACQUIRE_FOR_SECTION_SYNCHRONIZATION, PreFileAcquireForSectionSync, PostFileAcquireForSectionSync });
-        reg::kFltFuncVector->PushBack({ IRP_MJ_FILE_SYSTEM_CONTROL, PreFileSystemControl, PostFileSystemControl });
-        reg::kFltFuncVector->PushBack({ IRP_MJ_SET_INFORMATION, PreFileSetInformation, PostFileSetInformation });
+        reg::RegisterFltFunc(IRP_MJ_CREATE, PreFileCreate, PostFileCreate);
+        reg::RegisterFltFunc(IRP_MJ_CLOSE, PreFileClose, PostFileClose);
+        reg::RegisterFltFunc(IRP_MJ_CLEANUP, PreFileClose, PostFileClose);
+        reg::RegisterFltFunc(IRP_MJ_WRITE, PreWriteFile, PostFileWrite);
+        reg::RegisterFltFunc(IRP_MJ_READ, PreReadFile, PostReadFile);
+        reg::RegisterFltFunc(IRP_MJ_ACQUIRE_FOR_SECTION_SYNCHRONIZATION, PreFileAcquireForSectionSync, PostFileAcquireForSectionSync);
+        reg::RegisterFltFunc(IRP_MJ_FILE_SYSTEM_CONTROL, PreFileSystemControl, PostFileSystemControl);
+        reg::RegisterFltFunc(IRP_MJ_SET_INFORMATION, PreFileSetInformation, PostFileSetInformation);
 
         //DebugMessage("Callbacks created.");
         return;
@@ -110,8 +416,38 @@ namespace collector
         return STATUS_SUCCESS;
     }
 
+    // Whether the filter rules exclude the open before it happens. Matches
+    // the name as opened, which needs no normalization (no query of the file
+    // system), so an excluded open costs a rule lookup and nothing more. A
+    // name the rules miss only because it is not normalized (a short name,
+    // say) is caught by GetHandleContext on the handle's first IO, as is the
+    // driver's own log when there are no file rules.
+    static bool IsExcludedOpen(PFLT_CALLBACK_DATA data)
+    {
+        if (IsExcludedProcess((HANDLE)FltGetRequestorProcessId(data))) {
+            return true;
+        }
+        // No rules is the default: don't query the name of every open for them.
+        if (HasFileRules() == false) {
+            return false;
+        }
+        PFLT_FILE_NAME_INFORMATION name_info = nullptr;
+        NTSTATUS status = FltGetFileNameInformation(data, FLT_FILE_NAME_OPENED | FLT_FILE_NAME_QUERY_DEFAULT, &name_info);
+        if (!NT_SUCCESS(status)) {
+            // GetHandleContext asks again, for the normalized name.
+            return false;
+        }
+        std::WStringView name(name_info->Name);
+        bool excluded = name.HasCiSuffix(L"\\EventCollectorDriver.log") || IsExcludedFile(name);
+        FltReleaseFileNameInformation(name_info);
+        return excluded;
+    }
+
     FLT_PREOP_CALLBACK_STATUS PreFileCreate(PFLT_CALLBACK_DATA data, PCFLT_RELATED_OBJECTS flt_objects, PVOID* completion_context)
     {
+        // Whatever had this address before is gone.
+        krnl_std::EraseSeen(g_ExcludedHandles, (ull)flt_objects->FileObject);
+
         //  Directory opens don't need to be scanned.
         if (FlagOn(data->Iopb->Parameters.Create.Options, FILE_DIRECTORY_FILE))
             return FLT_PREOP_SUCCESS_NO_CALLBACK;
@@ -147,20 +483,11 @@ namespace collector
             return FLT_PREOP_SUCCESS_NO_CALLBACK;
         }
 
-        std::WString current_path(flt::GetFileFullPathName(data));
-        if (current_path.Size() == 0 || current_path.HasCiSuffix(L"\\EventCollectorDriver.log")) {
+        if (IsExcludedOpen(data)) {
+            krnl_std::TestAndInsertSeen(g_ExcludedHandles, (ull)file_obj);
             return FLT_PREOP_SUCCESS_NO_CALLBACK;
         }
 
-        //if (current_path.HasCiPrefix(L"\\device\\harddiskvolume3\\windows\\") == true
-        //    || current_path.HasCiPrefix(L"\\device\\harddiskvolume3\\program files\\") == true
-        //    || current_path.HasCiPrefix(L"\\device\\harddiskvolume3\\program files (x86)\\") == true
-        //    || current_path.HasCiPrefix(L"\\device\\harddiskvolume3\\users\\hieu\\appdata\\") == true
-        //    || current_path.HasCiPrefix(L"\\device\\harddiskvolume3\\programdata\\") == true
-        //    ) {
-        //    return FLT_PREOP_SUCCESS_NO_CALLBACK;
-        //}
-
         return FLT_PREOP_SUCCESS_WITH_CALLBACK;
     }
 
@@ -178,48 +505,32 @@ namespace collector
             return FLT_POSTOP_FINISHED_PROCESSING;
         }
 
-        std::WString current_path = flt::GetFileFullPathName(data);
-
-        if (current_path.Size() == 0) {
-            return FLT_POSTOP_FINISHED_PROCESSING;
-        }
-
         const auto& create_params = data->Iopb->Parameters.Create;
 
         bool is_created = (data->IoStatus.Information == FILE_CREATED);
         bool is_delete_on_close = FlagOn(create_params.Options, FILE_DELETE_ON_CLOSE);
 
-        /*
-        bool has_write_access = create_params.SecurityContext->DesiredAccess & (FILE_WRITE_DATA | FILE_APPEND_DATA);
-        bool has_delete_access = create_params.SecurityContext->DesiredAccess & DELETE;
-        // Not interested in files without write and delete access
-        if (!is_created && !has_write_access && !is_delete_on_close && !has_delete_access)
-        {
-            DebugMessage("File: %ws, Not interested in files without create, write and delete access", current_path.Data());
+        // Only the open knows these two; every other handle gets its context
+        // from GetHandleContext when it first does something.
+        if (!is_created && !is_delete_on_close) {
             return FLT_POSTOP_FINISHED_PROCESSING;
         }
-        */
-        ULONG options = create_params.Options;
 
-        PHANDLE_CONTEXT p_hc = nullptr;
-        NTSTATUS status = FltAllocateContext(flt_objects->Filter, FLT_STREAMHANDLE_CONTEXT, sizeof(HANDLE_CONTEXT), NonPagedPool, reinterpret_cast<PFLT_CONTEXT*>(&p_hc));
-        if (!NT_SUCCESS(status)) {
+        std::WString current_path = flt::GetFileFullPathName(data);
+        if (current_path.Size() == 0) {
             return FLT_POSTOP_FINISHED_PROCESSING;
         }
 
-        memset(p_hc, 0, sizeof(HANDLE_CONTEXT));
-        p_hc->requestor_pid = FltGetRequestorProcessId(data);
-        p_hc->process_path = GetProcessImageName((HANDLE)p_hc->requestor_pid);
-        p_hc->is_created = is_created;
-        p_hc->is_deleted = is_delete_on_close;
-        p_hc->path = current_path;
-
-        LARGE_INTEGER li_file_size = { 0, 0 };
-        FsRtlGetFileSize(flt_objects->FileObject, &li_file_size);
-        p_hc->file_size = li_file_size.QuadPart;
+        PHANDLE_CONTEXT p_hc = NewHandleContext(data, flt_objects, FLT_STREAMHANDLE_CONTEXT, current_path);
+        if (p_hc == nullptr) {
+            return FLT_POSTOP_FINISHED_PROCESSING;
+        }
+        p_hc->flags = (is_created ? (LONG)evt::kFlagCreated : 0) | (is_delete_on_close ? (LONG)evt::kFlagDeleted : 0);
 
-        status = FltSetStreamHandleContext(flt_objects->Instance, flt_objects->FileObject, FLT_SET_CONTEXT_KEEP_IF_EXISTS, reinterpret_cast<PFLT_CONTEXT>(p_hc), nullptr);
-        FltReleaseContext(p_hc);
+        p_hc = SetHandleContext(flt_objects, p_hc);
+        if (p_hc != nullptr) {
+            FltReleaseContext(p_hc);
+        }
         return FLT_POSTOP_FINISHED_PROCESSING;
     }
 
@@ -242,7 +553,7 @@ namespace collector
             if (!NT_SUCCESS(status)) {
                 return FLT_PREOP_SUCCESS_NO_CALLBACK;
             }
-            p_hc->is_mmap_modified = true;
+            SetHandleFlags(p_hc, evt::kFlagMmapModified);
             FltDeleteContext(p_hc);
             FltReleaseContext(p_hc);
             // Not calculate entropy yet.
@@ -252,8 +563,8 @@ namespace collector
         if (data->RequestorMode == KernelMode) {
             return FLT_PREOP_SUCCESS_NO_CALLBACK;
         }
-        NTSTATUS status = FltGetStreamHandleContext(flt_objects->Instance, flt_objects->FileObject, reinterpret_cast<PFLT_CONTEXT*>(&p_hc));
-        if (!NT_SUCCESS(status)) {
+        p_hc = GetHandleContext(data, flt_objects);
+        if (p_hc == nullptr) {
             return FLT_PREOP_SUCCESS_NO_CALLBACK;
         }
         defer(FltReleaseContext(p_hc););
@@ -283,34 +594,28 @@ namespace collector
             return FLT_PREOP_SUCCESS_NO_CALLBACK;
         }
 
-        auto freq_write = new LONGLONG[256];
-        RtlZeroMemory(freq_write, sizeof(LONGLONG) * 256);
-        defer(delete[] freq_write;);
-
         ULONG length = write_params.Length;
         if (length == 0) {
             return FLT_PREOP_SUCCESS_NO_CALLBACK;
         }
 
+        auto scratch = AllocHistogram();
+        if (scratch == nullptr) {
+            return FLT_PREOP_SUCCESS_NO_CALLBACK;
+        }
+        defer(FreeHistogram(scratch););
+        const unsigned int* freq_write = nullptr;
+        ull counted = 0;
+
         __try {
-            for (ULONG i = 0; i < length; i++) {
-                ++freq_write[buffer[i]];
-            }
+            freq_write = math::SampleByteHistogram(buffer, length, kEntropySampling, SampleSeed(), *scratch, &counted);
         }
         __except (EXCEPTION_EXECUTE_HANDLER) {
             return FLT_PREOP_SUCCESS_NO_CALLBACK;
         }
 
-        p_hc->is_modified = true;
-        p_hc->write_cnt_bytes += length;
-        auto write_entropy = math::ComputeByteEntropyFromFreq(freq_write, length);
-        p_hc->write_entropy = (p_hc->write_entropy * p_hc->write_cnt_times + write_entropy) / (p_hc->write_cnt_times + 1);
-        p_hc->write_cnt_times += 1;
-        auto t = GetNtSystemTime();
-        if (p_hc->first_write_timestamp == 0) {
-            p_hc->first_write_timestamp = t;
-        }
-        p_hc->last_write_timestamp = t;
+        SetHandleFlags(p_hc, evt::kFlagModified);
+        AddIo(p_hc->write, length, freq_write, counted);
 
         return FLT_PREOP_SUCCESS_NO_CALLBACK;
     }
@@ -332,10 +637,19 @@ namespace collector
             return FLT_PREOP_SUCCESS_NO_CALLBACK;
         }
 
-        PHANDLE_CONTEXT p_hc = nullptr;
+        // PostReadFile can run at DISPATCH_LEVEL in an arbitrary thread, where
+        // a user buffer cannot be touched: lock it into an MDL now. Fast IO
+        // post callbacks run in the caller's thread and keep the user buffer.
+        if (!FLT_IS_FASTIO_OPERATION(data) && data->Iopb->Parameters.Read.MdlAddress == nullptr) {
+            if (!NT_SUCCESS(FltLockUserBuffer(data))) {
+                return FLT_PREOP_SUCCESS_NO_CALLBACK;
+            }
+        }
 
-        NTSTATUS status = FltGetStreamHandleContext(flt_objects->Instance, flt_objects->FileObject, reinterpret_cast<PFLT_CONTEXT*>(&p_hc));
-        if (!NT_SUCCESS(status)) {
+        // Allocated here rather than in PostReadFile, which can run at
+        // DISPATCH_LEVEL where the name cannot be queried.
+        PHANDLE_CONTEXT p_hc = GetHandleContext(data, flt_objects);
+        if (p_hc == nullptr) {
             return FLT_PREOP_SUCCESS_NO_CALLBACK;
         }
 
@@ -352,7 +666,7 @@ namespace collector
         PHANDLE_CONTEXT p_hc = (PHANDLE_CONTEXT)(p_completion_context);
         defer(FltReleaseContext(p_hc););
 
-        if (!NT_SUCCESS(data->IoStatus.Status))
+        if (!NT_SUCCESS(data->IoStatus.Status) || FlagOn(flags, FLTFL_POST_OPERATION_DRAINING))
             return FLT_POSTOP_FINISHED_PROCESSING;
 
         UCHAR* buffer = nullptr;
@@ -365,7 +679,7 @@ namespace collector
                 return FLT_POSTOP_FINISHED_PROCESSING;
             }
         }
-        else {
+        else if (FLT_IS_FASTIO_OPERATION(data)) {
             __try {
                 buffer = (UCHAR*)read_params.ReadBuffer;
                 ProbeForRead(buffer, read_params.Length, 1);
@@ -378,34 +692,28 @@ namespace collector
             return FLT_POSTOP_FINISHED_PROCESSING;
         }
 
-        auto freq_read = new LONGLONG[256];
-        RtlZeroMemory(freq_read, sizeof(LONGLONG) * 256);
-        defer(delete[] freq_read;);
-
         ULONG length = min(read_params.Length, (ULONG)data->IoStatus.Information);
 
         if (length == 0) {
             return FLT_POSTOP_FINISHED_PROCESSING;
         }
 
+        auto scratch = AllocHistogram();
+        if (scratch == nullptr) {
+            return FLT_POSTOP_FINISHED_PROCESSING;
+        }
+        defer(FreeHistogram(scratch););
+        const unsigned int* freq_read = nullptr;
+        ull counted = 0;
+
         __try {
-            for (ULONG i = 0; i < length; i++) {
-                ++freq_read[buffer[i]];
-            }
+            freq_read = math::SampleByteHistogram(buffer, length, kEntropySampling, SampleSeed(), *scratch, &counted);
         }
         __except (EXCEPTION_EXECUTE_HANDLER) {
             return FLT_POSTOP_FINISHED_PROCESSING;
         }
-        p_hc->is_read = true;
-        p_hc->read_cnt_bytes += length;
-        auto read_entropy = math::ComputeByteEntropyFromFreq(freq_read, length);
-        p_hc->read_entropy = (p_hc->read_entropy * p_hc->read_cnt_times + read_entropy) / (p_hc->read_cnt_times + 1);
-        p_hc->read_cnt_times += 1;
-        auto t = GetNtSystemTime();
-        if (p_hc->first_read_timestamp == 0) {
-            p_hc->first_read_timestamp = t;
-        }
-        p_hc->last_read_timestamp = t;
+        SetHandleFlags(p_hc, evt::kFlagRead);
+        AddIo(p_hc->read, length, freq_read, counted);
 
         return FLT_POSTOP_FINISHED_PROCESSING;
     }
@@ -424,25 +732,39 @@ namespace collector
 
         //DebugMessage("File %ws, instance %p, file object %p, pid %d", flt::GetFileFullPathName(data).Data(), flt_objects->Instance, flt_objects->FileObject, FltGetRequestorProcessId(data));
 
-        PHANDLE_CONTEXT p_hc = nullptr;
-
-        status = FltGetStreamHandleContext(flt_objects->Instance, flt_objects->FileObject, reinterpret_cast<PFLT_CONTEXT*>(&p_hc));
-        if (!NT_SUCCESS(status))
-        {
-            if (status != STATUS_NOT_FOUND) {
-                //DebugMessage("FltGetStreamHandleContext failed: %x", status);
-            }
-            return FLT_PREOP_SUCCESS_NO_CALLBACK;
-        }
-        
         auto& set_info_params = data->Iopb->Parameters.SetFileInformation;
 
         auto file_info_class = set_info_params.FileInformationClass;
 
-        if (file_info_class == FileRenameInformation 
+        bool is_rename = file_info_class == FileRenameInformation
             || file_info_class == FileRenameInformationBypassAccessCheck
-            || file_info_class == FileRenameInformationEx 
-            || file_info_class == FileRenameInformationExBypassAccessCheck)
+            || file_info_class == FileRenameInformationEx
+            || file_info_class == FileRenameInformationExBypassAccessCheck;
+
+        LONG flags = 0;
+        if (file_info_class == FileDispositionInformation || file_info_class == FileDispositionInformationEx) {
+            flags = evt::kFlagDeleted;
+        }
+        else if (file_info_class == FileAllocationInformation) {
+            flags = evt::kFlagAlloc;
+        }
+        else if (file_info_class == FileEndOfFileInformation) {
+            flags = evt::kFlagEof;
+        }
+        else if (file_info_class == FileValidDataLengthInformation) {
+            flags = evt::kFlagFvdli;
+        }
+        else if (is_rename == false) {
+            return FLT_PREOP_SUCCESS_NO_CALLBACK;
+        }
+
+        PHANDLE_CONTEXT p_hc = GetHandleContext(data, flt_objects);
+        if (p_hc == nullptr) {
+            return FLT_PREOP_SUCCESS_NO_CALLBACK;
+        }
+        defer(FltReleaseContext(p_hc););
+
+        if (is_rename == true)
         {
             PFILE_RENAME_INFORMATION target_info = (PFILE_RENAME_INFORMATION)data->Iopb->Parameters.SetFileInformation.InfoBuffer;
             PFLT_FILE_NAME_INFORMATION p_name_info;
@@ -461,25 +783,19 @@ namespace collector
             {
                 //DebugMessage("File: %ws, renamed to %ws", p_hc->path, name_info->Name.Buffer);
 
-                p_hc->is_renamed = true;
-                p_hc->new_path = p_name_info->Name;
+                PathInfo* new_path = InternPath(p_name_info->Name);
                 FltReleaseFileNameInformation(p_name_info);
+                if (new_path != nullptr) {
+                    // Renamed twice: keep the last name.
+                    ReleasePathInfo((PathInfo*)InterlockedExchangePointer((PVOID*)&p_hc->new_path, new_path));
+                    flags = evt::kFlagRenamed;
+                }
             }
         }
-        else if (file_info_class == FileDispositionInformation || file_info_class == FileDispositionInformationEx) {
-            p_hc->is_deleted = true;
-        }
-        else if (file_info_class == FileAllocationInformation) {
-            p_hc->is_alloc = true;
-        }
-        else if (file_info_class == FileEndOfFileInformation) {
-            p_hc->is_eof = true;
-        }
-        else if (file_info_class == FileValidDataLengthInformation) {
-            p_hc->is_fvdli = true;
-        }
 
-        FltReleaseContext(p_hc);
+        if (flags != 0) {
+            SetHandleFlags(p_hc, flags);
+        }
         return FLT_PREOP_SUCCESS_NO_CALLBACK;
     }
 
@@ -505,32 +821,30 @@ namespace collector
         {
             PHANDLE_CONTEXT p_hc = nullptr;
 
+            NTSTATUS status = FltGetFileContext(flt_objects->Instance, flt_objects->FileObject, reinterpret_cast<PFLT_CONTEXT*>(&p_hc));
+            if (NT_SUCCESS(status)) {
+                FltReleaseContext(p_hc);
+                return FLT_PREOP_SUCCESS_NO_CALLBACK;
+            }
+
+            if (krnl_std::TestSeen(g_ExcludedHandles, (ull)flt_objects->FileObject)) {
+                return FLT_PREOP_SUCCESS_NO_CALLBACK;
+            }
             std::WString current_path = flt::GetFileFullPathName(data);
             if (current_path.Size() == 0) {
                 return FLT_PREOP_SUCCESS_NO_CALLBACK;
             }
 
-            NTSTATUS status = FltGetFileContext(flt_objects->Instance, flt_objects->FileObject, reinterpret_cast<PFLT_CONTEXT*>(&p_hc));
-            if (!NT_SUCCESS(status))
-            {
-                status = FltAllocateContext(flt_objects->Filter, FLT_FILE_CONTEXT, sizeof(HANDLE_CONTEXT), NonPagedPool, reinterpret_cast<PFLT_CONTEXT*>(&p_hc));
-                if (!NT_SUCCESS(status)) {
-                    return FLT_PREOP_SUCCESS_NO_CALLBACK;
-                }
-                
-                memset(p_hc, 0, sizeof(HANDLE_CONTEXT));
-
-                p_hc->path = current_path;
-                p_hc->requestor_pid = FltGetRequestorProcessId(data);
-                p_hc->is_mmap_open = true;
-                status = FltSetFileContext(flt_objects->Instance, flt_objects->FileObject, FLT_SET_CONTEXT_KEEP_IF_EXISTS, reinterpret_cast<PFLT_CONTEXT>(p_hc), nullptr);
-                if (!NT_SUCCESS(status)) {
-                    //DebugMessage("FltSetFileContext failed: %x", status);
-                }
-
-                FltReleaseContext(p_hc);
+            p_hc = NewHandleContext(data, flt_objects, FLT_FILE_CONTEXT, current_path);
+            if (p_hc == nullptr) {
                 return FLT_PREOP_SUCCESS_NO_CALLBACK;
             }
+            p_hc->flags = evt::kFlagMmapOpen;
+            status = FltSetFileContext(flt_objects->Instance, flt_objects->FileObject, FLT_SET_CONTEXT_KEEP_IF_EXISTS, reinterpret_cast<PFLT_CONTEXT>(p_hc), nullptr);
+            if (!NT_SUCCESS(status)) {
+                //DebugMessage("FltSetFileContext failed: %x", status);
+            }
+
             FltReleaseContext(p_hc);
         }
 
@@ -552,24 +866,27 @@ namespace collector
             return FLT_PREOP_SUCCESS_NO_CALLBACK;
         }
 
-        PHANDLE_CONTEXT p_hc = nullptr;
-        NTSTATUS status = FltGetStreamHandleContext(flt_objects->Instance, flt_objects->FileObject, reinterpret_cast<PFLT_CONTEXT*>(&p_hc));
-        if (!NT_SUCCESS(status)) {
-            return FLT_PREOP_SUCCESS_NO_CALLBACK;
-        }
-        defer(FltReleaseContext(p_hc););
+        LONG flags = 0;
         switch (data->Iopb->Parameters.FileSystemControl.Common.FsControlCode) {
         case FSCTL_OFFLOAD_WRITE:
-            p_hc->is_fs_ow = true;
+            flags = evt::kFlagFsOw;
             break;
         case FSCTL_WRITE_RAW_ENCRYPTED:
-            p_hc->is_fs_wre = true;
+            flags = evt::kFlagFsWre;
             break;
         case FSCTL_SET_ZERO_DATA:
-            p_hc->is_fs_szd = true;
+            flags = evt::kFlagFsSzd;
             break;
-        default: break;
+        default:
+            return FLT_PREOP_SUCCESS_NO_CALLBACK;
+        }
+
+        PHANDLE_CONTEXT p_hc = GetHandleContext(data, flt_objects);
+        if (p_hc == nullptr) {
+            return FLT_PREOP_SUCCESS_NO_CALLBACK;
         }
+        SetHandleFlags(p_hc, flags);
+        FltReleaseContext(p_hc);
         return FLT_PREOP_SUCCESS_NO_CALLBACK;
     }
 
@@ -580,6 +897,10 @@ namespace collector
 
     FLT_PREOP_CALLBACK_STATUS PreFileClose(PFLT_CALLBACK_DATA data, PCFLT_RELATED_OBJECTS flt_objects, PVOID* completion_context)
     {
+        if (data->Iopb->MajorFunction == IRP_MJ_CLOSE) {
+            krnl_std::EraseSeen(g_ExcludedHandles, (ull)flt_objects->FileObject);
+        }
+
         PHANDLE_CONTEXT p_hc = nullptr;
         NTSTATUS status = FltGetStreamHandleContext(flt_objects->Instance, flt_objects->FileObject, reinterpret_cast<PFLT_CONTEXT*>(&p_hc));
         if (!NT_SUCCESS(status)) {
@@ -599,105 +920,88 @@ namespace collector
         return FLT_POSTOP_FINISHED_PROCESSING;
     }
 
-    static void LogFileEvent(const collector::HANDLE_CONTEXT* p_hc)
+    // Offset of the extension's '.', or path.Size() if the last component has none.
+    static size_t ExtensionOffset(const std::WStringView& path)
     {
-        mtx.Lock();
-        if (sp->Find(p_hc->requestor_pid) == sp->End()) {
-            mtx.Unlock();
-            PushToLogQueue(L"P,%llu,%ws\n", (ull)p_hc->requestor_pid, p_hc->process_path.Data());
-            mtx.Lock();
-            sp->Insert(p_hc->requestor_pid);
-        }
-        mtx.Unlock();
-
-        auto hf = HashWstring(p_hc->path);
-        mtx.Lock();
-        if (sf->Find(hf) == sf->End()) {
-            mtx.Unlock();
-            PushToLogQueue(L"F,%llu,%ws\n", hf, p_hc->path.Data());
-            mtx.Lock();
-            sf->Insert(hf);
-            if (sf->Size() == 100'000) {
-                sf->Clear();
+        for (size_t i = path.Size(); i > 0; i--) {
+            WCHAR c = path[i - 1];
+            if (c == L'.') {
+                return i - 1;
             }
-        }
-        mtx.Unlock();
-
-        auto hfn = HashWstring(p_hc->new_path);
-        mtx.Lock();
-        if (sf->Find(hfn) == sf->End()) {
-            mtx.Unlock();
-            PushToLogQueue(L"F,%llu,%ws\n", hfn, p_hc->new_path.Data());
-            mtx.Lock();
-            sf->Insert(hfn);
-            if (sf->Size() == 100'000) {
-                sf->Clear();
+            if (c == L'\\') {
+                break;
             }
         }
-        mtx.Unlock();
-
-        PushToLogQueue(
-            L"O,"
-            L"%lu,"        // pid
-            L"%llu,"       // path hash
-            L"%lld,"       // file size
-
-            L"%d,%d,"      // is_read,is_modified
-
-            // READ
-            L"%lld,%lld,%lld,%lld,%lld,"
-
-            // WRITE
-            L"%lld,%lld,%lld,%lld,%lld,"
-
-            // RENAME
-            L"%d,%llu,"
-
-            // CREATE / DELETE
-            L"%d,%d,"
-
-            // FLAGS
-            L"%d,%d,%d,%d,%d,%d,%d,%d\n",
-
-            p_hc->requestor_pid,
-            hf,
-            p_hc->file_size,
+        return path.Size();
+    }
 
-            p_hc->is_read,
-            p_hc->is_modified,
+    // A rename that swaps the extension is what encryptors do last, so the
+    // service hears about it without waiting for a batch.
+    static bool IsExtensionChanged(const std::WStringView& old_path, const std::WStringView& new_path)
+    {
+        std::WStringView old_ext = old_path.Substr(ExtensionOffset(old_path));
+        std::WStringView new_ext = new_path.Substr(ExtensionOffset(new_path));
+        return old_ext.EqualCi(new_ext) == false;
+    }
 
-            // READ
-            (LONGLONG)(p_hc->read_entropy * 10000),
-            p_hc->first_read_timestamp,
-            p_hc->last_read_timestamp,
-            p_hc->read_cnt_bytes,
-            p_hc->read_cnt_times,
+    static void LogFileEvent(const collector::HANDLE_CONTEXT* p_hc)
+    {
+        if (p_hc->process != nullptr) {
+            LogPathOnce(g_SeenProcesses, evt::kProcessPath, (ull)p_hc->requestor_pid, p_hc->process->image_name);
+        }
 
-            // WRITE
-            (LONGLONG)(p_hc->write_entropy * 10000),
-            p_hc->first_write_timestamp,
-            p_hc->last_write_timestamp,
-            p_hc->write_cnt_bytes,
-            p_hc->write_cnt_times,
+        // Interned entries carry the key; a handle that was not renamed
+        // logs the empty path's.
+        auto hf = p_hc->path->key;
+        LogPathOnce(g_SeenPaths, evt::kFilePath, hf, PathInfoText(p_hc->path));
 
-            // RENAME
-            p_hc->is_renamed,
-            hfn,
+        std::WStringView new_path = PathInfoText(p_hc->new_path);
+        auto hfn = p_hc->new_path != nullptr ? p_hc->new_path->key : HashWstring(new_path);
+        LogPathOnce(g_SeenPaths, evt::kFilePath, hfn, new_path);
 
-            // CREATE / DELETE
-            p_hc->is_created,
-            p_hc->is_deleted,
+        // Byte-weighted over everything read/written through the handle.
+        math::ByteStreamEntropy read_entropy = {};
+        math::ByteStreamEntropy write_entropy = {};
+        if (p_hc->read.stats != nullptr) {
+            read_entropy = math::ComputeByteStreamEntropy(*p_hc->read.stats);
+        }
+        if (p_hc->write.stats != nullptr) {
+            write_entropy = math::ComputeByteStreamEntropy(*p_hc->write.stats);
+        }
 
-            // FLAGS
-            p_hc->is_alloc,
-            p_hc->is_eof,
-            p_hc->is_fvdli,
-            p_hc->is_fs_ow,
-            p_hc->is_fs_wre,
-            p_hc->is_fs_szd,
-            p_hc->is_mmap_open,
-            p_hc->is_mmap_modified
-        );
+        krnl_std::LogReservation res;
+        if (!BeginLogRecord(sizeof(evt::EventHandleSummary), &res)) {
+            return;
+        }
+        evt::EventHandleSummary* rec = (evt::EventHandleSummary*)res.data;
+        evt::InitEventHeader(rec->header, evt::kHandleSummary, sizeof(evt::EventHandleSummary));
+
+        rec->pid = p_hc->requestor_pid;
+        rec->path_hash = hf;
+        rec->new_path_hash = hfn;
+        rec->file_size = p_hc->file_size;
+
+        rec->flags = (unsigned int)p_hc->flags;
+
+        // READ
+        rec->first_read_timestamp = p_hc->read.first_timestamp;
+        rec->last_read_timestamp = p_hc->read.last_timestamp;
+        rec->read_cnt_bytes = p_hc->read.cnt_bytes;
+        rec->read_cnt_times = p_hc->read.cnt_times;
+        rec->read_entropy[evt::kEntropyWhole] = evt::EntropyToFixed(read_entropy.whole);
+        rec->read_entropy[evt::kEntropyHead] = evt::EntropyToFixed(read_entropy.head);
+        rec->read_entropy[evt::kEntropyTail] = evt::EntropyToFixed(read_entropy.tail);
+
+        // WRITE
+        rec->first_write_timestamp = p_hc->write.first_timestamp;
+        rec->last_write_timestamp = p_hc->write.last_timestamp;
+        rec->write_cnt_bytes = p_hc->write.cnt_bytes;
+        rec->write_cnt_times = p_hc->write.cnt_times;
+        rec->write_entropy[evt::kEntropyWhole] = evt::EntropyToFixed(write_entropy.whole);
+        rec->write_entropy[evt::kEntropyHead] = evt::EntropyToFixed(write_entropy.head);
+        rec->write_entropy[evt::kEntropyTail] = evt::EntropyToFixed(write_entropy.tail);
+
+        EndLogRecord(&res, sizeof(evt::EventHandleSummary));
 
     }
 
@@ -708,48 +1012,37 @@ namespace collector
             collector::HANDLE_CONTEXT* p_hc = (collector::HANDLE_CONTEXT*)context;
             if (p_hc != nullptr)
             {
-                int action_cnt = 
-                    p_hc->is_modified +
-                    p_hc->is_read +
-                    p_hc->is_renamed +
-                    //p_hc->is_created +
-                    p_hc->is_deleted +
-                    p_hc->is_alloc +
-                    p_hc->is_eof +
-                    p_hc->is_fvdli +
-                    p_hc->is_fs_ow +
-                    p_hc->is_fs_wre +
-                    p_hc->is_fs_szd +
-                    p_hc->is_mmap_modified;
-
-                if (action_cnt == 0) {
+                defer(
+                    FreeStreamStats(p_hc);
+                    ReleaseProcessInfo(p_hc->process);
+                    p_hc->process = nullptr;
+                    ReleasePathInfo(p_hc->path);
+                    p_hc->path = nullptr;
+                    ReleasePathInfo(p_hc->new_path);
+                    p_hc->new_path = nullptr;
+                );
+
+                LONG flags = p_hc->flags;
+                // Opening, creating or mapping a file is not an action by itself.
+                LONG actions = flags & ~(evt::kFlagCreated | evt::kFlagMmapOpen);
+                if (actions == 0) {
                     return;
                 }
                 LogFileEvent(p_hc);
 
-                if (p_hc->is_deleted == true 
-                    || (action_cnt == 1 && p_hc->is_read == true)) {
+                if ((flags & evt::kFlagDeleted) != 0
+                    || actions == evt::kFlagRead) {
                     return;
                 }
-                
-                std::WString path;
 
-                if (p_hc->is_renamed == true) {
-                    path = p_hc->new_path;
-                }
-                else {
-                    path = p_hc->path;
-                }
-                if (path.HasCiPrefix(L"\\device\\harddiskvolume3\\windows\\") == true
-                    || path.HasCiPrefix(L"\\device\\harddiskvolume3\\program files\\") == true
-                    || path.HasCiPrefix(L"\\device\\harddiskvolume3\\program files (x86)\\") == true
-                    || path.HasCiPrefix(L"\\device\\harddiskvolume3\\users\\hieu\\appdata\\") == true
-                    || path.HasCiPrefix(L"\\device\\harddiskvolume3\\programdata\\") == true
-                    ) {
+                bool is_renamed = (flags & evt::kFlagRenamed) != 0;
+                std::WStringView path = PathInfoText(is_renamed == true ? p_hc->new_path : p_hc->path);
+                if (IsUnreportedFile(path)) {
                     return;
                 }
-                //DebugMessage("Send %ws", tmp_path.Data());
-                com::kComPort->Send(path.Data(), (path.Size() + 1) * sizeof(WCHAR));
+                // Dropped when the service is not attached or is behind.
+                bool urgent = is_renamed == true && IsExtensionChanged(PathInfoText(p_hc->path), path);
+                com::EventChannel::WritePathEvent(p_hc->requestor_pid, path.Data(), (ULONG)path.Size(), urgent);
             }
         }
         return;
@@ -0,0 +1,129 @@
+#include "filter_rules.h"
+#include "process_cache.h"
+#include "../com/shared_ring.h"
+#include "../std/algo/rule_set.h"
+#include "../std/sync/ex_push_lock.h"
+#include "../template/common.h"
+#include "../template/debug.h"
+
+namespace collector
+{
+    // Replaced as a whole: a new set is compiled unlocked and swapped in
+    // under the exclusive lock; lookups hold it shared. None until the
+    // service sends its own: by default every open is logged.
+    static PushLock g_FilterRulesLock;
+    static RuleSet* g_FilterRules = nullptr;
+
+    // System and application directories: changes under them are logged but
+    // not reported to the service. Built once by InitFilterRules and only
+    // read after that, so it takes no lock.
+    static RuleSet* g_UnreportedPaths = nullptr;
+    static const WCHAR* kUnreportedPrefixes[] = {
+        L"\\device\\harddiskvolume3\\windows\\",
+        L"\\device\\harddiskvolume3\\program files\\",
+        L"\\device\\harddiskvolume3\\program files (x86)\\",
+        L"\\device\\harddiskvolume3\\users\\hieu\\appdata\\",
+        L"\\device\\harddiskvolume3\\programdata\\",
+    };
+
+    static void PublishFilterRules(RuleSet* rules)
+    {
+        RuleSet* old = nullptr;
+        {
+            PushLock::AutoExclusive lock(g_FilterRulesLock);
+            old = g_FilterRules;
+            g_FilterRules = rules;
+        }
+        delete old;
+    }
+
+    void InitFilterRules()
+    {
+        g_FilterRulesLock.Create();
+
+        RuleSet* rules = new (krnl_std::nothrow) RuleSet();
+        if (rules == nullptr) {
+            return;
+        }
+        for (auto prefix : kUnreportedPrefixes) {
+            rules->Add(RuleSet::kPathPrefix, prefix);
+        }
+        if (rules->Compile() == false) {
+            DebugMessage("Fail to compile the unreported prefixes, every change will be reported");
+            delete rules;
+            return;
+        }
+        g_UnreportedPaths = rules;
+    }
+
+    void UninitFilterRules()
+    {
+        PublishFilterRules(nullptr);
+        delete g_UnreportedPaths;
+        g_UnreportedPaths = nullptr;
+    }
+
+    NTSTATUS SetFilterRules(const void* rules, ULONG bytes)
+    {
+        RuleSet* set = new (krnl_std::nothrow) RuleSet();
+        if (set == nullptr) {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+        bool parsed = shm::ForEachFilterRule(rules, bytes, [&](const shm::FilterRule& rule) {
+            std::WStringView text((const WCHAR*)(&rule + 1), rule.chars);
+            return set->Add((RuleSet::Kind)rule.kind, text);
+        });
+        if (parsed == false) {
+            delete set;
+            return STATUS_INVALID_PARAMETER;
+        }
+        if (set->Compile() == false) {
+            delete set;
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+        DebugMessage("Filter rules: %llu rules, %llu bytes", set->Size(), set->Bytes());
+        PublishFilterRules(set);
+        return STATUS_SUCCESS;
+    }
+
+    bool IsExcludedProcess(HANDLE pid)
+    {
+        {
+            PushLock::AutoShared lock(g_FilterRulesLock);
+            if (g_FilterRules == nullptr || g_FilterRules->HasImages() == false) {
+                return false;
+            }
+        }
+        ProcessInfo* info = ReferenceProcessInfo(pid);
+        if (info == nullptr) {
+            return false;
+        }
+        bool excluded = false;
+        {
+            PushLock::AutoShared lock(g_FilterRulesLock);
+            excluded = g_FilterRules != nullptr && g_FilterRules->MatchImage(info->image_name, info->image_key);
+        }
+        ReleaseProcessInfo(info);
+        return excluded;
+    }
+
+    bool HasFileRules()
+    {
+        PushLock::AutoShared lock(g_FilterRulesLock);
+        return g_FilterRules != nullptr && g_FilterRules->HasPaths();
+    }
+
+    bool IsExcludedFile(const std::WStringView& path)
+    {
+        PushLock::AutoShared lock(g_FilterRulesLock);
+        return g_FilterRules != nullptr && g_FilterRules->MatchPath(path);
+    }
+
+    bool IsUnreportedFile(const std::WStringView& path)
+    {
+        if (g_UnreportedPaths != nullptr && g_UnreportedPaths->MatchPath(path)) {
+            return true;
+        }
+        return IsExcludedFile(path);
+    }
+}
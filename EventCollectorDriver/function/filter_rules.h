@@ -0,0 +1,33 @@
+#pragma once
+
+#include <fltKernel.h>
+#include "../std/string/wstring.h"
+
+// The collector's exclusion rules (std/algo/rule_set.h): opens by excluded
+// processes, and of excluded files, are skipped in PreFileCreate before the
+// name is normalized and never get a handle context. There are none until
+// the service sends them over the comport (shm::kChannelSetRules).
+//
+// Separately, changes under the built-in system and application prefixes
+// (\Windows\, Program Files, AppData, ProgramData) are logged like any
+// other but not reported to the service.
+
+namespace collector
+{
+    void InitFilterRules();
+    void UninitFilterRules();
+
+    // A kChannelSetRules payload, already copied out of the caller's buffer.
+    // The new set takes effect only if every rule parses and it compiles.
+    NTSTATUS SetFilterRules(const void* rules, ULONG bytes);
+
+    // Looks the process up only when there are process rules.
+    bool IsExcludedProcess(HANDLE pid);
+    // Whether IsExcludedFile can match anything, so callers can skip the
+    // name query when it cannot.
+    bool HasFileRules();
+    bool IsExcludedFile(const std::WStringView& path);
+    // Logged, but not sent to the service: under a built-in prefix, or
+    // excluded (a rename can move a file under an excluded prefix).
+    bool IsUnreportedFile(const std::WStringView& path);
+}
@@ -0,0 +1,74 @@
+#include "path_cache.h"
+#include "../std/algo/hash.h"
+#include "../std/sync/ex_push_lock.h"
+#include "../template/common.h"
+#include "../template/debug.h"
+
+namespace collector
+{
+    static PushLock kPathCacheLock;
+    static krnl_std::PathTable kPathCache;
+
+    void InitPathCache()
+    {
+        kPathCacheLock.Create();
+        krnl_std::InitPathTable(kPathCache);
+    }
+
+    void UninitPathCache()
+    {
+        // Every handle context has been cleaned up by now (FltUnregisterFilter
+        // runs before DrvUnload), and each one released its paths.
+        if (kPathCache.count != 0) {
+            DebugMessage("%llu interned paths still referenced", kPathCache.count);
+        }
+    }
+
+    PathInfo* InternPath(const std::WStringView& path)
+    {
+        if (path.Size() == 0) {
+            return nullptr;
+        }
+        ull key = HashWstring(path);
+        {
+            PushLock::AutoShared lock(kPathCacheLock);
+            PathInfo* info = krnl_std::FindPathEntry(kPathCache, key, path);
+            if (info != nullptr) {
+                return info;
+            }
+        }
+
+        PathInfo* info = (PathInfo*)krnl_std::Alloc(krnl_std::PathEntryBytes(path.Size()), krnl_std::kPathTag);
+        if (info == nullptr) {
+            return nullptr;
+        }
+        krnl_std::InitPathEntry(info, key, path);
+
+        PathInfo* existing = nullptr;
+        {
+            PushLock::AutoExclusive lock(kPathCacheLock);
+            existing = krnl_std::InsertPathEntry(kPathCache, info);
+        }
+        if (existing != nullptr) {
+            // Another open filled the same miss first.
+            krnl_std::Free(info);
+            return existing;
+        }
+        return info;
+    }
+
+    void ReleasePathInfo(PathInfo* info)
+    {
+        if (info == nullptr || krnl_std::DereferencePathEntryShared(info) == true) {
+            return;
+        }
+        bool is_last = false;
+        {
+            PushLock::AutoExclusive lock(kPathCacheLock);
+            is_last = krnl_std::DereferencePathEntryLocked(kPathCache, info);
+        }
+        if (is_last == true) {
+            krnl_std::Free(info);
+        }
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <fltKernel.h>
+#include "../std/string/wstring.h"
+#include "../std/map/path_table.h"
+
+// Interned file paths for handle contexts. Many handles name the same file,
+// so a context holds a reference to the one shared entry instead of its own
+// copy, and the entry's key is the path's key in the event log.
+
+namespace collector
+{
+    typedef krnl_std::PathEntry PathInfo;
+
+    void InitPathCache();
+    void UninitPathCache();
+
+    // Referenced entry for path, added on a miss. nullptr for an empty path
+    // or when the entry cannot be allocated; release it with ReleasePathInfo.
+    PathInfo* InternPath(const std::WStringView& path);
+    void ReleasePathInfo(PathInfo* info);
+
+    // Empty for nullptr.
+    inline std::WStringView PathInfoText(const PathInfo* info)
+    {
+        return info != nullptr ? krnl_std::PathText(info) : std::WStringView();
+    }
+}
@@ -0,0 +1,139 @@
+#include "process_cache.h"
+#include "../std/algo/rule_set.h"
+#include "../std/sync/ex_push_lock.h"
+#include "../template/common.h"
+#include "../template/debug.h"
+
+extern "C" NTKERNELAPI NTSTATUS PsGetProcessExitStatus(_In_ PEPROCESS Process);
+
+namespace collector
+{
+    static PushLock kProcessCacheLock;
+    static krnl_std::PidTable kProcessCache;
+
+    static ProcessInfo* NewProcessInfo(HANDLE pid)
+    {
+        std::WString image_name = GetProcessImageName(pid);
+        if (image_name.Size() == 0) {
+            return nullptr;
+        }
+        ProcessInfo* info = new (krnl_std::nothrow) ProcessInfo();
+        if (info == nullptr) {
+            return nullptr;
+        }
+        krnl_std::InitPidEntry(info->entry, (ull)pid);
+        info->image_name = Move(image_name);
+        info->image_key = RuleSet::Key(info->image_name);
+        return info;
+    }
+
+    void InitProcessCache()
+    {
+        kProcessCacheLock.Create();
+        krnl_std::InitPidTable(kProcessCache);
+    }
+
+    void UninitProcessCache()
+    {
+        // Handle contexts still holding references are gone by now
+        // (FltUnregisterFilter runs before DrvUnload).
+        for (;;) {
+            krnl_std::PidEntry* e = nullptr;
+            {
+                PushLock::AutoExclusive lock(kProcessCacheLock);
+                e = krnl_std::PopPidEntry(kProcessCache);
+            }
+            if (e == nullptr) {
+                break;
+            }
+            ReleaseProcessInfo((ProcessInfo*)e);
+        }
+    }
+
+    ProcessInfo* AddProcessInfo(HANDLE pid)
+    {
+        ProcessInfo* info = NewProcessInfo(pid);
+        if (info == nullptr) {
+            return nullptr;
+        }
+        krnl_std::ReferencePidEntry(&info->entry);
+
+        krnl_std::PidEntry* stale = nullptr;
+        {
+            PushLock::AutoExclusive lock(kProcessCacheLock);
+            // A reused pid can still have an entry added by a late open of
+            // the previous process.
+            stale = krnl_std::RemovePidEntry(kProcessCache, (ull)pid);
+            krnl_std::InsertPidEntry(kProcessCache, &info->entry);
+        }
+        if (stale != nullptr) {
+            ReleaseProcessInfo((ProcessInfo*)stale);
+        }
+        return info;
+    }
+
+    void RemoveProcessInfo(HANDLE pid)
+    {
+        krnl_std::PidEntry* e = nullptr;
+        {
+            PushLock::AutoExclusive lock(kProcessCacheLock);
+            e = krnl_std::RemovePidEntry(kProcessCache, (ull)pid);
+        }
+        if (e != nullptr) {
+            ReleaseProcessInfo((ProcessInfo*)e);
+        }
+    }
+
+    ProcessInfo* ReferenceProcessInfo(HANDLE pid)
+    {
+        {
+            PushLock::AutoShared lock(kProcessCacheLock);
+            krnl_std::PidEntry* e = krnl_std::FindPidEntry(kProcessCache, (ull)pid);
+            if (e != nullptr) {
+                return (ProcessInfo*)e;
+            }
+        }
+
+        PEPROCESS process = nullptr;
+        if (!NT_SUCCESS(PsLookupProcessByProcessId(pid, &process))) {
+            return nullptr;
+        }
+        defer(ObDereferenceObject(process););
+
+        ProcessInfo* info = NewProcessInfo(pid);
+        if (info == nullptr) {
+            return nullptr;
+        }
+
+        krnl_std::PidEntry* existing = nullptr;
+        bool exited = false;
+        {
+            PushLock::AutoExclusive lock(kProcessCacheLock);
+            // The exit status is set before the exit notification, whose
+            // RemoveProcessInfo waits for this lock. Once it is set, nothing
+            // would ever remove the entry, so hand it out uncached.
+            exited = PsGetProcessExitStatus(process) != STATUS_PENDING;
+            if (exited == false) {
+                krnl_std::ReferencePidEntry(&info->entry);
+                existing = krnl_std::InsertPidEntry(kProcessCache, &info->entry);
+            }
+        }
+        if (exited == true) {
+            // The table's reference becomes the caller's.
+            return info;
+        }
+        if (existing != nullptr) {
+            // Another open filled the same miss first.
+            delete info;
+            return (ProcessInfo*)existing;
+        }
+        return info;
+    }
+
+    void ReleaseProcessInfo(ProcessInfo* info)
+    {
+        if (info != nullptr && krnl_std::DereferencePidEntry(&info->entry) == true) {
+            delete info;
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <fltKernel.h>
+#include "../std/string/wstring.h"
+#include "../std/map/pid_table.h"
+
+// Image names of live processes, filled at process creation so opens do not
+// each query (and copy) the name. Handle contexts hold a reference to the
+// entry instead of their own copy.
+
+namespace collector
+{
+    struct ProcessInfo
+    {
+        krnl_std::PidEntry entry;   // first: the table links through it
+        std::WString image_name;
+        ull image_key;              // RuleSet::Key(image_name)
+    };
+
+    void InitProcessCache();
+    void UninitProcessCache();
+
+    // Process notify callback. Returns a referenced entry (nullptr if the
+    // name could not be read); release it with ReleaseProcessInfo.
+    ProcessInfo* AddProcessInfo(HANDLE pid);
+    void RemoveProcessInfo(HANDLE pid);
+
+    // Referenced entry for pid. Processes that were already running when
+    // the driver loaded are looked up once and added. A process that has
+    // already started to exit gets an entry that is not cached. nullptr if
+    // the process is gone.
+    ProcessInfo* ReferenceProcessInfo(HANDLE pid);
+    void ReleaseProcessInfo(ProcessInfo* info);
+}
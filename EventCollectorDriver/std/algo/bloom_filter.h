@@ -0,0 +1,59 @@
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+// Fixed 4096-bit Bloom filter over 64-bit keys, in front of a set that is
+// slower to search (RuleSet's tries): "no" is certain, "maybe" goes on to the
+// real lookup. Three bits per key, taken from one MixHash of it; with 200
+// keys about 1 lookup in 400 that should be rejected gets through.
+//
+// Filled before it is published and read-only afterwards, so lookups need
+// no lock and no atomics. No kernel dependencies.
+
+#include "hash.h"
+
+namespace krnl_std
+{
+    constexpr unsigned int kBloomBits = 4096;
+    constexpr unsigned int kBloomHashes = 3;
+
+    struct BloomFilter
+    {
+        unsigned long long word[kBloomBits / 64];
+    };
+
+    inline void InitBloom(BloomFilter& b)
+    {
+        for (unsigned int i = 0; i < kBloomBits / 64; i++) {
+            b.word[i] = 0;
+        }
+    }
+
+    // Bit i of key: 12 bits of the mixed key each.
+    inline unsigned int BloomBit(unsigned long long mixed, unsigned int i)
+    {
+        return (unsigned int)(mixed >> (i * 12)) & (kBloomBits - 1);
+    }
+
+    inline void AddBloom(BloomFilter& b, unsigned long long key)
+    {
+        unsigned long long mixed = MixHash(key);
+        for (unsigned int i = 0; i < kBloomHashes; i++) {
+            unsigned int bit = BloomBit(mixed, i);
+            b.word[bit / 64] |= 1ULL << (bit % 64);
+        }
+    }
+
+    inline bool MayContainBloom(const BloomFilter& b, unsigned long long key)
+    {
+        unsigned long long mixed = MixHash(key);
+        for (unsigned int i = 0; i < kBloomHashes; i++) {
+            unsigned int bit = BloomBit(mixed, i);
+            if ((b.word[bit / 64] & (1ULL << (bit % 64))) == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef ENTROPY_SAMPLING_H
+#define ENTROPY_SAMPLING_H
+
+// Entropy of large buffers estimated from a bounded number of blocks.
+// Portable like histogram.h / entropy.h (see bench/entropy_sampling_eval.cpp).
+
+#include "entropy.h"
+#include "histogram.h"
+
+namespace math
+{
+    struct EntropySampling
+    {
+        // Buffers up to this size are counted in full.
+        unsigned long long min_bytes;
+        // Size of each sampled block.
+        unsigned int block_bytes;
+        // Number of blocks sampled from a larger buffer.
+        unsigned int max_blocks;
+    };
+
+    struct EntropyEstimate
+    {
+        double entropy;                     // bits per byte, [0, 8]
+        // Standard error of the estimate, from the spread of the per-block
+        // entropies. 0 when every byte was counted.
+        double std_error;
+        unsigned long long sampled_bytes;   // bytes actually histogrammed
+    };
+
+    template <typename Count>
+    struct EntropySamplingScratch
+    {
+        ByteHistogramScratch<Count> count;
+        Count pooled[kByteHistogramBins];
+    };
+    typedef EntropySamplingScratch<unsigned int> EntropySamplingScratch32;
+
+    inline bool IsFullCount(unsigned long long len, const EntropySampling& cfg)
+    {
+        unsigned long long block = cfg.block_bytes;
+        unsigned long long blocks = cfg.max_blocks;
+        return len <= cfg.min_bytes || block == 0 || blocks < 2 || block * blocks >= len;
+    }
+
+    // Start of the k-th sampled block. stripe >= block_bytes whenever
+    // IsFullCount() is false, so slack never underflows.
+    inline unsigned long long SampleBlockOffset(
+        unsigned long long k,
+        unsigned long long len,
+        const EntropySampling& cfg,
+        unsigned long long* seed)
+    {
+        unsigned long long stripe = len / cfg.max_blocks;
+        unsigned long long slack = stripe - cfg.block_bytes;
+        unsigned long long offset = k * stripe;
+        if (*seed != 0 && slack != 0) {
+            // xorshift64 step per block
+            *seed ^= *seed << 13;
+            *seed ^= *seed >> 7;
+            *seed ^= *seed << 17;
+            offset += *seed % (slack + 1);
+        }
+        return offset;
+    }
+
+    // Histogram of buf with the same block selection as EstimateByteEntropy,
+    // without the per-block entropies or the bias correction; pass *counted
+    // to AddToByteStreamStats, which corrects for it. *counted receives the
+    // number of bytes behind the returned table (len when nothing was skipped).
+    template <typename Count>
+    inline const Count* SampleByteHistogram(
+        const unsigned char* buf,
+        unsigned long long len,
+        const EntropySampling& cfg,
+        unsigned long long seed,
+        EntropySamplingScratch<Count>& scratch,
+        unsigned long long* counted)
+    {
+        if (IsFullCount(len, cfg)) {
+            *counted = len;
+            return CountByteHistogram(buf, len, scratch.count);
+        }
+
+        for (int b = 0; b < kByteHistogramBins; b++) {
+            scratch.pooled[b] = 0;
+        }
+        for (unsigned long long k = 0; k < cfg.max_blocks; k++) {
+            unsigned long long offset = SampleBlockOffset(k, len, cfg, &seed);
+            const Count* freq = CountByteHistogram(buf + offset, cfg.block_bytes, scratch.count);
+            for (int b = 0; b < kByteHistogramBins; b++) {
+                scratch.pooled[b] += freq[b];
+            }
+        }
+        *counted = (unsigned long long)cfg.block_bytes * cfg.max_blocks;
+        return scratch.pooled;
+    }
+
+    // Counts every byte when len <= cfg.min_bytes, otherwise cfg.max_blocks
+    // blocks of cfg.block_bytes, one from each equal stripe of the buffer.
+    // Inside its stripe a block starts at an offset derived from seed, so a
+    // writer cannot predict which bytes are looked at, as long as seed comes
+    // from a secret source. seed == 0 takes the start of every stripe.
+    //
+    // The entropy comes from the pooled histogram of all blocks. The per-block
+    // entropies only feed std_error.
+    template <typename Count>
+    inline EntropyEstimate EstimateByteEntropy(
+        const unsigned char* buf,
+        unsigned long long len,
+        const EntropySampling& cfg,
+        unsigned long long seed,
+        EntropySamplingScratch<Count>& scratch)
+    {
+        EntropyEstimate est = { 0.0, 0.0, 0 };
+        if (len == 0) {
+            return est;
+        }
+
+        unsigned long long block = cfg.block_bytes;
+        unsigned long long blocks = cfg.max_blocks;
+        if (IsFullCount(len, cfg)) {
+            const Count* freq = CountByteHistogram(buf, len, scratch.count);
+            est.entropy = ComputeByteEntropyFromFreq(freq, (long long)len);
+            est.sampled_bytes = len;
+            return est;
+        }
+
+        for (int b = 0; b < kByteHistogramBins; b++) {
+            scratch.pooled[b] = 0;
+        }
+
+        double sum = 0.0;
+        double sum_sq = 0.0;
+        for (unsigned long long k = 0; k < blocks; k++) {
+            unsigned long long offset = SampleBlockOffset(k, len, cfg, &seed);
+            const Count* freq = CountByteHistogram(buf + offset, block, scratch.count);
+            double e = ComputeByteEntropyFromFreq(freq, (long long)block);
+            sum += e;
+            sum_sq += e * e;
+            for (int b = 0; b < kByteHistogramBins; b++) {
+                scratch.pooled[b] += freq[b];
+            }
+        }
+
+        est.sampled_bytes = block * blocks;
+        est.entropy = ComputeByteEntropyFromFreq(scratch.pooled, (long long)est.sampled_bytes);
+
+        // Shift the estimate to what counting all len bytes would have
+        // reported, so sampled and unsampled values stay comparable.
+        int used = 0;
+        for (int b = 0; b < kByteHistogramBins; b++) {
+            used += scratch.pooled[b] != 0;
+        }
+        est.entropy += SampledEntropyBias(used, 1.0 / (double)est.sampled_bytes - 1.0 / (double)len);
+        if (est.entropy > 8.0) {
+            est.entropy = 8.0;
+        }
+
+        double n = (double)blocks;
+        double mean = sum / n;
+        double variance = (sum_sq - n * mean * mean) / (n - 1.0);
+        // Finite population correction: sampling most of the buffer leaves
+        // little uncertainty.
+        double fpc = 1.0 - (double)est.sampled_bytes / (double)len;
+        est.std_error = Sqrt(variance * fpc / n);
+        return est;
+    }
+}
+
+#endif
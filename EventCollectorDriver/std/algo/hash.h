@@ -3,24 +3,64 @@
 
 #include "../string/wstring.h"
 
-inline unsigned long long HashWstring(const std::WString& str)
+inline unsigned long long HashWstring(const std::WStringView& str)
 {
     unsigned long long hash = 5381; // Magic number 5381 is used in DJB2 hash function
-    for (int i = 0; i < str.Size(); i++) {
+    for (size_t i = 0; i < str.Size(); i++) {
         WCHAR c = str[i];
         hash = ((hash << 5) + hash) + static_cast<unsigned long long>(c); // hash * 33 + c
     }
     return hash;
 }
 
+// HashWstring after std::FoldCase, so names that compare equal with the *Ci
+// comparisons hash equal.
+inline unsigned long long HashWstringCi(const std::WStringView& str)
+{
+    unsigned long long hash = 5381;
+    for (size_t i = 0; i < str.Size(); i++) {
+        hash = ((hash << 5) + hash) + static_cast<unsigned long long>(std::FoldCase(str[i]));
+    }
+    return hash;
+}
+
 inline unsigned long long HashString(const std::WString& str)
 {
     unsigned long long hash = 5381; // Magic number 5381 is used in DJB2 hash function
-    for (int i = 0; i < str.Size(); i++) {
+    for (size_t i = 0; i < str.Size(); i++) {
         WCHAR c = str[i];
         hash = ((hash << 5) + hash) + static_cast<unsigned long long>(c); // hash * 33 + c
     }
     return hash;
 }
 
+// MurmurHash3's 64-bit finalizer: spreads keys that differ in a few bits
+// (pids are multiples of 4, pointers are aligned) over the low bits that
+// HashMap and HashSet index with.
+inline unsigned long long MixHash(unsigned long long h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Default hasher of HashMap / HashSet: integers, pointers and HANDLEs by
+// value, WStrings by content.
+template <typename Key>
+struct Hash {
+    inline unsigned long long operator()(const Key& key) const {
+        return MixHash((unsigned long long)key);
+    }
+};
+
+template <>
+struct Hash<std::WString> {
+    inline unsigned long long operator()(const std::WString& key) const {
+        return MixHash(HashWstring(key));
+    }
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,115 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+// Byte histogram used for the read/write entropy in the collector.
+// No kernel or CRT dependencies, so the same code also builds in user mode
+// (see bench/histogram_bench.cpp).
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <emmintrin.h>
+#define HISTOGRAM_SSE2
+#endif
+
+namespace math
+{
+    constexpr int kByteHistogramBins = 256;
+
+    // A single IRP is at most 4 GB (Length is a ULONG), so 32-bit counters never
+    // overflow there and the table is 1 KB instead of 2 KB.
+    typedef unsigned int ByteHistogram32[kByteHistogramBins];
+
+    // For totals that can pass 4 GB (several buffers accumulated together).
+    typedef long long ByteHistogram64[kByteHistogramBins];
+
+    // Adds the byte counts of buf[0, len) to freq.
+    // freq is not cleared, so several buffers can be accumulated into one table.
+    template <typename Count>
+    inline void AccumulateByteHistogram(const unsigned char* buf, unsigned long long len, Count* freq)
+    {
+        for (unsigned long long i = 0; i < len; i++) {
+            ++freq[buf[i]];
+        }
+    }
+
+    // Scratch for CountByteHistogram: four private tables, so that runs of the
+    // same byte increment different counters and do not wait on each other's
+    // store-to-load forwarding.
+    template <typename Count>
+    struct ByteHistogramScratch
+    {
+        Count lanes[4][kByteHistogramBins];
+    };
+    typedef ByteHistogramScratch<unsigned int> ByteHistogramScratch32;
+
+    // Below this the cost of clearing and folding four tables outweighs the gain.
+    constexpr unsigned long long kSplitHistogramMinBytes = 1024;
+
+    // Counts buf[0, len) and returns the 256-bin table, which lives in
+    // scratch.lanes[0]. scratch does not need to be cleared beforehand.
+    template <typename Count>
+    inline const Count* CountByteHistogram(const unsigned char* buf, unsigned long long len, ByteHistogramScratch<Count>& scratch)
+    {
+        Count* l0 = scratch.lanes[0];
+        Count* l1 = scratch.lanes[1];
+        Count* l2 = scratch.lanes[2];
+        Count* l3 = scratch.lanes[3];
+
+        if (len < kSplitHistogramMinBytes) {
+            for (int b = 0; b < kByteHistogramBins; b++) {
+                l0[b] = 0;
+            }
+            AccumulateByteHistogram(buf, len, l0);
+            return l0;
+        }
+
+        for (int b = 0; b < kByteHistogramBins; b++) {
+            l0[b] = 0;
+            l1[b] = 0;
+            l2[b] = 0;
+            l3[b] = 0;
+        }
+
+        unsigned long long i = 0;
+#ifdef HISTOGRAM_SSE2
+        // One 16-byte load, then the bytes are peeled off two 64-bit halves in
+        // registers instead of being loaded one at a time.
+        for (; i + 16 <= len; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + i));
+            unsigned long long lo = (unsigned long long)_mm_cvtsi128_si64(v);
+            unsigned long long hi = (unsigned long long)_mm_cvtsi128_si64(_mm_unpackhi_epi64(v, v));
+            ++l0[lo & 0xFF];
+            ++l1[(lo >> 8) & 0xFF];
+            ++l2[(lo >> 16) & 0xFF];
+            ++l3[(lo >> 24) & 0xFF];
+            ++l0[(lo >> 32) & 0xFF];
+            ++l1[(lo >> 40) & 0xFF];
+            ++l2[(lo >> 48) & 0xFF];
+            ++l3[lo >> 56];
+            ++l0[hi & 0xFF];
+            ++l1[(hi >> 8) & 0xFF];
+            ++l2[(hi >> 16) & 0xFF];
+            ++l3[(hi >> 24) & 0xFF];
+            ++l0[(hi >> 32) & 0xFF];
+            ++l1[(hi >> 40) & 0xFF];
+            ++l2[(hi >> 48) & 0xFF];
+            ++l3[hi >> 56];
+        }
+#endif
+        for (; i + 4 <= len; i += 4) {
+            ++l0[buf[i]];
+            ++l1[buf[i + 1]];
+            ++l2[buf[i + 2]];
+            ++l3[buf[i + 3]];
+        }
+        for (; i < len; i++) {
+            ++l0[buf[i]];
+        }
+
+        for (int b = 0; b < kByteHistogramBins; b++) {
+            l0[b] += l1[b] + l2[b] + l3[b];
+        }
+        return l0;
+    }
+}
+
+#endif
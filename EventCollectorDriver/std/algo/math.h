@@ -49,6 +49,26 @@ namespace math
         return sum;
     }
 
+    // Newton iteration seeded from the exponent; no CRT sqrt in the kernel.
+    inline double Sqrt(double x)
+    {
+        if (x <= 0.0)
+            return 0.0;
+
+        union {
+            double d;
+            unsigned long long bits;
+        } v;
+
+        v.d = x;
+        v.bits = (v.bits >> 1) + (1023ULL << 51);   // halve the exponent
+        double r = v.d;
+        for (int i = 0; i < 6; ++i) {
+            r = 0.5 * (r + x / r);
+        }
+        return r;
+    }
+
     double Log2(double x)
     {
         if (x <= 0.0)
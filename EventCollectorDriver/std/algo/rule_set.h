@@ -0,0 +1,130 @@
+#ifndef RULE_SET_H_
+#define RULE_SET_H_
+
+// The collector's exclusion rules, compiled for checking every open:
+//   path prefix     "\device\harddiskvolume3\windows\": every file below it
+//   extension       ".tmp" (or "tmp"): files whose last component ends so
+//   process image   a full NT image path: every open by a process running it
+// Prefixes are one PathTrie. Extensions and images are exact names, each in
+// a PathTrie behind a BloomFilter of their HashWstringCi keys, so most
+// lookups stop at the filter without touching the trie. A process's key is
+// computed once, when it is cached (function/process_cache.h), not per open.
+//
+// Same life cycle as PathTrie: Add, Compile, then read-only for any number
+// of threads. Case-insensitive throughout, and allocation failures are
+// reported, not retried.
+
+#include "path_trie.h"
+#include "bloom_filter.h"
+
+class RuleSet {
+public:
+    enum Kind : unsigned short {
+        kPathPrefix = 1,
+        kExtension = 2,
+        kProcessImage = 3,
+    };
+
+    RuleSet();
+
+    RuleSet(const RuleSet&) = delete;
+    RuleSet& operator=(const RuleSet&) = delete;
+
+    // false for an unknown kind or empty text, after Compile, or when out
+    // of memory.
+    bool Add(Kind kind, std::WStringView text);
+
+    bool Compile();
+
+    bool Compiled() const { return prefixes_.Compiled() && extensions_.Compiled() && images_.Compiled(); }
+    ull Size() const { return prefixes_.Size() + extensions_.Size() + images_.Size(); }
+    bool HasImages() const { return images_.Size() != 0; }
+    bool HasPaths() const { return prefixes_.Size() + extensions_.Size() != 0; }
+    // Bytes held by the compiled tries and filters.
+    ull Bytes() const { return sizeof(*this) + prefixes_.Bytes() + extensions_.Bytes() + images_.Bytes(); }
+
+    // What MatchImage takes with the name.
+    static ull Key(std::WStringView name) { return HashWstringCi(name); }
+
+    // ".ext" of the last path component, empty if it has no '.'.
+    static std::WStringView Extension(std::WStringView path);
+
+    // Under an excluded prefix, or with an excluded extension.
+    bool MatchPath(std::WStringView path) const;
+
+    // key is Key(image).
+    bool MatchImage(std::WStringView image, ull key) const;
+
+private:
+    PathTrie prefixes_;
+    PathTrie extensions_;
+    PathTrie images_;
+    krnl_std::BloomFilter extension_bloom_;
+    krnl_std::BloomFilter image_bloom_;
+};
+
+inline RuleSet::RuleSet() {
+    krnl_std::InitBloom(extension_bloom_);
+    krnl_std::InitBloom(image_bloom_);
+}
+
+inline bool RuleSet::Add(Kind kind, std::WStringView text) {
+    if (text.Empty()) {
+        return false;
+    }
+    switch (kind) {
+    case kPathPrefix:
+        return prefixes_.AddPrefix(text);
+    case kExtension: {
+        std::WString ext;
+        if (text[0] != L'.') {
+            ext.PushBack(L'.');
+        }
+        ext.Append(text);
+        if (extensions_.AddPath(ext)) {
+            krnl_std::AddBloom(extension_bloom_, Key(ext));
+            return true;
+        }
+        return false;
+    }
+    case kProcessImage:
+        if (images_.AddPath(text)) {
+            krnl_std::AddBloom(image_bloom_, Key(text));
+            return true;
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+inline bool RuleSet::Compile() {
+    return prefixes_.Compile() && extensions_.Compile() && images_.Compile();
+}
+
+inline std::WStringView RuleSet::Extension(std::WStringView path) {
+    for (size_t i = path.Size(); i > 0; i--) {
+        WCHAR c = path[i - 1];
+        if (c == L'.') {
+            return path.Substr(i - 1);
+        }
+        if (c == L'\\') {
+            break;
+        }
+    }
+    return std::WStringView();
+}
+
+inline bool RuleSet::MatchPath(std::WStringView path) const {
+    std::WStringView ext = Extension(path);
+    if (!ext.Empty() && krnl_std::MayContainBloom(extension_bloom_, Key(ext)) && extensions_.Match(ext)) {
+        return true;
+    }
+    return prefixes_.Match(path);
+}
+
+inline bool RuleSet::MatchImage(std::WStringView image, ull key) const {
+    return krnl_std::MayContainBloom(image_bloom_, key) && images_.Match(image);
+}
+
+#endif // RULE_SET_H_
@@ -0,0 +1,171 @@
+#ifndef STREAM_ENTROPY_H
+#define STREAM_ENTROPY_H
+
+// Byte histograms accumulated over the life of a handle, so the entropy at
+// cleanup is weighted by bytes rather than by calls. Portable like the other
+// std/algo headers (see bench/stream_entropy_bench.cpp).
+
+#include "entropy.h"
+#include "histogram.h"
+
+namespace math
+{
+    // Head covers the first IOs through the handle until at least this many
+    // bytes; tail covers the most recent one to two windows.
+    constexpr unsigned int kStreamWindowBytes = 64 * 1024;
+
+    // 32-bit bins keep the whole struct at about one page of non-paged pool.
+    // When the stream passes 4 GB the whole-stream bins are halved, which
+    // keeps the distribution (and so the entropy) while freeing headroom.
+    struct ByteStreamStats
+    {
+        unsigned int whole[kByteHistogramBins];
+        unsigned int head[kByteHistogramBins];
+        unsigned int tail[2][kByteHistogramBins];
+        unsigned long long whole_total;
+        unsigned int head_total;
+        unsigned int tail_total[2];
+        unsigned int tail_cur;
+        // Sum over the IOs in each histogram of a^2 * (1/counted - 1/len), a
+        // the counts the IO added. Divided by total^2 it is how much the
+        // sampled IOs raise 1/n over counting every byte, which sets the
+        // Miller-Madow correction at cleanup. 0 when nothing was sampled.
+        double whole_excess;
+        double head_excess;
+        double tail_excess[2];
+    };
+
+    struct ByteStreamEntropy
+    {
+        double whole;
+        double head;
+        double tail;
+    };
+
+    inline void ResetByteStreamStats(ByteStreamStats& s)
+    {
+        unsigned char* p = reinterpret_cast<unsigned char*>(&s);
+        for (unsigned long long i = 0; i < sizeof(s); i++) {
+            p[i] = 0;
+        }
+    }
+
+    // Adds one IO. freq holds the counts of `counted` bytes out of the `len`
+    // bytes transferred; when the IO was sampled the counts are scaled up so
+    // every byte carries the same weight.
+    template <typename Count>
+    inline void AddToByteStreamStats(ByteStreamStats& s, const Count* freq, unsigned long long counted, unsigned long long len)
+    {
+        if (counted == 0 || len == 0) {
+            return;
+        }
+
+        // Very large single IOs are added at half weight or less so one call
+        // can never overflow the bins on its own.
+        unsigned int shift = 0;
+        while ((len >> shift) > 0x7FFFFFFFULL) {
+            shift++;
+        }
+        unsigned long long add_total = len >> shift;
+        // Rounding the scaled counts can add up to one per bin.
+        while (s.whole_total + add_total > 0xFFFFFFFFULL - kByteHistogramBins) {
+            s.whole_total = 0;
+            for (int b = 0; b < kByteHistogramBins; b++) {
+                s.whole[b] >>= 1;
+                s.whole_total += s.whole[b];
+            }
+            s.whole_excess *= 0.25;
+        }
+
+        double scale = (double)len / (double)counted / (double)(1ULL << shift);
+        bool fill_head = s.head_total < kStreamWindowBytes;
+        unsigned int cur = s.tail_cur;
+        if (s.tail_total[cur] >= kStreamWindowBytes) {
+            cur ^= 1;
+            s.tail_cur = cur;
+            s.tail_total[cur] = 0;
+            s.tail_excess[cur] = 0.0;
+            for (int b = 0; b < kByteHistogramBins; b++) {
+                s.tail[cur][b] = 0;
+            }
+        }
+
+        unsigned long long added = 0;
+        for (int b = 0; b < kByteHistogramBins; b++) {
+            unsigned int a = scale == 1.0 ? (unsigned int)freq[b] : (unsigned int)((double)freq[b] * scale + 0.5);
+            s.whole[b] += a;
+            s.tail[cur][b] += a;
+            if (fill_head) {
+                s.head[b] += a;
+            }
+            added += a;
+        }
+
+        s.whole_total += added;
+        if (counted < len) {
+            double excess = (double)added * (double)added * (1.0 / (double)counted - 1.0 / (double)len);
+            s.whole_excess += excess;
+            s.tail_excess[cur] += excess;
+            if (fill_head) {
+                s.head_excess += excess;
+            }
+        }
+        // Head/tail only need to know when a window is full, so saturate.
+        unsigned int window_add = added > kStreamWindowBytes ? kStreamWindowBytes : (unsigned int)added;
+        if (fill_head) {
+            s.head_total += window_add;
+        }
+        s.tail_total[cur] += window_add;
+    }
+
+    // Entropy plus the sampling bias correction, kept within [0, 8].
+    inline double CorrectSampledEntropy(double entropy, int used, double excess, unsigned long long total)
+    {
+        if (excess > 0.0) {
+            entropy += SampledEntropyBias(used, excess / ((double)total * (double)total));
+        }
+        return entropy > 8.0 ? 8.0 : entropy;
+    }
+
+    // Needs InitEntropyTables().
+    inline ByteStreamEntropy ComputeByteStreamEntropy(const ByteStreamStats& s)
+    {
+        ByteStreamEntropy e = { 0.0, 0.0, 0.0 };
+        e.whole = ComputeByteEntropyFromFreq(s.whole, (long long)s.whole_total);
+
+        unsigned long long head_total = 0;
+        unsigned long long tail_total = 0;
+        double head_sum = 0.0;
+        double tail_sum = 0.0;
+        int whole_used = 0;
+        int head_used = 0;
+        int tail_used = 0;
+        for (int b = 0; b < kByteHistogramBins; b++) {
+            unsigned long long h = s.head[b];
+            unsigned long long t = (unsigned long long)s.tail[0][b] + s.tail[1][b];
+            head_total += h;
+            tail_total += t;
+            head_sum += NLog2N(h);
+            tail_sum += NLog2N(t);
+            whole_used += s.whole[b] != 0;
+            head_used += h != 0;
+            tail_used += t != 0;
+        }
+        if (s.whole_total != 0) {
+            e.whole = CorrectSampledEntropy(e.whole, whole_used, s.whole_excess, s.whole_total);
+        }
+        if (head_total != 0) {
+            e.head = FastLog2(head_total) - head_sum / (double)head_total;
+            e.head = e.head < 0.0 ? 0.0 : e.head;
+            e.head = CorrectSampledEntropy(e.head, head_used, s.head_excess, head_total);
+        }
+        if (tail_total != 0) {
+            e.tail = FastLog2(tail_total) - tail_sum / (double)tail_total;
+            e.tail = e.tail < 0.0 ? 0.0 : e.tail;
+            e.tail = CorrectSampledEntropy(e.tail, tail_used, s.tail_excess[0] + s.tail_excess[1], tail_total);
+        }
+        return e;
+    }
+}
+
+#endif
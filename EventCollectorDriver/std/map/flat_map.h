@@ -0,0 +1,284 @@
+#ifndef FLAT_MAP_H_
+#define FLAT_MAP_H_
+
+// Sorted array of key/value entries with the Map interface; see
+// std/set/flat_set.h for when to prefer it over the tree. Entries expose
+// `first` and `second` like Map's Pair, but `first` must not be changed
+// through an iterator, since it is what keeps the array sorted.
+//
+// Insert replaces the value of an existing key, as Map::Insert does, and
+// returns (End(), false) when it cannot get memory.
+// Iterators are invalidated by any Insert, Erase or Reserve.
+
+#include "../memory/memory.h"
+#include "../memory/pair.h"
+#include "../iterator/iterator.h"
+
+template <typename Key, typename T, typename Compare = Less<Key>>
+class FlatMap {
+public:
+    struct Entry {
+        Key first;
+        T second;
+
+        // noexcept: `new Entry[n]` yields nullptr instead of constructing into it.
+        static void* operator new[](decltype(sizeof(0)) n) noexcept { return krnl_std::Alloc(n, krnl_std::kMapTag); }
+        static void operator delete[](void* p) { krnl_std::Free(p); }
+    };
+
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = Entry;
+    using size_type = ull;
+    using difference_type = ptrdiff_t;
+
+    class Iterator : public IteratorBase<Entry, RandomAccessIteratorTag> {
+    private:
+        Entry* entry_;
+
+    public:
+        Iterator() : entry_(nullptr) {}
+        explicit Iterator(Entry* entry) : entry_(entry) {}
+
+        Entry& operator*() const { return *entry_; }
+        Entry* operator->() const { return entry_; }
+
+        Iterator& operator++() { ++entry_; return *this; }
+        Iterator operator++(int) { Iterator tmp = *this; ++entry_; return tmp; }
+        Iterator& operator--() { --entry_; return *this; }
+        Iterator operator--(int) { Iterator tmp = *this; --entry_; return tmp; }
+
+        bool operator==(const Iterator& other) const { return entry_ == other.entry_; }
+        bool operator!=(const Iterator& other) const { return entry_ != other.entry_; }
+
+        friend class FlatMap;
+    };
+
+    using iterator = Iterator;
+    using const_iterator = Iterator;
+
+    FlatMap();
+    explicit FlatMap(const Compare& comp);
+    FlatMap(const FlatMap& other);
+    FlatMap(FlatMap&& other);
+    FlatMap& operator=(const FlatMap& other);
+    FlatMap& operator=(FlatMap&& other);
+    ~FlatMap();
+
+    // Iterators, in ascending key order
+    iterator Begin() const { return iterator(entries_); }
+    iterator End() const { return iterator(entries_ + size_); }
+
+    // Capacity
+    bool Empty() const { return size_ == 0; }
+    size_type Size() const { return size_; }
+    size_type Capacity() const { return capacity_; }
+    // Room for n entries; false if the memory is not available.
+    bool Reserve(size_type n);
+
+    // Modifiers
+    Pair<iterator, bool> Insert(const Key& key, const T& val);
+    Pair<iterator, bool> Insert(Key&& key, T&& val);
+    iterator Erase(const_iterator position);
+    size_type Erase(const Key& key);
+    void Clear();
+
+    // Operations
+    iterator Find(const Key& key) const;
+    size_type Count(const Key& key) const;
+    bool Contains(const Key& key) const { return Find(key) != End(); }
+    iterator LowerBound(const Key& key) const { return iterator(entries_ + LowerIndex(key)); }
+
+private:
+    Entry* entries_;
+    ull size_;
+    ull capacity_;
+    Compare compare_;
+
+    bool Grow(ull min_capacity);
+    ull LowerIndex(const Key& key) const;
+    template <typename K, typename V>
+    Pair<iterator, bool> InsertEntry(K&& key, V&& val);
+};
+
+template <typename Key, typename T, typename Compare>
+inline FlatMap<Key, T, Compare>::FlatMap() : entries_(nullptr), size_(0), capacity_(0), compare_() {}
+
+template <typename Key, typename T, typename Compare>
+inline FlatMap<Key, T, Compare>::FlatMap(const Compare& comp) : entries_(nullptr), size_(0), capacity_(0), compare_(comp) {}
+
+// A copy that cannot get its memory is empty.
+template <typename Key, typename T, typename Compare>
+inline FlatMap<Key, T, Compare>::FlatMap(const FlatMap& other) : FlatMap(other.compare_) {
+    if (other.size_ != 0 && Grow(other.size_)) {
+        for (ull i = 0; i < other.size_; i++) {
+            entries_[i].first = other.entries_[i].first;
+            entries_[i].second = other.entries_[i].second;
+        }
+        size_ = other.size_;
+    }
+}
+
+template <typename Key, typename T, typename Compare>
+inline FlatMap<Key, T, Compare>::FlatMap(FlatMap&& other)
+    : entries_(other.entries_), size_(other.size_), capacity_(other.capacity_), compare_(other.compare_) {
+    other.entries_ = nullptr;
+    other.size_ = 0;
+    other.capacity_ = 0;
+}
+
+template <typename Key, typename T, typename Compare>
+inline FlatMap<Key, T, Compare>& FlatMap<Key, T, Compare>::operator=(const FlatMap& other) {
+    if (this != &other) {
+        FlatMap tmp(other);
+        *this = Move(tmp);
+    }
+    return *this;
+}
+
+template <typename Key, typename T, typename Compare>
+inline FlatMap<Key, T, Compare>& FlatMap<Key, T, Compare>::operator=(FlatMap&& other) {
+    if (this != &other) {
+        delete[] entries_;
+        entries_ = other.entries_;
+        size_ = other.size_;
+        capacity_ = other.capacity_;
+        compare_ = other.compare_;
+        other.entries_ = nullptr;
+        other.size_ = 0;
+        other.capacity_ = 0;
+    }
+    return *this;
+}
+
+template <typename Key, typename T, typename Compare>
+inline FlatMap<Key, T, Compare>::~FlatMap() {
+    delete[] entries_;
+}
+
+template <typename Key, typename T, typename Compare>
+inline bool FlatMap<Key, T, Compare>::Grow(ull min_capacity) {
+    ull capacity = capacity_ < 8 ? 8 : capacity_ * 2;
+    if (capacity < min_capacity) {
+        capacity = min_capacity;
+    }
+    Entry* entries = new Entry[capacity];
+    if (entries == nullptr) {
+        return false;
+    }
+    for (ull i = 0; i < size_; i++) {
+        entries[i].first = Move(entries_[i].first);
+        entries[i].second = Move(entries_[i].second);
+    }
+    delete[] entries_;
+    entries_ = entries;
+    capacity_ = capacity;
+    return true;
+}
+
+template <typename Key, typename T, typename Compare>
+inline bool FlatMap<Key, T, Compare>::Reserve(size_type n) {
+    return n <= capacity_ || Grow(n);
+}
+
+// First index whose key is not less than `key`.
+template <typename Key, typename T, typename Compare>
+inline ull FlatMap<Key, T, Compare>::LowerIndex(const Key& key) const {
+    ull lo = 0;
+    ull hi = size_;
+    while (lo < hi) {
+        ull mid = lo + (hi - lo) / 2;
+        if (compare_(entries_[mid].first, key)) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// K and V are const references or values to move from.
+template <typename Key, typename T, typename Compare>
+template <typename K, typename V>
+inline Pair<typename FlatMap<Key, T, Compare>::iterator, bool> FlatMap<Key, T, Compare>::InsertEntry(K&& key, V&& val) {
+    ull pos = LowerIndex(key);
+    if (pos < size_ && !compare_(key, entries_[pos].first)) {
+        entries_[pos].second = static_cast<V&&>(val);
+        return Pair<iterator, bool>(iterator(entries_ + pos), false);
+    }
+    if (size_ == capacity_ && Grow(size_ + 1) == false) {
+        return Pair<iterator, bool>(End(), false);
+    }
+    for (ull i = size_; i > pos; i--) {
+        entries_[i].first = Move(entries_[i - 1].first);
+        entries_[i].second = Move(entries_[i - 1].second);
+    }
+    entries_[pos].first = static_cast<K&&>(key);
+    entries_[pos].second = static_cast<V&&>(val);
+    ++size_;
+    return Pair<iterator, bool>(iterator(entries_ + pos), true);
+}
+
+template <typename Key, typename T, typename Compare>
+inline Pair<typename FlatMap<Key, T, Compare>::iterator, bool> FlatMap<Key, T, Compare>::Insert(const Key& key, const T& val) {
+    return InsertEntry(key, val);
+}
+
+template <typename Key, typename T, typename Compare>
+inline Pair<typename FlatMap<Key, T, Compare>::iterator, bool> FlatMap<Key, T, Compare>::Insert(Key&& key, T&& val) {
+    return InsertEntry(Move(key), Move(val));
+}
+
+template <typename Key, typename T, typename Compare>
+inline typename FlatMap<Key, T, Compare>::iterator FlatMap<Key, T, Compare>::Erase(const_iterator position) {
+    if (position.entry_ < entries_ || position.entry_ >= entries_ + size_) {
+        return End();
+    }
+    ull pos = position.entry_ - entries_;
+    for (ull i = pos; i + 1 < size_; i++) {
+        entries_[i].first = Move(entries_[i + 1].first);
+        entries_[i].second = Move(entries_[i + 1].second);
+    }
+    --size_;
+    // Release what the last entry still holds (a WString's buffer).
+    entries_[size_].first = Key();
+    entries_[size_].second = T();
+    return iterator(entries_ + pos);
+}
+
+template <typename Key, typename T, typename Compare>
+inline typename FlatMap<Key, T, Compare>::size_type FlatMap<Key, T, Compare>::Erase(const Key& key) {
+    iterator it = Find(key);
+    if (it == End()) {
+        return 0;
+    }
+    Erase(it);
+    return 1;
+}
+
+// Keeps the memory, like Vector::Clear.
+template <typename Key, typename T, typename Compare>
+inline void FlatMap<Key, T, Compare>::Clear() {
+    for (ull i = 0; i < size_; i++) {
+        entries_[i].first = Key();
+        entries_[i].second = T();
+    }
+    size_ = 0;
+}
+
+template <typename Key, typename T, typename Compare>
+inline typename FlatMap<Key, T, Compare>::iterator FlatMap<Key, T, Compare>::Find(const Key& key) const {
+    ull pos = LowerIndex(key);
+    if (pos < size_ && !compare_(key, entries_[pos].first)) {
+        return iterator(entries_ + pos);
+    }
+    return End();
+}
+
+template <typename Key, typename T, typename Compare>
+inline typename FlatMap<Key, T, Compare>::size_type FlatMap<Key, T, Compare>::Count(const Key& key) const {
+    return Find(key) != End() ? 1 : 0;
+}
+
+#endif // FLAT_MAP_H_
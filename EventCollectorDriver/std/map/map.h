@@ -19,6 +19,14 @@ private:
 
         explicit Node(const Key& key, const T& value)
             : data(key, value), is_red(true), parent(nullptr), left(nullptr), right(nullptr) {}
+
+        // noexcept: `new Node` yields nullptr instead of constructing into it.
+        // The sentinel and Copy have no way to report a failure and use
+        // `new (krnl_std::retry) Node`, which never yields nullptr.
+        static void* operator new(decltype(sizeof(0)) n) noexcept { return krnl_std::Alloc(n, krnl_std::kMapTag); }
+        static void* operator new(decltype(sizeof(0)) n, const krnl_std::retry_t&) { return krnl_std::AllocRetry(n, krnl_std::kMapTag); }
+        static void operator delete(void* p) { krnl_std::Free(p); }
+        static void operator delete(void* p, const krnl_std::retry_t&) { krnl_std::Free(p); }
     };
 
     Node* root_;
@@ -65,13 +73,13 @@ public:
     using const_pointer = const value_type*;
 
     // Iterator class
-    class Iterator : public IteratorBase<value_type, BidirectionalIteratorTag> {
+    class Iterator : public IteratorBase<Pair<const Key, T>, BidirectionalIteratorTag> {
     private:
         Node* node_;
         const Map* map_;
 
     public:
-        using value_type = value_type;
+        using value_type = Pair<const Key, T>;
         using difference_type = ptrdiff_t;
         using pointer = value_type*;
         using reference = value_type&;
@@ -157,7 +165,7 @@ public:
 
 template <typename Key, typename T, typename Compare>
 inline Map<Key, T, Compare>::Map() : size_(0), compare_() {
-    nil_ = new Node(Key(), T());
+    nil_ = new (krnl_std::retry) Node(Key(), T());
     nil_->is_red = false;
     nil_->left = nil_->right = nil_->parent = nil_;
     root_ = nil_;
@@ -165,7 +173,7 @@ inline Map<Key, T, Compare>::Map() : size_(0), compare_() {
 
 template <typename Key, typename T, typename Compare>
 inline Map<Key, T, Compare>::Map(const KeyCompare& comp) : size_(0), compare_(comp) {
-    nil_ = new Node(Key(), T());
+    nil_ = new (krnl_std::retry) Node(Key(), T());
     nil_->is_red = false;
     nil_->left = nil_->right = nil_->parent = nil_;
     root_ = nil_;
@@ -350,6 +358,9 @@ inline Pair<typename Map<Key, T, Compare>::iterator, bool> Map<Key, T, Compare>:
     const Key& key, const T& val) {
 	Erase(key);
 	Node* z = new Node(key, val);
+    if (z == nullptr) {
+        return Pair<iterator, bool>(End(), false);
+    }
     Node* y = nil_;
     Node* x = root_;
 
@@ -767,7 +778,7 @@ inline typename Map<Key, T, Compare>::Node* Map<Key, T, Compare>::Copy(Node* nod
     if (node == nil_) {
         return nil_;
     }
-    Node* new_node = new Node(node->data.first, node->data.second);
+    Node* new_node = new (krnl_std::retry) Node(node->data.first, node->data.second);
     new_node->is_red = node->is_red;
     new_node->parent = parent;
     new_node->left = Copy(node->left, new_node);
@@ -0,0 +1,144 @@
+#ifndef PATH_TABLE_H
+#define PATH_TABLE_H
+
+// Reference-counted, interned paths: one copy of each path however many
+// handle contexts name it (function/path_cache.h). An entry is a header
+// followed by its characters in the same block, and the key is the path's
+// HashWstring, which is also its key in the event log. The table is a fixed
+// array of chained buckets and does no allocation and no locking of its own:
+// Find under a shared lock, Insert and the last Dereference under an
+// exclusive one.
+//
+// Unlike PidTable, the table holds no reference: an entry leaves the table
+// when its last holder drops it. References other than the last are dropped
+// without the lock.
+
+#include "../string/wstring.h"
+#include "../sync/ring_atomic.h"
+
+namespace krnl_std
+{
+    struct PathEntry
+    {
+        PathEntry* next;
+        unsigned long long key;
+        volatile unsigned long long refs;
+        size_t chars;
+        // chars WCHARs follow, not null-terminated.
+    };
+
+    constexpr unsigned int kPathTableBuckets = 1024;
+
+    struct PathTable
+    {
+        PathEntry* bucket[kPathTableBuckets];
+        unsigned long long count;
+    };
+
+    inline void InitPathTable(PathTable& t)
+    {
+        for (unsigned int i = 0; i < kPathTableBuckets; i++) {
+            t.bucket[i] = nullptr;
+        }
+        t.count = 0;
+    }
+
+    inline unsigned int PathBucket(unsigned long long key)
+    {
+        return (unsigned int)(key ^ (key >> 32)) % kPathTableBuckets;
+    }
+
+    // Size of the block for a path of `chars` characters.
+    inline size_t PathEntryBytes(size_t chars)
+    {
+        return sizeof(PathEntry) + chars * sizeof(WCHAR);
+    }
+
+    inline std::WStringView PathText(const PathEntry* e)
+    {
+        return std::WStringView((const WCHAR*)(e + 1), e->chars);
+    }
+
+    // `e` points to PathEntryBytes(text.Size()) bytes. The caller holds the
+    // one reference.
+    inline void InitPathEntry(PathEntry* e, unsigned long long key, const std::WStringView& text)
+    {
+        e->next = nullptr;
+        e->key = key;
+        e->refs = 1;
+        e->chars = text.Size();
+        memcpy(e + 1, text.Data(), text.Size() * sizeof(WCHAR));
+    }
+
+    inline void ReferencePathEntry(PathEntry* e)
+    {
+        ring_atomic::Add(&e->refs, 1);
+    }
+
+    // Shared lock. Returns the entry with a reference added, or nullptr.
+    inline PathEntry* FindPathEntry(PathTable& t, unsigned long long key, const std::WStringView& text)
+    {
+        for (PathEntry* e = t.bucket[PathBucket(key)]; e != nullptr; e = e->next) {
+            if (e->key == key && PathText(e) == text) {
+                ReferencePathEntry(e);
+                return e;
+            }
+        }
+        return nullptr;
+    }
+
+    // Exclusive lock. When the path is already present (two threads filled
+    // the same miss), returns the existing entry with a reference added and
+    // leaves `e` to the caller; otherwise links `e` and returns nullptr.
+    inline PathEntry* InsertPathEntry(PathTable& t, PathEntry* e)
+    {
+        PathEntry** head = &t.bucket[PathBucket(e->key)];
+        std::WStringView text = PathText(e);
+        for (PathEntry* it = *head; it != nullptr; it = it->next) {
+            if (it->key == e->key && PathText(it) == text) {
+                ReferencePathEntry(it);
+                return it;
+            }
+        }
+        e->next = *head;
+        *head = e;
+        t.count++;
+        return nullptr;
+    }
+
+    // No lock. Drops a reference that is not the last one; false when it may
+    // be, and the caller goes through DereferencePathEntryLocked instead.
+    inline bool DereferencePathEntryShared(PathEntry* e)
+    {
+        for (;;) {
+            unsigned long long refs = ring_atomic::LoadRelaxed(&e->refs);
+            if (refs <= 1) {
+                return false;
+            }
+            if (ring_atomic::Cas(&e->refs, refs, refs - 1)) {
+                return true;
+            }
+        }
+    }
+
+    // Exclusive lock, so no Find can revive the entry. true when that was
+    // the last reference: the entry is unlinked and the caller frees it
+    // after releasing the lock.
+    inline bool DereferencePathEntryLocked(PathTable& t, PathEntry* e)
+    {
+        if (ring_atomic::Add(&e->refs, (unsigned long long)-1) != 0) {
+            return false;
+        }
+        for (PathEntry** link = &t.bucket[PathBucket(e->key)]; *link != nullptr; link = &(*link)->next) {
+            if (*link == e) {
+                *link = e->next;
+                e->next = nullptr;
+                t.count--;
+                break;
+            }
+        }
+        return true;
+    }
+}
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef PID_TABLE_H
+#define PID_TABLE_H
+
+// Reference-counted per-process entries keyed by pid, for caches filled at
+// process creation and emptied at exit (function/process_cache.h). The
+// entry is embedded as the first member of the caller's struct; the table is
+// a fixed array of chained buckets and does no allocation and no locking of
+// its own: Find under a shared lock, Insert/Remove under an exclusive one.
+// References are taken with the lock held and dropped without it.
+//
+// No kernel dependencies, so the cache is modelled in user mode
+// (bench/process_cache_bench.cpp).
+
+#include "../sync/ring_atomic.h"
+
+namespace krnl_std
+{
+    struct PidEntry
+    {
+        PidEntry* next;
+        unsigned long long pid;
+        volatile unsigned long long refs;   // the table's own counts as one
+    };
+
+    constexpr unsigned int kPidTableBuckets = 256;
+
+    struct PidTable
+    {
+        PidEntry* bucket[kPidTableBuckets];
+        unsigned long long count;
+    };
+
+    inline void InitPidTable(PidTable& t)
+    {
+        for (unsigned int i = 0; i < kPidTableBuckets; i++) {
+            t.bucket[i] = nullptr;
+        }
+        t.count = 0;
+    }
+
+    inline unsigned int PidBucket(unsigned long long pid)
+    {
+        // pids are multiples of 4.
+        return (unsigned int)(pid >> 2) % kPidTableBuckets;
+    }
+
+    inline void InitPidEntry(PidEntry& e, unsigned long long pid)
+    {
+        e.next = nullptr;
+        e.pid = pid;
+        e.refs = 1;
+    }
+
+    inline void ReferencePidEntry(PidEntry* e)
+    {
+        ring_atomic::Add(&e->refs, 1);
+    }
+
+    // true when that was the last reference and the caller frees the entry.
+    inline bool DereferencePidEntry(PidEntry* e)
+    {
+        return ring_atomic::Add(&e->refs, (unsigned long long)-1) == 0;
+    }
+
+    // Shared lock. Returns the entry with a reference added, or nullptr.
+    inline PidEntry* FindPidEntry(PidTable& t, unsigned long long pid)
+    {
+        for (PidEntry* e = t.bucket[PidBucket(pid)]; e != nullptr; e = e->next) {
+            if (e->pid == pid) {
+                ReferencePidEntry(e);
+                return e;
+            }
+        }
+        return nullptr;
+    }
+
+    // Exclusive lock. The table takes over the entry's initial reference.
+    // When the pid is already present (two threads filled the same miss),
+    // returns the existing entry with a reference added and leaves `e` to
+    // the caller; otherwise returns nullptr.
+    inline PidEntry* InsertPidEntry(PidTable& t, PidEntry* e)
+    {
+        PidEntry** head = &t.bucket[PidBucket(e->pid)];
+        for (PidEntry* it = *head; it != nullptr; it = it->next) {
+            if (it->pid == e->pid) {
+                ReferencePidEntry(it);
+                return it;
+            }
+        }
+        e->next = *head;
+        *head = e;
+        t.count++;
+        return nullptr;
+    }
+
+    // Exclusive lock. Unlinks the entry and hands the table's reference to
+    // the caller, who drops it after releasing the lock.
+    inline PidEntry* RemovePidEntry(PidTable& t, unsigned long long pid)
+    {
+        for (PidEntry** link = &t.bucket[PidBucket(pid)]; *link != nullptr; link = &(*link)->next) {
+            PidEntry* e = *link;
+            if (e->pid == pid) {
+                *link = e->next;
+                e->next = nullptr;
+                t.count--;
+                return e;
+            }
+        }
+        return nullptr;
+    }
+
+    // Exclusive lock. Unlinks one entry, for emptying the table at unload.
+    inline PidEntry* PopPidEntry(PidTable& t)
+    {
+        for (unsigned int i = 0; i < kPidTableBuckets; i++) {
+            PidEntry* e = t.bucket[i];
+            if (e != nullptr) {
+                t.bucket[i] = e->next;
+                e->next = nullptr;
+                t.count--;
+                return e;
+            }
+        }
+        return nullptr;
+    }
+}
+
+#endif
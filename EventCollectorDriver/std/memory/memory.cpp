@@ -1,17 +1,133 @@
 #include "memory.h"
 
+namespace krnl_std
+{
+    // One lookaside list per size class, all with kPoolTag; large blocks
+    // are pool allocations with the caller's tag.
+    struct PoolSlabBackend
+    {
+        LOOKASIDE_LIST_EX lists[kSlabClassCount];
+        bool ready;
+
+        void* Get(unsigned int cls)
+        {
+            if (ready == false) {
+                return ExAllocatePool2(POOL_FLAG_NON_PAGED, SlabClassBytes(cls), kPoolTag);
+            }
+            return ExAllocateFromLookasideListEx(&lists[cls]);
+        }
+
+        void Put(unsigned int cls, void* block)
+        {
+            if (ready == false) {
+                ExFreePoolWithTag(block, kPoolTag);
+                return;
+            }
+            ExFreeToLookasideListEx(&lists[cls], block);
+        }
+
+        void* GetLarge(unsigned long long bytes, unsigned int tag)
+        {
+            return ExAllocatePool2(POOL_FLAG_NON_PAGED, bytes, tag);
+        }
+
+        void PutLarge(void* block, unsigned int tag)
+        {
+            ExFreePoolWithTag(block, tag);
+        }
+    };
+
+    static SlabAllocator<PoolSlabBackend> kAllocator;
+
+    void InitAllocator()
+    {
+        InitSlabAllocator(kAllocator);
+        for (unsigned int i = 0; i < kSlabClassCount; i++) {
+            NTSTATUS status = ExInitializeLookasideListEx(&kAllocator.backend.lists[i], nullptr, nullptr,
+                NonPagedPoolNx, 0, SlabClassBytes(i), kPoolTag, 0);
+            if (!NT_SUCCESS(status)) {
+                while (i-- > 0) {
+                    ExDeleteLookasideListEx(&kAllocator.backend.lists[i]);
+                }
+                return;
+            }
+        }
+        kAllocator.backend.ready = true;
+    }
+
+    // Only once nothing else runs: blocks freed later go back to the pool.
+    void UninitAllocator()
+    {
+        if (kAllocator.backend.ready == false) {
+            return;
+        }
+        kAllocator.backend.ready = false;
+        for (unsigned int i = 0; i < kSlabClassCount; i++) {
+            ExDeleteLookasideListEx(&kAllocator.backend.lists[i]);
+        }
+    }
+
+    void ReportAllocator()
+    {
+        for (unsigned int i = 0; i < kSlabMaxTags; i++) {
+            SlabTagStats& s = kAllocator.tags[i];
+            if (s.tag == 0) {
+                continue;
+            }
+            DbgPrintEx(0, 0, "[EventCollectorDriver] pool tag %08llx: %llu allocs, %llu frees, %llu bytes live, %llu failures\n",
+                s.tag, s.allocs, s.frees, s.bytes, s.failures);
+        }
+    }
+
+    void* Alloc(ull n, ULONG tag)
+    {
+        return SlabAlloc(kAllocator, n, tag);
+    }
+
+    void Free(void* p)
+    {
+        SlabFree(kAllocator, p);
+    }
+}
+
+// Plain new never returns nullptr: callers construct into the result
+// without checking (new T[n] in Vector, the Set/Map sentinels, ...), so it
+// keeps trying, as it always has. Below DISPATCH_LEVEL it backs off between
+// attempts instead of spinning. Paths that can handle a failure use
+// `new (krnl_std::nothrow)`.
+void* krnl_std::AllocRetry(ull n, ULONG tag)
+{
+    for (int i = 0;; i++) {
+        void* p = Alloc(n, tag);
+        if (p != nullptr) {
+            return p;
+        }
+        if (KeGetCurrentIrql() < DISPATCH_LEVEL) {
+            LARGE_INTEGER delay;
+            delay.QuadPart = -10000LL * (1LL << (i < 4 ? i : 4));    // 1, 2, 4, 8, 16 ms
+            KeDelayExecutionThread(KernelMode, FALSE, &delay);
+        }
+    }
+}
+
 void* operator new(ull n)
 {
-    void* p;
-    while ((p = krnl_std::Alloc(n)) == 0);
-    return (p);
+    return krnl_std::AllocRetry(n);
 }
 
 void* operator new[](ull n)
 {
-    void* p;
-    while ((p = krnl_std::Alloc(n)) == 0);
-    return (p);
+    return krnl_std::AllocRetry(n);
+}
+
+void* operator new(ull n, const krnl_std::nothrow_t&) noexcept
+{
+    return krnl_std::Alloc(n);
+}
+
+void* operator new[](ull n, const krnl_std::nothrow_t&) noexcept
+{
+    return krnl_std::Alloc(n);
 }
 
 void operator delete(void* p, ull n)
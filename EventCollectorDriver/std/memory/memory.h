@@ -6,6 +6,7 @@ typedef unsigned long long ull;
 #include <ntdef.h>
 #include <wdm.h>
 #include "../ulti/def.h"
+#include "slab.h"
 
 #pragma warning(disable:4100)
 
@@ -15,8 +16,24 @@ typedef unsigned long long ull;
 #define INT_MAX 2147483647
 #define ULL_MAX 0xFFFFFFFFFFFFFFFF
 
+namespace krnl_std
+{
+    struct nothrow_t {};
+    constexpr nothrow_t nothrow;
+    // For class-specific operator new: the Set/Map nodes' plain form is
+    // nothrow, `new (krnl_std::retry) Node` is the one that cannot fail.
+    struct retry_t {};
+    constexpr retry_t retry;
+}
+
+// The plain forms never return nullptr (they retry until the pool has the
+// memory), so their result is used unchecked; the nothrow forms fail at
+// once. Use `new (krnl_std::nothrow) T` on paths that can handle the
+// failure, and check its result.
 extern void* operator new(ull);
 extern void* operator new[](ull);
+extern void* operator new(ull, const krnl_std::nothrow_t&) noexcept;
+extern void* operator new[](ull, const krnl_std::nothrow_t&) noexcept;
 
 extern void operator delete(void*, ull);
 
@@ -32,7 +49,26 @@ ull Rand();
 
 namespace krnl_std
 {
-    void* Alloc(ull n);
+    // Pool tags, one per kind of allocation, for the per-tag counters (and
+    // for poolmon, on blocks too big for the lookaside lists).
+    constexpr ULONG kPoolTag = 0x22042003;
+    constexpr ULONG kStringTag = 'rtSK';
+    constexpr ULONG kSetTag = 'teSK';
+    constexpr ULONG kMapTag = 'paMK';
+    constexpr ULONG kTrieTag = 'irTK';
+    constexpr ULONG kPathTag = 'htPK';
+
+    // Sets up the lookaside lists. Until then, and after UninitAllocator,
+    // every block comes straight from the pool.
+    void InitAllocator();
+    void UninitAllocator();
+    // Prints the per-tag counters; blocks still allocated are leaks at unload.
+    void ReportAllocator();
+
+    // nullptr on failure, never retries.
+    void* Alloc(ull n, ULONG tag = kPoolTag);
+    // Never nullptr: retries as plain operator new does.
+    void* AllocRetry(ull n, ULONG tag = kPoolTag);
 
     void Free(void* p);
 }
@@ -55,23 +91,3 @@ inline void ZeroMemory(T* dst, ull len)
 
 void SetUlongAt(ull addr, ULONG value);
 ULONG GetUlongAt(ull addr);
-
-namespace krnl_std
-{
-    inline void* Alloc(ull n)
-    {
-        void* p = nullptr;
-        p = ExAllocatePool2(POOL_FLAG_NON_PAGED, n, 0x22042003); // Windows 10 2004 above
-        //p = ExAllocatePoolWithTag(NonPagedPool, n, 0x22042003);
-        return p;
-    }
-
-    inline void Free(void* p)
-    {
-        if (p == nullptr) {
-            return;
-        }
-        ExFreePoolWithTag(p, 0x22042003);
-    }
-
-}
@@ -0,0 +1,173 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+// Size-class allocator behind krnl_std::Alloc / operator new. Requests up to
+// kSlabMaxBlock bytes (header included) are rounded up to a power-of-two
+// class and served from a per-class free list; larger ones go straight to
+// the backend. Every block carries a SlabHeader, so Free needs no size, and
+// every allocation is counted against its pool tag.
+//
+// No kernel dependencies: the backend supplies the memory. The driver's
+// backend (std/memory/memory.cpp) keeps one lookaside list per class; the
+// user-mode one (bench/kstd_shim/slab_user.cpp) lets bench/slab_bench.cpp
+// test the allocator and the containers on top of it.
+//
+// Backend interface:
+//   void* Get(unsigned int cls)                 block of SlabClassBytes(cls)
+//   void  Put(unsigned int cls, void* block)
+//   void* GetLarge(unsigned long long bytes, unsigned int tag)
+//   void  PutLarge(void* block, unsigned int tag)
+// Any of the Get calls may return nullptr; the allocator never retries.
+
+#include "../sync/ring_atomic.h"
+
+namespace krnl_std
+{
+    constexpr unsigned int kSlabClassCount = 7;
+    constexpr unsigned long long kSlabMinBlock = 32;
+    constexpr unsigned long long kSlabMaxBlock = kSlabMinBlock << (kSlabClassCount - 1);   // 2048
+    constexpr unsigned int kSlabLarge = kSlabClassCount;
+    constexpr unsigned int kSlabMaxTags = 16;
+    constexpr unsigned short kSlabMagic = 0x4c53;       // "SL"
+    // Large blocks put the header at the end of this much slack, so a
+    // page-aligned backend block gives a cache-line-aligned payload.
+    constexpr unsigned long long kSlabLargeOffset = 64;
+
+    // In front of every block; keeps the payload 16-byte aligned. The tag
+    // is kept here rather than read back from the stats slot, which the
+    // overflow tags share: PutLarge must get the tag the block came with.
+    struct SlabHeader
+    {
+        unsigned short magic;
+        unsigned char cls;              // kSlabLarge for backend blocks
+        unsigned char tag_slot;
+        unsigned int tag;
+        unsigned long long bytes;       // as requested
+    };
+
+    static_assert(sizeof(SlabHeader) == 16, "SlabHeader layout");
+
+    // Counters per pool tag. A tag takes the first free slot the first time
+    // it is used; once all are taken, the last slot counts the rest.
+    struct SlabTagStats
+    {
+        volatile unsigned long long tag;    // 0: slot unused
+        volatile unsigned long long allocs;
+        volatile unsigned long long frees;
+        volatile unsigned long long bytes;  // requested bytes still allocated
+        volatile unsigned long long failures;
+    };
+
+    template <typename Backend>
+    struct SlabAllocator
+    {
+        Backend backend;
+        SlabTagStats tags[kSlabMaxTags];
+    };
+
+    inline unsigned long long SlabClassBytes(unsigned int cls)
+    {
+        return kSlabMinBlock << cls;
+    }
+
+    // Smallest class holding `total` bytes; total <= kSlabMaxBlock.
+    inline unsigned int SlabClassOf(unsigned long long total)
+    {
+        unsigned int cls = 0;
+        while (SlabClassBytes(cls) < total) {
+            cls++;
+        }
+        return cls;
+    }
+
+    inline unsigned int SlabTagSlot(SlabTagStats* tags, unsigned int tag)
+    {
+        for (unsigned int i = 0; i < kSlabMaxTags - 1; i++) {
+            unsigned long long t = ring_atomic::LoadRelaxed(&tags[i].tag);
+            if (t == tag) {
+                return i;
+            }
+            if (t == 0) {
+                if (ring_atomic::Cas(&tags[i].tag, 0, tag) || ring_atomic::Load(&tags[i].tag) == tag) {
+                    return i;
+                }
+            }
+        }
+        return kSlabMaxTags - 1;
+    }
+
+    template <typename Backend>
+    inline void InitSlabAllocator(SlabAllocator<Backend>& a)
+    {
+        for (unsigned int i = 0; i < kSlabMaxTags; i++) {
+            a.tags[i].tag = 0;
+            a.tags[i].allocs = 0;
+            a.tags[i].frees = 0;
+            a.tags[i].bytes = 0;
+            a.tags[i].failures = 0;
+        }
+    }
+
+    // nullptr when the backend has no memory; counted as a failure.
+    template <typename Backend>
+    inline void* SlabAlloc(SlabAllocator<Backend>& a, unsigned long long n, unsigned int tag)
+    {
+        SlabTagStats& s = a.tags[SlabTagSlot(a.tags, tag)];
+        unsigned long long total = n + sizeof(SlabHeader);
+        if (total < n || total + kSlabLargeOffset < total) {
+            ring_atomic::Add(&s.failures, 1);
+            return nullptr;
+        }
+
+        unsigned int cls = total <= kSlabMaxBlock ? SlabClassOf(total) : kSlabLarge;
+        unsigned char* block = (unsigned char*)(cls == kSlabLarge ?
+            a.backend.GetLarge(n + kSlabLargeOffset, tag) : a.backend.Get(cls));
+        if (block == nullptr) {
+            ring_atomic::Add(&s.failures, 1);
+            return nullptr;
+        }
+
+        SlabHeader* h = cls == kSlabLarge ? (SlabHeader*)(block + kSlabLargeOffset) - 1 : (SlabHeader*)block;
+        h->magic = kSlabMagic;
+        h->cls = (unsigned char)cls;
+        h->tag_slot = (unsigned char)(&s - a.tags);
+        h->tag = tag;
+        h->bytes = n;
+        ring_atomic::Add(&s.allocs, 1);
+        ring_atomic::Add(&s.bytes, n);
+        return h + 1;
+    }
+
+    // Blocks whose header was overwritten are leaked rather than handed to
+    // the wrong free list.
+    template <typename Backend>
+    inline void SlabFree(SlabAllocator<Backend>& a, void* p)
+    {
+        if (p == nullptr) {
+            return;
+        }
+        SlabHeader* h = (SlabHeader*)p - 1;
+        if (h->magic != kSlabMagic || h->cls > kSlabLarge || h->tag_slot >= kSlabMaxTags) {
+            return;
+        }
+        h->magic = 0;
+
+        SlabTagStats& s = a.tags[h->tag_slot];
+        ring_atomic::Add(&s.frees, 1);
+        ring_atomic::Add(&s.bytes, 0 - h->bytes);
+        if (h->cls == kSlabLarge) {
+            a.backend.PutLarge((unsigned char*)p - kSlabLargeOffset, h->tag);
+        }
+        else {
+            a.backend.Put(h->cls, h);
+        }
+    }
+
+    // Bytes the caller may use, i.e. what was asked for.
+    inline unsigned long long SlabSize(const void* p)
+    {
+        return ((const SlabHeader*)p - 1)->bytes;
+    }
+}
+
+#endif
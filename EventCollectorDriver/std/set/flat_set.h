@@ -0,0 +1,280 @@
+#ifndef FLAT_SET_H_
+#define FLAT_SET_H_
+
+// Sorted array with the Set interface, for lists that are filled once and
+// then only searched (protected paths, rule tables). A lookup is a binary
+// search over one contiguous block instead of a walk through pool nodes;
+// Insert and Erase shift the tail, so they cost O(n).
+//
+// Allocation failures are reported, not retried: Insert returns
+// (End(), false) and Reserve returns false, leaving the set unchanged.
+// Iterators are invalidated by any Insert, Erase or Reserve.
+
+#include "../memory/memory.h"
+#include "../memory/pair.h"
+#include "../iterator/iterator.h"
+
+template <typename Key, typename Compare = Less<Key>>
+class FlatSet {
+private:
+    struct Slot {
+        Key key;
+
+        // noexcept: `new Slot[n]` yields nullptr instead of constructing into it.
+        static void* operator new[](decltype(sizeof(0)) n) noexcept { return krnl_std::Alloc(n, krnl_std::kSetTag); }
+        static void operator delete[](void* p) { krnl_std::Free(p); }
+    };
+
+    Slot* slots_;
+    ull size_;
+    ull capacity_;
+    Compare compare_;
+
+    bool Grow(ull min_capacity);
+    ull LowerIndex(const Key& key) const;
+
+public:
+    using key_type = Key;
+    using value_type = Key;
+    using size_type = ull;
+    using difference_type = ptrdiff_t;
+
+    class Iterator : public IteratorBase<const Key, RandomAccessIteratorTag> {
+    private:
+        const Slot* slot_;
+
+    public:
+        Iterator() : slot_(nullptr) {}
+        explicit Iterator(const Slot* slot) : slot_(slot) {}
+
+        const Key& operator*() const { return slot_->key; }
+        const Key* operator->() const { return &slot_->key; }
+
+        Iterator& operator++() { ++slot_; return *this; }
+        Iterator operator++(int) { Iterator tmp = *this; ++slot_; return tmp; }
+        Iterator& operator--() { --slot_; return *this; }
+        Iterator operator--(int) { Iterator tmp = *this; --slot_; return tmp; }
+
+        bool operator==(const Iterator& other) const { return slot_ == other.slot_; }
+        bool operator!=(const Iterator& other) const { return slot_ != other.slot_; }
+
+        friend class FlatSet;
+    };
+
+    using iterator = Iterator;
+    using const_iterator = Iterator;
+
+    FlatSet();
+    explicit FlatSet(const Compare& comp);
+    FlatSet(const FlatSet& other);
+    FlatSet(FlatSet&& other);
+    FlatSet& operator=(const FlatSet& other);
+    FlatSet& operator=(FlatSet&& other);
+    ~FlatSet();
+
+    // Iterators, in ascending order
+    iterator Begin() const { return iterator(slots_); }
+    iterator End() const { return iterator(slots_ + size_); }
+
+    // Capacity
+    bool Empty() const { return size_ == 0; }
+    size_type Size() const { return size_; }
+    size_type Capacity() const { return capacity_; }
+    // Room for n keys; false if the memory is not available.
+    bool Reserve(size_type n);
+
+    // Element access, no bounds checking
+    const Key& operator[](size_type i) const { return slots_[i].key; }
+
+    // Modifiers
+    Pair<iterator, bool> Insert(const Key& key);
+    Pair<iterator, bool> Insert(Key&& key);
+    iterator Erase(const_iterator position);
+    size_type Erase(const Key& key);
+    void Clear();
+
+    // Operations
+    iterator Find(const Key& key) const;
+    size_type Count(const Key& key) const;
+    bool Contains(const Key& key) const { return Find(key) != End(); }
+    iterator LowerBound(const Key& key) const { return iterator(slots_ + LowerIndex(key)); }
+
+private:
+    template <typename K>
+    Pair<iterator, bool> InsertKey(K&& key);
+};
+
+template <typename Key, typename Compare>
+inline FlatSet<Key, Compare>::FlatSet() : slots_(nullptr), size_(0), capacity_(0), compare_() {}
+
+template <typename Key, typename Compare>
+inline FlatSet<Key, Compare>::FlatSet(const Compare& comp) : slots_(nullptr), size_(0), capacity_(0), compare_(comp) {}
+
+// A copy that cannot get its memory is empty.
+template <typename Key, typename Compare>
+inline FlatSet<Key, Compare>::FlatSet(const FlatSet& other) : FlatSet(other.compare_) {
+    if (other.size_ != 0 && Grow(other.size_)) {
+        for (ull i = 0; i < other.size_; i++) {
+            slots_[i].key = other.slots_[i].key;
+        }
+        size_ = other.size_;
+    }
+}
+
+template <typename Key, typename Compare>
+inline FlatSet<Key, Compare>::FlatSet(FlatSet&& other)
+    : slots_(other.slots_), size_(other.size_), capacity_(other.capacity_), compare_(other.compare_) {
+    other.slots_ = nullptr;
+    other.size_ = 0;
+    other.capacity_ = 0;
+}
+
+template <typename Key, typename Compare>
+inline FlatSet<Key, Compare>& FlatSet<Key, Compare>::operator=(const FlatSet& other) {
+    if (this != &other) {
+        FlatSet tmp(other);
+        *this = Move(tmp);
+    }
+    return *this;
+}
+
+template <typename Key, typename Compare>
+inline FlatSet<Key, Compare>& FlatSet<Key, Compare>::operator=(FlatSet&& other) {
+    if (this != &other) {
+        delete[] slots_;
+        slots_ = other.slots_;
+        size_ = other.size_;
+        capacity_ = other.capacity_;
+        compare_ = other.compare_;
+        other.slots_ = nullptr;
+        other.size_ = 0;
+        other.capacity_ = 0;
+    }
+    return *this;
+}
+
+template <typename Key, typename Compare>
+inline FlatSet<Key, Compare>::~FlatSet() {
+    delete[] slots_;
+}
+
+template <typename Key, typename Compare>
+inline bool FlatSet<Key, Compare>::Grow(ull min_capacity) {
+    ull capacity = capacity_ < 8 ? 8 : capacity_ * 2;
+    if (capacity < min_capacity) {
+        capacity = min_capacity;
+    }
+    Slot* slots = new Slot[capacity];
+    if (slots == nullptr) {
+        return false;
+    }
+    for (ull i = 0; i < size_; i++) {
+        slots[i].key = Move(slots_[i].key);
+    }
+    delete[] slots_;
+    slots_ = slots;
+    capacity_ = capacity;
+    return true;
+}
+
+template <typename Key, typename Compare>
+inline bool FlatSet<Key, Compare>::Reserve(size_type n) {
+    return n <= capacity_ || Grow(n);
+}
+
+// First index whose key is not less than `key`.
+template <typename Key, typename Compare>
+inline ull FlatSet<Key, Compare>::LowerIndex(const Key& key) const {
+    ull lo = 0;
+    ull hi = size_;
+    while (lo < hi) {
+        ull mid = lo + (hi - lo) / 2;
+        if (compare_(slots_[mid].key, key)) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// K is const Key& or Key: the key is copied or moved in only once its
+// place is known.
+template <typename Key, typename Compare>
+template <typename K>
+inline Pair<typename FlatSet<Key, Compare>::iterator, bool> FlatSet<Key, Compare>::InsertKey(K&& key) {
+    ull pos = LowerIndex(key);
+    if (pos < size_ && !compare_(key, slots_[pos].key)) {
+        return Pair<iterator, bool>(iterator(slots_ + pos), false);
+    }
+    if (size_ == capacity_ && Grow(size_ + 1) == false) {
+        return Pair<iterator, bool>(End(), false);
+    }
+    for (ull i = size_; i > pos; i--) {
+        slots_[i].key = Move(slots_[i - 1].key);
+    }
+    slots_[pos].key = static_cast<K&&>(key);
+    ++size_;
+    return Pair<iterator, bool>(iterator(slots_ + pos), true);
+}
+
+template <typename Key, typename Compare>
+inline Pair<typename FlatSet<Key, Compare>::iterator, bool> FlatSet<Key, Compare>::Insert(const Key& key) {
+    return InsertKey(key);
+}
+
+template <typename Key, typename Compare>
+inline Pair<typename FlatSet<Key, Compare>::iterator, bool> FlatSet<Key, Compare>::Insert(Key&& key) {
+    return InsertKey(Move(key));
+}
+
+template <typename Key, typename Compare>
+inline typename FlatSet<Key, Compare>::iterator FlatSet<Key, Compare>::Erase(const_iterator position) {
+    if (position.slot_ < slots_ || position.slot_ >= slots_ + size_) {
+        return End();
+    }
+    ull pos = position.slot_ - slots_;
+    for (ull i = pos; i + 1 < size_; i++) {
+        slots_[i].key = Move(slots_[i + 1].key);
+    }
+    --size_;
+    // Release what the last slot still holds (a WString's buffer).
+    slots_[size_].key = Key();
+    return iterator(slots_ + pos);
+}
+
+template <typename Key, typename Compare>
+inline typename FlatSet<Key, Compare>::size_type FlatSet<Key, Compare>::Erase(const Key& key) {
+    iterator it = Find(key);
+    if (it == End()) {
+        return 0;
+    }
+    Erase(it);
+    return 1;
+}
+
+// Keeps the memory, like Vector::Clear.
+template <typename Key, typename Compare>
+inline void FlatSet<Key, Compare>::Clear() {
+    for (ull i = 0; i < size_; i++) {
+        slots_[i].key = Key();
+    }
+    size_ = 0;
+}
+
+template <typename Key, typename Compare>
+inline typename FlatSet<Key, Compare>::iterator FlatSet<Key, Compare>::Find(const Key& key) const {
+    ull pos = LowerIndex(key);
+    if (pos < size_ && !compare_(key, slots_[pos].key)) {
+        return iterator(slots_ + pos);
+    }
+    return End();
+}
+
+template <typename Key, typename Compare>
+inline typename FlatSet<Key, Compare>::size_type FlatSet<Key, Compare>::Count(const Key& key) const {
+    return Find(key) != End() ? 1 : 0;
+}
+
+#endif // FLAT_SET_H_
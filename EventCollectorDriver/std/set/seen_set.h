@@ -0,0 +1,158 @@
+#ifndef SEEN_SET_H
+#define SEEN_SET_H
+
+// Fixed-size "have I logged this key yet" set for the collector's process and
+// path records. Keys live in 64-byte buckets of 8 slots; a key is only ever
+// looked for in its own bucket, so lookups touch one cache line and erasing
+// never breaks a probe chain. Insertion is lock-free (one compare-exchange).
+// A full bucket evicts with CLOCK (second chance): bit 63 of a slot is the
+// referenced bit, set on a hit and cleared as the hand passes.
+//
+// Forgetting a key only means its path is logged again, so the set is
+// allowed to be approximate: keys are compared on 63 bits, and two threads
+// inserting the same new key at once may both be told it was new.
+//
+// The caller provides the memory (SeenSetBytes); no kernel dependencies, so
+// the same code is benchmarked in user mode (bench/seen_set_bench.cpp).
+
+#include "../sync/ring_atomic.h"
+
+namespace krnl_std
+{
+    constexpr unsigned int kSeenBucketSlots = 8;
+    constexpr unsigned long long kSeenRefBit = 1ULL << 63;
+
+    struct alignas(64) SeenBucket
+    {
+        volatile unsigned long long slot[kSeenBucketSlots];    // 0 = empty
+    };
+
+    struct SeenSet
+    {
+        SeenBucket* buckets;        // nullptr: nothing is ever seen
+        unsigned long long mask;    // bucket count - 1
+        volatile unsigned long long evicted;
+    };
+
+    inline unsigned long long SeenSetBytes(unsigned long long buckets)
+    {
+        return buckets * sizeof(SeenBucket);
+    }
+
+    // buckets must be a power of two; mem must be 64-byte aligned (pool
+    // allocations of a page or more are).
+    inline void InitSeenSet(SeenSet& s, void* mem, unsigned long long buckets)
+    {
+        s.buckets = (SeenBucket*)mem;
+        s.mask = buckets - 1;
+        s.evicted = 0;
+        if (mem != nullptr) {
+            for (unsigned long long b = 0; b < buckets; b++) {
+                for (unsigned int i = 0; i < kSeenBucketSlots; i++) {
+                    s.buckets[b].slot[i] = 0;
+                }
+            }
+        }
+    }
+
+    inline unsigned long long SeenKey(unsigned long long key)
+    {
+        key &= ~kSeenRefBit;
+        return key != 0 ? key : 1;
+    }
+
+    inline SeenBucket& SeenBucketOf(SeenSet& s, unsigned long long k)
+    {
+        // Fibonacci hashing: pids are multiples of 4 and DJB2 hashes are
+        // weak in the low bits.
+        return s.buckets[((k * 0x9E3779B97F4A7C15ULL) >> 32) & s.mask];
+    }
+
+    // true if key was already in the set. Otherwise inserts it (evicting
+    // another key if the bucket is full) and returns false.
+    inline bool TestAndInsertSeen(SeenSet& s, unsigned long long key)
+    {
+        if (s.buckets == nullptr) {
+            return false;
+        }
+        unsigned long long k = SeenKey(key);
+        SeenBucket& b = SeenBucketOf(s, k);
+
+        for (;;) {
+            unsigned int empty = kSeenBucketSlots;
+            for (unsigned int i = 0; i < kSeenBucketSlots; i++) {
+                unsigned long long v = ring_atomic::LoadRelaxed(&b.slot[i]);
+                if ((v & ~kSeenRefBit) == k) {
+                    if ((v & kSeenRefBit) == 0) {
+                        ring_atomic::Cas(&b.slot[i], v, v | kSeenRefBit);
+                    }
+                    return true;
+                }
+                if (v == 0 && empty == kSeenBucketSlots) {
+                    empty = i;
+                }
+            }
+            if (empty == kSeenBucketSlots) {
+                break;
+            }
+            if (ring_atomic::Cas(&b.slot[empty], 0, k)) {
+                return false;
+            }
+            // Lost the slot to another insert; look again, it may be ours.
+        }
+
+        // CLOCK over the bucket. The hand starts at a key-dependent slot so
+        // concurrent evictions in one bucket rarely collide.
+        unsigned int hand = (unsigned int)(k >> 40) % kSeenBucketSlots;
+        for (unsigned int step = 0; step < 2 * kSeenBucketSlots; step++) {
+            unsigned int i = (hand + step) % kSeenBucketSlots;
+            unsigned long long v = ring_atomic::LoadRelaxed(&b.slot[i]);
+            if ((v & kSeenRefBit) != 0) {
+                ring_atomic::Cas(&b.slot[i], v, v & ~kSeenRefBit);
+            }
+            else if (ring_atomic::Cas(&b.slot[i], v, k)) {
+                if (v != 0) {
+                    ring_atomic::Add(&s.evicted, 1);
+                }
+                return false;
+            }
+        }
+        // Every slot kept being touched; take the hand's slot anyway.
+        ring_atomic::Store(&b.slot[hand], k);
+        ring_atomic::Add(&s.evicted, 1);
+        return false;
+    }
+
+    // true if key is in the set; inserts nothing and refreshes nothing.
+    inline bool TestSeen(SeenSet& s, unsigned long long key)
+    {
+        if (s.buckets == nullptr) {
+            return false;
+        }
+        unsigned long long k = SeenKey(key);
+        SeenBucket& b = SeenBucketOf(s, k);
+        for (unsigned int i = 0; i < kSeenBucketSlots; i++) {
+            if ((ring_atomic::LoadRelaxed(&b.slot[i]) & ~kSeenRefBit) == k) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline void EraseSeen(SeenSet& s, unsigned long long key)
+    {
+        if (s.buckets == nullptr) {
+            return;
+        }
+        unsigned long long k = SeenKey(key);
+        SeenBucket& b = SeenBucketOf(s, k);
+        for (unsigned int i = 0; i < kSeenBucketSlots; i++) {
+            unsigned long long v = ring_atomic::LoadRelaxed(&b.slot[i]);
+            if ((v & ~kSeenRefBit) == k) {
+                ring_atomic::Cas(&b.slot[i], v, 0);
+            }
+        }
+    }
+}
+
+#endif
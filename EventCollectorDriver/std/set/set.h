@@ -37,6 +37,14 @@ private:
 
         explicit Node(const Key& k)
             : key(k), is_red(true), parent(nullptr), left(nullptr), right(nullptr) {}
+
+        // noexcept: `new Node` yields nullptr instead of constructing into it.
+        // The sentinel and Copy have no way to report a failure and use
+        // `new (krnl_std::retry) Node`, which never yields nullptr.
+        static void* operator new(decltype(sizeof(0)) n) noexcept { return krnl_std::Alloc(n, krnl_std::kSetTag); }
+        static void* operator new(decltype(sizeof(0)) n, const krnl_std::retry_t&) { return krnl_std::AllocRetry(n, krnl_std::kSetTag); }
+        static void operator delete(void* p) { krnl_std::Free(p); }
+        static void operator delete(void* p, const krnl_std::retry_t&) { krnl_std::Free(p); }
     };
 
     Node* root_;
@@ -71,13 +79,13 @@ public:
     using const_pointer = const value_type*;
 
     // Iterator class
-    class Iterator : public IteratorBase<value_type, BidirectionalIteratorTag> {
+    class Iterator : public IteratorBase<Key, BidirectionalIteratorTag> {
     private:
         Node* node_;
         const Set* set_;
 
     public:
-        using value_type = value_type;
+        using value_type = Key;
         using difference_type = ptrdiff_t;
         using pointer = const value_type*;
         using reference = const value_type&;
@@ -182,7 +190,7 @@ bool DefaultCompare(const Key& a, const Key& b) {
 template <typename Key, typename Compare>
 Set<Key, Compare>::Set() : size_(0) {
     compare_ = &DefaultCompare<Key>;
-    nil_ = new Node(Key());
+    nil_ = new (krnl_std::retry) Node(Key());
     nil_->is_red = false;
     nil_->left = nil_->right = nil_->parent = nil_;
     root_ = nil_;
@@ -190,7 +198,7 @@ Set<Key, Compare>::Set() : size_(0) {
 
 template <typename Key, typename Compare>
 Set<Key, Compare>::Set(const key_compare& comp) : size_(0), compare_(comp) {
-    nil_ = new Node(Key());
+    nil_ = new (krnl_std::retry) Node(Key());
     nil_->is_red = false;
     nil_->left = nil_->right = nil_->parent = nil_;
     root_ = nil_;
@@ -198,7 +206,7 @@ Set<Key, Compare>::Set(const key_compare& comp) : size_(0), compare_(comp) {
 
 template <typename Key, typename Compare>
 Set<Key, Compare>::Set(Compare comp, void* /*alloc placeholder*/) : size_(0), compare_(comp) {
-    nil_ = new Node(Key());
+    nil_ = new (krnl_std::retry) Node(Key());
     nil_->is_red = false;
     nil_->left = nil_->right = nil_->parent = nil_;
     root_ = nil_;
@@ -367,6 +375,9 @@ template <typename Key, typename Compare>
 Pair<typename Set<Key, Compare>::iterator, bool> Set<Key, Compare>::Insert(
     const value_type& val) {
     Node* z = new Node(val);
+    if (z == nullptr) {
+        return Pair<iterator, bool>(End(), false);
+    }
     Node* y = nil_;
     Node* x = root_;
 
@@ -817,7 +828,7 @@ Set<Key, Compare>::Copy(Node* node, Node* parent, Node* other_nil) {
     if (node == other_nil) {
         return nil_;   // map other.nil_ -> this->nil_
     }
-    Node* new_node = new Node(node->key);
+    Node* new_node = new (krnl_std::retry) Node(node->key);
     new_node->is_red = node->is_red;
     new_node->parent = parent;
     new_node->left = Copy(node->left, new_node);
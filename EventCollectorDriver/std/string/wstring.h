@@ -1,13 +1,91 @@
 #pragma once
 
 #include "../memory/memory.h"
-#include "../algo/kmp.h"
 
 namespace std
 {
+	class WString;
+
+	// Case folding as the file system compares names, behind every *Ci
+	// comparison. ASCII is the common case and skips the upcase table.
+	__forceinline WCHAR FoldCase(WCHAR c)
+	{
+		if (c < 0x80) {
+			return (c >= L'a' && c <= L'z') ? (WCHAR)(c - (L'a' - L'A')) : c;
+		}
+		return RtlUpcaseUnicodeChar(c);
+	}
+
+	// Non-owning, read-only view of UTF-16 text: a pointer and a length, not
+	// null-terminated. Used for the comparisons, so checking a path against a
+	// literal or a UNICODE_STRING never copies either side. The viewed
+	// characters must outlive the view.
+	class WStringView
+	{
+	public:
+		static const size_t kNPos = static_cast<size_t>(-1ULL);
+
+		WStringView() = default;
+
+		// Null-terminated C-String, nullptr is empty.
+		WStringView(const WCHAR*);
+
+		WStringView(const WCHAR*, size_t);
+
+		WStringView(const UNICODE_STRING&);
+
+		WStringView(const WString&);
+
+		const WCHAR* Data() const { return data_; }
+
+		size_t Size() const { return size_; }
+
+		bool Empty() const { return size_ == 0; }
+
+		// No bounds checking.
+		WCHAR operator[](size_t i) const { return data_[i]; }
+
+		// At most n characters from pos, clamped to the view.
+		WStringView Substr(size_t pos, size_t n = kNPos) const;
+
+		bool HasPrefix(const WStringView&) const;
+
+		bool HasCiPrefix(const WStringView&) const;
+
+		bool HasSuffix(const WStringView&) const;
+
+		bool HasCiSuffix(const WStringView&) const;
+
+		// Position of the first occurrence at or after begin_pos, or kNPos.
+		size_t FindFirstOf(const WStringView&, size_t begin_pos = 0) const;
+
+		bool Contain(const WStringView&) const;
+
+		// <0, 0, >0 as wcscmp, by code unit and then by length.
+		int Compare(const WStringView&) const;
+
+		// Same, after case folding each character as the file system does.
+		int CompareCi(const WStringView&) const;
+
+		bool operator==(const WStringView&) const;
+
+		bool operator!=(const WStringView&) const;
+
+		// Comparing by case insensitive
+		bool EqualCi(const WStringView&) const;
+
+	private:
+		const WCHAR* data_ = nullptr;
+		size_t size_ = 0;
+	};
+
 	class WString
 	{
 	public:
+		// Strings up to this many characters live in the object itself: file
+		// names, extensions and numbers do, full paths do not.
+		static const size_t kInlineCapacity = 15;
+
 		/* ----- Constructors ----- */
 
 		// Default constructor
@@ -21,15 +99,18 @@ namespace std
 
 		explicit WString(const UNICODE_STRING&);
 		explicit WString(const PUNICODE_STRING&);
+		explicit WString(const WStringView&);
 
-		// Move constructor
-		explicit WString(WString&&) noexcept;
+		// Move constructor: takes the buffer of a heap string, copies an
+		// inline one.
+		WString(WString&&) noexcept;
 
 		// Copy Assingment
 		WString& operator=(const WString&);
 		WString& operator=(const WCHAR*);
 		WString& operator=(const UNICODE_STRING&);
 		WString& operator=(const PUNICODE_STRING&);
+		WString& operator=(const WStringView&);
 
         // Move assignment
         WString& operator=(WString&&) noexcept;
@@ -93,7 +174,7 @@ namespace std
 		// Has a default value param for custom values when resizing.
 		void Resize(size_t, WCHAR val = L'\0');
 
-		// Returns the size of the WString (number of elements). 
+		// Returns the size of the WString (number of elements).
 		size_t Size() const;
 
 		// Returns size of allocated storate capacity
@@ -118,32 +199,14 @@ namespace std
 		// Removes the last element from the String
 		void PopBack();
 
-		// Append a WString to the back.
-		void Append(const WString&);
-
-		// Append a null-terminated C-String to the back.
-		void Append(const WCHAR*);
-
-		// Append an UNICODE_STRING to the back.
-		void Append(const UNICODE_STRING&);
-
-		// Add a WString to the back.
-		WString& operator+=(const WString&);
-
-		// Add a null-terminated C-String to the back.
-		WString& operator+=(const WCHAR*);
+		// Append characters to the back; they may come from this WString.
+		void Append(const WStringView&);
 
-		// Add an UNICODE_STRING to the back.
-		WString& operator+=(const UNICODE_STRING&);
+		// Add a WString, C-String or UNICODE_STRING to the back.
+		WString& operator+=(const WStringView&);
 
-		// Combination of 2 WStrings
-		WString operator+(const WString&);
-
-		// Combination of a WString and a null-terminated C-String
-		WString operator+(const WCHAR*);
-
-		// Combination of a WString and a null-terminated C-String
-		WString operator+(const UNICODE_STRING&);
+		// Combination of this WString and a WString, C-String or UNICODE_STRING
+		WString operator+(const WStringView&) const;
 
 		WString& ConverToUpcase();
 
@@ -159,7 +222,7 @@ namespace std
 
 		/* ----- ELEMENT ACCESS ----- */
 
-		static const size_t kNPos = static_cast<size_t>(-1ULL);
+		static const size_t kNPos = WStringView::kNPos;
 
 		// Access elements with bounds checking.
 		WCHAR& At(size_t n);
@@ -185,87 +248,67 @@ namespace std
 		// Returns a reference to the last element
 		const WCHAR& Back() const;
 
-		// Returns a pointer to the array used by WString
+		// Returns a pointer to the array used by WString, null-terminated
 		WCHAR* Data();
 
-		// Returns a pointer to the array used by WString
+		// Returns a pointer to the array used by WString, null-terminated
 		const WCHAR* Data() const;
 
 		// Returns an UNICODE_STRING used by this WString if valid
 		const UNICODE_STRING UniStr() const;
 
+		WStringView View() const;
+
 		/*----------------------------*/
 
 
 
 		/* -------- COMPARISON -------*/
+		// All of these take a WStringView, so a WString, a null-terminated
+		// C-String or an UNICODE_STRING can be passed without a copy.
 
 		// Check if this WString is a prefix of a WString
-		bool IsPrefixOf(const WString&) const;
+		bool IsPrefixOf(const WStringView&) const;
 
 		// Check if this WString is a prefix of a WString (case insensitive)
-		bool IsCiPrefixOf(const WString&) const;
+		bool IsCiPrefixOf(const WStringView&) const;
 
 		// Check if this WString has a WString as its prefix
-		bool HasPrefix(const WString&) const;
+		bool HasPrefix(const WStringView&) const;
 
 		// Check if this WString has a WString as its prefix (case insensitive)
-		bool HasCiPrefix(const WString&) const;
+		bool HasCiPrefix(const WStringView&) const;
 
 		// Check if this WString is a suffix of a WString
-		bool IsSuffixOf(const WString&) const;
+		bool IsSuffixOf(const WStringView&) const;
 
 		// Check if this WString is a suffix of a WString (case insensitive)
-		bool IsCiSuffixOf(const WString&) const;
+		bool IsCiSuffixOf(const WStringView&) const;
 
 		// Check if this a WString has a WString as its suffix
-		bool HasSuffix(const WString&) const;
+		bool HasSuffix(const WStringView&) const;
 
 		// Check if this a WString has a WString as its suffix (case insensitive)
-		bool HasCiSuffix(const WString&) const;
+		bool HasCiSuffix(const WStringView&) const;
 
 		// Get the first position of a WString in this WString
-		size_t FindFirstOf(const WString&, size_t begin_pos = 0) const;
-
-		// Get the first position of a null-terminated C-String in this WString
-		size_t FindFirstOf(const WCHAR*, size_t begin_pos = 0) const;
-
-		// Get the first position of a UNICODE_STRING in this WString
-		size_t FindFirstOf(const UNICODE_STRING&, size_t begin_pos = 0) const;
+		size_t FindFirstOf(const WStringView&, size_t begin_pos = 0) const;
 
 		// Check if a WString is in this WString
-		bool Contain(const WString&) const;
+		bool Contain(const WStringView&) const;
 
-		// Check if a null-terminated C-String is in this WString
-		bool Contain(const WCHAR*) const;
+		bool operator==(const WStringView&) const;
 
-		// Check if a UNICODE_STRING is in this WString
-		bool Contain(const UNICODE_STRING&) const;
-
-		bool operator==(const WString&) const;
-		bool operator==(const WCHAR*) const;
-		bool operator==(const UNICODE_STRING&) const;
-
-		// Comparing by case insensitive
-		bool EqualCi(const WString&) const;
 		// Comparing by case insensitive
-		bool EqualCi(const WCHAR*) const;
-		// Comparing by case insensitive
-		bool EqualCi(const UNICODE_STRING&) const;
+		bool EqualCi(const WStringView&) const;
 
-		bool operator!=(const WString&) const;
-		bool operator!=(const WCHAR*) const;
-		bool operator!=(const UNICODE_STRING&) const;
+		bool operator!=(const WStringView&) const;
 
 		// Overloading the greater operator
-		bool operator>(const WString&) const;
-		bool operator>(const WCHAR*) const;
-		bool operator>(const UNICODE_STRING&) const;
+		bool operator>(const WStringView&) const;
 
 		// Overloading the smaller operator
-		bool operator<(const WString&) const;
-		bool operator<(const WCHAR*) const;
-		bool operator<(const UNICODE_STRING&) const;
+		bool operator<(const WStringView&) const;
 
 		/*----------------------------*/
 
@@ -274,13 +317,26 @@ namespace std
 		void Deallocate(PVOID buf);
 		void Reset();
 		void Repair();
-		const bool IsInvalid() const;
+		bool IsInvalid() const;
+		bool IsInline() const;
+		// Moves the characters to a buffer of new_cap, keeping the size.
+		void Grow(size_t new_cap);
+		void Assign(const WCHAR*, size_t);
 	private:
 		size_t size_ = 0;
+		// Characters the buffer holds, not counting the terminator.
 		size_t capacity_ = 0;
+		// inline_ or a heap block; nullptr only in an object that was zeroed
+		// instead of constructed (a memset context), which reads as empty.
 		WCHAR* elements_ = nullptr;
+		WCHAR inline_[kInlineCapacity + 1];
 	};
 
+	inline WStringView::WStringView(const WString& s)
+		: data_(s.Data()), size_(s.Size())
+	{
+	}
+
 	WString ToWString(short);
     WString ToWString(unsigned short);
 	WString ToWString(int);
@@ -0,0 +1,209 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+// Byte ring for variable-length log records. Any number of producers reserve
+// space with one compare-exchange and format straight into the ring; a single
+// consumer drains it. No kernel or CRT dependencies beyond memmove, so the
+// same code is stress-tested in user mode (see bench/log_ring_stress.cpp).
+//
+// Record layout, 16-byte aligned:
+//   LogRecordHeader | payload (bytes) | slack up to size
+// A record whose payload does not fit before the end of the buffer is placed
+// at offset 0 and the tail of the buffer becomes a padding record (bytes 0).
+// stamp is the absolute position of the record + 1 and is written last. The
+// consumer compacts payloads over the headers, so the bytes a later header
+// lands on may be old path text; it zeroes every slot before handing it back
+// (and InitLogRing zeroes the buffer), so an uncommitted header reads 0 and
+// never passes for committed. The drain also bounds-checks size and bytes
+// before trusting a record.
+
+#include <string.h>
+
+#include "ring_atomic.h"
+
+namespace krnl_std
+{
+    struct LogRecordHeader
+    {
+        volatile unsigned long long stamp;
+        unsigned int size;      // whole slot, header included
+        unsigned int bytes;     // payload, 0 for padding
+    };
+
+    constexpr unsigned long long kLogRecordAlign = sizeof(LogRecordHeader);
+
+    // Producers and the consumer touch different lines.
+    struct alignas(64) LogRing
+    {
+        unsigned char* buf;
+        unsigned long long mask;                    // capacity - 1
+        alignas(64) volatile unsigned long long reserve;   // producers
+        alignas(64) volatile unsigned long long read;      // consumer
+        volatile unsigned long long dropped_full;   // no room in the ring
+        volatile unsigned long long dropped_format; // aborted by the producer
+    };
+
+    struct LogReservation
+    {
+        LogRing* ring;
+        unsigned long long pos;     // absolute position of the header
+        unsigned long long end;     // absolute end of the reserved slot
+        unsigned char* data;        // payload area
+        unsigned long long cap;     // bytes available at data
+    };
+
+    inline unsigned long long AlignLogRecord(unsigned long long n)
+    {
+        return (n + kLogRecordAlign - 1) & ~(kLogRecordAlign - 1);
+    }
+
+    // capacity must be a power of two and at least twice the largest record.
+    inline void InitLogRing(LogRing& r, void* buf, unsigned long long capacity)
+    {
+        r.buf = (unsigned char*)buf;
+        r.mask = capacity - 1;
+        memset(buf, 0, (size_t)capacity);
+        r.reserve = 0;
+        r.read = 0;
+        r.dropped_full = 0;
+        r.dropped_format = 0;
+    }
+
+    // Reserves room for up to max_bytes of payload. Returns false (and counts a
+    // drop) when the consumer has not freed enough space yet.
+    inline bool ReserveLogRecord(LogRing& r, unsigned long long max_bytes, LogReservation* out)
+    {
+        unsigned long long capacity = r.mask + 1;
+        unsigned long long total = AlignLogRecord(sizeof(LogRecordHeader) + max_bytes);
+        if (total > capacity / 2) {
+            ring_atomic::Add(&r.dropped_format, 1);
+            return false;
+        }
+
+        for (;;) {
+            unsigned long long pos = ring_atomic::Load(&r.reserve);
+            unsigned long long room = capacity - (pos & r.mask);
+            unsigned long long pad = total > room ? room : 0;
+            if (pos + pad + total - ring_atomic::Load(&r.read) > capacity) {
+                ring_atomic::Add(&r.dropped_full, 1);
+                return false;
+            }
+            if (!ring_atomic::Cas(&r.reserve, pos, pos + pad + total)) {
+                continue;
+            }
+
+            if (pad != 0) {
+                LogRecordHeader* h = (LogRecordHeader*)(r.buf + (pos & r.mask));
+                h->size = (unsigned int)pad;
+                h->bytes = 0;
+                ring_atomic::Store(&h->stamp, pos + 1);
+            }
+            out->ring = &r;
+            out->pos = pos + pad;
+            out->end = pos + pad + total;
+            out->data = r.buf + (out->pos & r.mask) + sizeof(LogRecordHeader);
+            out->cap = total - sizeof(LogRecordHeader);
+            return true;
+        }
+    }
+
+    // Publishes the first `bytes` of the reservation. When no later record was
+    // reserved in the meantime the unused tail goes back to the ring.
+    inline void CommitLogRecord(LogReservation& res, unsigned long long bytes)
+    {
+        LogRing& r = *res.ring;
+        unsigned long long end = res.pos + AlignLogRecord(sizeof(LogRecordHeader) + bytes);
+        if (end >= res.end || !ring_atomic::Cas(&r.reserve, res.end, end)) {
+            end = res.end;
+        }
+
+        LogRecordHeader* h = (LogRecordHeader*)(r.buf + (res.pos & r.mask));
+        h->size = (unsigned int)(end - res.pos);
+        h->bytes = (unsigned int)bytes;
+        ring_atomic::Store(&h->stamp, res.pos + 1);
+    }
+
+    // Gives the reservation up, e.g. when formatting failed.
+    inline void AbortLogRecord(LogReservation& res)
+    {
+        ring_atomic::Add(&res.ring->dropped_format, 1);
+        CommitLogRecord(res, 0);
+    }
+
+    // Bytes reserved but not yet drained, headers and padding included.
+    inline unsigned long long LogRingPending(LogRing& r)
+    {
+        return ring_atomic::Load(&r.reserve) - ring_atomic::Load(&r.read);
+    }
+
+    // Zeroes [from, to) of the ring, wrapping at most once.
+    inline void ClearLogRing(LogRing& r, unsigned long long from, unsigned long long to)
+    {
+        unsigned long long capacity = r.mask + 1;
+        unsigned long long idx = from & r.mask;
+        unsigned long long len = to - from;
+        unsigned long long first = len < capacity - idx ? len : capacity - idx;
+        memset(r.buf + idx, 0, (size_t)first);
+        if (len != first) {
+            memset(r.buf, 0, (size_t)(len - first));
+        }
+    }
+
+    // Consumer side, one thread at a time. Moves the payloads of all committed
+    // records down over their headers, then hands each contiguous run to
+    // sink(const unsigned char* data, unsigned long long len) before the space
+    // is released. At most two runs per call (before and after the wrap).
+    // Stops at the first record that is still being written, so records come
+    // out in reservation order. A header that fails the bounds checks also
+    // stops the drain. Returns the payload bytes drained.
+    template <typename Sink>
+    inline unsigned long long DrainLogRing(LogRing& r, Sink&& sink)
+    {
+        unsigned long long capacity = r.mask + 1;
+        unsigned long long start = r.read;
+        unsigned long long pos = start;
+        unsigned long long end = ring_atomic::Load(&r.reserve);
+        unsigned char* run = nullptr;
+        unsigned long long run_len = 0;
+        unsigned long long drained = 0;
+
+        while (pos < end) {
+            unsigned long long idx = pos & r.mask;
+            LogRecordHeader* h = (LogRecordHeader*)(r.buf + idx);
+            if (ring_atomic::Load(&h->stamp) != pos + 1) {
+                break;
+            }
+            unsigned int size = h->size;
+            unsigned int bytes = h->bytes;
+            if (size < sizeof(LogRecordHeader) || (size & (kLogRecordAlign - 1)) != 0 ||
+                size > capacity / 2 || idx + size > capacity || size > end - pos ||
+                bytes > size - sizeof(LogRecordHeader)) {
+                break;
+            }
+
+            if (run == nullptr || (idx == 0 && run != r.buf)) {
+                if (run_len != 0) {
+                    sink(run, run_len);
+                    drained += run_len;
+                }
+                run = r.buf + idx;
+                run_len = 0;
+            }
+            if (bytes != 0) {
+                memmove(run + run_len, (unsigned char*)h + sizeof(LogRecordHeader), bytes);
+                run_len += bytes;
+            }
+            pos += size;
+        }
+
+        if (run_len != 0) {
+            sink(run, run_len);
+            drained += run_len;
+        }
+        ClearLogRing(r, start, pos);
+        ring_atomic::Store(&r.read, pos);
+        return drained;
+    }
+}
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef RING_ATOMIC_H
+#define RING_ATOMIC_H
+
+// 64-bit atomics for the rings in log_ring.h and com/shared_ring.h, so they
+// build unchanged in the driver and in user mode.
+//
+// Load and Store are sequentially consistent: the wake-up handshakes store
+// one word and then load another, which acquire/release alone would let the
+// CPU reorder. LoadRelaxed is a plain read, for values that carry no data
+// dependency (std/set/seen_set.h), where a locked read would dirty the line.
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace krnl_std
+{
+    namespace ring_atomic
+    {
+#ifdef _MSC_VER
+        // Interlocked ops are full barriers on x64 and ARM64 alike.
+        inline unsigned long long Load(volatile unsigned long long* p)
+        {
+            return (unsigned long long)_InterlockedCompareExchange64((volatile long long*)p, 0, 0);
+        }
+
+        inline unsigned long long LoadRelaxed(volatile unsigned long long* p)
+        {
+            return (unsigned long long)__iso_volatile_load64((volatile long long*)p);
+        }
+
+        inline void Store(volatile unsigned long long* p, unsigned long long v)
+        {
+            _InterlockedExchange64((volatile long long*)p, (long long)v);
+        }
+
+        inline bool Cas(volatile unsigned long long* p, unsigned long long expected, unsigned long long desired)
+        {
+            return (unsigned long long)_InterlockedCompareExchange64((volatile long long*)p, (long long)desired, (long long)expected) == expected;
+        }
+
+        // Returns the new value.
+        inline unsigned long long Add(volatile unsigned long long* p, unsigned long long v)
+        {
+            return (unsigned long long)_InterlockedExchangeAdd64((volatile long long*)p, (long long)v) + v;
+        }
+#else
+        inline unsigned long long Load(volatile unsigned long long* p)
+        {
+            return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+        }
+
+        inline unsigned long long LoadRelaxed(volatile unsigned long long* p)
+        {
+            return __atomic_load_n(p, __ATOMIC_RELAXED);
+        }
+
+        inline void Store(volatile unsigned long long* p, unsigned long long v)
+        {
+            __atomic_store_n(p, v, __ATOMIC_SEQ_CST);
+        }
+
+        inline bool Cas(volatile unsigned long long* p, unsigned long long expected, unsigned long long desired)
+        {
+            return __atomic_compare_exchange_n(p, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+        }
+
+        // Returns the new value. Full barrier, like the Interlocked version,
+        // so it can drop a reference count.
+        inline unsigned long long Add(volatile unsigned long long* p, unsigned long long v)
+        {
+            return __atomic_add_fetch(p, v, __ATOMIC_SEQ_CST);
+        }
+#endif
+    }
+}
+
+#endif
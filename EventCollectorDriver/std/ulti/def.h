@@ -1,7 +1,9 @@
 #pragma once
-typedef long long ptrdiff_t;
+typedef decltype((char*)0 - (char*)0) ptrdiff_t;
 
+#ifdef _MSC_VER
 #pragma warning(disable:4100)
+#endif
 
 template <typename ValType>
 struct Less {
@@ -327,7 +327,7 @@ inline void Vector<T>::Reserve(ull new_size)
 	T* p = Allocate(new_size);
 
 	for (ull i = 0; i < size_; ++i)
-		p[i] = elements_[i];
+		p[i] = Move(elements_[i]);
 
 	Deallocate();
 
@@ -409,9 +409,9 @@ inline bool Vector<T>::Swap(ull i, ull j)
 {
 	if (i >= size_ || j >= size_)
 		return false;
-	T temp = elements_[i];
-	elements_[i] = elements_[j];
-	elements_[j] = temp;
+	T temp = Move(elements_[i]);
+	elements_[i] = Move(elements_[j]);
+	elements_[j] = Move(temp);
 	return true;
 }
 
@@ -428,7 +428,7 @@ inline bool Vector<T>::Erase(ull i)
 	}
 	// Move all elements after i one position to the left
 	for (ull index = i; index < size_ - 2; ++index)
-		elements_[index] = elements_[index + 1];
+		elements_[index] = Move(elements_[index + 1]);
 	elements_[size_ - 1] = T();
 	--size_;
 	return true;
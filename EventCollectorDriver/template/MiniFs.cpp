@@ -21,12 +21,12 @@ CONST FLT_OPERATION_REGISTRATION kCallbacks[] = {
       0,
       (PFLT_PRE_OPERATION_CALLBACK)&MiniFsPreOperation,
       (PFLT_POST_OPERATION_CALLBACK)&MiniFsPostOperation },
-/*
+
     { IRP_MJ_READ,
       0,
       (PFLT_PRE_OPERATION_CALLBACK)&MiniFsPreOperation,
       (PFLT_POST_OPERATION_CALLBACK)&MiniFsPostOperation },
-*/
+
     { IRP_MJ_WRITE,
       0,
       (PFLT_PRE_OPERATION_CALLBACK)&MiniFsPreOperation,
@@ -309,6 +309,8 @@ DriverEntry (
 
     DebugMessage("%ws", __FUNCTIONW__);
 
+    krnl_std::InitAllocator();
+
     NTSTATUS status = InitDebugSystem();
 
     if (!NT_SUCCESS(status)) {
@@ -371,6 +373,9 @@ DriverUnload(
     reg::DrvUnload(driver_object);
     CloseDebugSystem();
 
+    krnl_std::ReportAllocator();
+    krnl_std::UninitAllocator();
+
     DebugMessage("Successfully unloaded driver");
     return STATUS_SUCCESS;
 }
@@ -413,39 +418,53 @@ MiniFsPreOperation (
         return FLT_PREOP_SUCCESS_NO_CALLBACK;
     }
 
-    reg::Context* p = nullptr;
-    if ((*completion_context) == nullptr)
+    const reg::IrpMjDispatch* d = reg::GetFltDispatch(data->Iopb->MajorFunction);
+    if (d == nullptr)
     {
-        p = reg::AllocCompletionContext();
-        (*completion_context) = (PVOID* )p;
-        if (p == nullptr)
-        {
-            return FLT_PREOP_SUCCESS_NO_CALLBACK;
-        }
-        p->status->Resize(reg::kFltFuncVector->Size());
+        return FLT_PREOP_SUCCESS_NO_CALLBACK;
     }
-    else
+
+    // One callback (every major today): it owns the completion context and
+    // the returned status, exactly as if it were registered with FltMgr.
+    if (d->count == 1)
     {
-        p = (reg::Context*)(*completion_context);
+        return d->func[0].pre_func(data, flt_objects, completion_context);
     }
 
-    for (int i = 0; i < reg::kFltFuncVector->Size(); i++)
+    reg::Context* p = reg::AllocCompletionContext();
+    if (p == nullptr)
+    {
+        return FLT_PREOP_SUCCESS_NO_CALLBACK;
+    }
+
+    bool need_post = false;
+    for (ULONG i = 0; i < d->count; i++)
     {
-        if (data->Iopb->MajorFunction == (*reg::kFltFuncVector)[i].irp_mj_function_code &&
-            (*reg::kFltFuncVector)[i].pre_func != nullptr)
+        p->status[i] = FLT_PREOP_SUCCESS_NO_CALLBACK;
+        if (d->func[i].pre_func == nullptr)
         {
-            PVOID completion_context_tmp = nullptr;
-            FLT_PREOP_CALLBACK_STATUS status = (*reg::kFltFuncVector)[i].pre_func(data, flt_objects, &completion_context_tmp);
-            (*(p->status))[i] = status;
-            (*p->completion_context)[i] = completion_context_tmp;
-            if (status == FLT_PREOP_COMPLETE)
-            {
-                DeallocCompletionContext(p);
-                return FLT_PREOP_COMPLETE;
-            }
+            continue;
+        }
+        FLT_PREOP_CALLBACK_STATUS status = d->func[i].pre_func(data, flt_objects, &p->completion_context[i]);
+        p->status[i] = status;
+        if (status == FLT_PREOP_COMPLETE)
+        {
+            // Callbacks that already ran and asked for a post-op never get it.
+            reg::DeallocCompletionContext(p);
+            return FLT_PREOP_COMPLETE;
+        }
+        if (status != FLT_PREOP_SUCCESS_NO_CALLBACK)
+        {
+            need_post = true;
         }
     }
 
+    if (need_post == false)
+    {
+        reg::DeallocCompletionContext(p);
+        return FLT_PREOP_SUCCESS_NO_CALLBACK;
+    }
+    *completion_context = p;
     return FLT_PREOP_SUCCESS_WITH_CALLBACK;
 }
 
@@ -457,49 +476,36 @@ MiniFsPostOperation (
     _In_ FLT_POST_OPERATION_FLAGS flags
     )
 {
-    UNREFERENCED_PARAMETER( data );
-    UNREFERENCED_PARAMETER( flt_objects );
-    UNREFERENCED_PARAMETER( completion_context );
-    UNREFERENCED_PARAMETER( flags );
-
-    reg::Context* p = (reg::Context*)completion_context;
-    if (p == nullptr)
-    {
-        return FLT_POSTOP_FINISHED_PROCESSING;
-    }
+    // Only reached when the pre-operation asked for it, so the dispatch entry
+    // exists. Draining and failed operations are passed through: the post
+    // callbacks check both themselves and may have references to drop.
+    const reg::IrpMjDispatch* d = reg::GetFltDispatch(data->Iopb->MajorFunction);
 
-    if (flags & FLTFL_POST_OPERATION_DRAINING)
+    if (d->count == 1)
     {
-        DeallocCompletionContext(p);
-        return FLT_POSTOP_FINISHED_PROCESSING;
-    }
-
-    if (!NT_SUCCESS(data->IoStatus.Status))
-    {
-        DeallocCompletionContext(p);
-        return FLT_POSTOP_FINISHED_PROCESSING;
+        if (d->func[0].post_func == nullptr)
+        {
+            return FLT_POSTOP_FINISHED_PROCESSING;
+        }
+        return d->func[0].post_func(data, flt_objects, completion_context, flags);
     }
 
+    reg::Context* p = (reg::Context*)completion_context;
     FLT_POSTOP_CALLBACK_STATUS postop_status = FLT_POSTOP_FINISHED_PROCESSING;
 
-    for (int i = 0; i < (*reg::kFltFuncVector).Size(); i++)
+    for (ULONG i = 0; i < d->count; i++)
     {
-        if (data->Iopb->MajorFunction == (*reg::kFltFuncVector)[i].irp_mj_function_code &&
-            (*reg::kFltFuncVector)[i].post_func != nullptr)
+        if (d->func[i].post_func != nullptr && p->status[i] != FLT_PREOP_SUCCESS_NO_CALLBACK)
         {
-            if ((*(p->status))[i] != FLT_PREOP_SUCCESS_NO_CALLBACK && (*(p->status))[i] != FLT_PREOP_COMPLETE)
+            auto ret_status = d->func[i].post_func(data, flt_objects, p->completion_context[i], flags);
+            if (ret_status == FLT_POSTOP_MORE_PROCESSING_REQUIRED)
             {
-                PVOID completion_context_tmp = (*p->completion_context)[i];
-                auto ret_status = (*reg::kFltFuncVector)[i].post_func(data, flt_objects, completion_context_tmp, flags);
-                if (ret_status == FLT_POSTOP_MORE_PROCESSING_REQUIRED)
-                {
-                    postop_status = FLT_POSTOP_MORE_PROCESSING_REQUIRED;
-                }
+                postop_status = FLT_POSTOP_MORE_PROCESSING_REQUIRED;
             }
         }
     }
 
-    DeallocCompletionContext(p);
+    reg::DeallocCompletionContext(p);
     return postop_status;
 }
 
@@ -11,6 +11,9 @@
 
 extern inline PFLT_FILTER kFilterHandle = nullptr;
 
+// FltMgr only calls MiniFsPreOperation for the majors listed here.
+extern CONST FLT_OPERATION_REGISTRATION kCallbacks[];
+
 #define PTDBG_TRACE_ROUTINES            0x00000001
 #define PTDBG_TRACE_OPERATION_STATUS    0x00000002
 
@@ -3,27 +3,18 @@
 #include <wdm.h>
 #include <stdarg.h>
 #include "../std/ulti/def.h"
+#include "../std/sync/log_ring.h"
+#include "../com/event_record.h"
 
 static HANDLE g_LogFileHandle = NULL;
 static LONG g_LogWrittenCount = 0;
 
-typedef struct _LOG_SLOT {
-    PWCHAR Buffer;      // allocated buffer (WCHAR*)
-    ULONG  Bytes;       // bytes to write (not include extra null)
-} LOG_SLOT, * PLOG_SLOT;
-
-static LOG_SLOT* g_Arr1 = nullptr;
-static LOG_SLOT* g_Arr2 = nullptr;
-
-// active/work pointers
-static LOG_SLOT* g_ArrWaitWrite = nullptr;
-static LOG_SLOT* g_ArrWrite = nullptr;
-
-static volatile LONG g_ActiveCount = 0;
-static volatile LONG g_WorkCount = 0;
-
-// spinlock to protect swap + active push index
-static KSPIN_LOCK g_LogArrLock;
+// Per-processor rings (see std/sync/log_ring.h), all carved out of
+// g_LogRingMemory. Producers format in place, the worker drains.
+static krnl_std::LogRing* g_LogRings = nullptr;
+static ULONG g_LogRingCount = 0;
+static ULONGLONG g_LogRingBytes = 0;
+static PUCHAR g_LogRingMemory = nullptr;
 
 // Worker thread state
 static HANDLE     g_LogThreadHandle = NULL;
@@ -136,19 +127,29 @@ VOID writeToLogFile(PVOID buffer, ULONG size)
     return;
 }
 
-static __forceinline VOID freeWorkArrayEntries()
+static VOID drainLogRings(bool force)
 {
-    LONG cnt = g_WorkCount;
-    if (cnt <= 0) return;
-
-    for (LONG i = 0; i < cnt; i++) {
-        if (g_ArrWrite[i].Buffer) {
-            ExFreePoolWithTag(g_ArrWrite[i].Buffer, LOG_TAG);
-            g_ArrWrite[i].Buffer = nullptr;
-            g_ArrWrite[i].Bytes = 0;
+    for (ULONG i = 0; i < g_LogRingCount; i++) {
+        krnl_std::LogRing& ring = g_LogRings[i];
+        if (!force && krnl_std::LogRingPending(ring) < g_LogRingBytes * LOG_RING_FLUSH_PERCENT / 100) {
+            continue;
         }
+        krnl_std::DrainLogRing(ring, [](const unsigned char* data, unsigned long long len) {
+            writeToLogFile((PVOID)data, (ULONG)len);
+            });
+    }
+}
+
+VOID GetLogDropCounts(ULONGLONG* dropped_full, ULONGLONG* dropped_format)
+{
+    ULONGLONG full = 0;
+    ULONGLONG format = 0;
+    for (ULONG i = 0; i < g_LogRingCount; i++) {
+        full += krnl_std::ring_atomic::Load(&g_LogRings[i].dropped_full);
+        format += krnl_std::ring_atomic::Load(&g_LogRings[i].dropped_format);
     }
-    g_WorkCount = 0;
+    *dropped_full = full;
+    *dropped_format = format;
 }
 
 //
@@ -160,6 +161,7 @@ VOID LogWorkerThread(_In_ PVOID start_context)
 
     DebugMessage("DebugLogWorkerThread started");
     LONGLONG lastFlush = GetNtSystemTime100ns();
+    ULONGLONG reportedDrops = 0;
 
     for (;;) {
 
@@ -168,72 +170,20 @@ VOID LogWorkerThread(_In_ PVOID start_context)
             break;
         }
 
-        // Check flush conditions
-        bool doFlush = false;
+        // Every ring once per LOG_FLUSH_SEC, a ring filling up right away
         LONGLONG now = GetNtSystemTime100ns();
+        bool timeout = now - lastFlush >= (LONGLONG)LOG_FLUSH_SEC * 10LL * 1000LL * 1000LL;
+        drainLogRings(timeout);
+        if (timeout) {
+            lastFlush = now;
 
-        // time condition
-        if (now - lastFlush >= (LONGLONG)LOG_FLUSH_SEC * 10LL * 1000LL * 1000LL) {
-            doFlush = true;
-        }
-
-        // threshold condition
-        if (g_ActiveCount > LOG_SWAP_TH) {
-            doFlush = true;
-        }
-
-        if (doFlush) {
-            // swap arrays quickly
-            KIRQL oldIrql;
-            KeAcquireSpinLock(&g_LogArrLock, &oldIrql);
-
-            // Move active -> work by swapping pointers
-            LOG_SLOT* tmp = g_ArrWaitWrite;
-            g_ArrWaitWrite = g_ArrWrite;
-            g_ArrWrite = tmp;
-
-            // WorkCount becomes previous ActiveCount
-            g_WorkCount = g_ActiveCount;
-            g_ActiveCount = 0;
-
-            KeReleaseSpinLock(&g_LogArrLock, oldIrql);
-
-            if (g_WorkCount <= 0) {
-                continue;
-            }
-
-            // Compute total bytes
-            SIZE_T totalBytes = 0;
-            for (LONG i = 0; i < g_WorkCount; i++) {
-                totalBytes += g_ArrWrite[i].Bytes;
-            }
-
-            if (totalBytes == 0) {
-                freeWorkArrayEntries();
-                continue;
-            }
-
-            // Allocate one big buffer and copy all
-            PUCHAR big = (PUCHAR)ExAllocatePool2(POOL_FLAG_NON_PAGED, totalBytes, LOG_TAG);
-            SIZE_T off = 0;
-            if (big) {
-                for (LONG i = 0; i < g_WorkCount; i++) {
-                    if (g_ArrWrite[i].Buffer && g_ArrWrite[i].Bytes) {
-                        RtlCopyMemory(big + off, g_ArrWrite[i].Buffer, g_ArrWrite[i].Bytes);
-                        off += g_ArrWrite[i].Bytes;
-                    }
-                }
-            }
-
-            // free per-entry buffers
-            freeWorkArrayEntries();
-
-            if (big != nullptr) {
-                writeToLogFile(big, off);
-                ExFreePoolWithTag(big, LOG_TAG);
+            ULONGLONG droppedFull = 0;
+            ULONGLONG droppedFormat = 0;
+            GetLogDropCounts(&droppedFull, &droppedFormat);
+            if (droppedFull + droppedFormat != reportedDrops) {
+                reportedDrops = droppedFull + droppedFormat;
+                DebugMessage("Log lines dropped: %llu (ring full), %llu (format)", droppedFull, droppedFormat);
             }
-
-            lastFlush = now;
         }
 
         LARGE_INTEGER interval;
@@ -241,74 +191,86 @@ VOID LogWorkerThread(_In_ PVOID start_context)
         KeDelayExecutionThread(KernelMode, FALSE, &interval);
     }
 
+    // Whatever was committed before the stop
+    drainLogRings(true);
+
     DebugMessage("DebugLogWorkerThread exiting");
     PsTerminateSystemThread(STATUS_SUCCESS);
 }
 
-VOID PushToLogQueue(PCWSTR fmt, ...)
+BOOLEAN BeginLogRecord(ULONG max_bytes, krnl_std::LogReservation* res)
 {
-    if (!fmt ||
+    if (g_LogRingCount == 0 ||
         KeGetCurrentIrql() != PASSIVE_LEVEL) {
-        return;
+        return FALSE;
     }
 
-    NTSTATUS status = STATUS_SUCCESS;
+    // Not suspended while holding a reservation, which would stall the
+    // worker on this ring.
+    KeEnterCriticalRegion();
 
-    PWCHAR p_log = (PWCHAR)ExAllocatePool2(POOL_FLAG_NON_PAGED, INITIAL_LOG_ALLOC * sizeof(WCHAR), LOG_TAG);
-    if (p_log == nullptr) {
+    krnl_std::LogRing& ring = g_LogRings[KeGetCurrentProcessorNumberEx(nullptr) % g_LogRingCount];
+    if (!krnl_std::ReserveLogRecord(ring, max_bytes, res)) {
+        KeLeaveCriticalRegion();
+        return FALSE;
+    }
+    return TRUE;
+}
+
+VOID EndLogRecord(krnl_std::LogReservation* res, ULONG bytes)
+{
+    if (bytes == 0) {
+        krnl_std::AbortLogRecord(*res);
+    }
+    else {
+        krnl_std::CommitLogRecord(*res, bytes);
+    }
+    KeLeaveCriticalRegion();
+}
+
+VOID PushToLogQueue(PCWSTR fmt, ...)
+{
+    if (!fmt) {
+        return;
+    }
+
+    krnl_std::LogReservation res;
+    if (!BeginLogRecord(sizeof(evt::EventRecordHeader) + LOG_LINE_MAX_CHARS * sizeof(WCHAR), &res)) {
         return;
     }
-    RtlZeroMemory(p_log, INITIAL_LOG_ALLOC * sizeof(WCHAR));
+
+    evt::EventRecordHeader* header = (evt::EventRecordHeader*)res.data;
+    PWCHAR p_log = (PWCHAR)(header + 1);
     size_t remaining = 0;
 
     //
-    // Try formatting into the buffer
+    // Format straight into the ring, behind the record header
     // STRSAFE_NO_TRUNCATION ensures failure instead of silent truncation
     //
     va_list args;
     va_start(args, fmt);
-    status = RtlStringCbVPrintfExW(
-        p_log, (INITIAL_LOG_ALLOC - 1) * sizeof(WCHAR),
+    NTSTATUS status = RtlStringCbVPrintfExW(
+        p_log, LOG_LINE_MAX_CHARS * sizeof(WCHAR),
         NULL, &remaining, STRSAFE_NO_TRUNCATION,
         fmt, args
     );
     va_end(args);
 
-    if (!NT_SUCCESS(status)) {
-        ExFreePoolWithTag(p_log, LOG_TAG);
-        return;
-    }
-    ULONG sz = wcsnlen(p_log, INITIAL_LOG_ALLOC - 1) * sizeof(WCHAR);
-
+    // remaining counts the terminating null, which is not written out
+    ULONG sz = NT_SUCCESS(status) ? (ULONG)(LOG_LINE_MAX_CHARS * sizeof(WCHAR) - remaining) : 0;
     if (sz == 0) {
-        ExFreePoolWithTag(p_log, LOG_TAG);
+        EndLogRecord(&res, 0);
         return;
     }
 
     DebugMessage("%ws", p_log);
 
-    // push into active array
-    KIRQL oldIrql = 0;
-    KeAcquireSpinLock(&g_LogArrLock, &oldIrql);
-
-    LONG idx = g_ActiveCount;
-    if (idx >= LOG_ARRAY_CAP) {
-        KeReleaseSpinLock(&g_LogArrLock, oldIrql);
-        ExFreePoolWithTag(p_log, LOG_TAG);
-        p_log = nullptr;
-        return;
-    }
-
-    g_ArrWaitWrite[idx].Buffer = p_log;
-    g_ArrWaitWrite[idx].Bytes = sz;
-    g_ActiveCount = idx + 1;
-
-    KeReleaseSpinLock(&g_LogArrLock, oldIrql);
-    return;
+    evt::InitEventHeader(*header, evt::kText, sizeof(evt::EventRecordHeader) + sz);
+    EndLogRecord(&res, sizeof(evt::EventRecordHeader) + sz);
 }
 
 //
-// Initialize logging system: queue + event + worker thread
+// Initialize logging system: rings + worker thread
 //
 NTSTATUS InitDebugSystem()
 {
@@ -319,25 +281,27 @@ NTSTATUS InitDebugSystem()
     // Initialize underlying log file object
     initLogFile();
 
-    // allocate two arrays upfront
-    g_Arr1 = (LOG_SLOT*)ExAllocatePool2(POOL_FLAG_NON_PAGED, sizeof(LOG_SLOT) * LOG_ARRAY_CAP, LOG_TAG);
-    g_Arr2 = (LOG_SLOT*)ExAllocatePool2(POOL_FLAG_NON_PAGED, sizeof(LOG_SLOT) * LOG_ARRAY_CAP, LOG_TAG);
-    if (!g_Arr1 || !g_Arr2) {
-        if (g_Arr1) ExFreePoolWithTag(g_Arr1, LOG_TAG);
-        if (g_Arr2) ExFreePoolWithTag(g_Arr2, LOG_TAG);
-        g_Arr1 = g_Arr2 = nullptr;
-        return STATUS_INSUFFICIENT_RESOURCES;
+    ULONG count = KeQueryActiveProcessorCountEx(ALL_PROCESSOR_GROUPS);
+    if (count == 0) {
+        count = 1;
+    }
+    ULONGLONG ringBytes = LOG_RING_MAX_BYTES;
+    while (ringBytes > LOG_RING_MIN_BYTES && ringBytes * count > LOG_RING_TOTAL_BYTES) {
+        ringBytes >>= 1;
     }
 
-    RtlZeroMemory(g_Arr1, sizeof(LOG_SLOT) * LOG_ARRAY_CAP);
-    RtlZeroMemory(g_Arr2, sizeof(LOG_SLOT) * LOG_ARRAY_CAP);
-
-    KeInitializeSpinLock(&g_LogArrLock);
+    SIZE_T headerBytes = ((sizeof(krnl_std::LogRing) * count + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
+    g_LogRingMemory = (PUCHAR)ExAllocatePool2(POOL_FLAG_NON_PAGED, headerBytes + ringBytes * count, LOG_TAG);
+    if (g_LogRingMemory == nullptr) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
 
-    g_ArrWaitWrite = g_Arr1;
-    g_ArrWrite = g_Arr2;
-    g_ActiveCount = 0;
-    g_WorkCount = 0;
+    g_LogRings = (krnl_std::LogRing*)g_LogRingMemory;
+    for (ULONG i = 0; i < count; i++) {
+        krnl_std::InitLogRing(g_LogRings[i], g_LogRingMemory + headerBytes + ringBytes * i, ringBytes);
+    }
+    g_LogRingBytes = ringBytes;
+    g_LogRingCount = count;
 
     g_LogThreadStop = FALSE;
     g_LogThreadHandle = NULL;
@@ -356,11 +320,11 @@ NTSTATUS InitDebugSystem()
     if (!NT_SUCCESS(status)) {
         DebugMessage("PsCreateSystemThread failed: 0x%08X", status);
 
-        // free arrays (no per-entry buffers yet, so safe)
-        ExFreePoolWithTag(g_Arr1, LOG_TAG);
-        ExFreePoolWithTag(g_Arr2, LOG_TAG);
-        g_Arr1 = g_Arr2 = nullptr;
-        g_ArrWaitWrite = g_ArrWrite = nullptr;
+        // nothing has been pushed without a worker to drain it
+        g_LogRingCount = 0;
+        g_LogRings = nullptr;
+        ExFreePoolWithTag(g_LogRingMemory, LOG_TAG);
+        g_LogRingMemory = nullptr;
 
         g_LogThreadHandle = NULL;
         return status;
@@ -370,7 +334,7 @@ NTSTATUS InitDebugSystem()
 }
 
 //
-// Stop worker thread and cleanup queue + file
+// Stop worker thread and cleanup rings + file
 //
 VOID CloseDebugSystem()
 {
@@ -385,55 +349,14 @@ VOID CloseDebugSystem()
         g_LogThreadHandle = NULL;
     }
 
-    // Free any remaining buffers in both arrays
-    // We need to safely snapshot counts + pointers
-    {
-        KIRQL oldIrql = 0;
-        KeAcquireSpinLock(&g_LogArrLock, &oldIrql);
-
-        // Free active entries
-        LONG ac = g_ActiveCount;
-        LOG_SLOT* ap = g_ArrWaitWrite;
-
-        // Free work entries
-        LONG wc = g_WorkCount;
-        LOG_SLOT* wp = g_ArrWrite;
-
-        // reset counts to avoid double free if called again
-        g_ActiveCount = 0;
-        g_WorkCount = 0;
-
-        KeReleaseSpinLock(&g_LogArrLock, oldIrql);
-
-        for (LONG i = 0; i < ac; i++) {
-            if (ap[i].Buffer) {
-                ExFreePoolWithTag(ap[i].Buffer, LOG_TAG);
-                ap[i].Buffer = nullptr;
-                ap[i].Bytes = 0;
-            }
-        }
-
-        for (LONG i = 0; i < wc; i++) {
-            if (wp[i].Buffer) {
-                ExFreePoolWithTag(wp[i].Buffer, LOG_TAG);
-                wp[i].Buffer = nullptr;
-                wp[i].Bytes = 0;
-            }
-        }
+    // Callbacks are unregistered by now, so nobody is pushing
+    g_LogRingCount = 0;
+    g_LogRings = nullptr;
+    if (g_LogRingMemory) {
+        ExFreePoolWithTag(g_LogRingMemory, LOG_TAG);
+        g_LogRingMemory = nullptr;
     }
 
-    // Free arrays
-    if (g_Arr1) {
-        ExFreePoolWithTag(g_Arr1, LOG_TAG);
-        g_Arr1 = nullptr;
-    }
-    if (g_Arr2) {
-        ExFreePoolWithTag(g_Arr2, LOG_TAG);
-        g_Arr2 = nullptr;
-    }
-
-    g_ArrWaitWrite = g_ArrWrite = nullptr;
-
     // Close file handle
     closeLogFile();
-}
\ No newline at end of file
+}
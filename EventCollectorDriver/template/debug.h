@@ -14,16 +14,23 @@
 #endif // DEBUG
 
 #include <fltKernel.h>
+#include "../std/sync/log_ring.h"
 
 #pragma warning( disable : 4083 4024 4047 4702 4189 4101 4100)
 
+// Binary records (com/event_record.h); tools/evtlog converts them to text.
 #define LOG_PATH   L"\\SystemRoot\\EventCollectorDriver.log"
 #define DEBUG_LOG_THRESHOLD 100
-#define INITIAL_LOG_ALLOC 4096
+#define LOG_LINE_MAX_CHARS 4096
 
 #define LOG_TAG         'gLbD'
-#define LOG_ARRAY_CAP   5000
-#define LOG_SWAP_TH     2500
+// One ring per processor, carved out of a single allocation of about
+// LOG_RING_TOTAL_BYTES, each ring clamped to [MIN, MAX] (powers of two).
+#define LOG_RING_TOTAL_BYTES    (4 * 1024 * 1024)
+#define LOG_RING_MIN_BYTES      (64 * 1024)
+#define LOG_RING_MAX_BYTES      (1024 * 1024)
+// Drain a ring early once this much of it is in use.
+#define LOG_RING_FLUSH_PERCENT  50
 #define LOG_FLUSH_SEC   1
 
 NTSTATUS InitDebugSystem();
@@ -31,6 +38,16 @@ VOID CloseDebugSystem();
 VOID LogWorkerThread(_In_ PVOID start_context);
 VOID PushToLogQueue(PCWSTR fmt, ...);
 
+// Binary records (com/event_record.h) are built in place: reserve up to
+// max_bytes, fill res->data, then end with the bytes actually used (0 gives
+// the reservation up). PASSIVE_LEVEL only; the thread stays in a critical
+// region between the two calls.
+BOOLEAN BeginLogRecord(ULONG max_bytes, krnl_std::LogReservation* res);
+VOID EndLogRecord(krnl_std::LogReservation* res, ULONG bytes);
+
+// Lines dropped because a ring was full / because formatting failed.
+VOID GetLogDropCounts(ULONGLONG* dropped_full, ULONGLONG* dropped_format);
+
 #ifdef HIEU_DEBUG
 
 #define DebugMessage(x, ...) DbgPrintEx(0, 0, "[EventCollectorDriver] [%s:%d] " x "\n", __FUNCTION__, __LINE__, __VA_ARGS__)
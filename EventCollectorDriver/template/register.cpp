@@ -3,7 +3,12 @@
 
 namespace reg
 {
-	Vector<IrpMjFunc>* kFltFuncVector = nullptr;
+	UCHAR kFltDispatchIndex[256] = { 0 };
+	IrpMjDispatch kFltDispatch[REG_MAX_MJ];
+	static ULONG kFltDispatchCount = 0;
+
+	static LOOKASIDE_LIST_EX kContextLookaside;
+	static bool kIsContextLookasideInit = false;
 
 	Vector<void*>* kDrvFuncVector = nullptr;
 
@@ -41,8 +46,17 @@ namespace reg
 	{
 		DebugMessage("MiniFilterRegister");
 
-		kFltFuncVector = new Vector<IrpMjFunc>();
-		
+		NTSTATUS status = ExInitializeLookasideListEx(&kContextLookaside, nullptr, nullptr, NonPagedPoolNx, 0,
+			sizeof(Context), 0x22042003, 0);
+		if (!NT_SUCCESS(status))
+		{
+			DebugMessage("Fail to initialize completion context lookaside list: %x", status);
+		}
+		else
+		{
+			kIsContextLookasideInit = true;
+		}
+
 		com::kComPort = new com::ComPort();
 
 		collector::FltRegister();
@@ -53,6 +67,7 @@ namespace reg
 	void PostFltRegister()
 	{
 		com::kComPort->SetPfltFilter(kFilterHandle);
+		com::EventChannel::Create();
 		com::kComPort->Create();
 	}
 
@@ -71,10 +86,17 @@ namespace reg
 		com::kComPort->Close();
 		DebugMessage("Unregistering kFilterHandle");
 		FltUnregisterFilter(kFilterHandle);
+		// After the last ContextCleanup, which is what writes to the channel.
+		com::EventChannel::Close();
 
 		DebugMessage("Free memory structures");
-		delete kFltFuncVector;
-		kFltFuncVector = nullptr;
+		if (kIsContextLookasideInit == true)
+		{
+			ExDeleteLookasideListEx(&kContextLookaside);
+			kIsContextLookasideInit = false;
+		}
+		RtlZeroMemory(kFltDispatchIndex, sizeof(kFltDispatchIndex));
+		kFltDispatchCount = 0;
 		delete com::kComPort;
 		com::kComPort = nullptr;
 
@@ -82,23 +104,69 @@ namespace reg
 		return STATUS_SUCCESS;
 	}
 
-	Context* AllocCompletionContext()
+	// A major missing from kCallbacks would never reach its callbacks.
+	static bool IsMajorFiltered(UCHAR major_function)
 	{
-		// DebugMessage("Alloccompletion_context");
+		for (const FLT_OPERATION_REGISTRATION* op = kCallbacks; op->MajorFunction != IRP_MJ_OPERATION_END; op++)
+		{
+			if (op->MajorFunction == major_function)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
 
-		Context* context = new Context();
-		context->status = new Vector<FLT_PREOP_CALLBACK_STATUS>(kFltFuncVector->Size());
-        context->completion_context = new Vector<PVOID>(kFltFuncVector->Size());
-		return context;
+	bool RegisterFltFunc(UCHAR major_function, PFLT_PRE_OPERATION_CALLBACK pre_func, PFLT_POST_OPERATION_CALLBACK post_func)
+	{
+		if (IsMajorFiltered(major_function) == false)
+		{
+			DebugMessage("RegisterFltFunc: major %d is not in kCallbacks", major_function);
+			return false;
+		}
+
+		UCHAR index = kFltDispatchIndex[major_function];
+		if (index == 0)
+		{
+			if (kFltDispatchCount == REG_MAX_MJ)
+			{
+				DebugMessage("RegisterFltFunc: more than %d majors", REG_MAX_MJ);
+				return false;
+			}
+			kFltDispatch[kFltDispatchCount] = IrpMjDispatch();
+			index = (UCHAR)++kFltDispatchCount;
+			kFltDispatchIndex[major_function] = index;
+		}
+
+		IrpMjDispatch& d = kFltDispatch[index - 1];
+		if (d.count == REG_MAX_FUNCS_PER_MJ)
+		{
+			DebugMessage("RegisterFltFunc: more than %d callbacks for major %d", REG_MAX_FUNCS_PER_MJ, major_function);
+			return false;
+		}
+		d.func[d.count].pre_func = pre_func;
+		d.func[d.count].post_func = post_func;
+		d.count++;
+		return true;
 	}
 
-	void DeallocCompletionContext(Context *context)
+	Context* AllocCompletionContext()
 	{
-		// DebugMessage("Dealloccompletion_context");
+		if (kIsContextLookasideInit == false)
+		{
+			return nullptr;
+		}
+		Context* context = (Context*)ExAllocateFromLookasideListEx(&kContextLookaside);
+		if (context != nullptr)
+		{
+			RtlZeroMemory(context, sizeof(Context));
+		}
+		return context;
+	}
 
-        delete context->completion_context;
-		delete context->status;
-		delete context;
+	void DeallocCompletionContext(Context* context)
+	{
+		ExFreeToLookasideListEx(&kContextLookaside, context);
 	}
 
 }
\ No newline at end of file
@@ -6,25 +6,52 @@
 #include "../std/vector/vector.h"
 #include "../com/ioctl/ioctl.h"
 #include "../com/comport/comport.h"
+#include "../com/channel/channel.h"
 #include "debug.h"
 #include "MiniFs.h"
 
 namespace reg
 {
+	// Callbacks per IRP_MJ code and distinct codes with callbacks.
+	#define REG_MAX_FUNCS_PER_MJ 4
+	#define REG_MAX_MJ 16
+
 	struct IrpMjFunc
 	{
-		ull irp_mj_function_code = 0;
 		PFLT_PRE_OPERATION_CALLBACK pre_func = nullptr;
 		PFLT_POST_OPERATION_CALLBACK post_func = nullptr;
 	};
 
+	struct IrpMjDispatch
+	{
+		ULONG count = 0;
+		IrpMjFunc func[REG_MAX_FUNCS_PER_MJ];
+	};
+
+	// Completion context of MiniFsPreOperation when a major has more than one
+	// callback; with exactly one, the callback's own context is passed through.
 	struct Context
 	{
-		Vector<FLT_PREOP_CALLBACK_STATUS>* status = nullptr;
-        Vector<PVOID>* completion_context = nullptr;
+		FLT_PREOP_CALLBACK_STATUS status[REG_MAX_FUNCS_PER_MJ];
+		PVOID completion_context[REG_MAX_FUNCS_PER_MJ];
 	};
 
-	extern Vector<IrpMjFunc>* kFltFuncVector;
+	// Indexed by MajorFunction (a UCHAR, FltMgr's own operations are the
+	// negative codes 0xEC-0xFF): 0 for none, otherwise 1 + slot in kFltDispatch.
+	// Filled by FltRegister, read-only once filtering starts.
+	extern UCHAR kFltDispatchIndex[256];
+	extern IrpMjDispatch kFltDispatch[REG_MAX_MJ];
+
+	inline const IrpMjDispatch* GetFltDispatch(UCHAR major_function)
+	{
+		UCHAR index = kFltDispatchIndex[major_function];
+		return index != 0 ? &kFltDispatch[index - 1] : nullptr;
+	}
+
+	// Adds a callback pair for an IRP_MJ code; callbacks run in the order
+	// they were registered. Only before FltRegisterFilter; false for a major
+	// that is not in kCallbacks (MiniFs.cpp), which FltMgr would never call.
+	bool RegisterFltFunc(UCHAR major_function, PFLT_PRE_OPERATION_CALLBACK pre_func, PFLT_POST_OPERATION_CALLBACK post_func);
 
 	extern Vector<void*>* kDrvFuncVector;
 
@@ -0,0 +1,238 @@
+#include "event_log_reader.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace evt {
+
+	namespace {
+		unsigned short ReadU16(const unsigned char* p)
+		{
+			return (unsigned short)(p[0] | (p[1] << 8));
+		}
+
+		void AppendAscii(std::u16string& out, const char* s)
+		{
+			for (; *s != '\0'; ++s) {
+				out.push_back((char16_t)(unsigned char)*s);
+			}
+		}
+
+		void AppendNumber(std::u16string& out, long long v)
+		{
+			char buf[32];
+			snprintf(buf, sizeof(buf), "%lld,", v);
+			AppendAscii(out, buf);
+		}
+
+		void AppendUnsigned(std::u16string& out, unsigned long long v)
+		{
+			char buf[32];
+			snprintf(buf, sizeof(buf), "%llu,", v);
+			AppendAscii(out, buf);
+		}
+
+		void AppendFlag(std::u16string& out, unsigned int flags, unsigned int bit)
+		{
+			out.push_back((flags & bit) != 0 ? u'1' : u'0');
+			out.push_back(u',');
+		}
+	}
+
+	EventLogReader::EventLogReader(const unsigned char* data, size_t size)
+		: data_(data), size_(size)
+	{
+		legacy_ = size_ >= 2 && ReadU16(data_) != kEventMagic;
+	}
+
+	bool EventLogReader::Next(EventView* out)
+	{
+		if (legacy_) {
+			if (pos_ != 0 || size_ == 0) {
+				return false;
+			}
+			pos_ = size_;
+			out->type = kText;
+			out->data = data_;
+			out->size = (unsigned int)size_;
+			return true;
+		}
+
+		while (pos_ + sizeof(EventRecordHeader) <= size_) {
+			EventRecordHeader h;
+			memcpy(&h, data_ + pos_, sizeof(h));
+			bool known = h.type >= kText && h.type <= kHandleSummary;
+			if (h.magic != kEventMagic || !known || h.size < sizeof(h) || h.size > size_ - pos_) {
+				// Records start on even offsets (all sizes are even).
+				pos_ += 2;
+				skipped_ += 2;
+				continue;
+			}
+			out->type = (EventRecordType)h.type;
+			out->data = data_ + pos_;
+			out->size = h.size;
+			pos_ += h.size;
+			return true;
+		}
+		skipped_ += size_ - pos_;
+		pos_ = size_;
+		return false;
+	}
+
+	bool DecodeHandleSummary(const EventView& view, EventHandleSummary* out)
+	{
+		if (view.type != kHandleSummary || view.size < sizeof(EventHandleSummary)) {
+			return false;
+		}
+		memcpy(out, view.data, sizeof(EventHandleSummary));
+		return true;
+	}
+
+	bool DecodePath(const EventView& view, EventPathRecord* out, std::u16string* path)
+	{
+		if ((view.type != kProcessPath && view.type != kFilePath) || view.size < sizeof(EventPathRecord)) {
+			return false;
+		}
+		memcpy(out, view.data, sizeof(EventPathRecord));
+		if (sizeof(EventPathRecord) + (size_t)out->chars * 2 > view.size) {
+			return false;
+		}
+		path->resize(out->chars);
+		memcpy(&(*path)[0], view.data + sizeof(EventPathRecord), (size_t)out->chars * 2);
+		return true;
+	}
+
+	bool DecodeText(const EventView& view, std::u16string* text)
+	{
+		if (view.type != kText) {
+			return false;
+		}
+		// A legacy log has no header in front of the text.
+		size_t header = ReadU16(view.data) == kEventMagic ? sizeof(EventRecordHeader) : 0;
+		size_t chars = (view.size - header) / 2;
+		text->resize(chars);
+		if (chars != 0) {
+			memcpy(&(*text)[0], view.data + header, chars * 2);
+		}
+		return true;
+	}
+
+	std::u16string FormatHandleSummary(const EventHandleSummary& rec)
+	{
+		std::u16string out;
+		out.reserve(256);
+		AppendAscii(out, "O,");
+		AppendUnsigned(out, rec.pid);
+		AppendUnsigned(out, rec.path_hash);
+		AppendNumber(out, rec.file_size);
+
+		AppendFlag(out, rec.flags, kFlagRead);
+		AppendFlag(out, rec.flags, kFlagModified);
+
+		// READ
+		AppendNumber(out, rec.read_entropy[kEntropyWhole]);
+		AppendNumber(out, rec.first_read_timestamp);
+		AppendNumber(out, rec.last_read_timestamp);
+		AppendNumber(out, rec.read_cnt_bytes);
+		AppendNumber(out, rec.read_cnt_times);
+
+		// WRITE
+		AppendNumber(out, rec.write_entropy[kEntropyWhole]);
+		AppendNumber(out, rec.first_write_timestamp);
+		AppendNumber(out, rec.last_write_timestamp);
+		AppendNumber(out, rec.write_cnt_bytes);
+		AppendNumber(out, rec.write_cnt_times);
+
+		// RENAME
+		AppendFlag(out, rec.flags, kFlagRenamed);
+		AppendUnsigned(out, rec.new_path_hash);
+
+		// CREATE / DELETE
+		AppendFlag(out, rec.flags, kFlagCreated);
+		AppendFlag(out, rec.flags, kFlagDeleted);
+
+		// FLAGS
+		AppendFlag(out, rec.flags, kFlagAlloc);
+		AppendFlag(out, rec.flags, kFlagEof);
+		AppendFlag(out, rec.flags, kFlagFvdli);
+		AppendFlag(out, rec.flags, kFlagFsOw);
+		AppendFlag(out, rec.flags, kFlagFsWre);
+		AppendFlag(out, rec.flags, kFlagFsSzd);
+		AppendFlag(out, rec.flags, kFlagMmapOpen);
+		AppendFlag(out, rec.flags, kFlagMmapModified);
+
+		// READ / WRITE head, tail entropy
+		AppendNumber(out, rec.read_entropy[kEntropyHead]);
+		AppendNumber(out, rec.read_entropy[kEntropyTail]);
+		AppendNumber(out, rec.write_entropy[kEntropyHead]);
+		AppendNumber(out, rec.write_entropy[kEntropyTail]);
+		out.back() = u'\n';
+		return out;
+	}
+
+	std::u16string FormatRecord(const EventView& view)
+	{
+		std::u16string out;
+		switch (view.type)
+		{
+		case kText:
+			DecodeText(view, &out);
+			break;
+		case kProcessPath:
+		case kFilePath:
+		{
+			EventPathRecord rec;
+			std::u16string path;
+			if (DecodePath(view, &rec, &path)) {
+				AppendAscii(out, view.type == kProcessPath ? "P," : "F,");
+				AppendUnsigned(out, rec.key);
+				out += path;
+				out.push_back(u'\n');
+			}
+			break;
+		}
+		case kHandleSummary:
+		{
+			EventHandleSummary rec;
+			if (DecodeHandleSummary(view, &rec)) {
+				out = FormatHandleSummary(rec);
+			}
+			break;
+		}
+		}
+		return out;
+	}
+
+	std::string Utf16ToUtf8(const std::u16string& text)
+	{
+		std::string out;
+		out.reserve(text.size());
+		for (size_t i = 0; i < text.size(); i++) {
+			unsigned int cp = text[i];
+			if (cp >= 0xD800 && cp < 0xDC00 && i + 1 < text.size() && text[i + 1] >= 0xDC00 && text[i + 1] < 0xE000) {
+				cp = 0x10000 + ((cp - 0xD800) << 10) + (text[i + 1] - 0xDC00);
+				i++;
+			}
+			if (cp < 0x80) {
+				out.push_back((char)cp);
+			}
+			else if (cp < 0x800) {
+				out.push_back((char)(0xC0 | (cp >> 6)));
+				out.push_back((char)(0x80 | (cp & 0x3F)));
+			}
+			else if (cp < 0x10000) {
+				out.push_back((char)(0xE0 | (cp >> 12)));
+				out.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+				out.push_back((char)(0x80 | (cp & 0x3F)));
+			}
+			else {
+				out.push_back((char)(0xF0 | (cp >> 18)));
+				out.push_back((char)(0x80 | ((cp >> 12) & 0x3F)));
+				out.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+				out.push_back((char)(0x80 | (cp & 0x3F)));
+			}
+		}
+		return out;
+	}
+
+}  // namespace evt
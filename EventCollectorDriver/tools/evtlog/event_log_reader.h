@@ -0,0 +1,52 @@
+#pragma once
+
+// User-mode reader for the collector log (com/event_record.h). Builds on
+// Windows and Linux; text comes out as UTF-16 (char16_t) so the legacy log
+// can be reproduced byte for byte.
+
+#include "../../com/event_record.h"
+
+#include <cstddef>
+#include <string>
+
+namespace evt {
+
+	struct EventView {
+		EventRecordType type;
+		const unsigned char* data;  // whole record, header included
+		unsigned int size;
+	};
+
+	class EventLogReader {
+	public:
+		EventLogReader(const unsigned char* data, size_t size);
+
+		// Next well-formed record. Garbage between records (a torn write at a
+		// log rotation, say) is skipped and counted. A log written before the
+		// binary format comes out as a single kText view.
+		bool Next(EventView* out);
+
+		unsigned long long SkippedBytes() const { return skipped_; }
+		bool IsLegacyText() const { return legacy_; }
+
+	private:
+		const unsigned char* data_;
+		size_t size_;
+		size_t pos_ = 0;
+		unsigned long long skipped_ = 0;
+		bool legacy_ = false;
+	};
+
+	// Copies the fixed part out of the view (records are not aligned in the
+	// file). false if the view has the wrong type or is too short.
+	bool DecodeHandleSummary(const EventView& view, EventHandleSummary* out);
+	bool DecodePath(const EventView& view, EventPathRecord* out, std::u16string* path);
+	bool DecodeText(const EventView& view, std::u16string* text);
+
+	// The line the driver used to write for this record, '\n' included.
+	std::u16string FormatHandleSummary(const EventHandleSummary& rec);
+	std::u16string FormatRecord(const EventView& view);
+
+	std::string Utf16ToUtf8(const std::u16string& text);
+
+}  // namespace evt
@@ -0,0 +1,138 @@
+"""
+Python reader for the collector log (com/event_record.h), the same decoding
+as event_log_reader.cpp, for the evaluation scripts.
+
+    import evtlog
+    for line in evtlog.iter_lines(path):   # 'P,...', 'F,...', 'O,...' or text, '\n' included
+        ...
+
+A log written before the binary format (plain UTF-16LE text) is passed
+through line by line. Paths are UTF-16 as the driver saw them and may hold
+lone surrogates, so text is decoded with errors='replace' instead of failing.
+
+Run as a script it prints the text form of a log, like evtlog2csv:
+    python evtlog.py <log>
+"""
+import struct
+import sys
+
+EVENT_MAGIC = 0xEC5A
+
+TEXT = 1
+PROCESS_PATH = 2
+FILE_PATH = 3
+HANDLE_SUMMARY = 4
+
+_HEADER = struct.Struct('<HBBI')                 # EventRecordHeader
+_PATH = struct.Struct('<HBBIQII')                # EventPathRecord
+_SUMMARY = struct.Struct('<HBBIIIQQq' + 'q' * 8 + 'I' * 6)    # EventHandleSummary
+
+# EventHandleFlags
+FLAG_READ = 1 << 0
+FLAG_MODIFIED = 1 << 1
+FLAG_RENAMED = 1 << 2
+FLAG_CREATED = 1 << 3
+FLAG_DELETED = 1 << 4
+FLAG_ALLOC = 1 << 5
+FLAG_EOF = 1 << 6
+FLAG_FVDLI = 1 << 7
+FLAG_FS_OW = 1 << 8
+FLAG_FS_WRE = 1 << 9
+FLAG_FS_SZD = 1 << 10
+FLAG_MMAP_OPEN = 1 << 11
+FLAG_MMAP_MODIFIED = 1 << 12
+
+assert _HEADER.size == 8 and _PATH.size == 24 and _SUMMARY.size == 128
+
+
+def _utf16(data):
+    return data.decode('utf-16-le', errors='replace')
+
+
+def is_legacy_text(data):
+    return len(data) >= 2 and struct.unpack_from('<H', data)[0] != EVENT_MAGIC
+
+
+def iter_records(data):
+    """
+    Yields (type, record bytes, header included) for every well-formed
+    record. Garbage between records is skipped, as EventLogReader::Next does.
+    """
+    pos = 0
+    end = len(data)
+    while pos + _HEADER.size <= end:
+        magic, rtype, _, size = _HEADER.unpack_from(data, pos)
+        if magic != EVENT_MAGIC or not TEXT <= rtype <= HANDLE_SUMMARY or size < _HEADER.size or size > end - pos:
+            # Records start on even offsets (all sizes are even).
+            pos += 2
+            continue
+        yield rtype, data[pos:pos + size]
+        pos += size
+
+
+def format_handle_summary(rec):
+    """The O line FormatHandleSummary writes, from the record bytes."""
+    (_, _, _, _, pid, flags, path_hash, new_path_hash, file_size,
+     first_read, last_read, read_bytes, read_times,
+     first_write, last_write, write_bytes, write_times,
+     r_whole, r_head, r_tail, w_whole, w_head, w_tail) = _SUMMARY.unpack_from(rec)
+
+    def flag(bit):
+        return 1 if flags & bit else 0
+
+    fields = [
+        'O', pid, path_hash, file_size,
+        flag(FLAG_READ), flag(FLAG_MODIFIED),
+        r_whole, first_read, last_read, read_bytes, read_times,
+        w_whole, first_write, last_write, write_bytes, write_times,
+        flag(FLAG_RENAMED), new_path_hash,
+        flag(FLAG_CREATED), flag(FLAG_DELETED),
+        flag(FLAG_ALLOC), flag(FLAG_EOF), flag(FLAG_FVDLI), flag(FLAG_FS_OW),
+        flag(FLAG_FS_WRE), flag(FLAG_FS_SZD), flag(FLAG_MMAP_OPEN), flag(FLAG_MMAP_MODIFIED),
+        r_head, r_tail, w_head, w_tail,
+    ]
+    return ','.join(str(f) for f in fields) + '\n'
+
+
+def format_record(rtype, rec):
+    """The text the driver used to write for one record, '' if malformed."""
+    if rtype == TEXT:
+        return _utf16(rec[_HEADER.size:])
+    if rtype in (PROCESS_PATH, FILE_PATH):
+        if len(rec) < _PATH.size:
+            return ''
+        key, chars = _PATH.unpack_from(rec)[4:6]
+        if _PATH.size + chars * 2 > len(rec):
+            return ''
+        path = _utf16(rec[_PATH.size:_PATH.size + chars * 2])
+        return f"{'P' if rtype == PROCESS_PATH else 'F'},{key},{path}\n"
+    if rtype == HANDLE_SUMMARY and len(rec) >= _SUMMARY.size:
+        return format_handle_summary(rec)
+    return ''
+
+
+def iter_lines_from_bytes(data):
+    if is_legacy_text(data):
+        yield from _utf16(data).splitlines(keepends=True)
+        return
+    for rtype, rec in iter_records(data):
+        text = format_record(rtype, rec)
+        if rtype == TEXT:
+            yield from text.splitlines(keepends=True)
+        elif text:
+            yield text
+
+
+def iter_lines(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    yield from iter_lines_from_bytes(data)
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 2:
+        print('usage: evtlog.py <log>', file=sys.stderr)
+        sys.exit(1)
+    out = sys.stdout.buffer
+    for line in iter_lines(sys.argv[1]):
+        out.write(line.encode('utf-8', errors='replace'))
@@ -0,0 +1,81 @@
+/*
+Converts a collector log (LOG_PATH, binary since the event record format)
+back to the text lines the driver used to write.
+
+Usage: evtlog2csv [--utf16] [-o out] <log>
+  --utf16  write UTF-16LE like the old log (default UTF-8)
+  -o out   output file (default stdout)
+
+A summary (records per type, bytes per handle summary, skipped bytes) goes
+to stderr.
+*/
+#include "event_log_reader.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+	bool utf16 = false;
+	const char* out_path = nullptr;
+	const char* in_path = nullptr;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--utf16") == 0) {
+			utf16 = true;
+		}
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			out_path = argv[++i];
+		}
+		else {
+			in_path = argv[i];
+		}
+	}
+	if (in_path == nullptr) {
+		fprintf(stderr, "usage: evtlog2csv [--utf16] [-o out] <log>\n");
+		return 1;
+	}
+
+	std::ifstream in(in_path, std::ios::binary);
+	if (!in) {
+		fprintf(stderr, "cannot open %s\n", in_path);
+		return 1;
+	}
+	std::vector<unsigned char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	FILE* out = out_path != nullptr ? fopen(out_path, "wb") : stdout;
+	if (out == nullptr) {
+		fprintf(stderr, "cannot create %s\n", out_path);
+		return 1;
+	}
+
+	unsigned long long counts[evt::kHandleSummary + 1] = {};
+	unsigned long long text_bytes = 0;
+	evt::EventLogReader reader(data.data(), data.size());
+	evt::EventView view;
+	while (reader.Next(&view)) {
+		counts[view.type]++;
+		std::u16string line = evt::FormatRecord(view);
+		if (utf16) {
+			fwrite(line.data(), sizeof(char16_t), line.size(), out);
+			text_bytes += line.size() * sizeof(char16_t);
+		}
+		else {
+			std::string utf8 = evt::Utf16ToUtf8(line);
+			fwrite(utf8.data(), 1, utf8.size(), out);
+			text_bytes += utf8.size();
+		}
+	}
+	if (out != stdout) {
+		fclose(out);
+	}
+
+	fprintf(stderr, "%s%zu bytes in, %llu bytes out, %llu skipped\n",
+		reader.IsLegacyText() ? "legacy text log, " : "", data.size(), text_bytes, reader.SkippedBytes());
+	fprintf(stderr, "text %llu, process paths %llu, file paths %llu, handle summaries %llu (%zu bytes each)\n",
+		counts[evt::kText], counts[evt::kProcessPath], counts[evt::kFilePath], counts[evt::kHandleSummary],
+		sizeof(evt::EventHandleSummary));
+	return 0;
+}
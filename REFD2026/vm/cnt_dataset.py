@@ -1,6 +1,15 @@
 from collections import defaultdict
 import os
 import re
+import struct
+import sys
+
+# The collector log is binary (EventCollectorDriver/com/event_record.h).
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'EventCollectorDriver', 'tools', 'evtlog'))
+import evtlog
+# Scan results pulled next to each log (RansomDetectorService manager/scan_result_writer.h).
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'VmControl', 'code'))
+import scan_result_reader
 
 HOST_ROOT_LOG_DIRS = [
     "D:\\MalwareBazaarRun\\logs_refd",
@@ -10,23 +19,37 @@ def is_ransom_work(log_path):
     if not os.path.exists(log_path):
         return False
     try:
-        with open(log_path, 'r', encoding='utf-16-le', errors="ignore") as f:
-            for line in f:
-                if "hieunt-" in line.lower():
-                    return True
-    except Exception:
+        for line in evtlog.iter_lines(log_path):
+            if "hieunt-" in line.lower():
+                return True
+    except OSError:
         pass
     return False
 
+def count_scans(scan_result_path):
+    """Number of scans the service recorded, 0 when there is no readable file."""
+    if not os.path.exists(scan_result_path):
+        return 0
+    try:
+        result = scan_result_reader.ReadScanResults(scan_result_path)
+    except (OSError, ValueError, struct.error):
+        return 0
+    return len(result["columns"]["ts_ms"])
+
 ransom_list = set()
 matched_list = set()
+matched_scans = 0
 
 for rld in HOST_ROOT_LOG_DIRS:
     for root, dirs, files in os.walk(rld):
         for fn in files:
+            if fn.endswith(".rscb"):
+                continue
             path = os.path.join(root, fn)
             ransom_list.add(fn)
             if is_ransom_work(path):
                 matched_list.add(fn)
+                matched_scans += count_scans(os.path.splitext(path)[0] + ".rscb")
 
-print(f"{len(matched_list)}/{len(ransom_list)} files match")
\ No newline at end of file
+print(f"{len(matched_list)}/{len(ransom_list)} files match")
+print(f"{matched_scans} scans recorded for the matching samples")
\ No newline at end of file
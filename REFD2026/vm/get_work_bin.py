@@ -1,5 +1,10 @@
 import os
 import shutil
+import sys
+
+# The collector log is binary (EventCollectorDriver/com/event_record.h).
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'EventCollectorDriver', 'tools', 'evtlog'))
+import evtlog
 
 # ================= CONFIG =================
 HOST_ROOT_LOG_DIRS = [
@@ -9,7 +14,6 @@ HOST_ROOT_LOG_DIRS = [
 MALWARE_SRC_DIR = r"D:\MalwareBazaarFinal"
 MALWARE_DST_DIR = r"D:\MalwareBazaarWork"
 
-LOG_ENCODING = "utf-16-le"
 KEYWORD = "hieunt-"
 # ==========================================
 
@@ -20,11 +24,10 @@ def is_ransom_work(log_path: str) -> bool:
     if not os.path.isfile(log_path):
         return False
     try:
-        with open(log_path, "r", encoding=LOG_ENCODING, errors="ignore") as f:
-            for line in f:
-                if KEYWORD in line.lower():
-                    return True
-    except Exception:
+        for line in evtlog.iter_lines(log_path):
+            if KEYWORD in line.lower():
+                return True
+    except OSError:
         pass
     return False
 
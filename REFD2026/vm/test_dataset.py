@@ -1,6 +1,7 @@
 import os
 import sys
 import time
+import struct
 import shutil
 import random
 import threading
@@ -10,6 +11,13 @@ from multiprocessing import Process, Lock, Manager
 
 from vix import VixHost, VixError, VixVM
 
+# The collector log is binary (EventCollectorDriver/com/event_record.h).
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'EventCollectorDriver', 'tools', 'evtlog'))
+import evtlog
+# The service's scan results are columnar (RansomDetectorService manager/scan_result_writer.h).
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'VmControl', 'code'))
+import scan_result_reader
+
 
 # ============================
 # CONFIG
@@ -23,6 +31,7 @@ HOST_NOT_COMPATIBLE_DIR = "D:\\MalwareBazaarRun\\not_compatible"
 GUEST_DOWNLOAD_DIR = "C:\\Users\\hieu\\Downloads\\"
 GUEST_LOG_PATH = "C:\\Windows\\EventCollectorDriver.log"
 GUEST_TYPE_LOG_PATH = "C:\\Windows\\TypeCollector.log"
+GUEST_SCAN_RESULT_PATH = "C:\\hieunt_scan_result.rscb"
 
 STOP_FILE = "E:\\Code\\Github\\REFD\\REFD2026\\vm\\ggez.txt"
 
@@ -183,15 +192,23 @@ def is_ransom_work(log_path):
     if not os.path.exists(log_path):
         return False
     try:
-        with open(log_path, 'r', encoding='utf-16-le') as f:
-            for line in f:
-                l = line.lower()
-                if "hieunt" in l:
-                    return True
-    except Exception:
+        for line in evtlog.iter_lines(log_path):
+            if "hieunt" in line.lower():
+                return True
+    except OSError:
         pass
     return False
 
+def scan_result_summary(scan_result_path):
+    """(scans, distinct paths, failed scans) from the service's scan results, None if unreadable."""
+    try:
+        result = scan_result_reader.ReadScanResults(scan_result_path)
+    except (OSError, ValueError, struct.error):
+        return None
+    kinds = result["columns"]["kind"]
+    failed = sum(1 for k in kinds if k == ord('e'))
+    return len(kinds), len(result["paths"]), failed
+
 # ============================
 # EVALUATE 1 SAMPLE
 # ============================
@@ -201,6 +218,7 @@ def evaluate_ransom(sample_name: str, vm: VixVM, f, max_run_time, done_event: th
     guest_mal_path = os.path.join(GUEST_DOWNLOAD_DIR, sample_name + ".exe")
     host_log_path = os.path.join(HOST_ROOT_LOG_DIR, sample_name + ".log")
     host_type_log_path = os.path.join(HOST_ROOT_LOG_DIR, sample_name + ".type.log")
+    host_scan_result_path = os.path.join(HOST_ROOT_LOG_DIR, sample_name + ".rscb")
 
     print(f"Evaluating ransomware {sample_name}", flush=True, file=f)
     try:
@@ -231,6 +249,14 @@ def evaluate_ransom(sample_name: str, vm: VixVM, f, max_run_time, done_event: th
                 done_event.set()
                 return False
             pull_log(vm, GUEST_TYPE_LOG_PATH, host_type_log_path, f)
+            try:
+                pull_log(vm, GUEST_SCAN_RESULT_PATH, host_scan_result_path, f)
+            except VixError as ex:
+                # Nothing scanned yet; the service creates the file on start.
+                print(f"No scan results yet: {ex}", flush=True, file=f)
+        summary = scan_result_summary(host_scan_result_path)
+        if summary is not None:
+            print(f"Scan results {sample_name}: {summary[0]} scans, {summary[1]} paths, {summary[2]} failed", flush=True, file=f)
         done_event.set()
         return True
     except VixError as ex:
@@ -253,6 +279,7 @@ def evaluate_ransom(sample_name: str, vm: VixVM, f, max_run_time, done_event: th
 def evaluate_ransom_with_timeout(sample_name: str, vm: VixVM, f, max_run_time_minute, vm_path):
     host_log_path = os.path.join(HOST_ROOT_LOG_DIR, sample_name + ".log")
     host_type_log_path = os.path.join(HOST_ROOT_LOG_DIR, sample_name + ".type.log")
+    host_scan_result_path = os.path.join(HOST_ROOT_LOG_DIR, sample_name + ".rscb")
     done_event = threading.Event()
     t = threading.Thread(target=evaluate_ransom, args=(sample_name, vm, f, max_run_time_minute, done_event, vm_path))
     t.start()
@@ -268,6 +295,10 @@ def evaluate_ransom_with_timeout(sample_name: str, vm: VixVM, f, max_run_time_mi
             os.remove(host_type_log_path)
         except:
             pass
+        try:
+            os.remove(host_scan_result_path)
+        except:
+            pass
         # os._exit(0)
         return 2
     else:
@@ -282,6 +313,10 @@ def evaluate_ransom_with_timeout(sample_name: str, vm: VixVM, f, max_run_time_mi
             os.remove(host_type_log_path)
         except:
             pass
+        try:
+            os.remove(host_scan_result_path)
+        except:
+            pass
         return False
 
 def vm_process(vm_path: str, runtime_log: str, ransom_names, mutex, max_run_time_minute):
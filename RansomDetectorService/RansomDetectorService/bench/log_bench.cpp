@@ -0,0 +1,116 @@
+/*
+Throughput of the debug log (ulti/debug.cpp) with many writer threads, against
+the previous design: a global mutex and one write per line.
+
+The lines go through WriteLogW like scan results do, so a producer that
+outruns the writer thread waits for a free slot and nothing is dropped. The
+rate is lines that reached the file per second, final flush included;
+"waits" counts the lines that found the ring full.
+
+Every 100th line is longer than LOG_SLOT_CHARS and must come out truncated,
+not dropped. Afterwards the writer counters must add up:
+  queued == written == lines, dropped == 0, truncated == long lines.
+Then, with the writer stopped, a result line and a debug line must both be
+dropped without the writer being restarted (a restarted writer would be a
+joinable std::thread at exit, which terminates the process).
+
+Usage: log_bench [threads] [lines_per_thread]
+
+Writes to LOG_PATH (rotating it like the service does) and LOG_PATH.old.
+Exits non-zero when the counters do not add up.
+*/
+#include "ulti/debug.h"
+
+#include <chrono>
+#include <mutex>
+
+namespace {
+	constexpr unsigned int kLongEvery = 100;
+
+	double Seconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	template <typename Fn>
+	double RunWriters(unsigned int threads, unsigned long long lines, Fn&& write_line)
+	{
+		auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> workers;
+		for (unsigned int t = 0; t < threads; t++) {
+			workers.emplace_back([&, t]() {
+				for (unsigned long long i = 0; i < lines; i++) {
+					write_line(t, i);
+				}
+				});
+		}
+		for (auto& w : workers) {
+			w.join();
+		}
+		return Seconds(start);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int threads = argc > 1 ? (unsigned int)atoi(argv[1]) : 16;
+	unsigned long long lines = argc > 2 ? strtoull(argv[2], nullptr, 10) : 100000;
+	if (threads == 0 || lines == 0) {
+		fprintf(stderr, "usage: %s [threads] [lines_per_thread]\n", argv[0]);
+		return 1;
+	}
+	const std::wstring long_text(LOG_SLOT_CHARS * 2, L'x');
+	unsigned long long long_lines = threads * ((lines + kLongEvery - 1) / kLongEvery);
+
+	debug::InitDebugLog();
+	double ring_sec = RunWriters(threads, lines, [&](unsigned int t, unsigned long long i) {
+		if (i % kLongEvery == 0) {
+			debug::WriteLogW(L"%u %llu %ws\n", t, i, long_text.c_str());
+		}
+		else {
+			debug::WriteLogW(L"%u %llu C:\\Users\\bench\\Documents\\report_%llu.docx entropy 7.98\n", t, i, i);
+		}
+		});
+	// Producers are done; the rate includes the final drain and flush.
+	auto drain_start = std::chrono::steady_clock::now();
+	debug::CleanupDebugLog();
+	ring_sec += Seconds(drain_start);
+	debug::LogStats stats = debug::GetLogStats();
+
+	debug::WriteLogW(L"after cleanup\n");
+	debug::WriteDebugToFileW(L"after cleanup\n");
+	ull late_dropped = debug::GetLogStats().lines_dropped - stats.lines_dropped;
+
+	// Previous design: format on the caller, then one write under a lock.
+	platform::File old_file;
+	std::mutex old_lock;
+	old_file.Open(std::wstring(LOG_PATH) + L".old", platform::File::Mode::kCreate);
+	double old_sec = RunWriters(threads, lines, [&](unsigned int t, unsigned long long i) {
+		wchar_t line[LOG_SLOT_CHARS + 1];
+		int n = swprintf(line, LOG_SLOT_CHARS, L"%u %llu C:\\Users\\bench\\Documents\\report_%llu.docx entropy 7.98\n", t, i, i);
+		if (n <= 0) {
+			return;
+		}
+		std::lock_guard<std::mutex> guard(old_lock);
+		old_file.Write(line, n * sizeof(wchar_t));
+		});
+	old_file.Close();
+
+	ull total = threads * lines;
+	printf("# threads %u, lines %llu, ring %u slots x %u chars\n", threads, total, LOG_RING_SLOT_COUNT, LOG_SLOT_CHARS);
+	printf("ring : %.2f M lines/s, queued %llu dropped %llu waits %llu truncated %llu written %llu, %llu writes, %.1f MB, peak depth %llu, %llu rotations\n",
+		stats.lines_written / ring_sec / 1e6, stats.lines_queued, stats.lines_dropped, stats.full_waits, stats.lines_truncated, stats.lines_written,
+		stats.write_calls, stats.bytes_written / 1048576.0, stats.max_queue_depth, stats.rotations);
+	printf("old  : %.2f M lines/s, %llu writes\n", total / old_sec / 1e6, total);
+
+	if (stats.lines_queued != total || stats.lines_written != total || stats.lines_dropped != 0 ||
+		stats.lines_truncated != long_lines || stats.write_errors != 0) {
+		fprintf(stderr, "FAILED: counters do not add up (long lines %llu, write errors %llu)\n", long_lines, stats.write_errors);
+		return 1;
+	}
+	if (late_dropped != 2) {
+		fprintf(stderr, "FAILED: %llu of 2 lines logged after cleanup were dropped\n", late_dropped);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,165 @@
+/*
+Checks and times helper::GetWstrHashCi, the case-insensitive path hash used as
+cache id by the scanner and the ETW controller.
+
+For every path of the corpus:
+  - the hash equals the hash of its platform lowercase copy (the baseline
+    lowercased with CharLowerBuffW before hashing) and of its uppercase copy,
+  - distinct lowercase paths get distinct hashes (64-bit, so any collision in
+    a corpus this size is a bug).
+Then it times GetWstrHashCi against the baseline: a lowercase copy plus
+GetWstrHash. The corpus is hashed over and over (about 2M hashes per
+variant), so a small one stays in cache and the timing is of the hashing,
+not of memory.
+
+Usage: path_hash_bench [dir] [synthetic_count]
+
+Without dir the corpus is synthetic_count generated paths (default 5000)
+mixing ASCII, Latin-1, Greek, Cyrillic and CJK components. On POSIX the
+platform lowercase is towlower, so the C.UTF-8 locale is selected first.
+Exits non-zero on any mismatch or collision.
+*/
+#include "ulti/file_helper.h"
+
+#include <chrono>
+#include <clocale>
+#include <cwctype>
+#include <filesystem>
+#include <random>
+#include <unordered_map>
+
+namespace {
+	// Letters whose lower/upper forms map back and forth one to one.
+	const wchar_t* const kAlphabets[] = {
+		L"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-",
+		L"\u00e0\u00e1\u00e2\u00e4\u00e7\u00e8\u00e9\u00ea\u00f1\u00f6\u00fc\u00c0\u00c1\u00c2\u00c4\u00c7\u00c8\u00c9\u00ca\u00d1\u00d6\u00dc",
+		L"\u03b1\u03b2\u03b3\u03b4\u03b5\u03b6\u03b7\u03b8\u0391\u0392\u0393\u0394\u0395\u0396\u0397\u0398",
+		L"\u0430\u0431\u0432\u0433\u0434\u0435\u0436\u0437\u0410\u0411\u0412\u0413\u0414\u0415\u0416\u0417",
+		L"\u6587\u4ef6\u6570\u636e\u5907\u4efd\u7167\u7247",
+	};
+
+	std::wstring MakePath(std::mt19937& rng)
+	{
+		std::wstring path = L"C:\\Users\\";
+		size_t depth = 2 + rng() % 5;
+		for (size_t d = 0; d < depth; d++) {
+			const wchar_t* alphabet = kAlphabets[rng() % 8 < 5 ? 0 : 1 + rng() % 4];
+			size_t n = wcslen(alphabet);
+			size_t len = 1 + rng() % 20;
+			for (size_t i = 0; i < len; i++) {
+				path += alphabet[rng() % n];
+			}
+			path += d + 1 == depth ? L".docx" : L"\\";
+		}
+		return path;
+	}
+
+	std::wstring Lower(std::wstring s)
+	{
+		platform::ToLowerInPlace(s.data(), s.size());
+		return s;
+	}
+
+	std::wstring Upper(std::wstring s)
+	{
+		for (auto& c : s) {
+			c = (wchar_t)towupper((wint_t)c);
+		}
+		return s;
+	}
+
+	double Seconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+int main(int argc, char** argv)
+{
+#ifndef _WIN32
+	if (setlocale(LC_CTYPE, "C.UTF-8") == nullptr) {
+		fprintf(stderr, "C.UTF-8 locale not available, non-Latin folding is not checked\n");
+	}
+#endif
+
+	std::vector<std::wstring> paths;
+	if (argc >= 2 && argv[1][0] != '\0') {
+		std::error_code ec;
+		for (auto it = std::filesystem::recursive_directory_iterator(argv[1],
+			std::filesystem::directory_options::skip_permission_denied, ec);
+			it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+			if (ec) {
+				break;
+			}
+			try {
+				paths.push_back(it->path().wstring());
+			}
+			catch (const std::exception&) {
+				// not valid in the current locale
+			}
+		}
+	}
+	else {
+		size_t count = argc >= 3 ? (size_t)strtoull(argv[2], nullptr, 10) : 5000;
+		std::mt19937 rng(20260401);
+		paths.reserve(count);
+		for (size_t i = 0; i < count; i++) {
+			paths.push_back(MakePath(rng));
+		}
+	}
+	if (paths.empty()) {
+		fprintf(stderr, "empty corpus\n");
+		return 1;
+	}
+
+	ull mismatches = 0;
+	ull collisions = 0;
+	std::unordered_map<ull, std::wstring> seen;
+	seen.reserve(paths.size());
+	for (const auto& path : paths) {
+		std::wstring lower = Lower(path);
+		ull hash = helper::GetWstrHashCi(path);
+		if (hash != helper::GetWstrHashCi(lower)) {
+			mismatches++;
+		}
+		std::wstring upper = Upper(path);
+		if (Lower(upper) == lower && hash != helper::GetWstrHashCi(upper)) {
+			mismatches++;
+		}
+		auto [it, inserted] = seen.emplace(hash, lower);
+		if (!inserted && it->second != lower) {
+			collisions++;
+		}
+	}
+
+	// Keep the results alive so neither loop is optimized away.
+	ull sink = 0;
+	size_t rounds = (std::max)((size_t)1, (size_t)2000000 / paths.size());
+	double hashes = (double)rounds * paths.size();
+	auto start = std::chrono::steady_clock::now();
+	for (size_t r = 0; r < rounds; r++) {
+		for (const auto& path : paths) {
+			sink += helper::GetWstrHashCi(path);
+		}
+	}
+	double fused_sec = Seconds(start);
+
+	start = std::chrono::steady_clock::now();
+	for (size_t r = 0; r < rounds; r++) {
+		for (const auto& path : paths) {
+			sink += helper::GetWstrHash(Lower(path));
+		}
+	}
+	double baseline_sec = Seconds(start);
+
+	printf("paths %zu distinct %zu mismatches %llu collisions %llu, %zu rounds\n", paths.size(), seen.size(), mismatches, collisions, rounds);
+	printf("fused    : %.1f ns/path\n", fused_sec * 1e9 / hashes);
+	printf("baseline : %.1f ns/path (lowercase copy + GetWstrHash)\n", baseline_sec * 1e9 / hashes);
+	printf("# %llx\n", sink);
+
+	if (mismatches != 0 || collisions != 0) {
+		fprintf(stderr, "FAILED\n");
+		return 1;
+	}
+	return 0;
+}
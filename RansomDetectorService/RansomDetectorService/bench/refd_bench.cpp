@@ -0,0 +1,104 @@
+/*
+Offline driver for the detection core: walks a directory tree, feeds every
+regular file through Receiver -> Scanner -> FileType exactly as ETW events
+would, then prints throughput and the perf::Report() latency table.
+
+Usage: refd_bench <dir> [pid_count]
+
+pid_count spreads the files over that many fake pids (default 8) so the
+Scanner's per-pid round robin is exercised the same way as in the service.
+*/
+#include "ulti/support.h"
+#include "manager/scanner.h"
+#include "manager/receiver.h"
+#include "manager/file_type_iden.h"
+#include "ulti/perf_stats.h"
+
+#include <filesystem>
+
+namespace {
+	constexpr ull kIdleTimeoutMs = 30'000;
+	constexpr uint32_t kPollMs = 50;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <dir> [pid_count]\n", argv[0]);
+		return 1;
+	}
+	ULONG pid_count = argc >= 3 ? (ULONG)strtoul(argv[2], nullptr, 10) : 8;
+	if (pid_count == 0) {
+		pid_count = 1;
+	}
+
+	std::vector<std::wstring> paths;
+	ull total_bytes = 0;
+	std::error_code ec;
+	for (auto it = std::filesystem::recursive_directory_iterator(argv[1],
+		std::filesystem::directory_options::skip_permission_denied, ec);
+		it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+		if (ec) {
+			break;
+		}
+		if (it->is_regular_file(ec) == false) {
+			continue;
+		}
+		paths.push_back(it->path().wstring());
+		total_bytes += it->file_size(ec);
+	}
+	if (paths.empty()) {
+		fprintf(stderr, "no files under %s\n", argv[1]);
+		return 1;
+	}
+
+	debug::InitDebugLog();
+	perf::Start();
+
+	auto ft = type_iden::FileType::GetInstance();
+	auto rcv = manager::Receiver::GetInstance();
+	auto scanner = manager::Scanner::GetInstance();
+	if (ft->Init() == false || rcv->Init() == false || scanner->Init() == false) {
+		fprintf(stderr, "init failed\n");
+		return 1;
+	}
+
+	ull start_ms = ulti::GetCurrentSteadyTimeInMs();
+	for (size_t i = 0; i < paths.size(); i++) {
+		rcv->PushFileEventSync(paths[i], (ULONG)(i % pid_count) + 1);
+	}
+
+	// Wait until every file has been picked up, or nothing moved for a while.
+	ull last_scanned = 0;
+	ull last_progress_ms = ulti::GetCurrentSteadyTimeInMs();
+	while (true) {
+		ull scanned = perf::CounterValue(perf::Counter::kFilesScanned);
+		ull now_ms = ulti::GetCurrentSteadyTimeInMs();
+		if (scanned >= paths.size()) {
+			break;
+		}
+		if (scanned != last_scanned) {
+			last_scanned = scanned;
+			last_progress_ms = now_ms;
+		}
+		else if (now_ms - last_progress_ms > kIdleTimeoutMs) {
+			fprintf(stderr, "stalled at %llu/%zu files\n", scanned, paths.size());
+			break;
+		}
+		platform::SleepMs(kPollMs);
+	}
+	ull elapsed_ms = ulti::GetCurrentSteadyTimeInMs() - start_ms;
+
+	scanner->Uninit();
+	rcv->Uninit();
+	ft->Uninit();
+	perf::Stop();
+	debug::CleanupDebugLog();
+
+	double seconds = (std::max)(elapsed_ms, 1ULL) / 1000.0;
+	printf("files %zu bytes %llu elapsed_ms %llu files_per_s %.1f mb_per_s %.1f\n",
+		paths.size(), total_bytes, elapsed_ms,
+		paths.size() / seconds, total_bytes / seconds / (1024.0 * 1024.0));
+	printf("%s", perf::Report().c_str());
+	return 0;
+}
@@ -0,0 +1,248 @@
+#include "driver_channel.h"
+#include "receiver.h"
+#include "../ulti/file_helper.h"
+#include "../../../../EventCollectorDriver/com/shared_ring.h"
+
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include <fltUser.h>
+#pragma comment(lib, "fltlib.lib")
+
+#define DRIVER_PORT_NAME L"\\hieunt_mf"
+#define DRIVER_CHANNEL_IDLE_MS 100
+
+// One rule per line, "prefix|ext|image <text>"; '#' starts a comment. Paths
+// may be DOS ("C:\Windows\") or NT ("\device\harddiskvolume3\windows\").
+// UTF-8, with or without a BOM, or UTF-16 with a BOM (Notepad's "Unicode").
+// When the file is missing the driver excludes nothing at open time.
+#define DRIVER_FILTER_RULES_PATH L"C:\\hieunt_filter_rules.txt"
+
+namespace manager
+{
+    // The whole file, decoded by its BOM; UTF-8 when it has none. false
+    // when it cannot be opened.
+    static bool ReadRulesText(const wchar_t* path, std::wstring* text)
+    {
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs.is_open()) {
+            return false;
+        }
+        std::string bytes((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        const unsigned char* b = (const unsigned char*)bytes.data();
+        if (bytes.size() >= 2 && ((b[0] == 0xFF && b[1] == 0xFE) || (b[0] == 0xFE && b[1] == 0xFF))) {
+            bool big_endian = b[0] == 0xFE;
+            text->clear();
+            for (ull i = 2; i + 1 < bytes.size(); i += 2) {
+                text->push_back(big_endian ? (wchar_t)(b[i] << 8 | b[i + 1]) : (wchar_t)(b[i + 1] << 8 | b[i]));
+            }
+            return true;
+        }
+        if (bytes.size() >= 3 && b[0] == 0xEF && b[1] == 0xBB && b[2] == 0xBF) {
+            bytes.erase(0, 3);
+        }
+        *text = ulti::StrToWstr(bytes);
+        return true;
+    }
+
+    DriverChannel* DriverChannel::GetInstance()
+    {
+        static DriverChannel instance;
+        return &instance;
+    }
+
+    DriverChannel::~DriverChannel()
+    {
+        Stop();
+    }
+
+    bool DriverChannel::Start()
+    {
+        if (drain_thread_.joinable()) {
+            return true;
+        }
+
+        HRESULT hr = FilterConnectCommunicationPort(DRIVER_PORT_NAME, 0, nullptr, 0, nullptr, &port_);
+        if (FAILED(hr)) {
+            PrintDebugW(L"FilterConnectCommunicationPort failed: 0x%x", hr);
+            port_ = INVALID_HANDLE_VALUE;
+            return false;
+        }
+
+        if (Attach() == false) {
+            Detach();
+            return false;
+        }
+
+        LoadFilterRules();
+
+        stop_ = false;
+        drain_thread_ = std::thread(&DriverChannel::DrainLoop, this);
+        return true;
+    }
+
+    void DriverChannel::Stop()
+    {
+        if (drain_thread_.joinable()) {
+            stop_ = true;
+            SetEvent(event_);
+            drain_thread_.join();
+        }
+        Detach();
+    }
+
+    bool DriverChannel::Attach()
+    {
+        event_ = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+        if (event_ == nullptr) {
+            PrintDebugW(L"CreateEventW failed: %d", GetLastError());
+            return false;
+        }
+
+        shm::ChannelControl control = {};
+        control.command = shm::kChannelAttach;
+        control.version = shm::kChannelVersion;
+        control.event = (unsigned long long)event_;
+
+        shm::ChannelAttachReply reply = {};
+        DWORD returned = 0;
+        HRESULT hr = FilterSendMessage(port_, &control, sizeof(control), &reply, sizeof(reply), &returned);
+        if (FAILED(hr) || returned < sizeof(reply) || reply.status < 0) {
+            PrintDebugW(L"Channel attach failed: hr 0x%x, status 0x%x", hr, reply.status);
+            CloseHandle(event_);
+            event_ = nullptr;
+            return false;
+        }
+
+        shm::SharedRingHeader* ring = (shm::SharedRingHeader*)reply.base;
+        if (ring->magic != shm::kChannelMagic || ring->version != shm::kChannelVersion
+            || (ull)ring->header_bytes + ring->capacity > reply.size) {
+            PrintDebugW(L"Channel header mismatch");
+            return false;
+        }
+
+        ring_ = ring;
+        ring_size_ = reply.size;
+        PrintDebugW(L"Channel attached, %llu bytes at %p", ring_size_, ring_);
+        return true;
+    }
+
+    void DriverChannel::Detach()
+    {
+        // Closing the port makes the driver unmap the ring as well; the
+        // explicit detach just does it while we are still around to log.
+        if (port_ != INVALID_HANDLE_VALUE) {
+            if (ring_ != nullptr) {
+                PrintDebugW(L"Channel detaching, %llu events, %llu dropped", ring_->produced, ring_->dropped);
+                shm::ChannelControl control = {};
+                control.command = shm::kChannelDetach;
+                control.version = shm::kChannelVersion;
+                DWORD returned = 0;
+                FilterSendMessage(port_, &control, sizeof(control), nullptr, 0, &returned);
+                ring_ = nullptr;
+            }
+            CloseHandle(port_);
+            port_ = INVALID_HANDLE_VALUE;
+        }
+        if (event_ != nullptr) {
+            CloseHandle(event_);
+            event_ = nullptr;
+        }
+    }
+
+    void DriverChannel::LoadFilterRules()
+    {
+        // Not a wifstream: without a codec it reads each byte as a
+        // character, which garbles any non-ASCII path.
+        std::wstring file_text;
+        if (ReadRulesText(DRIVER_FILTER_RULES_PATH, &file_text) == false) {
+            return;
+        }
+        std::wistringstream ifs(file_text);
+
+        std::vector<unsigned char> message(sizeof(shm::ChannelControl));
+        shm::ChannelControl* control = (shm::ChannelControl*)message.data();
+        control->command = shm::kChannelSetRules;
+        control->version = shm::kChannelVersion;
+
+        ull count = 0;
+        std::wstring line;
+        while (std::getline(ifs, line)) {
+            std::wistringstream ss(line);
+            std::wstring kind_name;
+            if (!(ss >> kind_name) || kind_name[0] == L'#') {
+                continue;
+            }
+            std::wstring text;
+            std::getline(ss >> std::ws, text);
+            while (!text.empty() && (text.back() == L' ' || text.back() == L'\t' || text.back() == L'\r')) {
+                text.pop_back();
+            }
+
+            unsigned short kind = 0;
+            if (kind_name == L"prefix") {
+                kind = shm::kRulePathPrefix;
+                if (text.size() >= 2 && text[1] == L':') {
+                    text = helper::GetNativePath(text);
+                }
+            }
+            else if (kind_name == L"ext") {
+                kind = shm::kRuleExtension;
+            }
+            else if (kind_name == L"image") {
+                kind = shm::kRuleProcessImage;
+                if (text.size() >= 2 && text[1] == L':') {
+                    text = helper::GetNativePath(text);
+                }
+            }
+            if (kind == 0 || text.empty() || text.size() > 0xFFFF) {
+                PrintDebugW(L"Filter rule skipped: %ws", line.c_str());
+                continue;
+            }
+
+            ull at = message.size();
+            message.resize(at + shm::FilterRuleBytes((unsigned int)text.size()));
+            shm::WriteFilterRule(message.data() + at, kind, text.data(), (unsigned short)text.size());
+            count++;
+        }
+
+        if (message.size() - sizeof(shm::ChannelControl) > shm::kFilterRulesMaxBytes) {
+            PrintDebugW(L"Filter rules too large: %llu bytes", (ull)message.size());
+            return;
+        }
+        DWORD returned = 0;
+        HRESULT hr = FilterSendMessage(port_, message.data(), (DWORD)message.size(), nullptr, 0, &returned);
+        PrintDebugW(L"Filter rules sent, %llu rules: hr 0x%x", count, hr);
+    }
+
+    void DriverChannel::DrainLoop()
+    {
+        auto rcv = Receiver::GetInstance();
+        std::wstring path;
+
+        while (stop_ == false) {
+            ull n = shm::DrainSharedRing(*ring_, [&](const shm::ChannelRecord& r) {
+                if (r.type != shm::kChannelPathEvent || r.size < sizeof(shm::PathEventRecord)) {
+                    return;
+                }
+                const shm::PathEventRecord* rec = (const shm::PathEventRecord*)&r;
+                if (sizeof(shm::PathEventRecord) + (ull)rec->chars * sizeof(WCHAR) > r.size) {
+                    return;
+                }
+                path.assign((const WCHAR*)(rec + 1), rec->chars);
+                rcv->PushFileEventSync(path, rec->pid);
+            });
+            if (n != 0) {
+                continue;
+            }
+
+            // The timeout only bounds how long Stop waits; wake-ups come from
+            // the driver setting the event.
+            if (shm::PrepareSharedRingWait(*ring_) == true) {
+                WaitForSingleObject(event_, DRIVER_CHANNEL_IDLE_MS);
+                shm::FinishSharedRingWait(*ring_);
+            }
+        }
+    }
+}
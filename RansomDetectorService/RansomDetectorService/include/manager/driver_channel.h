@@ -0,0 +1,51 @@
+#ifndef MANAGER_DRIVER_CHANNEL_H_
+#define MANAGER_DRIVER_CHANNEL_H_
+
+#include "ulti/support.h"
+#include "ulti/debug.h"
+
+#include <atomic>
+#include <thread>
+
+namespace shm {
+	struct SharedRingHeader;
+}
+
+namespace manager {
+
+	// Consumer side of the EventCollectorDriver shared-memory channel
+	// (EventCollectorDriver/com/shared_ring.h). Connects to the driver's
+	// comport, asks it to map the event ring into this process and feeds each
+	// path event to Receiver::PushFileEventSync from a drain thread. Also
+	// hands the driver its exclusion rules (DRIVER_FILTER_RULES_PATH).
+	class DriverChannel {
+	private:
+		HANDLE port_ = INVALID_HANDLE_VALUE;
+		HANDLE event_ = nullptr;
+		shm::SharedRingHeader* ring_ = nullptr;
+		ull ring_size_ = 0;
+
+		std::thread drain_thread_;
+		std::atomic<bool> stop_{ false };
+
+		DriverChannel() = default;
+		~DriverChannel();
+
+		DriverChannel(const DriverChannel&) = delete;
+		DriverChannel& operator=(const DriverChannel&) = delete;
+
+		bool Attach();
+		void Detach();
+		void DrainLoop();
+		void LoadFilterRules();
+
+	public:
+		static DriverChannel* GetInstance();
+
+		// false when the driver is not loaded; ETW still feeds the receiver.
+		bool Start();
+		void Stop();
+	};
+
+}
+#endif  // MANAGER_DRIVER_CHANNEL_H_
@@ -106,16 +106,21 @@ void EtwController::StartLogger()
 // ================= Event worker queue =================
 void EtwController::EnqueueEvent(EventInfo&& e)
 {
+    e.enqueue_ns = perf::Now();
+    perf::Add(perf::Counter::kEventsReceived);
+
     std::lock_guard<std::mutex> lk(m_evtMutex);
 
     // Drop oldest if too large (avoid RAM blow)
     if (m_evtQueue.size() >= MAX_EVT_QUEUE) {
         // keep queue moving; drop a chunk
         size_t drop = MAX_EVT_QUEUE / 10;
+        perf::Add(perf::Counter::kEventsDropped, (std::min)(drop, m_evtQueue.size()));
         while (drop-- && !m_evtQueue.empty()) m_evtQueue.pop_front();
     }
 
     m_evtQueue.emplace_back(std::move(e));
+    perf::SetGauge(perf::Gauge::kEventQueue, m_evtQueue.size());
 }
 
 void EtwController::EventLoop()
@@ -132,12 +137,17 @@ void EtwController::EventLoop()
             }
             tmpEvtQueue.swap(m_evtQueue);
         }
+        perf::SetGauge(perf::Gauge::kEventQueue, 0);
 
         while (tmpEvtQueue.empty() == false) {
             EventInfo e;
             e = std::move(tmpEvtQueue.front());
             tmpEvtQueue.pop_front();
 
+            ull start_ns = perf::Now();
+            perf::Record(perf::Stage::kEventQueueWait, start_ns - e.enqueue_ns);
+            defer{ perf::Record(perf::Stage::kDispatch, perf::Now() - start_ns); };
+
             try {
                 DispatchEvent(e);
             }
@@ -243,7 +253,7 @@ void EtwController::IHCacheAdd(ULONGLONG ts, const std::wstring& path, ULONGLONG
     cache.emplace(
         name_hash,
         IHEntry{
-            path,
+            ulti::ToLower(path),
             1,          // initial reference
             ts
         }
@@ -272,8 +282,8 @@ bool EtwController::AddToIHCache(ULONGLONG ts, const std::wstring& path, ULONGLO
     if (path.empty())
         return false;
 
-    std::wstring lower = ulti::ToLower(path);
-    ULONGLONG name_hash = helper::GetWstrHash(lower);
+    // Hash case-insensitively in place; the lowercase copy is only built on insert.
+    ULONGLONG name_hash = helper::GetWstrHashCi(path);
     if (out_name_hash != nullptr) {
         *out_name_hash = name_hash;
     }
@@ -283,7 +293,7 @@ bool EtwController::AddToIHCache(ULONGLONG ts, const std::wstring& path, ULONGLO
         return false;
 
     // Otherwise, cache it and increase reference count
-    IHCacheAdd(ts, lower, name_hash);
+    IHCacheAdd(ts, path, name_hash);
     return true;
 }
 
@@ -654,6 +664,8 @@ void EtwController::StartProviderBlocking()
 
     auto file_cb = [this](const EVENT_RECORD& r, const krabs::trace_context& c)
         {
+            perf::ScopedTimer timer(perf::Stage::kEtwCallback);
+
             krabs::schema s(r, c.schema_locator);
             krabs::parser parser(s);
 
@@ -2,6 +2,7 @@
 #pragma once
 #include "ulti/support.h"
 #include "ulti/lru_cache.hpp"
+#include "ulti/perf_stats.h"
 
 #define MAX_CACHE_SIZE 50'000
 #define MAX_EVT_QUEUE  100'000   // prevent unbounded RAM
@@ -23,6 +24,8 @@ struct EventInfo
 
     UINT32 create_options = 0;
     bool has_create_options = false;
+
+    ull enqueue_ns = 0;
 }; 
 
 struct IHEntry {
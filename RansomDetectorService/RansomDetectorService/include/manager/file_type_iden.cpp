@@ -1,6 +1,7 @@
 #include "file_type_iden.h"
 #include "ulti/support.h"
 #include "ulti/debug.h"
+#include "ulti/perf_stats.h"
 #include "../file_type/txt.h"
 #include "../file_type/compress.h"
 #include "../file_type/image.h"
@@ -117,6 +118,10 @@ namespace type_iden
 			PrintDebugW(L"TrID init failed");
 			return false;
 		}
+#else
+		// TrID is a 32-bit Windows DLL; nothing to load elsewhere.
+		(void)defs_dir;
+		(void)trid_dll_path;
 #endif // _M_IX86
 
 		return true;
@@ -132,70 +137,75 @@ namespace type_iden
 
 		*p_status = ERROR_SUCCESS;
 
+		// Declared first so it also covers the TrID fallback below.
+		perf::ScopedTimer timer(perf::Stage::kGetTypes);
+
 #ifdef _M_IX86
 		defer
 		{
 			if (types.size() == 0 && file_size > 0 && file_size <= FILE_MAX_SIZE_SCAN)
 			{
+				ull start_ns = perf::Now();
 				ulti::AddVectorsInPlace(types, trid_->GetTypes(file_path));
+				perf::Record(perf::Validator::kTrid, perf::Now() - start_ns);
 			}
 		};
 #endif // _M_IX86 
 
-		HANDLE file_handle = CreateFileW(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
-			nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
-		if (file_handle == INVALID_HANDLE_VALUE) {
-			*p_status = GetLastError();
+		platform::File file;
+		if (file.Open(file_path, platform::File::Mode::kRead) == false) {
+			*p_status = platform::LastError();
 			return types;
 		}
-		defer{ CloseHandle(file_handle); };
 
-		LARGE_INTEGER li_size{};
-		if (!GetFileSizeEx(file_handle, &li_size)) {
-			*p_status = GetLastError();
+		uint64_t size = 0;
+		if (file.GetSize(&size) == false) {
+			*p_status = platform::LastError();
 			return types;
 		}
 
-		*p_file_size = static_cast<size_t>(li_size.QuadPart);
+		*p_file_size = size;
 		if (*p_file_size > FILE_MAX_SIZE_SCAN) {
 			*p_status = ERROR_FILE_TOO_LARGE;
 			return types;
 		}
 
-		UCHAR* data = (UCHAR*)HeapAlloc(GetProcessHeap(), 0, *p_file_size);
-		if (!data) {
+		std::unique_ptr<UCHAR[]> buffer(new (std::nothrow) UCHAR[*p_file_size]);
+		if (!buffer) {
 			*p_status = ERROR_OUTOFMEMORY;
 			return types;
 		}
-		defer{ HeapFree(GetProcessHeap(), 0, data); };
+		UCHAR* data = buffer.get();
 
-		DWORD bytes_read = 0;
-		BOOL ok = ReadFile(file_handle, data, *p_file_size, &bytes_read, nullptr);
+		size_t bytes_read = 0;
+		bool ok = file.Read(data, *p_file_size, &bytes_read);
 		if (!ok || bytes_read != *p_file_size) {
-			*p_status = GetLastError();
+			*p_status = ok ? ERROR_HANDLE_EOF : platform::LastError();
 			return types;
 		}
 
 		const span<UCHAR> span_data(data, *p_file_size);
 
-		auto TryGetTypes = [&](auto&& fn) -> void {
+		auto TryGetTypes = [&](perf::Validator validator, auto&& fn) -> void {
 			if (types.size() > 0) return; 
+			ull start_ns = perf::Now();
 			auto new_type = fn(span_data);
+			perf::Record(validator, perf::Now() - start_ns);
 			if (!new_type.empty()) {
 				ulti::AddVectorsInPlace(types, new_type);
 			}
 		};
 
-		TryGetTypes(GetPdfTypes);
-		TryGetTypes(GetZipTypes);
-		TryGetTypes(GetRarTypes);
-		TryGetTypes(GetPngTypes);
-		TryGetTypes(GetJpgTypes);
-		TryGetTypes(GetAudioVideoTypes);
-		TryGetTypes(Get7zTypes);
-		TryGetTypes(GetTxtTypes);
-		TryGetTypes(GetZlibTypes);
-		TryGetTypes(GetGzipTypes);
+		TryGetTypes(perf::Validator::kPdf, GetPdfTypes);
+		TryGetTypes(perf::Validator::kZip, GetZipTypes);
+		TryGetTypes(perf::Validator::kRar, GetRarTypes);
+		TryGetTypes(perf::Validator::kPng, GetPngTypes);
+		TryGetTypes(perf::Validator::kJpg, GetJpgTypes);
+		TryGetTypes(perf::Validator::kAudioVideo, GetAudioVideoTypes);
+		TryGetTypes(perf::Validator::k7z, Get7zTypes);
+		TryGetTypes(perf::Validator::kTxt, GetTxtTypes);
+		TryGetTypes(perf::Validator::kZlib, GetZlibTypes);
+		TryGetTypes(perf::Validator::kGzip, GetGzipTypes);
 
 		//TryGetTypes(GetWebpTypes); // Bad performance, do not use.
 		//TryGetTypes(GetOleTypes); // Bad performance, do not implement.
@@ -1,5 +1,6 @@
 #include "receiver.h"
 #include "ulti/file_helper.h"
+#include "ulti/perf_stats.h"
 
 namespace manager
 {
@@ -43,9 +44,11 @@ namespace manager
     void Receiver::MoveQueueSync(std::queue<FileIoInfo>& target_file_io_queue) {
         std::lock_guard<std::mutex> lk(file_io_mutex_);
         target_file_io_queue = std::move(file_io_queue_);
+        perf::SetGauge(perf::Gauge::kReceiverQueue, 0);
     }
 
     void Receiver::PushFileEventSync(const std::wstring& path, ULONG pid) {
+        perf::ScopedTimer timer(perf::Stage::kReceiverPush);
         std::lock_guard<std::mutex> lk(file_io_mutex_);
         if (path.size() == 0) {
             return;
@@ -57,6 +60,7 @@ namespace manager
             return;
         }
         file_io_queue_.push(std::move(info));
+        perf::SetGauge(perf::Gauge::kReceiverQueue, file_io_queue_.size());
         return;
     }
 }
\ No newline at end of file
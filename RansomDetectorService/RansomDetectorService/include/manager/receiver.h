@@ -12,6 +12,7 @@ namespace manager {
 	struct FileIoInfo {
 		ULONG pid = 0;
 		std::wstring path;
+		ull queued_ns = 0;  // Set when handed to a scanner worker
 	};
 
 	class Receiver {
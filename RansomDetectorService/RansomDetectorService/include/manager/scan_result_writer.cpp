@@ -0,0 +1,264 @@
+﻿#include "scan_result_writer.h"
+
+namespace manager {
+    namespace {
+        template <typename T>
+        void Put(std::vector<char>& out, const T& v)
+        {
+            const char* p = reinterpret_cast<const char*>(&v);
+            out.insert(out.end(), p, p + sizeof(T));
+        }
+
+        template <typename T>
+        void PutColumn(std::vector<char>& out, const std::vector<T>& col)
+        {
+            const char* p = reinterpret_cast<const char*>(col.data());
+            out.insert(out.end(), p, p + col.size() * sizeof(T));
+            out.resize((out.size() + 7) & ~size_t(7), 0);
+        }
+
+        // Paths are stored as UTF-16 regardless of sizeof(wchar_t).
+        void PutUtf16(std::vector<char>& out, const std::wstring& ws)
+        {
+            if constexpr (sizeof(wchar_t) == 2) {
+                Put(out, (uint32_t)ws.size());
+                const char* p = reinterpret_cast<const char*>(ws.data());
+                out.insert(out.end(), p, p + ws.size() * sizeof(wchar_t));
+            }
+            else {
+                std::vector<uint16_t> units;
+                units.reserve(ws.size());
+                for (wchar_t c : ws) {
+                    uint32_t cp = (uint32_t)c;
+                    if (cp >= 0x10000) {
+                        cp -= 0x10000;
+                        units.push_back((uint16_t)(0xD800 + (cp >> 10)));
+                        units.push_back((uint16_t)(0xDC00 + (cp & 0x3FF)));
+                    }
+                    else {
+                        units.push_back((uint16_t)cp);
+                    }
+                }
+                Put(out, (uint32_t)units.size());
+                const char* p = reinterpret_cast<const char*>(units.data());
+                out.insert(out.end(), p, p + units.size() * sizeof(uint16_t));
+            }
+        }
+    }
+
+    void ScanResultWriter::Block::Clear()
+    {
+        ts_ms.clear();
+        path_id.clear();
+        type_mask.clear();
+        size.clear();
+        pid.clear();
+        status.clear();
+        validate_us.clear();
+        kind.clear();
+        new_types.clear();
+        new_paths.clear();
+        opened_ms = 0;
+    }
+
+    // ======================================================
+    // Lifecycle
+    // ======================================================
+
+    bool ScanResultWriter::Open(const std::wstring& path)
+    {
+        // Same order as WritePending: block, then file.
+        std::lock_guard<std::mutex> bl(block_mutex_);
+        std::lock_guard<std::mutex> lk(file_mutex_);
+        if (file_.IsOpen() == true) {
+            // Rows already written refer to the dictionaries; keep them.
+            return true;
+        }
+
+        // A new file starts with empty dictionaries, so never append to an old
+        // one, and forget what went into the previous file before the first
+        // row can reach this one.
+        block_.Clear();
+        type_bits_.clear();
+        known_paths_.clear();
+        if (file_.Open(path, platform::File::Mode::kCreate) == false) {
+            PrintDebugW(L"Open %ws failed, error %s", path.c_str(), debug::GetErrorMessage(platform::LastError()).c_str());
+            return false;
+        }
+
+        out_.clear();
+        Put(out_, kFileMagic);
+        Put(out_, kVersion);
+        Put(out_, uint16_t(0));
+        file_.Write(out_.data(), out_.size());
+
+        stop_ = false;
+        flush_thread_ = std::thread(&ScanResultWriter::FlushThread, this);
+        return true;
+    }
+
+    void ScanResultWriter::Close()
+    {
+        {
+            std::lock_guard<std::mutex> bl(block_mutex_);
+            stop_ = true;
+        }
+        flush_cv_.notify_all();
+        if (flush_thread_.joinable()) {
+            flush_thread_.join();
+        }
+
+        Flush();
+
+        std::lock_guard<std::mutex> lk(file_mutex_);
+        file_.Close();
+    }
+
+    // Writes the block once it is kBlockMaxAgeMs old even if no row comes
+    // to trigger it, so an idle service still gets its results on disk.
+    void ScanResultWriter::FlushThread()
+    {
+        std::unique_lock<std::mutex> bl(block_mutex_);
+        while (stop_ == false) {
+            ull wait_ms = kBlockMaxAgeMs;
+            if (block_.Rows() != 0) {
+                long long left = (long long)(block_.opened_ms + kBlockMaxAgeMs - ulti::GetCurrentSteadyTimeInMs());
+                wait_ms = left > 0 ? (ull)left : 0;
+            }
+            flush_cv_.wait_for(bl, std::chrono::milliseconds(wait_ms), [this] { return stop_; });
+            if (stop_ == true) {
+                break;
+            }
+            if (block_.Expired(ulti::GetCurrentSteadyTimeInMs())) {
+                WritePending(bl);
+                bl.lock();
+            }
+        }
+    }
+
+    // ======================================================
+    // Row accumulation
+    // ======================================================
+
+    // Caller holds block_mutex_.
+    ull ScanResultWriter::TypeMask(const std::vector<std::string>& types)
+    {
+        ull mask = 0;
+        for (const auto& type : types) {
+            auto it = type_bits_.find(type);
+            if (it == type_bits_.end()) {
+                if (type_bits_.size() >= kOtherTypeBit) {
+                    mask |= 1ULL << kOtherTypeBit;
+                    continue;
+                }
+                uint8_t bit = (uint8_t)type_bits_.size();
+                it = type_bits_.emplace(type, bit).first;
+                block_.new_types.emplace_back(bit, type);
+            }
+            mask |= 1ULL << it->second;
+        }
+        return mask;
+    }
+
+    void ScanResultWriter::Append(const ScanResultRow& row, const std::wstring& path, const std::vector<std::string>& types)
+    {
+        std::unique_lock<std::mutex> bl(block_mutex_);
+
+        ull now_ms = ulti::GetCurrentSteadyTimeInMs();
+        if (block_.Rows() == 0) {
+            block_.opened_ms = now_ms;
+            // Only at a block boundary, so every block still carries the
+            // paths its rows use.
+            if (known_paths_.size() >= kMaxKnownPaths) {
+                known_paths_.clear();
+            }
+        }
+        if (known_paths_.insert(row.path_id).second == true) {
+            block_.new_paths.emplace_back(row.path_id, path);
+        }
+
+        block_.ts_ms.push_back(row.ts_ms);
+        block_.path_id.push_back(row.path_id);
+        block_.type_mask.push_back(TypeMask(types));
+        block_.size.push_back(row.size);
+        block_.pid.push_back(row.pid);
+        block_.status.push_back(row.status);
+        block_.validate_us.push_back(row.validate_us);
+        block_.kind.push_back((uint8_t)row.kind);
+
+        if (block_.Rows() < kBlockRows && block_.Expired(now_ms) == false) {
+            return;
+        }
+        WritePending(bl);
+    }
+
+    void ScanResultWriter::Flush()
+    {
+        std::unique_lock<std::mutex> bl(block_mutex_);
+        if (block_.Rows() == 0) {
+            return;
+        }
+        WritePending(bl);
+    }
+
+    void ScanResultWriter::WritePending(std::unique_lock<std::mutex>& bl)
+    {
+        Block ready;
+        std::swap(ready, block_);
+
+        // Take the file lock before releasing the block lock so blocks (and the
+        // dictionary deltas they carry) reach the file in order.
+        std::lock_guard<std::mutex> fl(file_mutex_);
+        bl.unlock();
+        WriteBlock(ready);
+    }
+
+    // ======================================================
+    // Serialization
+    // ======================================================
+
+    // Caller holds file_mutex_.
+    void ScanResultWriter::WriteBlock(const Block& block)
+    {
+        if (file_.IsOpen() == false) {
+            return;
+        }
+
+        out_.clear();
+        Put(out_, kBlockMagic);
+        Put(out_, (uint32_t)block.Rows());
+        Put(out_, (uint32_t)block.new_types.size());
+        Put(out_, (uint32_t)block.new_paths.size());
+        Put(out_, uint32_t(0)); // body_bytes, patched below
+        Put(out_, uint32_t(0)); // reserved, keeps blocks 8-byte aligned
+        const size_t body_start = out_.size();
+
+        for (const auto& [bit, name] : block.new_types) {
+            Put(out_, bit);
+            Put(out_, (uint16_t)name.size());
+            out_.insert(out_.end(), name.begin(), name.end());
+        }
+        for (const auto& [id, path] : block.new_paths) {
+            Put(out_, id);
+            PutUtf16(out_, path);
+        }
+        out_.resize((out_.size() + 7) & ~size_t(7), 0);
+
+        PutColumn(out_, block.ts_ms);
+        PutColumn(out_, block.path_id);
+        PutColumn(out_, block.type_mask);
+        PutColumn(out_, block.size);
+        PutColumn(out_, block.pid);
+        PutColumn(out_, block.status);
+        PutColumn(out_, block.validate_us);
+        PutColumn(out_, block.kind);
+
+        uint32_t body_bytes = (uint32_t)(out_.size() - body_start);
+        memcpy(out_.data() + body_start - 2 * sizeof(uint32_t), &body_bytes, sizeof(body_bytes));
+
+        if (file_.Write(out_.data(), out_.size()) == false) {
+            PrintDebugW(L"Write failed, error %s", debug::GetErrorMessage(platform::LastError()).c_str());
+        }
+    }
+
+} // namespace manager
@@ -0,0 +1,125 @@
+#pragma once
+#ifndef MANAGER_SCAN_RESULT_WRITER_H_
+#define MANAGER_SCAN_RESULT_WRITER_H_
+
+#include "../ulti/support.h"
+#include "../ulti/debug.h"
+
+#ifdef _WIN32
+#define SCAN_RESULT_PATH L"C:\\hieunt_scan_result.rscb"
+#else
+#define SCAN_RESULT_PATH L"/tmp/hieunt_scan_result.rscb"
+#endif
+
+/*
+Columnar scan-result file (all integers little-endian).
+
+    file header : u32 magic 'RSCF', u16 version, u16 reserved
+    block       : u32 magic 'RSCB', u32 row_count, u32 new_type_count,
+                  u32 new_path_count, u32 body_bytes, u32 reserved, then body:
+        new types : { u8 bit, u16 name_len, utf-8 name }    (type dictionary delta)
+        new paths : { u64 path_id, u32 char_count, utf-16 }  (path dictionary delta)
+        columns   : ts_ms u64[], path_id u64[], type_mask u64[], size u64[],
+                    pid u32[], status u32[], validate_us u32[], kind u8[]
+                    each column is padded to 8 bytes, so blocks and
+                    columns stay 8-byte aligned in the file
+
+Every column is a plain fixed-width array, so it maps 1:1 onto an Arrow
+primitive buffer / Parquet PLAIN page. The dictionaries are deltas: a reader
+accumulates them across blocks. The writer forgets the paths it has written
+once it knows kMaxKnownPaths of them, so a path id may come again in a later
+delta, always with the same path. Bit 63 of type_mask means "type not in
+dictionary" (more than 63 distinct type names).
+
+A block is written once it has kBlockRows rows or its first row is
+kBlockMaxAgeMs old, whichever comes first; a timer thread writes it when no
+more rows come. Close writes whatever is left.
+*/
+
+namespace manager {
+
+    enum class ScanResultKind : uint8_t {
+        kDirectory = 'd',
+        kFile = 'f',
+        kError = 'e',
+    };
+
+    struct ScanResultRow {
+        ull ts_ms = 0;
+        ull path_id = 0;
+        ull size = 0;
+        ULONG pid = 0;
+        DWORD status = 0;
+        uint32_t validate_us = 0;
+        ScanResultKind kind = ScanResultKind::kFile;
+    };
+
+    class ScanResultWriter
+    {
+    public:
+        static constexpr uint32_t kFileMagic = 0x46435352;   // "RSCF"
+        static constexpr uint32_t kBlockMagic = 0x42435352;  // "RSCB"
+        static constexpr uint16_t kVersion = 1;
+        static constexpr size_t kBlockRows = 4096;
+        static constexpr ull kBlockMaxAgeMs = 5000;
+        static constexpr size_t kMaxKnownPaths = 100'000;
+        static constexpr uint32_t kOtherTypeBit = 63;
+
+        // Closes, so the timer thread is never left running.
+        ~ScanResultWriter() { Close(); }
+
+        bool Open(const std::wstring& path);
+        // Stops the timer and writes the pending block. Safe to call again.
+        void Close();
+
+        // Thread-safe. path is only stored the first time path_id is seen.
+        void Append(const ScanResultRow& row, const std::wstring& path, const std::vector<std::string>& types);
+
+        // Writes the pending block, if any.
+        void Flush();
+
+    private:
+        struct Block {
+            std::vector<ull> ts_ms;
+            std::vector<ull> path_id;
+            std::vector<ull> type_mask;
+            std::vector<ull> size;
+            std::vector<uint32_t> pid;
+            std::vector<uint32_t> status;
+            std::vector<uint32_t> validate_us;
+            std::vector<uint8_t> kind;
+            std::vector<std::pair<uint8_t, std::string>> new_types;
+            std::vector<std::pair<ull, std::wstring>> new_paths;
+            // Steady clock, not the rows' ts_ms: rows from several workers
+            // arrive out of order.
+            ull opened_ms = 0;
+
+            size_t Rows() const { return ts_ms.size(); }
+            bool Expired(ull now_ms) const { return Rows() != 0 && (long long)(now_ms - opened_ms) >= (long long)kBlockMaxAgeMs; }
+            void Clear();
+        };
+
+        ull TypeMask(const std::vector<std::string>& types);
+        void WriteBlock(const Block& block);
+        // Caller holds `bl` on block_mutex_; released on return.
+        void WritePending(std::unique_lock<std::mutex>& bl);
+        void FlushThread();
+
+        std::mutex block_mutex_;
+        Block block_;
+        std::unordered_map<std::string, uint8_t> type_bits_;
+        std::unordered_set<ull> known_paths_;
+
+        // Guarded by block_mutex_.
+        std::condition_variable flush_cv_;
+        bool stop_ = false;
+        std::thread flush_thread_;
+
+        std::mutex file_mutex_;
+        platform::File file_;
+        std::vector<char> out_;
+    };
+
+} // namespace manager
+
+#endif // MANAGER_SCAN_RESULT_WRITER_H_
@@ -2,6 +2,7 @@
 #include "receiver.h"
 #include "file_type_iden.h"
 #include "ulti/file_helper.h"
+#include "ulti/perf_stats.h"
 
 namespace manager {
     namespace {
@@ -49,6 +50,8 @@ namespace manager {
 
         running_ = true;
 
+        result_writer_.Open(SCAN_RESULT_PATH);
+
         scanner_thread_ = std::thread(&Scanner::QueuingThread, this);
 
         for (size_t i = 0; i < kWorkerCount; i++) {
@@ -73,6 +76,8 @@ namespace manager {
                 t.join();
         }
         worker_threads_.clear();
+
+        result_writer_.Close();
     }
 
     // ======================================================
@@ -109,7 +114,7 @@ namespace manager {
         auto ft = type_iden::FileType::GetInstance();
         if (!ft) return;
 
-        auto tid = GetCurrentThreadId();
+        auto tid = platform::CurrentThreadId();
 
         while (running_)
         {
@@ -125,19 +130,23 @@ namespace manager {
 
                 io = std::move(file_queues_.front());
                 file_queues_.pop();
+                perf::SetGauge(perf::Gauge::kFileQueue, file_queues_.size());
             }
 
-            auto lp = ulti::ToLower(io.path);
-            auto hash = helper::GetWstrHash(lp);
+            ull pickup_ns = perf::Now();
+            perf::Record(perf::Stage::kScanQueueWait, pickup_ns - io.queued_ns);
+
+            auto hash = helper::GetWstrHashCi(io.path);
             auto now_ms = ulti::GetCurrentSteadyTimeInMs();
 
             {
                 std::lock_guard<std::mutex> g(file_scan_state_mutex_);
                 FileScanState state;
                 auto exist = file_scan_states_.get(hash, state);
-                //PrintDebugW("[TID %d] exist %d, state.last_scan_ms %lld, state.next_scan_ms %lld, path %ws", tid, exist, state.last_scan_ms, state.next_scan_ms, lp.c_str());
+                //PrintDebugW("[TID %d] exist %d, state.last_scan_ms %lld, state.next_scan_ms %lld, path %ws", tid, exist, state.last_scan_ms, state.next_scan_ms, io.path.c_str());
                 if (exist == true && now_ms <= state.last_scan_ms + kRescanDelayMs) {
                     if (state.next_scan_ms <= now_ms) {
+                        perf::Add(perf::Counter::kScanRequeued);
                         state.next_scan_ms = now_ms + kRescanDelayMs;
                         ResendToPidQueue(std::move(io), state.next_scan_ms);
                         file_scan_states_.put(hash, state);
@@ -153,15 +162,31 @@ namespace manager {
             DWORD status = ERROR_SUCCESS;
             ull file_size = 0;
 
+            perf::Add(perf::Counter::kFilesScanned);
+            defer{ perf::Record(perf::Stage::kScan, perf::Now() - pickup_ns); };
+
+            ScanResultRow row;
+            row.ts_ms = now_ms;
+            row.path_id = hash;
+            row.pid = io.pid;
+
             if (helper::DirExist(io.path) == true) {
                 PrintDebugW(L"[Scan TID %d] PID %d, %ws, d", tid, io.pid, io.path.c_str());
                 debug::WriteLogW(L"%lld,d,%ws\n", now_ms, io.path.c_str());
+                row.kind = ScanResultKind::kDirectory;
+                result_writer_.Append(row, io.path, {});
                 continue;
             }
 
+            auto validate_start = std::chrono::steady_clock::now();
             auto types = ft->GetTypes(io.path, &status, &file_size);
+            row.validate_us = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - validate_start).count();
+            row.size = file_size;
+            row.status = status;
             if (status == ERROR_SHARING_VIOLATION) {
                 //PrintDebugW("[TID %d] Resend %ws, pid %d", tid, io.path.c_str(), io.pid);
+                perf::Add(perf::Counter::kScanRequeued);
                 ResendToPidQueue(std::move(io), now_ms + kRescanDelayMs * 2);
                 continue;
             }
@@ -170,10 +195,14 @@ namespace manager {
             PrintDebugW(L"[Scan TID %d] PID %d, (%ws), %x, %ws", tid, io.pid, types_wstr.c_str(), status, io.path.c_str());
             if (types_wstr.empty() == false) {
                 debug::WriteLogW(L"%lld,f,%ws,(%ws),%x\n", now_ms, io.path.c_str(), types_wstr.c_str(), status);
+                row.kind = ScanResultKind::kFile;
+                result_writer_.Append(row, io.path, types);
                 continue;
             }
             if (status != ERROR_SUCCESS) {
                 debug::WriteLogW(L"%lld,e,%ws,%x\n", now_ms, io.path.c_str(), status);
+                row.kind = ScanResultKind::kError;
+                result_writer_.Append(row, io.path, types);
                 continue;
             }
         }
@@ -197,7 +226,7 @@ namespace manager {
             std::queue<FileIoInfo> tmp_queue;
 
             rcv->MoveQueueSync(tmp_queue);
-            int n_file_to_scan = 0;
+            size_t n_file_to_scan = 0;
 
             {
                 std::lock_guard<std::mutex> lk(pid_queue_mutex_);
@@ -226,12 +255,13 @@ namespace manager {
                         }
 
                         if (q.top().time_scan_ms <= now_ms) {
-                            FileIoInfo io{ it.first, q.top().path };
+                            FileIoInfo io{ it.first, q.top().path, perf::Now() };
                             q.pop();
 
                             file_queue_mutex_.lock();
                             //PrintDebugW("Push path to file_queues_: %ws", io.path.c_str());
                             file_queues_.push(std::move(io));
+                            perf::SetGauge(perf::Gauge::kFileQueue, file_queues_.size());
                             file_queue_mutex_.unlock();
                             cv_.notify_one();
 
@@ -243,6 +273,7 @@ namespace manager {
                     for (auto pid : pids_to_remove) {
                         pid_queues_.erase(pid);
                     }
+                    perf::SetGauge(perf::Gauge::kPidQueues, pid_queues_.size());
                     
                     if (any_file_available == false) {
                         break;
@@ -252,7 +283,7 @@ namespace manager {
 
             if (n_file_to_scan == 0) {
                 // Sleep briefly to avoid busy spinning
-                Sleep(100);
+                platform::SleepMs(100);
             }
         }
     }
@@ -5,6 +5,7 @@
 #include "../ulti/support.h"
 #include "../ulti/debug.h"
 #include "receiver.h"
+#include "scan_result_writer.h"
 #include "../ulti/lru_cache.hpp"
 
 namespace manager {
@@ -82,6 +83,9 @@ namespace manager {
         };
         LruMap<ull, FileScanState> file_scan_states_{ 100'000 };
 
+        // Columnar copy of the scan results written to the debug log
+        ScanResultWriter result_writer_;
+
     private:
         void ResendToPidQueue(FileIoInfo&& io, ull next_scan_ms);
         void QueuingThread();
@@ -0,0 +1,168 @@
+#pragma once
+
+#ifndef PLATFORM_PLATFORM_H_
+#define PLATFORM_PLATFORM_H_
+
+/*
+Thin OS layer for the detection core (type_iden, manager::Scanner,
+manager::Receiver and the ulti helpers they use).
+
+platform_win.cpp forwards to the same Win32 calls the service always used;
+platform_posix.cpp lets the core build and run on Linux for benchmarking.
+Status values are Win32 error codes on both sides (errno is mapped), so the
+callers keep comparing against ERROR_SHARING_VIOLATION etc.
+*/
+
+#include <cstdint>
+#include <cstdarg>
+#include <cstddef>
+#include <string>
+
+#ifndef _WIN32
+#include <cwchar>
+#include <cstring>
+
+typedef uint32_t DWORD;
+typedef uint32_t ULONG;
+typedef uint32_t UINT32;
+typedef uint16_t WORD;
+typedef uint64_t ULONGLONG;
+typedef int64_t LONGLONG;
+typedef unsigned char UCHAR;
+typedef wchar_t WCHAR;
+typedef int BOOL;
+typedef void* PVOID;
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#define MAX_PATH 260
+
+#define ERROR_SUCCESS               0
+#define ERROR_FILE_NOT_FOUND        2
+#define ERROR_PATH_NOT_FOUND        3
+#define ERROR_TOO_MANY_OPEN_FILES   4
+#define ERROR_ACCESS_DENIED         5
+#define ERROR_INVALID_HANDLE        6
+#define ERROR_NOT_ENOUGH_MEMORY     8
+#define ERROR_OUTOFMEMORY           14
+#define ERROR_SHARING_VIOLATION     32
+#define ERROR_HANDLE_EOF            38
+#define ERROR_FILE_EXISTS           80
+#define ERROR_INVALID_PARAMETER     87
+#define ERROR_INSUFFICIENT_BUFFER   122
+#define ERROR_ALREADY_EXISTS        183
+#define ERROR_FILE_TOO_LARGE        223
+#define ERROR_GEN_FAILURE           31
+
+#define ZeroMemory(p, n) memset((p), 0, (n))
+#endif // _WIN32
+
+namespace platform {
+
+    // ===== Debug output =====
+
+    // OutputDebugStringW on Windows, stderr elsewhere.
+    void DebugOutput(const wchar_t* msg);
+
+    // Win32 error code of the last failed platform call on this thread.
+    DWORD LastError();
+    std::wstring ErrorMessage(DWORD code);
+
+    // ===== Formatting =====
+
+    // Formats with MSVC wide printf semantics on every platform: %s / %ws are
+    // wide strings, %hs / %S are narrow. Returns the number of characters
+    // written, or -1 if the output did not fit (the buffer is still terminated).
+    int FormatV(wchar_t* buf, size_t cap, const wchar_t* fmt, va_list args);
+
+    // Number of characters FormatV would write, excluding the terminator.
+    int CountV(const wchar_t* fmt, va_list args);
+
+    struct LocalTime {
+        int year, month, day, hour, minute, second, millisecond;
+    };
+    LocalTime GetLocalTime();
+
+    // ===== Time / threads =====
+
+    void SleepMs(uint32_t ms);
+    uint32_t CurrentThreadId();
+    uint32_t CurrentProcessId();
+
+    // Auto-reset event.
+    class Event
+    {
+    public:
+        Event();
+        ~Event();
+        Event(const Event&) = delete;
+        Event& operator=(const Event&) = delete;
+
+        void Set();
+        // Returns true if signaled, false on timeout.
+        bool Wait(uint32_t timeout_ms);
+
+    private:
+        void* impl_ = nullptr;
+    };
+
+    // ===== Memory =====
+
+    // Page-aligned, committed, zeroed memory.
+    void* AllocPages(size_t size);
+    void FreePages(void* p, size_t size);
+
+    // ===== Files =====
+
+    class File
+    {
+    public:
+        enum class Mode {
+            kRead,      // existing file, shared read/write/delete
+            kAppend,    // open or create, writes go to the end
+            kCreate,    // create or truncate
+        };
+
+        File() = default;
+        ~File();
+        File(const File&) = delete;
+        File& operator=(const File&) = delete;
+
+        bool Open(const std::wstring& path, Mode mode);
+        void Close();
+        bool IsOpen() const;
+
+        bool GetSize(uint64_t* size) const;
+        // Reads exactly size bytes unless EOF or an error occurs.
+        bool Read(void* buf, size_t size, size_t* bytes_read);
+        bool Write(const void* buf, size_t size);
+
+    private:
+#ifdef _WIN32
+        void* handle_ = (void*)(intptr_t)-1;
+#else
+        int fd_ = -1;
+#endif
+    };
+
+    bool IsDirectory(const std::wstring& path);
+    bool IsRegularFile(const std::wstring& path);
+    bool GetFileSize(const std::wstring& path, uint64_t* size);
+    // Replaces `to` if it exists.
+    bool RenameFile(const std::wstring& from, const std::wstring& to);
+
+    // ===== Strings =====
+
+    std::wstring Utf8ToWide(const std::string& str);
+    std::string WideToUtf8(const std::wstring& wstr);
+    void ToLowerInPlace(wchar_t* s, size_t len);
+    void ToLowerInPlace(char* s, size_t len);
+
+}  // namespace platform
+
+#endif // PLATFORM_PLATFORM_H_
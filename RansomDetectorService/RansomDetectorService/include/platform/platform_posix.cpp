@@ -0,0 +1,423 @@
+#include "../ulti/include.h"
+
+#ifndef _WIN32
+
+#include <cerrno>
+#include <cwctype>
+#include <ctime>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace platform {
+
+    namespace {
+        thread_local DWORD last_error = ERROR_SUCCESS;
+
+        DWORD ErrnoToWin32(int err)
+        {
+            switch (err)
+            {
+            case 0: return ERROR_SUCCESS;
+            case ENOENT: return ERROR_FILE_NOT_FOUND;
+            case ENOTDIR: return ERROR_PATH_NOT_FOUND;
+            case EMFILE:
+            case ENFILE: return ERROR_TOO_MANY_OPEN_FILES;
+            case EACCES:
+            case EPERM:
+            case EROFS: return ERROR_ACCESS_DENIED;
+            case EBADF: return ERROR_INVALID_HANDLE;
+            case ENOMEM: return ERROR_NOT_ENOUGH_MEMORY;
+            case EBUSY:
+            case ETXTBSY: return ERROR_SHARING_VIOLATION;
+            case EEXIST: return ERROR_ALREADY_EXISTS;
+            case EINVAL: return ERROR_INVALID_PARAMETER;
+            case EFBIG: return ERROR_FILE_TOO_LARGE;
+            default: return ERROR_GEN_FAILURE;
+            }
+        }
+
+        void SetLastErrorFromErrno()
+        {
+            last_error = ErrnoToWin32(errno);
+        }
+
+        std::string NativePath(const std::wstring& path)
+        {
+            return WideToUtf8(path);
+        }
+
+        // Rewrites an MSVC wide format string for glibc: in MSVC wide printf
+        // %s means wchar_t*, while C99 says char*. Flags, width, precision and
+        // length modifiers are copied through unchanged.
+        std::wstring TranslateFormat(const wchar_t* fmt)
+        {
+            std::wstring out;
+            out.reserve(wcslen(fmt) + 8);
+            for (const wchar_t* p = fmt; *p != L'\0'; ++p) {
+                out.push_back(*p);
+                if (*p != L'%') {
+                    continue;
+                }
+                ++p;
+                if (*p == L'%') {
+                    out.push_back(L'%');
+                    continue;
+                }
+                while (*p != L'\0' && wcschr(L"-+ #0123456789.*", *p) != nullptr) {
+                    out.push_back(*p++);
+                }
+                if (*p == L'\0') {
+                    break;
+                }
+                if (*p == L'w' && p[1] == L's') {          // %ws
+                    out += L"ls";
+                    ++p;
+                }
+                else if (*p == L'h' && p[1] == L's') {     // %hs
+                    out += L"s";
+                    ++p;
+                }
+                else if (*p == L's') {                      // %s
+                    out += L"ls";
+                }
+                else if (*p == L'S') {                      // %S
+                    out += L"s";
+                }
+                else if (*p == L'I' && p[1] == L'6' && p[2] == L'4') { // %I64d
+                    out += L"ll";
+                    p += 2;
+                }
+                else {
+                    out.push_back(*p);
+                }
+            }
+            return out;
+        }
+
+        struct EventImpl {
+            std::mutex mutex;
+            std::condition_variable cv;
+            bool signaled = false;
+        };
+    }
+
+    // ===== Debug output =====
+
+    void DebugOutput(const wchar_t* msg)
+    {
+        fputs(WideToUtf8(msg).c_str(), stderr);
+    }
+
+    DWORD LastError()
+    {
+        return last_error;
+    }
+
+    std::wstring ErrorMessage(DWORD code)
+    {
+        return L"error " + std::to_wstring(code);
+    }
+
+    // ===== Formatting =====
+
+    int FormatV(wchar_t* buf, size_t cap, const wchar_t* fmt, va_list args)
+    {
+        if (cap == 0) {
+            return -1;
+        }
+        std::wstring translated = TranslateFormat(fmt);
+        int n = vswprintf(buf, cap, translated.c_str(), args);
+        if (n < 0) {
+            buf[cap - 1] = L'\0';
+        }
+        return n;
+    }
+
+    int CountV(const wchar_t* fmt, va_list args)
+    {
+        // glibc has no wide vsnprintf(nullptr, 0): grow until it fits.
+        std::wstring translated = TranslateFormat(fmt);
+        std::vector<wchar_t> buf(256);
+        for (;;) {
+            va_list copy;
+            va_copy(copy, args);
+            int n = vswprintf(buf.data(), buf.size(), translated.c_str(), copy);
+            va_end(copy);
+            if (n >= 0) {
+                return n;
+            }
+            if (buf.size() >= (1u << 24)) {
+                return -1;
+            }
+            buf.resize(buf.size() * 2);
+        }
+    }
+
+    LocalTime GetLocalTime()
+    {
+        timespec ts{};
+        clock_gettime(CLOCK_REALTIME, &ts);
+        tm t{};
+        localtime_r(&ts.tv_sec, &t);
+        return { t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec, (int)(ts.tv_nsec / 1000000) };
+    }
+
+    // ===== Time / threads =====
+
+    void SleepMs(uint32_t ms)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+
+    uint32_t CurrentThreadId()
+    {
+        return (uint32_t)syscall(SYS_gettid);
+    }
+
+    uint32_t CurrentProcessId()
+    {
+        return (uint32_t)getpid();
+    }
+
+    Event::Event()
+    {
+        impl_ = new EventImpl();
+    }
+
+    Event::~Event()
+    {
+        delete static_cast<EventImpl*>(impl_);
+    }
+
+    void Event::Set()
+    {
+        auto e = static_cast<EventImpl*>(impl_);
+        {
+            std::lock_guard<std::mutex> lk(e->mutex);
+            e->signaled = true;
+        }
+        e->cv.notify_one();
+    }
+
+    bool Event::Wait(uint32_t timeout_ms)
+    {
+        auto e = static_cast<EventImpl*>(impl_);
+        std::unique_lock<std::mutex> lk(e->mutex);
+        bool signaled = e->cv.wait_for(lk, std::chrono::milliseconds(timeout_ms), [e] { return e->signaled; });
+        e->signaled = false;
+        return signaled;
+    }
+
+    // ===== Memory =====
+
+    void* AllocPages(size_t size)
+    {
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    void FreePages(void* p, size_t size)
+    {
+        if (p != nullptr) {
+            munmap(p, size);
+        }
+    }
+
+    // ===== Files =====
+
+    File::~File()
+    {
+        Close();
+    }
+
+    bool File::Open(const std::wstring& path, Mode mode)
+    {
+        Close();
+        int flags = O_CLOEXEC;
+        switch (mode)
+        {
+        case Mode::kRead: flags |= O_RDONLY; break;
+        case Mode::kAppend: flags |= O_WRONLY | O_CREAT | O_APPEND; break;
+        case Mode::kCreate: flags |= O_WRONLY | O_CREAT | O_TRUNC; break;
+        }
+        fd_ = open(NativePath(path).c_str(), flags, 0644);
+        if (fd_ < 0) {
+            SetLastErrorFromErrno();
+            return false;
+        }
+        return true;
+    }
+
+    void File::Close()
+    {
+        if (fd_ >= 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    bool File::IsOpen() const
+    {
+        return fd_ >= 0;
+    }
+
+    bool File::GetSize(uint64_t* size) const
+    {
+        struct stat st {};
+        if (fstat(fd_, &st) != 0) {
+            SetLastErrorFromErrno();
+            return false;
+        }
+        *size = (uint64_t)st.st_size;
+        return true;
+    }
+
+    bool File::Read(void* buf, size_t size, size_t* bytes_read)
+    {
+        *bytes_read = 0;
+        while (*bytes_read < size) {
+            ssize_t n = read(fd_, (char*)buf + *bytes_read, size - *bytes_read);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                SetLastErrorFromErrno();
+                return false;
+            }
+            if (n == 0) {
+                break;
+            }
+            *bytes_read += (size_t)n;
+        }
+        return true;
+    }
+
+    bool File::Write(const void* buf, size_t size)
+    {
+        size_t done = 0;
+        while (done < size) {
+            ssize_t n = write(fd_, (const char*)buf + done, size - done);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                SetLastErrorFromErrno();
+                return false;
+            }
+            done += (size_t)n;
+        }
+        return true;
+    }
+
+    bool IsDirectory(const std::wstring& path)
+    {
+        struct stat st {};
+        return stat(NativePath(path).c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    }
+
+    bool IsRegularFile(const std::wstring& path)
+    {
+        struct stat st {};
+        return stat(NativePath(path).c_str(), &st) == 0 && !S_ISDIR(st.st_mode);
+    }
+
+    bool GetFileSize(const std::wstring& path, uint64_t* size)
+    {
+        struct stat st {};
+        if (stat(NativePath(path).c_str(), &st) != 0) {
+            SetLastErrorFromErrno();
+            return false;
+        }
+        *size = (uint64_t)st.st_size;
+        return true;
+    }
+
+    bool RenameFile(const std::wstring& from, const std::wstring& to)
+    {
+        if (rename(NativePath(from).c_str(), NativePath(to).c_str()) != 0) {
+            SetLastErrorFromErrno();
+            return false;
+        }
+        return true;
+    }
+
+    // ===== Strings =====
+
+    std::wstring Utf8ToWide(const std::string& str)
+    {
+        std::wstring out;
+        out.reserve(str.size());
+        for (size_t i = 0; i < str.size();) {
+            unsigned char c = (unsigned char)str[i];
+            uint32_t cp = 0xFFFD;
+            size_t n = 1;
+            if (c < 0x80) {
+                cp = c;
+            }
+            else if ((c >> 5) == 0x6 && i + 1 < str.size()) {
+                cp = ((c & 0x1F) << 6) | (str[i + 1] & 0x3F);
+                n = 2;
+            }
+            else if ((c >> 4) == 0xE && i + 2 < str.size()) {
+                cp = ((c & 0x0F) << 12) | ((str[i + 1] & 0x3F) << 6) | (str[i + 2] & 0x3F);
+                n = 3;
+            }
+            else if ((c >> 3) == 0x1E && i + 3 < str.size()) {
+                cp = ((c & 0x07) << 18) | ((str[i + 1] & 0x3F) << 12) | ((str[i + 2] & 0x3F) << 6) | (str[i + 3] & 0x3F);
+                n = 4;
+            }
+            out.push_back((wchar_t)cp);
+            i += n;
+        }
+        return out;
+    }
+
+    std::string WideToUtf8(const std::wstring& wstr)
+    {
+        std::string out;
+        out.reserve(wstr.size());
+        for (wchar_t wc : wstr) {
+            uint32_t cp = (uint32_t)wc;
+            if (cp < 0x80) {
+                out.push_back((char)cp);
+            }
+            else if (cp < 0x800) {
+                out.push_back((char)(0xC0 | (cp >> 6)));
+                out.push_back((char)(0x80 | (cp & 0x3F)));
+            }
+            else if (cp < 0x10000) {
+                out.push_back((char)(0xE0 | (cp >> 12)));
+                out.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+                out.push_back((char)(0x80 | (cp & 0x3F)));
+            }
+            else {
+                out.push_back((char)(0xF0 | (cp >> 18)));
+                out.push_back((char)(0x80 | ((cp >> 12) & 0x3F)));
+                out.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+                out.push_back((char)(0x80 | (cp & 0x3F)));
+            }
+        }
+        return out;
+    }
+
+    void ToLowerInPlace(wchar_t* s, size_t len)
+    {
+        for (size_t i = 0; i < len; i++) {
+            s[i] = (wchar_t)towlower((wint_t)s[i]);
+        }
+    }
+
+    void ToLowerInPlace(char* s, size_t len)
+    {
+        for (size_t i = 0; i < len; i++) {
+            s[i] = (char)tolower((unsigned char)s[i]);
+        }
+    }
+
+}  // namespace platform
+
+#endif // _WIN32
@@ -0,0 +1,258 @@
+#include "../ulti/include.h"
+
+#ifdef _WIN32
+
+namespace platform {
+
+    // ===== Debug output =====
+
+    void DebugOutput(const wchar_t* msg)
+    {
+        OutputDebugStringW(msg);
+    }
+
+    DWORD LastError()
+    {
+        return GetLastError();
+    }
+
+    std::wstring ErrorMessage(DWORD code)
+    {
+        LPWSTR message_buffer = nullptr;
+        size_t size = FormatMessageW(
+            FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
+            nullptr, code, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
+            (LPWSTR)&message_buffer, 0, nullptr);
+
+        std::wstring message(message_buffer, size);
+        LocalFree(message_buffer);
+        return message;
+    }
+
+    // ===== Formatting =====
+
+    int FormatV(wchar_t* buf, size_t cap, const wchar_t* fmt, va_list args)
+    {
+        return _vsnwprintf_s(buf, cap, _TRUNCATE, fmt, args);
+    }
+
+    int CountV(const wchar_t* fmt, va_list args)
+    {
+        return _vscwprintf(fmt, args);
+    }
+
+    LocalTime GetLocalTime()
+    {
+        SYSTEMTIME time;
+        ::GetLocalTime(&time);
+        return { time.wYear, time.wMonth, time.wDay, time.wHour, time.wMinute, time.wSecond, time.wMilliseconds };
+    }
+
+    // ===== Time / threads =====
+
+    void SleepMs(uint32_t ms)
+    {
+        Sleep(ms);
+    }
+
+    uint32_t CurrentThreadId()
+    {
+        return GetCurrentThreadId();
+    }
+
+    uint32_t CurrentProcessId()
+    {
+        return GetCurrentProcessId();
+    }
+
+    Event::Event()
+    {
+        impl_ = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    }
+
+    Event::~Event()
+    {
+        if (impl_ != nullptr) {
+            CloseHandle(impl_);
+        }
+    }
+
+    void Event::Set()
+    {
+        SetEvent(impl_);
+    }
+
+    bool Event::Wait(uint32_t timeout_ms)
+    {
+        return WaitForSingleObject(impl_, timeout_ms) == WAIT_OBJECT_0;
+    }
+
+    // ===== Memory =====
+
+    void* AllocPages(size_t size)
+    {
+        return VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    }
+
+    void FreePages(void* p, size_t)
+    {
+        if (p != nullptr) {
+            VirtualFree(p, 0, MEM_RELEASE);
+        }
+    }
+
+    // ===== Files =====
+
+    File::~File()
+    {
+        Close();
+    }
+
+    bool File::Open(const std::wstring& path, Mode mode)
+    {
+        Close();
+        switch (mode)
+        {
+        case Mode::kRead:
+            handle_ = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            break;
+        case Mode::kAppend:
+            handle_ = CreateFileW(path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ,
+                nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            break;
+        case Mode::kCreate:
+            handle_ = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ,
+                nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            break;
+        }
+        if (handle_ == nullptr) {
+            handle_ = INVALID_HANDLE_VALUE;
+        }
+        return handle_ != INVALID_HANDLE_VALUE;
+    }
+
+    void File::Close()
+    {
+        if (handle_ != INVALID_HANDLE_VALUE) {
+            CloseHandle(handle_);
+            handle_ = INVALID_HANDLE_VALUE;
+        }
+    }
+
+    bool File::IsOpen() const
+    {
+        return handle_ != INVALID_HANDLE_VALUE;
+    }
+
+    bool File::GetSize(uint64_t* size) const
+    {
+        LARGE_INTEGER li_size{};
+        if (!GetFileSizeEx(handle_, &li_size)) {
+            return false;
+        }
+        *size = (uint64_t)li_size.QuadPart;
+        return true;
+    }
+
+    bool File::Read(void* buf, size_t size, size_t* bytes_read)
+    {
+        *bytes_read = 0;
+        while (*bytes_read < size) {
+            DWORD chunk = (DWORD)(std::min)(size - *bytes_read, (size_t)0x40000000);
+            DWORD n = 0;
+            if (!ReadFile(handle_, (char*)buf + *bytes_read, chunk, &n, nullptr)) {
+                return false;
+            }
+            if (n == 0) {
+                break;
+            }
+            *bytes_read += n;
+        }
+        return true;
+    }
+
+    bool File::Write(const void* buf, size_t size)
+    {
+        DWORD written = 0;
+        return WriteFile(handle_, buf, (DWORD)size, &written, nullptr) == TRUE && written == size;
+    }
+
+    bool IsDirectory(const std::wstring& path)
+    {
+        DWORD file_attributes = GetFileAttributesW(path.c_str());
+        return file_attributes != INVALID_FILE_ATTRIBUTES && FlagOn(file_attributes, FILE_ATTRIBUTE_DIRECTORY);
+    }
+
+    bool IsRegularFile(const std::wstring& path)
+    {
+        DWORD file_attributes = GetFileAttributesW(path.c_str());
+        return file_attributes != INVALID_FILE_ATTRIBUTES && !FlagOn(file_attributes, FILE_ATTRIBUTE_DIRECTORY);
+    }
+
+    bool GetFileSize(const std::wstring& path, uint64_t* size)
+    {
+        WIN32_FILE_ATTRIBUTE_DATA fad;
+        if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &fad)) {
+            return false;
+        }
+        *size = ((uint64_t)fad.nFileSizeHigh << 32) | fad.nFileSizeLow;
+        return true;
+    }
+
+    bool RenameFile(const std::wstring& from, const std::wstring& to)
+    {
+        return MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+    }
+
+    // ===== Strings =====
+
+    std::wstring Utf8ToWide(const std::string& str)
+    {
+        if (str.empty()) return L"";
+
+        int size_needed = MultiByteToWideChar(CP_UTF8, 0,
+            str.c_str(), static_cast<int>(str.size()),
+            nullptr, 0);
+        if (size_needed <= 0) {
+            return L"";
+        }
+
+        std::wstring wstr(size_needed, L'\0');
+        MultiByteToWideChar(CP_UTF8, 0,
+            str.c_str(), static_cast<int>(str.size()),
+            &wstr[0], size_needed);
+        return wstr;
+    }
+
+    std::string WideToUtf8(const std::wstring& wstr)
+    {
+        if (wstr.empty()) return "";
+
+        int size_needed = WideCharToMultiByte(CP_UTF8, 0,
+            wstr.c_str(), static_cast<int>(wstr.size()),
+            nullptr, 0, nullptr, nullptr);
+        if (size_needed <= 0) {
+            return "";
+        }
+
+        std::string str(size_needed, '\0');
+        WideCharToMultiByte(CP_UTF8, 0,
+            wstr.c_str(), static_cast<int>(wstr.size()),
+            &str[0], size_needed, nullptr, nullptr);
+        return str;
+    }
+
+    void ToLowerInPlace(wchar_t* s, size_t len)
+    {
+        CharLowerBuffW(s, (DWORD)len);
+    }
+
+    void ToLowerInPlace(char* s, size_t len)
+    {
+        CharLowerBuffA(s, (DWORD)len);
+    }
+
+}  // namespace platform
+
+#endif // _WIN32
@@ -3,76 +3,410 @@
 
 namespace debug {
 
-	std::mutex file_debug_mutex;
-	HANDLE log_file_handle = INVALID_HANDLE_VALUE;
-	int debug_count = 0;
+	static_assert((LOG_RING_SLOT_COUNT & (LOG_RING_SLOT_COUNT - 1)) == 0, "LOG_RING_SLOT_COUNT must be a power of two");
 
-	void InitDebugLog()
+	// Bounded MPSC ring (Vyukov): a slot is free for position p when seq == p,
+	// and holds a published line when seq == p + 1.
+	struct LogSlot
+	{
+		std::atomic<size_t> seq;
+		size_t len;
+		wchar_t text[LOG_SLOT_CHARS + 1];
+	};
+
+	static LogSlot log_ring[LOG_RING_SLOT_COUNT];
+	alignas(64) static std::atomic<size_t> log_enqueue_pos = 0;
+	alignas(64) static std::atomic<size_t> log_dequeue_pos = 0;
+
+	static std::mutex log_start_mutex;
+	static std::atomic<bool> log_running = false;
+	static std::atomic<bool> log_stop = false;
+	static std::thread log_writer_thread;
+	static platform::Event log_wake_event;
+	static platform::Event log_space_event;     // set by the writer after it freed slots
+
+	// Only touched by the writer thread while it is running.
+	static platform::File log_file;
+	static ull log_file_bytes = 0;
+	static ull log_file_open_ms = 0;
+	static char* log_staging = nullptr;
+	static size_t log_staging_len = 0;
+
+	static struct
+	{
+		std::atomic<ull> lines_queued = 0;
+		std::atomic<ull> lines_dropped = 0;
+		std::atomic<ull> full_waits = 0;
+		std::atomic<ull> lines_truncated = 0;
+		std::atomic<ull> lines_written = 0;
+		std::atomic<ull> bytes_written = 0;
+		std::atomic<ull> write_calls = 0;
+		std::atomic<ull> write_errors = 0;
+		std::atomic<ull> rotations = 0;
+		std::atomic<ull> max_queue_depth = 0;
+	} log_stats;
+
+	static void OpenLogFile()
+	{
+		// Appends, so count what earlier runs left towards the rotation size.
+		uint64_t size = 0;
+		log_file.Open(LOG_PATH, platform::File::Mode::kAppend);
+		log_file_bytes = log_file.IsOpen() && log_file.GetSize(&size) ? size : 0;
+		log_file_open_ms = ulti::GetCurrentSteadyTimeInMs();
+	}
+
+	static void CloseLogFile()
+	{
+		log_file.Close();
+	}
+
+	static std::wstring RotatedLogPath(int index)
 	{
-		if (log_file_handle != INVALID_HANDLE_VALUE)
+		return std::wstring(LOG_PATH) + L"." + std::to_wstring(index);
+	}
+
+	// LOG_PATH -> LOG_PATH.1 -> ... -> LOG_PATH.LOG_ROTATE_KEEP, the oldest is
+	// replaced. If LOG_PATH cannot be moved (a reader without delete sharing),
+	// logging goes on appending to it.
+	static void RotateLogFile()
+	{
+		CloseLogFile();
+		for (int i = LOG_ROTATE_KEEP - 1; i >= 1; i--)
 		{
-			CloseHandle(log_file_handle);
+			platform::RenameFile(RotatedLogPath(i), RotatedLogPath(i + 1));
 		}
-		log_file_handle = CreateFileW(
-			LOG_PATH,
-			FILE_APPEND_DATA,
-			FILE_SHARE_READ,
-			nullptr,
-			OPEN_ALWAYS,
-			FILE_ATTRIBUTE_NORMAL,
-			nullptr
-		);
-		if (log_file_handle == INVALID_HANDLE_VALUE || log_file_handle == 0)
+		if (platform::RenameFile(LOG_PATH, RotatedLogPath(1)) == true)
 		{
-			// Handle error (optional: log to another output)
+			log_stats.rotations++;
 		}
-		debug_count = 0;
+		OpenLogFile();
 	}
 
-	void CleanupDebugLog()
+	// Writes the staging buffer with a single WriteFile.
+	static void FlushStaging()
 	{
-		if (log_file_handle != INVALID_HANDLE_VALUE)
+		if (log_staging_len == 0)
+		{
+			return;
+		}
+		defer{ log_staging_len = 0; };
+
+		if (log_file.IsOpen() == false)
 		{
-			CloseHandle(log_file_handle);
-			log_file_handle = INVALID_HANDLE_VALUE;
+			OpenLogFile();
+			if (log_file.IsOpen() == false)
+			{
+				log_stats.write_errors++;
+				return;
+			}
+		}
+
+		if (log_file.Write(log_staging, log_staging_len) == false)
+		{
+			log_stats.write_errors++;
+			CloseLogFile();
+			return;
+		}
+		log_stats.write_calls++;
+		log_stats.bytes_written += log_staging_len;
+		log_file_bytes += log_staging_len;
+
+		if (log_file_bytes >= LOG_ROTATE_BYTES ||
+			ulti::GetCurrentSteadyTimeInMs() - log_file_open_ms >= LOG_ROTATE_SECONDS * 1000ull)
+		{
+			RotateLogFile();
 		}
 	}
 
-	void WriteDebugToFileW(const std::wstring& message)
+#ifndef _WIN32
+	// wchar_t is UTF-32 here; the log is written as UTF-8 so it stays readable.
+	// `out` needs room for 4 bytes per char.
+	static size_t EncodeUtf8(const wchar_t* text, size_t len, char* out)
+	{
+		char* p = out;
+		for (size_t i = 0; i < len; i++)
+		{
+			uint32_t cp = (uint32_t)text[i];
+			if (cp < 0x80)
+			{
+				*p++ = (char)cp;
+			}
+			else if (cp < 0x800)
+			{
+				*p++ = (char)(0xC0 | (cp >> 6));
+				*p++ = (char)(0x80 | (cp & 0x3F));
+			}
+			else if (cp < 0x10000)
+			{
+				*p++ = (char)(0xE0 | (cp >> 12));
+				*p++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+				*p++ = (char)(0x80 | (cp & 0x3F));
+			}
+			else
+			{
+				*p++ = (char)(0xF0 | (cp >> 18));
+				*p++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+				*p++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+				*p++ = (char)(0x80 | (cp & 0x3F));
+			}
+		}
+		return p - out;
+	}
+#endif
+
+	// Moves every published slot into the staging buffer, flushing whenever it fills up.
+	// Returns the number of lines drained.
+	static size_t DrainRing()
 	{
-		std::lock_guard<std::mutex> lock(file_debug_mutex);
+		size_t drained = 0;
+		size_t pos = log_dequeue_pos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			LogSlot& slot = log_ring[pos & (LOG_RING_SLOT_COUNT - 1)];
+			if (slot.seq.load(std::memory_order_acquire) != pos + 1)
+			{
+				break;
+			}
 
-		try {
-			if (log_file_handle == INVALID_HANDLE_VALUE || log_file_handle == 0)
+#ifdef _WIN32
+			// UTF-16LE, same as the log has always been.
+			size_t max_bytes = slot.len * sizeof(wchar_t);
+#else
+			size_t max_bytes = slot.len * 4;
+#endif
+			if (log_staging_len + max_bytes > LOG_WRITE_CHUNK_BYTES)
 			{
-				InitDebugLog();
-				if (log_file_handle == INVALID_HANDLE_VALUE || log_file_handle == 0)
-				{
-					return;
-				}
+				FlushStaging();
+			}
+#ifdef _WIN32
+			size_t bytes = max_bytes;
+			memcpy(log_staging + log_staging_len, slot.text, bytes);
+#else
+			size_t bytes = EncodeUtf8(slot.text, slot.len, log_staging + log_staging_len);
+#endif
+			log_staging_len += bytes;
+			if (bytes != 0)
+			{
+				log_stats.lines_written++;
+			}
+
+			slot.seq.store(pos + LOG_RING_SLOT_COUNT, std::memory_order_release);
+			++pos;
+			log_dequeue_pos.store(pos, std::memory_order_relaxed);
+			++drained;
+		}
+		return drained;
+	}
+
+	static void LogWriterThread()
+	{
+		ull last_flush_ms = ulti::GetCurrentSteadyTimeInMs();
+		OpenLogFile();
+
+		while (log_stop.load(std::memory_order_acquire) == false)
+		{
+			if (DrainRing() != 0)
+			{
+				log_space_event.Set();
 			}
-			debug_count++;
 
-			// Never write into message.c_str(); that is undefined behavior.
-			std::wstring line = message;
-			if (line.empty() || line.back() != L'\n') {
-				line.push_back(L'\n');
+			ull now_ms = ulti::GetCurrentSteadyTimeInMs();
+			if (now_ms - last_flush_ms >= LOG_FLUSH_MS)
+			{
+				FlushStaging();
+				last_flush_ms = now_ms;
 			}
 
-			DWORD bytes_written = 0;
-			WriteFile(log_file_handle, line.data(), static_cast<DWORD>(line.size() * sizeof(wchar_t)), &bytes_written, nullptr);
-			//FlushFileBuffers(log_file_handle);
+			// Producers only signal past the wake mark, so normally this times out
+			// and lines get batched for up to LOG_FLUSH_MS.
+			log_wake_event.Wait(LOG_FLUSH_MS);
+		}
+
+		DrainRing();
+		FlushStaging();
+		CloseLogFile();
+		// Result writers still waiting see log_stop and give up.
+		log_space_event.Set();
+	}
+
+	static bool StartLogWriter()
+	{
+		std::lock_guard<std::mutex> lock(log_start_mutex);
+		if (log_running.load(std::memory_order_acquire) == true)
+		{
+			return true;
+		}
 
-			if (debug_count >= DEBUG_LOG_THRESHOLD) {
-				CleanupDebugLog();
-				InitDebugLog();
+		if (log_staging == nullptr)
+		{
+			// Page-aligned so each chunk write starts on a page boundary.
+			log_staging = static_cast<char*>(platform::AllocPages(LOG_WRITE_CHUNK_BYTES));
+			if (log_staging == nullptr)
+			{
+				return false;
 			}
 		}
+
+		for (size_t i = 0; i < LOG_RING_SLOT_COUNT; ++i)
+		{
+			log_ring[i].seq.store(i + log_dequeue_pos.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+		log_enqueue_pos.store(log_dequeue_pos.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+		log_stop.store(false, std::memory_order_release);
+		try {
+			log_writer_thread = std::thread(LogWriterThread);
+		}
 		catch (...) {
-			// Handle exception if needed
+			return false;
+		}
+		log_running.store(true, std::memory_order_release);
+		return true;
+	}
+
+	// Claims a free slot. When the ring is full, waits for the writer if
+	// `wait_for_space`, else returns nullptr and counts a drop. Also nullptr
+	// when the writer is not running: it is never restarted from here, so
+	// nothing logged after CleanupDebugLog leaves a thread behind.
+	static LogSlot* AcquireSlot(size_t& out_pos, bool wait_for_space)
+	{
+		if (log_running.load(std::memory_order_acquire) == false)
+		{
+			log_stats.lines_dropped++;
+			return nullptr;
+		}
+
+		bool waited = false;
+		size_t pos = log_enqueue_pos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			LogSlot& slot = log_ring[pos & (LOG_RING_SLOT_COUNT - 1)];
+			size_t seq = slot.seq.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+			if (diff == 0)
+			{
+				if (log_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					if (waited == true)
+					{
+						// One Set wakes one waiter; pass it on to the next.
+						log_space_event.Set();
+					}
+					out_pos = pos;
+					return &slot;
+				}
+			}
+			else if (diff < 0)
+			{
+				log_wake_event.Set();
+				if (wait_for_space == false || log_stop.load(std::memory_order_acquire) == true)
+				{
+					log_stats.lines_dropped++;
+					return nullptr;
+				}
+				if (waited == false)
+				{
+					log_stats.full_waits++;
+					waited = true;
+				}
+				log_space_event.Wait(LOG_FLUSH_MS);
+				pos = log_enqueue_pos.load(std::memory_order_relaxed);
+			}
+			else
+			{
+				pos = log_enqueue_pos.load(std::memory_order_relaxed);
+			}
 		}
 	}
 
+	// Publishes a slot. len == 0 publishes an empty slot, which the writer skips.
+	static void PublishSlot(LogSlot* slot, size_t pos, size_t len)
+	{
+		if (len != 0 && slot->text[len - 1] != L'\n')
+		{
+			slot->text[len++] = L'\n';
+		}
+		slot->len = len;
+		slot->seq.store(pos + 1, std::memory_order_release);
+
+		if (len != 0)
+		{
+			log_stats.lines_queued++;
+		}
+		else
+		{
+			log_stats.lines_dropped++;
+		}
+
+		// The writer may already have drained past this slot.
+		size_t dequeue_pos = log_dequeue_pos.load(std::memory_order_relaxed);
+		ull depth = pos + 1 > dequeue_pos ? pos + 1 - dequeue_pos : 0;
+		ull max_depth = log_stats.max_queue_depth.load(std::memory_order_relaxed);
+		while (depth > max_depth && !log_stats.max_queue_depth.compare_exchange_weak(max_depth, depth, std::memory_order_relaxed))
+		{
+		}
+		if (depth >= LOG_RING_WAKE_MARK)
+		{
+			log_wake_event.Set();
+		}
+	}
+
+	void InitDebugLog()
+	{
+		StartLogWriter();
+	}
+
+	void CleanupDebugLog()
+	{
+		std::lock_guard<std::mutex> lock(log_start_mutex);
+		if (log_running.load(std::memory_order_acquire) == false)
+		{
+			return;
+		}
+		log_stop.store(true, std::memory_order_release);
+		log_wake_event.Set();
+		if (log_writer_thread.joinable())
+		{
+			log_writer_thread.join();
+		}
+		log_running.store(false, std::memory_order_release);
+	}
+
+	void WriteDebugToFileW(const std::wstring& message)
+	{
+		size_t pos = 0;
+		LogSlot* slot = AcquireSlot(pos, false);
+		if (slot == nullptr)
+		{
+			return;
+		}
+
+		size_t len = message.size();
+		if (len > LOG_SLOT_CHARS)
+		{
+			len = LOG_SLOT_CHARS;
+			log_stats.lines_truncated++;
+		}
+		wmemcpy(slot->text, message.data(), len);
+		PublishSlot(slot, pos, len);
+	}
+
+	LogStats GetLogStats()
+	{
+		LogStats stats;
+		stats.lines_queued = log_stats.lines_queued.load(std::memory_order_relaxed);
+		stats.lines_dropped = log_stats.lines_dropped.load(std::memory_order_relaxed);
+		stats.full_waits = log_stats.full_waits.load(std::memory_order_relaxed);
+		stats.lines_truncated = log_stats.lines_truncated.load(std::memory_order_relaxed);
+		stats.lines_written = log_stats.lines_written.load(std::memory_order_relaxed);
+		stats.bytes_written = log_stats.bytes_written.load(std::memory_order_relaxed);
+		stats.write_calls = log_stats.write_calls.load(std::memory_order_relaxed);
+		stats.write_errors = log_stats.write_errors.load(std::memory_order_relaxed);
+		stats.rotations = log_stats.rotations.load(std::memory_order_relaxed);
+		stats.max_queue_depth = log_stats.max_queue_depth.load(std::memory_order_relaxed);
+		return stats;
+	}
+
 	void DebugPrintW(const wchar_t* pwsz_format, ...) {
 		if (pwsz_format == nullptr) return;
 
@@ -81,14 +415,13 @@ namespace debug {
 		buffer.clear();
 
 		// Build timestamp string first
-		SYSTEMTIME time;
-		GetLocalTime(&time);
+		platform::LocalTime time = platform::GetLocalTime();
 
 		wchar_t time_str[64];
-		int prefix_len = swprintf_s(time_str, 64,
+		int prefix_len = swprintf(time_str, 64,
 			L"[%d/%02d/%02d - %02d:%02d:%02d][REFD] ",
-			time.wYear, time.wMonth, time.wDay,
-			time.wHour, time.wMinute, time.wSecond);
+			time.year, time.month, time.day,
+			time.hour, time.minute, time.second);
 
 		if (prefix_len <= 0) return;
 
@@ -97,7 +430,7 @@ namespace debug {
 
 		va_list args_copy;
 		va_copy(args_copy, args);
-		int msg_len = _vscwprintf(pwsz_format, args_copy);
+		int msg_len = platform::CountV(pwsz_format, args_copy);
 		va_end(args_copy);
 
 		if (msg_len <= 0) {
@@ -112,12 +445,12 @@ namespace debug {
 		wmemcpy(buffer.data(), time_str, prefix_len);
 
 		// Format message into buffer right after prefix
-		vswprintf_s(buffer.data() + prefix_len, msg_len + 1, pwsz_format, args);
+		platform::FormatV(buffer.data() + prefix_len, msg_len + 1, pwsz_format, args);
 
 		va_end(args);
 
 		// Null-terminated already, safe to print
-		OutputDebugStringW(buffer.data());
+		platform::DebugOutput(buffer.data());
 		//WriteDebugToFileW(buffer.data());
 	}
 
@@ -126,48 +459,38 @@ namespace debug {
 		if (!format)
 			return;
 
-		// 1KB max message per thread
-		constexpr size_t kMaxChars = 1024;
-
-		thread_local std::wstring buffer;
-
-		// Ensure capacity once
-		if (buffer.capacity() < kMaxChars)
-			buffer.reserve(kMaxChars);
-
-		buffer.resize(kMaxChars);
+		// Format straight into the ring slot, no per-thread staging copy.
+		size_t pos = 0;
+		LogSlot* slot = AcquireSlot(pos, true);
+		if (slot == nullptr)
+			return;
 
 		va_list args;
 		va_start(args, format);
 
-		int written = vswprintf_s(
-			buffer.data(),
-			buffer.size(),
+		slot->text[0] = L'\0';
+		int written = platform::FormatV(
+			slot->text,
+			LOG_SLOT_CHARS,
 			format,
 			args
 		);
 
 		va_end(args);
 
-		if (written <= 0)
-			return;  // failed or truncated
-
-		buffer.resize(static_cast<size_t>(written));
-
-		WriteDebugToFileW(buffer.c_str());
+		// FormatV returns -1 on truncation too, with what fit left in the slot.
+		// Lines that produced nothing are published empty and counted as dropped.
+		size_t len = written >= 0 ? static_cast<size_t>(written) : wcsnlen(slot->text, LOG_SLOT_CHARS - 1);
+		if (written < 0 && len != 0)
+		{
+			log_stats.lines_truncated++;
+		}
+		PublishSlot(slot, pos, len);
 	}
 
 
 	std::wstring GetErrorMessage(DWORD errorCode) {
-		LPWSTR messageBuffer = nullptr;
-		size_t size = FormatMessageW(
-			FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
-			nullptr, errorCode, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
-			(LPWSTR)&messageBuffer, 0, nullptr);
-
-		std::wstring message(messageBuffer, size);
-		LocalFree(messageBuffer);
-		return message;
+		return platform::ErrorMessage(errorCode);
 	}
 
 }  // namespace debug
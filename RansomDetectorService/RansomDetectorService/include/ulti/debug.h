@@ -5,24 +5,59 @@
 
 #include "include.h"
 
-#define DEBUG_LOG_THRESHOLD 1000
+#ifdef _WIN32
 #define LOG_PATH L"C:\\hieunt_filetype.log"
+#else
+#define LOG_PATH L"/tmp/hieunt_filetype.log"
+#endif
+
+// Async log writer: producers format straight into a slot of a lock-free ring,
+// a single writer thread batches the slots into large WriteFile calls. Scan
+// results (WriteLogW) wait for a free slot, debug lines are dropped instead.
+#define LOG_RING_SLOT_COUNT 1024            // power of two
+#define LOG_SLOT_CHARS 1024                 // max chars per line, longer ones are truncated
+#define LOG_RING_WAKE_MARK (LOG_RING_SLOT_COUNT / 4)
+#define LOG_WRITE_CHUNK_BYTES (64 * 1024)   // staging buffer, one write when full
+#define LOG_FLUSH_MS 200                    // max time a line waits in staging
+#define LOG_ROTATE_BYTES (8 * 1024 * 1024)  // rotate the log once it is this big
+#define LOG_ROTATE_SECONDS (24 * 60 * 60)   // or has been open this long
+#define LOG_ROTATE_KEEP 3                   // rotated logs kept, LOG_PATH.1 is the newest
 
 namespace debug {
 
-    // Initializes the debug log file.
+    struct LogStats
+    {
+        ull lines_queued = 0;
+        ull lines_dropped = 0;   // debug line with the ring full, formatting failed or log closed
+        ull full_waits = 0;      // result lines that had to wait for a free slot
+        ull lines_truncated = 0; // longer than LOG_SLOT_CHARS, written cut
+        ull lines_written = 0;
+        ull bytes_written = 0;
+        ull write_calls = 0;
+        ull write_errors = 0;
+        ull rotations = 0;
+        ull max_queue_depth = 0;
+    };
+
+    // Opens the debug log file and starts the writer thread. Lines logged
+    // before this are dropped.
     void InitDebugLog();
 
-    // Cleans up the debug log file.
+    // Drains pending lines, stops the writer thread and closes the log file.
+    // Lines logged afterwards are dropped until InitDebugLog is called again.
     void CleanupDebugLog();
 
-    // Writes a debug message to the log file.
+    // Queues a debug message for the log file. Never blocks; drops when the ring is full.
     void WriteDebugToFileW(const std::wstring& s);
 
+    // Snapshot of the writer counters.
+    LogStats GetLogStats();
+
     // Logs a formatted debug message.
     void DebugPrintW(const wchar_t* pwsz_format, ...);
 
-    // Logs a formatted message to file.
+    // Logs a formatted scan result to file. Waits while the ring is full, so
+    // results are not lost under load.
     void WriteLogW(const wchar_t* pwsz_format, ...);
 
     // Retrieves a formatted error message from a Windows error code.
@@ -30,7 +65,12 @@ namespace debug {
 
 }  // namespace debug 
 
+#ifdef _WIN32
 #define PrintDebugW(str, ...) \
     debug::DebugPrintW(L"[%ws:%d] " str L"\n", __FUNCTIONW__, __LINE__, __VA_ARGS__)
+#else
+#define PrintDebugW(str, ...) \
+    debug::DebugPrintW(L"[%hs:%d] " str L"\n", __func__, __LINE__ __VA_OPT__(,) __VA_ARGS__)
+#endif
 
 #endif // ULTI_DEBUG_H_
\ No newline at end of file
@@ -1,7 +1,15 @@
 ﻿#include "file_helper.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CI_HASH_SSE2
+#include <emmintrin.h>
+#endif
 
 namespace helper
 {
+#ifdef _WIN32
     void InitDosDeviceCache()
     {
         wchar_t device_path[MAX_PATH];
@@ -125,37 +133,53 @@ namespace helper
         }
         return long_path;
     }
+#else
+    // POSIX paths are already native: no device names, no 8.3 short names, and
+    // case is significant, so the path is passed through unchanged.
+    void InitDosDeviceCache()
+    {
+    }
+
+    std::wstring GetNativePath(const std::wstring& dos_path)
+    {
+        return dos_path;
+    }
+
+    std::wstring GetDosPathCaseSensitive(const std::wstring& nt_path)
+    {
+        return nt_path;
+    }
+
+    std::wstring GetDosPath(const std::wstring& nt_path)
+    {
+        return nt_path;
+    }
+
+    std::wstring GetLongDosPath(const std::wstring& dos_path)
+    {
+        return dos_path;
+    }
+#endif // _WIN32
 
     bool FileExist(const std::wstring& ws)
     {
-        DWORD file_attributes = GetFileAttributesW(ws.c_str());
-        if (file_attributes == INVALID_FILE_ATTRIBUTES || FlagOn(file_attributes, FILE_ATTRIBUTE_DIRECTORY) == true) {
-            return false;
-        }
-        return true;
+        return platform::IsRegularFile(ws);
     }
 
     bool DirExist(const std::wstring& dir_path)
     {
-        DWORD file_attributes = GetFileAttributesW(dir_path.c_str());
-        if (file_attributes == INVALID_FILE_ATTRIBUTES || FlagOn(file_attributes, FILE_ATTRIBUTE_DIRECTORY) == false) {
-            return false;
-        }
-        return true;
+        return platform::IsDirectory(dir_path);
     }
 
     ull GetFileSize(const std::wstring& ws)
     {
-        WIN32_FILE_ATTRIBUTE_DATA fad;
-        if (!GetFileAttributesEx(ws.c_str(), GetFileExInfoStandard, &fad))
+        uint64_t size = 0;
+        if (platform::GetFileSize(ws, &size) == false)
         {
-            PrintDebugW(L"GetFileSize failed for file %ws, error %s", ws.c_str(), debug::GetErrorMessage(GetLastError()).c_str());
+            PrintDebugW(L"GetFileSize failed for file %ws, error %s", ws.c_str(), debug::GetErrorMessage(platform::LastError()).c_str());
             return 0;
         }
-        LARGE_INTEGER size;
-        size.HighPart = fad.nFileSizeHigh;
-        size.LowPart = fad.nFileSizeLow;
-        return size.QuadPart;
+        return size;
     }
 
     std::wstring GetFileName(const std::wstring& path)
@@ -231,6 +255,236 @@ namespace helper
         return hash;
     }
 
+    namespace {
+        constexpr ull kCiHashSeed = 0x243F6A8885A308D3ULL;
+        constexpr ull kCiHashK0 = 0xA0761D6478BD642FULL;
+        constexpr ull kCiHashK1 = 0xE7037ED1A0B428DBULL;
+        constexpr ull kCiHashK2 = 0x8EBC6AF09C88C6E3ULL;
+        constexpr size_t kCiHashBlock = 8; // UTF-16 code units per step
+
+        // 64x64 -> 128 multiply, folded back to 64 bits.
+        inline ull MulFold(ull a, ull b)
+        {
+#if defined(__SIZEOF_INT128__)
+            unsigned __int128 r = (unsigned __int128)a * b;
+            return (ull)r ^ (ull)(r >> 64);
+#elif defined(_M_X64)
+            ull hi = 0;
+            ull lo = _umul128(a, b, &hi);
+            return lo ^ hi;
+#else
+            ull a_lo = (uint32_t)a, a_hi = a >> 32;
+            ull b_lo = (uint32_t)b, b_hi = b >> 32;
+            ull ll = a_lo * b_lo, lh = a_lo * b_hi, hl = a_hi * b_lo, hh = a_hi * b_hi;
+            ull mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+            ull lo = (mid << 32) | (uint32_t)ll;
+            ull hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+            return lo ^ hi;
+#endif
+        }
+
+        // wchar_t per folding run: one platform lowercase call per run.
+        constexpr size_t kCiFoldRun = 64;
+
+        inline uint16_t FoldLatin1(uint16_t c)
+        {
+            if ((uint16_t)(c - L'A') <= (L'Z' - L'A')) {
+                return c + 0x20;
+            }
+            if ((uint16_t)(c - 0xC0) <= (0xDE - 0xC0) && c != 0xD7) {
+                return c + 0x20;
+            }
+            return c;
+        }
+
+        // Folds up to kCiFoldRun chars into UTF-16 code units (out needs room for
+        // two per char) and returns how many. ASCII and Latin-1 are folded inline;
+        // the other BMP letters of the run go through platform::ToLowerInPlace
+        // (CharLowerBuffW on Windows) in a single call. Surrogates and code
+        // points above the BMP are kept as-is.
+        size_t FoldRun(const wchar_t* ws, size_t n, uint16_t* out)
+        {
+            wchar_t wide[kCiFoldRun];
+            size_t at[kCiFoldRun];
+            size_t m = 0;
+            size_t k = 0;
+            for (size_t i = 0; i < n; i++) {
+                uint32_t c = (uint32_t)ws[i];
+                if (c < 0x100) {
+                    out[k++] = FoldLatin1((uint16_t)c);
+                }
+                else if (c <= 0xFFFF) {
+                    if (c < 0xD800 || c > 0xDFFF) {
+                        wide[m] = (wchar_t)c;
+                        at[m++] = k;
+                    }
+                    out[k++] = (uint16_t)c;
+                }
+                else if (c <= 0x10FFFF) {
+                    c -= 0x10000;
+                    out[k++] = (uint16_t)(0xD800 + (c >> 10));
+                    out[k++] = (uint16_t)(0xDC00 + (c & 0x3FF));
+                }
+                else {
+                    out[k++] = (uint16_t)c;
+                }
+            }
+            if (m != 0) {
+                platform::ToLowerInPlace(wide, m);
+                for (size_t j = 0; j < m; j++) {
+                    out[at[j]] = (uint16_t)wide[j];
+                }
+            }
+            return k;
+        }
+
+        inline ull PackUnits(const uint16_t* u)
+        {
+            return (ull)u[0] | ((ull)u[1] << 16) | ((ull)u[2] << 32) | ((ull)u[3] << 48);
+        }
+
+        // Streaming state of the hash. Blocks are fed as two little-endian 64-bit
+        // lanes of already folded code units; both the SIMD and the scalar path end
+        // up in MixBlock so they produce identical values.
+        class CiHasher
+        {
+        public:
+            void MixBlock(ull lane0, ull lane1)
+            {
+                h_ = MulFold(lane0 ^ kCiHashK0 ^ h_, lane1 ^ kCiHashK1);
+                len_ += kCiHashBlock;
+            }
+
+            // Whether the next MixBlock starts on a block boundary.
+            bool IsAligned() const
+            {
+                return tail_len_ == 0;
+            }
+
+            // Units already folded by FoldRun.
+            void PushFolded(const uint16_t* u, size_t n)
+            {
+                size_t i = 0;
+                for (; tail_len_ == 0 && i + kCiHashBlock <= n; i += kCiHashBlock) {
+                    MixBlock(PackUnits(u + i), PackUnits(u + i + 4));
+                }
+                for (; i < n; i++) {
+                    tail_[tail_len_++] = u[i];
+                    if (tail_len_ == kCiHashBlock) {
+                        MixBlock(PackUnits(tail_), PackUnits(tail_ + 4));
+                        tail_len_ = 0;
+                    }
+                }
+            }
+
+            ull Finish()
+            {
+                ull total = len_ + tail_len_;
+                if (tail_len_ != 0) {
+                    for (size_t i = tail_len_; i < kCiHashBlock; i++) {
+                        tail_[i] = 0;
+                    }
+                    h_ = MulFold(PackUnits(tail_) ^ kCiHashK0 ^ h_, PackUnits(tail_ + 4) ^ kCiHashK1);
+                }
+                ull h = MulFold(h_ ^ kCiHashK2, total ^ kCiHashK1);
+                h ^= h >> 32;
+                return h;
+            }
+
+        private:
+            ull h_ = kCiHashSeed;
+            ull len_ = 0;
+            uint16_t tail_[kCiHashBlock] = {};
+            size_t tail_len_ = 0;
+        };
+
+#ifdef CI_HASH_SSE2
+        // Lowercase 8 code units in one go: ASCII A-Z and Latin-1 C0-DE (except D7).
+        // Only valid when all 8 are below 0x100, see LoadLatin1Block.
+        inline __m128i FoldCase8(__m128i v)
+        {
+            const __m128i bias = _mm_set1_epi16((short)0x8000);
+            const __m128i ascii = _mm_cmplt_epi16(
+                _mm_xor_si128(_mm_sub_epi16(v, _mm_set1_epi16(L'A')), bias),
+                _mm_set1_epi16((short)(26 ^ 0x8000)));
+            const __m128i latin = _mm_andnot_si128(
+                _mm_cmpeq_epi16(v, _mm_set1_epi16(0xD7)),
+                _mm_cmplt_epi16(
+                    _mm_xor_si128(_mm_sub_epi16(v, _mm_set1_epi16(0xC0)), bias),
+                    _mm_set1_epi16((short)(31 ^ 0x8000))));
+            const __m128i delta = _mm_and_si128(_mm_or_si128(ascii, latin), _mm_set1_epi16(0x20));
+            return _mm_add_epi16(v, delta);
+        }
+
+        // Loads 8 chars as 16-bit units, false if any is 0x100 or above.
+        inline bool LoadLatin1Block(const wchar_t* p, __m128i* out)
+        {
+            if constexpr (sizeof(wchar_t) == sizeof(uint16_t)) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                *out = v;
+                return _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_srli_epi16(v, 8), _mm_setzero_si128())) == 0xFFFF;
+            }
+            else {
+                __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 4));
+                __m128i high_bits = _mm_or_si128(_mm_srli_epi32(lo, 8), _mm_srli_epi32(hi, 8));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi32(high_bits, _mm_setzero_si128())) != 0xFFFF) {
+                    return false;
+                }
+                *out = _mm_packs_epi32(lo, hi);
+                return true;
+            }
+        }
+#endif
+    }
+
+    ull GetWstrHashCi(const wchar_t* ws, size_t len)
+    {
+        CiHasher hasher;
+        uint16_t folded[kCiFoldRun * 2];
+        size_t i = 0;
+
+#ifdef CI_HASH_SSE2
+        alignas(16) uint16_t block[kCiHashBlock];
+        __m128i v;
+        while (i + kCiHashBlock <= len) {
+            if (LoadLatin1Block(ws + i, &v)) {
+                _mm_store_si128(reinterpret_cast<__m128i*>(block), FoldCase8(v));
+                if (hasher.IsAligned()) {
+                    hasher.MixBlock(PackUnits(block), PackUnits(block + 4));
+                }
+                else {
+                    // After a surrogate pair (wchar_t holding code points).
+                    hasher.PushFolded(block, kCiHashBlock);
+                }
+                i += kCiHashBlock;
+                continue;
+            }
+            // A run of blocks with letters above Latin-1 takes one platform call.
+            size_t n = kCiHashBlock;
+            while (n + kCiHashBlock <= kCiFoldRun && i + n + kCiHashBlock <= len && !LoadLatin1Block(ws + i + n, &v)) {
+                n += kCiHashBlock;
+            }
+            hasher.PushFolded(folded, FoldRun(ws + i, n, folded));
+            i += n;
+        }
+#endif
+        // The tail. Where wchar_t holds full code points, their UTF-16
+        // encoding is hashed.
+        while (i < len) {
+            size_t n = (std::min)(len - i, kCiFoldRun);
+            hasher.PushFolded(folded, FoldRun(ws + i, n, folded));
+            i += n;
+        }
+        return hasher.Finish();
+    }
+
+    ull GetWstrHashCi(const std::wstring& ws)
+    {
+        return GetWstrHashCi(ws.data(), ws.size());
+    }
+
+#ifdef _WIN32
     std::wstring CopyToTmp(const std::wstring& ws, bool create_new_if_duplicate)
 	{
 		std::wstring base_tmp_name = std::to_wstring(GetWstrHash(ws));
@@ -359,4 +613,6 @@ namespace helper
         // Close search handle
         FindClose(h_find);
     }
+#endif // _WIN32
+
 }
\ No newline at end of file
@@ -54,9 +54,20 @@ namespace helper {
 	std::vector<std::wstring> GetFileExtensions(const std::wstring& file_name);
 
 	ull GetWstrHash(const std::wstring& file_path);
-	
+
+	// Case-insensitive path hash: folds case on the fly (no temporary lowercase copy)
+	// and hashes 8 UTF-16 code units per step. ASCII and Latin-1 are folded inline,
+	// other BMP letters through platform::ToLowerInPlace (CharLowerBuffW on Windows,
+	// the locale's towlower on POSIX), so values above Latin-1 can differ between
+	// OS versions and locales: use it for in-process caches, do not persist it.
+	// Surrogates are hashed as-is.
+	ull GetWstrHashCi(const wchar_t* ws, size_t len);
+	ull GetWstrHashCi(const std::wstring& file_path);
+
+#ifdef _WIN32
 	std::wstring CopyToTmp(const std::wstring& file_path, bool create_new_if_duplicate = false);
 
 	void ClearTmpFiles();
+#endif // _WIN32
 }
 #endif  // ULTI_HELPER_H_
@@ -7,6 +7,7 @@
 #define ULTI_INCLUDE_H_
 #define NOMINMAX
 
+#ifdef _WIN32
 #pragma comment(lib, "iphlpapi.lib")
 #pragma comment(lib, "comsupp.lib")
 #pragma comment(lib, "ntdll.lib")
@@ -26,7 +27,6 @@
 #define WIN32_NO_STATUS
 #include <Windows.h>
 #undef WIN32_NO_STATUS
-#include <limits>
 #include <iphlpapi.h>
 #include <TlHelp32.h>
 #include <Psapi.h>
@@ -38,8 +38,12 @@
 //#include <winternl.h>
 #include <wtsapi32.h>
 #include <userenv.h>
+#endif // _WIN32
+
+#include "../platform/platform.h"
 
 #include <zlib.h>
+#include <limits>
 #include <memory>
 #include <iostream>
 #include <string>
@@ -56,6 +60,9 @@
 #include <deque>
 #include <syncstream>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <bit>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
@@ -101,7 +108,9 @@ struct {
 #define TOKENPASTE2(x, y) TOKENPASTE(x, y)
 #define defer auto TOKENPASTE2(__deferred_lambda_call, __COUNTER__) = deferrer << [&]
 
+#ifdef _MSC_VER
 #pragma warning(disable : 26110)
+#endif
 
 typedef unsigned int uint32;
 
@@ -112,7 +121,9 @@ typedef long long ll;
 
 #define ZeroMem(data,size) ZeroMemory(data,size)
 
+#ifdef _WIN32
 #define GetCurrentDir _getcwd
+#endif
 
 namespace fs = std::filesystem;
 
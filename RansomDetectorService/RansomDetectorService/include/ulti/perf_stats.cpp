@@ -0,0 +1,453 @@
+#include "perf_stats.h"
+#include "debug.h"
+
+#ifdef _WIN32
+#include <sddl.h>
+#pragma comment(lib, "Advapi32.lib")
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace perf {
+
+    namespace {
+        constexpr uint32_t kSubBucketBits = 4;
+        constexpr uint32_t kSubBuckets = 1u << kSubBucketBits;
+        constexpr uint32_t kMagnitudes = 42;    // up to 2^45 ns
+        constexpr uint32_t kBucketCount = kMagnitudes * kSubBuckets;
+
+        constexpr size_t kStageCount = (size_t)Stage::kCount;
+        constexpr size_t kValidatorCount = (size_t)Validator::kCount;
+        constexpr size_t kHistCount = kStageCount + kValidatorCount;
+
+        const char* kHistNames[kHistCount] = {
+            "etw_callback", "event_queue_wait", "dispatch", "receiver_push",
+            "scan_queue_wait", "get_types", "scan",
+            "val_pdf", "val_zip", "val_rar", "val_png", "val_jpg", "val_av",
+            "val_7z", "val_txt", "val_zlib", "val_gzip", "val_trid",
+        };
+        const char* kGaugeNames[(size_t)Gauge::kCount] = {
+            "event_queue", "receiver_queue", "pid_queues", "file_queue",
+        };
+        const char* kCounterNames[(size_t)Counter::kCount] = {
+            "events_dropped", "events_received", "files_scanned", "scan_requeued",
+        };
+
+        // Values below kSubBuckets map 1:1, above that each power of two is split
+        // into kSubBuckets linear steps.
+        inline uint32_t BucketIndex(ull v)
+        {
+            if (v < kSubBuckets) {
+                return (uint32_t)v;
+            }
+            uint32_t msb = 63 - (uint32_t)std::countl_zero(v);
+            uint32_t magnitude = msb - kSubBucketBits + 1;
+            if (magnitude >= kMagnitudes) {
+                return kBucketCount - 1;
+            }
+            uint32_t sub = (uint32_t)(v >> (msb - kSubBucketBits)) & (kSubBuckets - 1);
+            return magnitude * kSubBuckets + sub;
+        }
+
+        // Upper bound of a bucket, used when reporting percentiles.
+        inline ull BucketValue(uint32_t idx)
+        {
+            uint32_t magnitude = idx / kSubBuckets;
+            uint32_t sub = idx % kSubBuckets;
+            if (magnitude == 0) {
+                return sub;
+            }
+            uint32_t shift = magnitude - 1;
+            return ((ull)(kSubBuckets + sub + 1) << shift) - 1;
+        }
+
+        struct Histogram {
+            std::atomic<ull> buckets[kBucketCount];
+            std::atomic<ull> count;
+            std::atomic<ull> sum;
+            std::atomic<ull> max;
+        };
+
+        // Single writer (the owning thread), so a relaxed load+store is enough
+        // and avoids a locked add on the hot path.
+        inline void Bump(std::atomic<ull>& a, ull n)
+        {
+            a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        struct alignas(64) Shard {
+            Histogram hist[kHistCount];
+            std::atomic<ull> counters[(size_t)Counter::kCount];
+        };
+
+        std::mutex shard_mutex;
+        std::vector<std::unique_ptr<Shard>> shards;
+
+        std::atomic<ull> gauges[(size_t)Gauge::kCount];
+        std::atomic<ull> gauge_peaks[(size_t)Gauge::kCount];
+
+        // Shards outlive their threads so counts are never lost; threads in this
+        // service are long-lived so the list stays small.
+        Shard* LocalShard()
+        {
+            thread_local Shard* shard = nullptr;
+            if (shard == nullptr) {
+                auto owned = std::make_unique<Shard>();
+                shard = owned.get();
+                std::lock_guard<std::mutex> lk(shard_mutex);
+                shards.push_back(std::move(owned));
+            }
+            return shard;
+        }
+
+        void RecordHist(size_t idx, ull ns)
+        {
+            Histogram& h = LocalShard()->hist[idx];
+            Bump(h.buckets[BucketIndex(ns)], 1);
+            Bump(h.count, 1);
+            Bump(h.sum, ns);
+            if (ns > h.max.load(std::memory_order_relaxed)) {
+                h.max.store(ns, std::memory_order_relaxed);
+            }
+        }
+
+        std::atomic<bool> running = false;
+        std::thread dump_thread;
+        std::thread pipe_thread;
+        std::thread signal_thread;
+        std::mutex stop_mutex;
+        std::condition_variable stop_cv;
+
+        void DumpThread()
+        {
+            std::unique_lock<std::mutex> lk(stop_mutex);
+            while (running) {
+                stop_cv.wait_for(lk, std::chrono::milliseconds(PERF_DUMP_INTERVAL_MS), [] { return !running; });
+                lk.unlock();
+                DumpToFile();
+                lk.lock();
+            }
+        }
+
+#ifdef _WIN32
+        // Manual reset; set by Stop. Everything the pipe thread waits on
+        // also waits on this.
+        HANDLE pipe_stop_event = nullptr;
+
+        // Finishes an overlapped call on `pipe` that returned `done`. false
+        // when it failed, or when Stop came first and the call was cancelled.
+        bool FinishPipeIo(HANDLE pipe, OVERLAPPED* ov, BOOL done)
+        {
+            if (done == FALSE) {
+                DWORD error = GetLastError();
+                if (error == ERROR_PIPE_CONNECTED) {
+                    return true;
+                }
+                if (error != ERROR_IO_PENDING) {
+                    return false;
+                }
+                HANDLE events[2] = { ov->hEvent, pipe_stop_event };
+                if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0) {
+                    CancelIo(pipe);
+                    DWORD n = 0;
+                    GetOverlappedResult(pipe, ov, &n, TRUE);
+                    return false;
+                }
+            }
+            DWORD n = 0;
+            return GetOverlappedResult(pipe, ov, &n, FALSE) != FALSE;
+        }
+
+        // Overlapped, so Stop never depends on a client (or itself) showing
+        // up to complete a ConnectNamedPipe.
+        void PipeThread()
+        {
+            SECURITY_ATTRIBUTES sa = { sizeof(sa), nullptr, FALSE };
+            if (ConvertStringSecurityDescriptorToSecurityDescriptorW(PERF_PIPE_SDDL, SDDL_REVISION_1, &sa.lpSecurityDescriptor, nullptr) == FALSE) {
+                PrintDebugW(L"ConvertStringSecurityDescriptorToSecurityDescriptorW failed, error %s", debug::GetErrorMessage(GetLastError()).c_str());
+                return;
+            }
+            defer{ LocalFree(sa.lpSecurityDescriptor); };
+
+            OVERLAPPED ov = {};
+            ov.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+            if (ov.hEvent == nullptr) {
+                PrintDebugW(L"CreateEventW failed, error %s", debug::GetErrorMessage(GetLastError()).c_str());
+                return;
+            }
+            defer{ CloseHandle(ov.hEvent); };
+
+            while (running) {
+                HANDLE pipe = CreateNamedPipeW(PERF_PIPE_NAME, PIPE_ACCESS_OUTBOUND | FILE_FLAG_OVERLAPPED,
+                    PIPE_TYPE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                    1, 64 * 1024, 0, 0, &sa);
+                if (pipe == INVALID_HANDLE_VALUE) {
+                    // Another instance still closing, say; try again later.
+                    PrintDebugW(L"CreateNamedPipeW failed, error %s", debug::GetErrorMessage(GetLastError()).c_str());
+                    WaitForSingleObject(pipe_stop_event, PERF_PIPE_RETRY_MS);
+                    continue;
+                }
+                defer{ CloseHandle(pipe); };
+
+                ResetEvent(ov.hEvent);
+                if (FinishPipeIo(pipe, &ov, ConnectNamedPipe(pipe, &ov)) == false) {
+                    continue;
+                }
+
+                std::string report = Report();
+                ResetEvent(ov.hEvent);
+                if (FinishPipeIo(pipe, &ov, WriteFile(pipe, report.data(), (DWORD)report.size(), nullptr, &ov)) == true) {
+                    FlushFileBuffers(pipe);
+                }
+                DisconnectNamedPipe(pipe);
+            }
+        }
+#else
+        // The SIGUSR1 handler only writes a byte here (the one thing it can
+        // safely do); SignalThread reads it and dumps. Stop writes one too,
+        // to wake it up.
+        int trigger_pipe[2] = { -1, -1 };
+
+        void OnDumpSignal(int)
+        {
+            int saved = errno;
+            char c = 1;
+            // Non-blocking: with the pipe full a dump is already pending.
+            if (write(trigger_pipe[1], &c, 1) < 0) {
+            }
+            errno = saved;
+        }
+
+        void SignalThread()
+        {
+            for (;;) {
+                char c = 0;
+                ssize_t n = read(trigger_pipe[0], &c, 1);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n != 1 || running == false) {
+                    return;
+                }
+                DumpToFile();
+            }
+        }
+
+        bool StartSignalTrigger()
+        {
+            if (pipe2(trigger_pipe, O_CLOEXEC) != 0) {
+                return false;
+            }
+            fcntl(trigger_pipe[1], F_SETFL, fcntl(trigger_pipe[1], F_GETFL) | O_NONBLOCK);
+
+            struct sigaction sa = {};
+            sa.sa_handler = OnDumpSignal;
+            sa.sa_flags = SA_RESTART;
+            sigemptyset(&sa.sa_mask);
+            if (sigaction(SIGUSR1, &sa, nullptr) != 0) {
+                close(trigger_pipe[0]);
+                close(trigger_pipe[1]);
+                trigger_pipe[0] = trigger_pipe[1] = -1;
+                return false;
+            }
+            signal_thread = std::thread(SignalThread);
+            return true;
+        }
+
+        void StopSignalTrigger()
+        {
+            if (trigger_pipe[1] == -1) {
+                return;
+            }
+            // Ignored rather than the default, which would end the process.
+            signal(SIGUSR1, SIG_IGN);
+            char c = 0;
+            if (write(trigger_pipe[1], &c, 1) < 0) {
+                // Full: SignalThread has bytes to read and sees running == false.
+            }
+            if (signal_thread.joinable()) signal_thread.join();
+            close(trigger_pipe[0]);
+            close(trigger_pipe[1]);
+            trigger_pipe[0] = trigger_pipe[1] = -1;
+        }
+#endif // _WIN32
+    }
+
+    ull Now()
+    {
+        return (ull)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void Record(Stage stage, ull ns)
+    {
+        RecordHist((size_t)stage, ns);
+    }
+
+    void Record(Validator validator, ull ns)
+    {
+        RecordHist(kStageCount + (size_t)validator, ns);
+    }
+
+    void Add(Counter counter, ull n)
+    {
+        Bump(LocalShard()->counters[(size_t)counter], n);
+    }
+
+    ull CounterValue(Counter counter)
+    {
+        ull total = 0;
+        std::lock_guard<std::mutex> lk(shard_mutex);
+        for (const auto& shard : shards) {
+            total += shard->counters[(size_t)counter].load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    void SetGauge(Gauge gauge, ull value)
+    {
+        gauges[(size_t)gauge].store(value, std::memory_order_relaxed);
+        ull peak = gauge_peaks[(size_t)gauge].load(std::memory_order_relaxed);
+        while (value > peak && !gauge_peaks[(size_t)gauge].compare_exchange_weak(peak, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    void Start()
+    {
+        if (running.exchange(true) == true) {
+            return;
+        }
+        dump_thread = std::thread(DumpThread);
+#ifdef _WIN32
+        pipe_stop_event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (pipe_stop_event != nullptr) {
+            pipe_thread = std::thread(PipeThread);
+        }
+        else {
+            PrintDebugW(L"CreateEventW failed, error %s, no perf pipe", debug::GetErrorMessage(GetLastError()).c_str());
+        }
+#else
+        if (StartSignalTrigger() == false) {
+            PrintDebugW(L"Failed to install the SIGUSR1 handler, errno %d, no on-demand perf dump", errno);
+        }
+#endif
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lk(stop_mutex);
+            if (running.exchange(false) == false) {
+                return;
+            }
+        }
+        stop_cv.notify_all();
+
+#ifdef _WIN32
+        if (pipe_stop_event != nullptr) {
+            SetEvent(pipe_stop_event);
+        }
+#endif
+
+        if (dump_thread.joinable()) dump_thread.join();
+        if (pipe_thread.joinable()) pipe_thread.join();
+#ifdef _WIN32
+        if (pipe_stop_event != nullptr) {
+            CloseHandle(pipe_stop_event);
+            pipe_stop_event = nullptr;
+        }
+#else
+        StopSignalTrigger();
+#endif
+        DumpToFile();
+    }
+
+    std::string Report()
+    {
+        struct Merged {
+            std::vector<ull> buckets = std::vector<ull>(kBucketCount);
+            ull count = 0, sum = 0, max = 0;
+        };
+        std::vector<Merged> hists(kHistCount);
+        ull counters[(size_t)Counter::kCount] = {};
+
+        {
+            std::lock_guard<std::mutex> lk(shard_mutex);
+            for (const auto& shard : shards) {
+                for (size_t i = 0; i < kHistCount; i++) {
+                    const Histogram& h = shard->hist[i];
+                    Merged& m = hists[i];
+                    for (uint32_t b = 0; b < kBucketCount; b++) {
+                        m.buckets[b] += h.buckets[b].load(std::memory_order_relaxed);
+                    }
+                    m.count += h.count.load(std::memory_order_relaxed);
+                    m.sum += h.sum.load(std::memory_order_relaxed);
+                    m.max = (std::max)(m.max, h.max.load(std::memory_order_relaxed));
+                }
+                for (size_t i = 0; i < (size_t)Counter::kCount; i++) {
+                    counters[i] += shard->counters[i].load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        auto percentile = [](const Merged& m, double q) -> ull {
+            ull target = (ull)(q * (double)m.count);
+            ull seen = 0;
+            for (uint32_t b = 0; b < kBucketCount; b++) {
+                seen += m.buckets[b];
+                if (seen > target) {
+                    return (std::min)(BucketValue(b), m.max);
+                }
+            }
+            return m.max;
+        };
+
+        std::ostringstream ss;
+        ss << "# stage count mean_us p50_us p90_us p99_us p999_us max_us\n";
+        char line[256];
+        for (size_t i = 0; i < kHistCount; i++) {
+            const Merged& m = hists[i];
+            if (m.count == 0) {
+                continue;
+            }
+            snprintf(line, sizeof(line), "%s %llu %.1f %.1f %.1f %.1f %.1f %.1f\n",
+                kHistNames[i], m.count, (double)m.sum / m.count / 1000.0,
+                percentile(m, 0.50) / 1000.0, percentile(m, 0.90) / 1000.0,
+                percentile(m, 0.99) / 1000.0, percentile(m, 0.999) / 1000.0,
+                m.max / 1000.0);
+            ss << line;
+        }
+
+        ss << "# gauge current peak\n";
+        for (size_t i = 0; i < (size_t)Gauge::kCount; i++) {
+            ss << kGaugeNames[i] << " " << gauges[i].load(std::memory_order_relaxed)
+                << " " << gauge_peaks[i].load(std::memory_order_relaxed) << "\n";
+        }
+
+        ss << "# counter value\n";
+        for (size_t i = 0; i < (size_t)Counter::kCount; i++) {
+            ss << kCounterNames[i] << " " << counters[i] << "\n";
+        }
+
+        auto log_stats = debug::GetLogStats();
+        ss << "log_lines_written " << log_stats.lines_written << "\n";
+        ss << "log_lines_dropped " << log_stats.lines_dropped << "\n";
+        ss << "log_lines_truncated " << log_stats.lines_truncated << "\n";
+        ss << "log_max_queue_depth " << log_stats.max_queue_depth << "\n";
+        return ss.str();
+    }
+
+    bool DumpToFile(const std::wstring& path)
+    {
+        std::string report = Report();
+        platform::File file;
+        if (file.Open(path, platform::File::Mode::kCreate) == false) {
+            return false;
+        }
+        return file.Write(report.data(), report.size());
+    }
+
+}  // namespace perf
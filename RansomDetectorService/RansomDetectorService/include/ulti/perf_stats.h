@@ -0,0 +1,116 @@
+#pragma once
+
+#ifndef ULTI_PERF_STATS_H_
+#define ULTI_PERF_STATS_H_
+
+#include "include.h"
+
+#ifdef _WIN32
+#define PERF_DUMP_PATH L"C:\\hieunt_perf.log"
+#define PERF_PIPE_NAME L"\\\\.\\pipe\\hieunt_perf"
+// SYSTEM and administrators only: the default DACL would let any local user
+// read the report.
+#define PERF_PIPE_SDDL L"D:P(A;;GA;;;SY)(A;;GA;;;BA)"
+#define PERF_PIPE_RETRY_MS 1000
+#else
+#define PERF_DUMP_PATH L"/tmp/hieunt_perf.log"
+#endif
+#define PERF_DUMP_INTERVAL_MS 10000
+
+/*
+Always-on pipeline latency counters.
+
+Every thread records into its own shard (plain relaxed stores, no locks, no
+shared cache lines). A background thread merges the shards every
+PERF_DUMP_INTERVAL_MS and rewrites PERF_DUMP_PATH. On demand: on Windows,
+connecting to PERF_PIPE_NAME returns the same report; elsewhere, SIGUSR1
+rewrites PERF_DUMP_PATH at once (kill -USR1 <pid>).
+
+Histograms are HDR-style log-linear: 16 sub-buckets per power of two, so any
+recorded value is reported within ~6% of its true value, from 1 ns up to 2^45 ns
+(~9.8 h).
+*/
+
+namespace perf {
+
+    enum class Stage : uint32_t {
+        kEtwCallback = 0,   // file_cb: parse EVENT_RECORD + EnqueueEvent
+        kEventQueueWait,    // EnqueueEvent -> DispatchEvent
+        kDispatch,          // DispatchEvent
+        kReceiverPush,      // Receiver::PushFileEventSync (path resolution)
+        kScanQueueWait,     // QueuingThread hand-off -> WorkerThread pickup
+        kGetTypes,          // FileType::GetTypes
+        kScan,              // WorkerThread: pickup -> result logged
+        kCount
+    };
+
+    enum class Validator : uint32_t {
+        kPdf = 0,
+        kZip,
+        kRar,
+        kPng,
+        kJpg,
+        kAudioVideo,
+        k7z,
+        kTxt,
+        kZlib,
+        kGzip,
+        kTrid,
+        kCount
+    };
+
+    enum class Gauge : uint32_t {
+        kEventQueue = 0,    // EtwController::m_evtQueue
+        kReceiverQueue,     // Receiver::file_io_queue_
+        kPidQueues,         // Scanner::pid_queues_ (number of pids)
+        kFileQueue,         // Scanner::file_queues_
+        kCount
+    };
+
+    enum class Counter : uint32_t {
+        kEventsDropped = 0, // EnqueueEvent overflow
+        kEventsReceived,
+        kFilesScanned,
+        kScanRequeued,      // sharing violation / rescan delay
+        kCount
+    };
+
+    // Monotonic clock in nanoseconds.
+    ull Now();
+
+    void Record(Stage stage, ull ns);
+    void Record(Validator validator, ull ns);
+    void Add(Counter counter, ull n = 1);
+    void SetGauge(Gauge gauge, ull value);
+
+    // Sum of a counter over all threads.
+    ull CounterValue(Counter counter);
+
+    // Starts the periodic dump thread and the on-demand trigger: the named pipe
+    // server on Windows, the SIGUSR1 handler elsewhere.
+    void Start();
+    void Stop();
+
+    // Merges all shards and renders the text report.
+    std::string Report();
+
+    // Writes Report() to PERF_DUMP_PATH.
+    bool DumpToFile(const std::wstring& path = PERF_DUMP_PATH);
+
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(Stage stage) : stage_(stage), start_(Now()) {}
+        ~ScopedTimer() { Record(stage_, Now() - start_); }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        Stage stage_;
+        ull start_;
+    };
+
+}  // namespace perf
+
+#endif // ULTI_PERF_STATS_H_
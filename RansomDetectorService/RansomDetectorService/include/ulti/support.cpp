@@ -4,37 +4,11 @@
 namespace ulti
 {
     std::wstring StrToWstr(const std::string& str) {
-        if (str.empty()) return L"";
-
-        int size_needed = MultiByteToWideChar(CP_UTF8, 0,
-            str.c_str(), static_cast<int>(str.size()),
-            nullptr, 0);
-        if (size_needed <= 0) {
-            return L"";
-        }
-
-        std::wstring wstr(size_needed, L'\0');
-        MultiByteToWideChar(CP_UTF8, 0,
-            str.c_str(), static_cast<int>(str.size()),
-            &wstr[0], size_needed);
-        return wstr;
+        return platform::Utf8ToWide(str);
     }
 
     std::string WstrToStr(const std::wstring& wstr) {
-        if (wstr.empty()) return "";
-
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0,
-            wstr.c_str(), static_cast<int>(wstr.size()),
-            nullptr, 0, nullptr, nullptr);
-        if (size_needed <= 0) {
-            return "";
-        }
-
-        std::string str(size_needed, '\0');
-        WideCharToMultiByte(CP_UTF8, 0, 
-            wstr.c_str(), static_cast<int>(wstr.size()), 
-            &str[0], size_needed, nullptr, nullptr);
-        return str;
+        return platform::WideToUtf8(wstr);
     }
 
     std::string CharVectorToString(const std::vector<char>& v)
@@ -55,25 +29,25 @@ namespace ulti
     std::wstring ToLower(const std::wstring& wstr)
     {
         std::wstring result = wstr;
-        CharLowerBuffW(result.data(), result.size());
+        platform::ToLowerInPlace(result.data(), result.size());
         return result;
     }
 
     std::string ToLower(const std::string& wstr)
     {
         std::string result = wstr;
-        CharLowerBuffA(result.data(), result.size());
+        platform::ToLowerInPlace(result.data(), result.size());
         return result;
     }
 
     void ToLowerOverride(std::wstring& wstr)
     {
-        CharLowerBuffW(wstr.data(), wstr.size());
+        platform::ToLowerInPlace(wstr.data(), wstr.size());
     }
 
     void ToLowerOverride(std::string& wstr)
     {
-        CharLowerBuffA(wstr.data(), wstr.size());
+        platform::ToLowerInPlace(wstr.data(), wstr.size());
     }
 
     // Split a string by a given delimiter into a vector of strings.
@@ -143,6 +117,7 @@ namespace ulti
         #endif
     }
 
+#ifdef _WIN32
     bool CreateDir(const std::wstring& dir_path)
     {
         BOOL status = ::CreateDirectory(dir_path.c_str(), NULL);
@@ -325,4 +300,6 @@ namespace ulti
         }
     }
 
+#endif // _WIN32
+
 }
@@ -36,6 +36,7 @@ namespace ulti
 
     bool IsCurrentX86Process();
 
+#ifdef _WIN32
     bool CreateDir(const std::wstring& dir_path);
 
     bool KillProcess(DWORD pid);
@@ -66,6 +67,7 @@ namespace ulti
      * @param cpu_perc Target CPU percentage (e.g., 5.0 for 5%)
      */
     void ThreadPerfCtrlSleep(double cpu_perc = 5.0);
+#endif // _WIN32
 
 }
 
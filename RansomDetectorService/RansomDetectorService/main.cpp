@@ -11,6 +11,8 @@ C/C++ -> General -> Additional Include Dir -> $(ProjectDir)include
 #include "manager/file_type_iden.h"
 #include "ulti/file_helper.h"
 #include "manager/etw_controller.h"
+#include "manager/driver_channel.h"
+#include "ulti/perf_stats.h"
 
 static void ServiceMain()
 {
@@ -20,6 +22,8 @@ static void ServiceMain()
 	
 	debug::InitDebugLog();
 
+	perf::Start();
+
 	helper::InitDosDeviceCache();
 
 	auto ft = type_iden::FileType::GetInstance();
@@ -54,34 +58,42 @@ static void ServiceMain()
 		return;
 	}
 
+	// Optional: without EventCollectorDriver the receiver only gets ETW events.
+	manager::DriverChannel::GetInstance()->Start();
+
 	etwc->Start();
 }
 
 static void StopService() {
 
+	manager::DriverChannel::GetInstance()->Stop();
+
 	auto etwc = EtwController::GetInstance();
-	if (etwc == nullptr) {
-		return;
+	if (etwc != nullptr) {
+		etwc->Stop();
 	}
-	etwc->Stop();
 
-	auto ft = type_iden::FileType::GetInstance();
-	if (ft != nullptr) {
-		ft->Uninit();
-		return;
-	}
+	perf::Stop();
 
+	// Every component, producers first: the scanner's workers use the file
+	// type validators, and Scanner::Uninit writes the last scan results.
 	auto rcv = manager::Receiver::GetInstance();
 	if (rcv != nullptr) {
 		rcv->Uninit();
-		return;
 	}
 
 	auto scanner = manager::Scanner::GetInstance();
 	if (scanner != nullptr) {
 		scanner->Uninit();
-		return;
 	}
+
+	auto ft = type_iden::FileType::GetInstance();
+	if (ft != nullptr) {
+		ft->Uninit();
+	}
+
+	// Last, so everything above still gets logged.
+	debug::CleanupDebugLog();
 }
 
 int main()
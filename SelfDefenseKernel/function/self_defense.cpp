@@ -1,12 +1,17 @@
 ﻿#include "self_defense.h"
 #include "query.h"
 #include "../../std/map/map.h"
-#include "../../std/sync/mutex.h"
+#include "../../std/sync/ex_push_lock.h"
+#include "../../std/algo/path_trie.h"
+#include "../../std/map/pid_flags.h"
 #include "../../template/register.h"
 #include "../../template/flt-ex.h"
 #include "../../std/file/file.h"
 #include "../../std/ulti/def.h"
 
+// Exported by ntoskrnl; STATUS_PENDING until the process starts to exit.
+extern "C" NTKERNELAPI NTSTATUS PsGetProcessExitStatus(_In_ PEPROCESS Process);
+
 namespace self_defense {
 
     struct ProcessInfo
@@ -23,22 +28,44 @@ namespace self_defense {
     bool kIsAttacked = false;
 
     // Map PID với process full path, trạng thái bảo vệ, thời điểm bắt đầu của process
+    // Looked up on every protected-path check; held shared for lookups,
+    // exclusive only to insert or erase.
     static Map<HANDLE, ProcessInfo>* kProcessMap;
-    static Mutex kProcessMapMutex;
+    static PushLock kProcessMapLock;
 
     static Vector<std::WString>* kProtectedDirList;
     static Vector<std::WString>* kProtectedFileList;
-    static Mutex kFileMutex;
+    // Serializes changes to the lists; the lookups go through kProtectedPaths.
+    static PushLock kFileLock;
+    // Both lists compiled into one trie by PublishProtectedPaths. Readers hold
+    // kProtectedPathsLock shared for the lookup only; a rebuild compiles the
+    // new trie unlocked and takes the lock exclusive just to swap the pointer,
+    // so a lookup never waits for a compile and never sees a freed trie.
+    static PathTrie* kProtectedPaths;
+    static PushLock kProtectedPathsLock;
+
+    // What PreObCallback needs to know about each process, so a handle open
+    // costs two lock-free lookups instead of two image name queries. Set at
+    // process creation (or at the first open of a process started before the
+    // driver), removed at exit, cleared when the protected lists change.
+    constexpr unsigned int kVerdictTrustedSource = 1;   // may open guarded processes
+    constexpr unsigned int kVerdictGuardedTarget = 2;   // rights stripped from handles to it
+    static krnl_std::PidFlagsTable kVerdicts;
+    static PushLock kVerdictLock;                       // writers of kVerdicts only
+    static volatile ull kVerdictGeneration;             // bumped by each clear
     static PVOID kHandleRegistration;
     static bool kEnableProtectFile;
 
     void DrvRegister()
     {
         DebugMessage("%ws", __FUNCTIONW__);
-        kFileMutex.Create();
-        kProcessMapMutex.Create();
+        kFileLock.Create();
+        kProcessMapLock.Create();
+        kVerdictLock.Create();
+        krnl_std::InitPidFlags(kVerdicts);
+        kProtectedPathsLock.Create();
 
-		kFileMutex.Lock();
+		kFileLock.LockExclusive();
         kProtectedDirList = new Vector<std::WString>();
 		Vector<std::WString> default_protected_dirs = GetDefaultProtectedDirs();
 		for (int i = 0; i < default_protected_dirs.Size(); ++i)
@@ -51,7 +78,8 @@ namespace self_defense {
 		{
 			kProtectedFileList->PushBack(default_protected_files[i]);
 		}
-		kFileMutex.Unlock();
+		PublishProtectedPaths();
+		kFileLock.UnlockExclusive();
 
         kProcessMap = new Map<HANDLE, ProcessInfo>(); // thay đổi kiểu dữ liệu của map
         NTSTATUS status;
@@ -119,12 +147,20 @@ namespace self_defense {
             kIsObCallbackRegistered = false;
         }
 
-        kProcessMapMutex.Lock();
+        kProcessMapLock.LockExclusive();
         delete kProcessMap;
-        kProcessMapMutex.Unlock();
-        kFileMutex.Lock();
+        kProcessMapLock.UnlockExclusive();
+        kFileLock.LockExclusive();
+        PathTrie* paths = nullptr;
+        {
+            PushLock::AutoExclusive lock(kProtectedPathsLock);
+            paths = kProtectedPaths;
+            kProtectedPaths = nullptr;
+        }
+        delete paths;
         delete kProtectedDirList;
-        kFileMutex.Unlock();
+        delete kProtectedFileList;
+        kFileLock.UnlockExclusive();
     }
 
     void FltRegister()
@@ -319,23 +355,25 @@ namespace self_defense {
         {
             // Process is being created
             auto ppid = PsGetCurrentProcessId();
+            ull verdict_generation = krnl_std::ring_atomic::Load(&kVerdictGeneration);
             const std::WString& process_path = GetProcessImageName(pid);
             const std::WString& parent_process_path = GetProcessImageName(ppid);
             DebugMessage("Creation, pid %llu, path %ws, ppid %llu, parent path %ws", (ull)pid, process_path.Data(), (ull)ppid, parent_process_path.Data());
 
+            CacheVerdict(process, pid, ComputeVerdict(process_path), verdict_generation);
+
             bool is_protected = IsProtectedFile(process_path) ||
                 (IsProtectedFile(parent_process_path) && parent_process_path.Contain(L"VMware\\VMware Tools") == false);
 
             if (is_protected == false)
             {
                 // If parent process is protected, then child process is also protected
-                kProcessMapMutex.Lock();
+                PushLock::AutoShared lock(kProcessMapLock);
                 auto it = kProcessMap->Find(ppid);
                 if (it != kProcessMap->End())
                 {
                     is_protected = it->second.is_protected;
                 }
-                kProcessMapMutex.Unlock();
             }
 
             if (process_path.FindFirstOf(L"Downloads") != std::WString::kNPos)
@@ -349,18 +387,19 @@ namespace self_defense {
             }
             LARGE_INTEGER start_time;
             KeQuerySystemTime(&start_time);
-            kProcessMapMutex.Lock();
-
+            PushLock::AutoExclusive lock(kProcessMapLock);
             kProcessMap->Insert(pid, { pid, process_path, is_protected, start_time }); // lưu vào cache với trạng thái bảo vệ
-            kProcessMapMutex.Unlock();
         }
         else
         {
             // Process kết thúc, xóa khỏi cache
-            kProcessMapMutex.Lock();
             DebugMessage("Termination, pid %llu, path %ws", (ull)pid, GetProcessImageName(pid).Data());
+            {
+                PushLock::AutoExclusive lock(kVerdictLock);
+                krnl_std::RemovePidFlags(kVerdicts, (ull)pid);
+            }
+            PushLock::AutoExclusive lock(kProcessMapLock);
             kProcessMap->Erase(pid);
-            kProcessMapMutex.Unlock();
         }
     }
 
@@ -412,27 +451,22 @@ namespace self_defense {
 		}
         */
 
-        std::WString source_process_path = GetProcessImageName(source_pid);
-
-        if (source_process_path.EqualCi(L"\\Device\\HarddiskVolume3\\Windows\\System32\\services.exe") == true)
+        // Most opens target a process that is not guarded; check that first.
+        if ((GetVerdict(target_pid) & kVerdictGuardedTarget) == 0)
         {
-            //DebugMessage("source_process_path %ws is services", source_process_path.Data());
+            //DebugMessage("target pid %llu is whitelisted", (ull)target_pid);
             return OB_PREOP_SUCCESS;
         }
 
-        std::WString target_process_path = GetProcessImageName(target_pid);
-        if (target_process_path.HasCiSuffix(L"RansomDetectorService.exe") == false &&
-            target_process_path.FindFirstOf(L"VMware") == std::WString::kNPos)
+        if ((GetVerdict(source_pid) & kVerdictTrustedSource) != 0)
         {
-            //DebugMessage("target_process_path %ws is whitelisted", target_process_path.Data());
+            //DebugMessage("source pid %llu is services or protected", (ull)source_pid);
             return OB_PREOP_SUCCESS;
         }
 
-        if (IsProtectedFile(source_process_path) == true)
-        {
-            //DebugMessage("source_process_path %ws is protected", source_process_path.Data());
-            return OB_PREOP_SUCCESS;
-        }
+        // Only opens that lose rights pay for the names, for the log lines.
+        std::WString source_process_path = GetProcessImageName(source_pid);
+        std::WString target_process_path = GetProcessImageName(target_pid);
         /*
         if (source_process_path.HasPrefix(L"\\Device\\HarddiskVolume3\\Program Files\\VMware\\VMware Tools\\") == true)
         {
@@ -551,54 +585,136 @@ namespace self_defense {
 		return OB_PREOP_SUCCESS;
 	}
 
-	// Kiểm tra xem thư mục có nằm trong danh sách bảo vệ không
-	bool IsProtectedFile(const std::WString& path)
+	// Rebuilds kProtectedPaths from kProtectedDirList and kProtectedFileList.
+	// Call with kFileLock held exclusive after changing either list. If the trie cannot
+	// be built the old one is dropped all the same, and IsProtectedFile scans
+	// the lists until a rebuild succeeds.
+	void PublishProtectedPaths()
 	{
-		//DebugMessage("Checking file: %ws", path.Data());
-		kFileMutex.Lock();
-		bool is_protected = false;
-
-		for (int i = 0; i < kProtectedDirList->Size(); i++) {
-			const auto& protected_dir = kProtectedDirList->At(i);
-			/*
-			if (protected_dir.IsPrefixOf(path)) {
-				is_protected = true;
-				break;
+		PathTrie* paths = new PathTrie();
+		if (paths != nullptr)
+		{
+			bool ok = true;
+			for (int i = 0; ok && i < kProtectedDirList->Size(); i++) {
+				ok = paths->AddPrefix(kProtectedDirList->At(i));
 			}
-			*/
-			if (protected_dir.Size() < path.Size() && _wcsnicmp(protected_dir.Data(), path.Data(), protected_dir.Size()) == 0)
-			{
-				is_protected = true;
+			for (int i = 0; ok && i < kProtectedFileList->Size(); i++) {
+				ok = paths->AddPath(kProtectedFileList->At(i));
 			}
-        }
-
-		for (int i = 0; i < kProtectedFileList->Size(); i++) {
-			const auto& protected_file = kProtectedFileList->At(i);
-			/*
-			if (protected_file.IsPrefixOf(path) && path.IsPrefixOf(protected_file)) {
-				is_protected = true;
-				break;
+			if (ok == false || paths->Compile() == false)
+			{
+				DebugMessage("Fail to compile protected paths, falling back to list scan");
+				delete paths;
+				paths = nullptr;
 			}
-			*/
-			if (protected_file.Size() == path.Size() && _wcsnicmp(protected_file.Data(), path.Data(), protected_file.Size()) == 0)
+			else
 			{
-				is_protected = true;
+				DebugMessage("Protected paths compiled: %llu entries, %llu bytes", paths->Size(), paths->Bytes());
 			}
 		}
 
-        kFileMutex.Unlock();
+		PathTrie* old_paths = nullptr;
+		{
+			PushLock::AutoExclusive lock(kProtectedPathsLock);
+			old_paths = kProtectedPaths;
+			kProtectedPaths = paths;
+		}
+		delete old_paths;
 
-		if (is_protected)
+		// Trusted-source verdicts came from the old lists.
+		PushLock::AutoExclusive lock(kVerdictLock);
+		krnl_std::ring_atomic::Add(&kVerdictGeneration, 1);
+		krnl_std::ClearPidFlags(kVerdicts);
+	}
+
+	unsigned int ComputeVerdict(const std::WString& process_path)
+	{
+		unsigned int verdict = 0;
+		if (process_path.EqualCi(L"\\Device\\HarddiskVolume3\\Windows\\System32\\services.exe") == true ||
+			IsProtectedFile(process_path) == true)
 		{
-			//DebugMessage("File %ws is protected", path.Data());
+			verdict |= kVerdictTrustedSource;
 		}
-		else
+		if (process_path.HasCiSuffix(L"RansomDetectorService.exe") == true ||
+			process_path.FindFirstOf(L"VMware") != std::WString::kNPos)
 		{
-			//DebugMessage("File %ws is not protected", path.Data());
+			verdict |= kVerdictGuardedTarget;
 		}
+		return verdict;
+	}
 
-        return is_protected;
-    }
+	// `generation` is kVerdictGeneration from before the verdict was
+	// computed; a clear since then means it may be stale, so it is dropped.
+	// `process` is the referenced process the verdict was computed for, so
+	// `pid` cannot have been reused. Once it has started to exit, its exit
+	// notification may already have removed the pid, and storing now would
+	// hand the verdict to the next process given that pid. The exit status
+	// is set before the notification runs, which takes kVerdictLock, so a
+	// store made under the lock before the status changes is removed by it.
+	void CacheVerdict(PEPROCESS process, HANDLE pid, unsigned int verdict, ull generation)
+	{
+		PushLock::AutoExclusive lock(kVerdictLock);
+		if (kVerdictGeneration == generation && PsGetProcessExitStatus(process) == STATUS_PENDING)
+		{
+			krnl_std::SetPidFlags(kVerdicts, (ull)pid, verdict);
+		}
+	}
+
+	// Lock-free on a hit. A miss (a process started before the driver, or
+	// the table full around its pid) computes the verdict and caches it,
+	// unless the image name cannot be read or the process is exiting, which
+	// is retried next time.
+	unsigned int GetVerdict(HANDLE pid)
+	{
+		unsigned int verdict = 0;
+		if (krnl_std::FindPidFlags(kVerdicts, (ull)pid, &verdict) == true)
+		{
+			return verdict;
+		}
+		// The reference keeps the pid on this process until the verdict is
+		// stored.
+		PEPROCESS process = nullptr;
+		if (!NT_SUCCESS(PsLookupProcessByProcessId(pid, &process)))
+		{
+			return ComputeVerdict(std::WString());
+		}
+		ull generation = krnl_std::ring_atomic::Load(&kVerdictGeneration);
+		std::WString process_path = GetProcessImageName(pid);
+		verdict = ComputeVerdict(process_path);
+		if (process_path.Size() != 0)
+		{
+			CacheVerdict(process, pid, verdict, generation);
+		}
+		ObDereferenceObject(process);
+		return verdict;
+	}
+
+	// Kiểm tra xem thư mục có nằm trong danh sách bảo vệ không
+	bool IsProtectedFile(const std::WString& path)
+	{
+		//DebugMessage("Checking file: %ws", path.Data());
+		{
+			PushLock::AutoShared lock(kProtectedPathsLock);
+			if (kProtectedPaths != nullptr)
+			{
+				return kProtectedPaths->Match(path);
+			}
+		}
+
+		// No compiled trie (out of memory): the lists themselves.
+		PushLock::AutoShared lock(kFileLock);
+		bool is_protected = false;
+
+		for (int i = 0; is_protected == false && i < kProtectedDirList->Size(); i++) {
+			const auto& protected_dir = kProtectedDirList->At(i);
+			is_protected = protected_dir.Size() < path.Size() && protected_dir.IsCiPrefixOf(path);
+		}
+
+		for (int i = 0; is_protected == false && i < kProtectedFileList->Size(); i++) {
+			is_protected = kProtectedFileList->At(i).EqualCi(path);
+		}
+		return is_protected;
+	}
 
 	bool IsInProtectedFile(const std::WString& path)
 	{
@@ -608,33 +724,39 @@ namespace self_defense {
     // Kiểm tra xem PID có thuộc process cần bảo vệ không
     bool IsProtectedProcess(HANDLE pid)
     {
-        kProcessMapMutex.Lock();
 		//DebugMessage("Checking pid %llu: %ws", (ull)pid, GetProcessImageName(pid).Data());
-
-        auto it = kProcessMap->Find(pid);
         bool is_protected = false;
-
-        if (it != kProcessMap->End())
+        bool is_cached = false;
         {
-			//DebugMessage("PID %llu is in process map", (ull)pid);
-            is_protected = it->second.is_protected; // lấy trạng thái bảo vệ từ cache
-            if (is_protected == false)
+            PushLock::AutoShared lock(kProcessMapLock);
+            auto it = kProcessMap->Find(pid);
+            if (it != kProcessMap->End())
             {
-                is_protected = IsProtectedFile(it->second.process_path);
+                //DebugMessage("PID %llu is in process map", (ull)pid);
+                is_cached = true;
+                is_protected = it->second.is_protected; // lấy trạng thái bảo vệ từ cache
+                if (is_protected == false)
+                {
+                    is_protected = IsProtectedFile(it->second.process_path);
+                }
             }
         }
-        else
+
+        if (is_cached == false)
         {
 			//DebugMessage("PID %llu is not in process map", (ull)pid);
 
-            // Process không có trong cache, lấy thông tin mới
+            // Process không có trong cache, lấy thông tin mới (ngoài lock)
             std::WString process_path = GetProcessImageName(pid);
             is_protected = IsProtectedFile(process_path);
 
-            // Lưu vào cache
-            kProcessMap->Insert(pid, { pid, process_path, is_protected, 0 });
+            // Lưu vào cache, trừ khi ProcessNotifyCallback đã lưu trước
+            PushLock::AutoExclusive lock(kProcessMapLock);
+            if (kProcessMap->Find(pid) == kProcessMap->End())
+            {
+                kProcessMap->Insert(pid, { pid, process_path, is_protected, 0 });
+            }
         }
-        kProcessMapMutex.Unlock();
 
 		if (is_protected)
 		{
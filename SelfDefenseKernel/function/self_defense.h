@@ -26,10 +26,16 @@ namespace self_defense {
     );
 
     // Các hàm trợ giúp
+    void PublishProtectedPaths();
     bool IsProtectedFile(const std::WString& path);
     bool IsInProtectedFile(const std::WString& path);
     bool IsProtectedProcess(HANDLE pid);
 
+    // Per-process verdicts for PreObCallback
+    unsigned int ComputeVerdict(const std::WString& process_path);
+    void CacheVerdict(PEPROCESS process, HANDLE pid, unsigned int verdict, ull generation);
+    unsigned int GetVerdict(HANDLE pid);
+
     std::WString GetProcessImageName(HANDLE pid);
 	Vector<std::WString> GetDefaultProtectedDirs();
 	Vector<std::WString> GetDefaultProtectedFiles();
@@ -0,0 +1,287 @@
+#ifndef AHO_CORASICK_H_
+#define AHO_CORASICK_H_
+
+// Case-insensitive search for any of a list of substrings ("VMware",
+// "\Downloads\", ...) in one pass over the text, however long the list:
+// an Aho-Corasick automaton, one step per text character plus failure-link
+// steps that add up to at most the text length. Running FindFirstOf once per
+// pattern costs the list length times that; it is still the cheaper of the
+// two up to about sixteen patterns (bench/search_bench.cpp).
+//
+// Same life cycle and layout as PathTrie: Add, then Compile()d into a single
+// block with each node's edges sorted for binary search, then read-only for
+// any number of threads. Characters are folded with std::FoldCase.
+// Allocation failures are reported, not retried: Add and Compile return
+// false and the automaton then finds nothing.
+
+#include "../memory/memory.h"
+#include "../string/wstring.h"
+
+class AhoCorasick {
+public:
+    static constexpr unsigned int kNone = 0xFFFFFFFF;
+
+    AhoCorasick();
+    ~AhoCorasick();
+
+    AhoCorasick(const AhoCorasick&) = delete;
+    AhoCorasick& operator=(const AhoCorasick&) = delete;
+
+    // Patterns are numbered from 0 in the order they are added; adding one
+    // again keeps its first number. false for an empty pattern, after
+    // Compile, or when out of memory.
+    bool Add(std::WStringView pattern);
+
+    bool Compile();
+
+    bool Compiled() const { return nodes_ != nullptr; }
+    ull Size() const { return patterns_; }
+    // Bytes held by the compiled automaton.
+    ull Bytes() const { return bytes_; }
+
+    // Start of the occurrence that ends first in `text` (the longest, of
+    // those ending at the same place), or std::WStringView::kNPos. Its
+    // pattern number goes to `pattern` if given.
+    size_t Find(std::WStringView text, unsigned int* pattern = nullptr) const;
+
+    bool Match(std::WStringView text) const { return Find(text) != std::WStringView::kNPos; }
+
+private:
+    struct BuildNode {
+        unsigned int first_child;
+        unsigned int next_sibling;
+        unsigned int pattern;
+        WCHAR label;
+    };
+
+    // `out` is the longest pattern ending here: the node's own, or its
+    // failure node's `out`.
+    struct Node {
+        unsigned int first_edge;
+        unsigned int edge_count;
+        unsigned int fail;
+        unsigned int out;
+    };
+
+    BuildNode* build_;
+    unsigned int build_size_;
+    unsigned int build_capacity_;
+
+    void* block_;
+    Node* nodes_;
+    unsigned int* targets_;
+    WCHAR* labels_;
+    unsigned int* lengths_;     // per pattern
+    unsigned int patterns_;
+    ull bytes_;
+
+    unsigned int NewBuildNode(WCHAR label);
+    unsigned int Edge(unsigned int node, WCHAR c) const;
+};
+
+inline AhoCorasick::AhoCorasick()
+    : build_(nullptr), build_size_(0), build_capacity_(0),
+      block_(nullptr), nodes_(nullptr), targets_(nullptr), labels_(nullptr), lengths_(nullptr),
+      patterns_(0), bytes_(0) {}
+
+inline AhoCorasick::~AhoCorasick() {
+    krnl_std::Free(build_);
+    krnl_std::Free(block_);
+}
+
+inline unsigned int AhoCorasick::NewBuildNode(WCHAR label) {
+    if (build_size_ == build_capacity_) {
+        unsigned int capacity = build_capacity_ < 64 ? 64 : build_capacity_ * 2;
+        if (capacity <= build_capacity_) {
+            return kNone;
+        }
+        BuildNode* nodes = (BuildNode*)krnl_std::Alloc((ull)capacity * sizeof(BuildNode), krnl_std::kTrieTag);
+        if (nodes == nullptr) {
+            return kNone;
+        }
+        if (build_size_ != 0) {
+            memcpy(nodes, build_, (ull)build_size_ * sizeof(BuildNode));
+        }
+        krnl_std::Free(build_);
+        build_ = nodes;
+        build_capacity_ = capacity;
+    }
+    BuildNode& n = build_[build_size_];
+    n.first_child = kNone;
+    n.next_sibling = kNone;
+    n.pattern = kNone;
+    n.label = label;
+    return build_size_++;
+}
+
+// Nodes a failed Add already linked in stay, patternless, and find nothing.
+inline bool AhoCorasick::Add(std::WStringView pattern) {
+    if (nodes_ != nullptr || pattern.Size() == 0 || pattern.Size() >= kNone) {
+        return false;
+    }
+    if (build_size_ == 0 && NewBuildNode(0) == kNone) {
+        return false;
+    }
+    unsigned int node = 0;
+    for (size_t i = 0; i < pattern.Size(); i++) {
+        WCHAR c = std::FoldCase(pattern[i]);
+        unsigned int* link = &build_[node].first_child;
+        while (*link != kNone && build_[*link].label < c) {
+            link = &build_[*link].next_sibling;
+        }
+        if (*link == kNone || build_[*link].label != c) {
+            // NewBuildNode may move build_, so `link` is re-derived.
+            ull offset = (ull)((char*)link - (char*)build_);
+            unsigned int child = NewBuildNode(c);
+            if (child == kNone) {
+                return false;
+            }
+            link = (unsigned int*)((char*)build_ + offset);
+            build_[child].next_sibling = *link;
+            *link = child;
+        }
+        node = *link;
+    }
+    if (build_[node].pattern == kNone) {
+        build_[node].pattern = patterns_++;
+    }
+    return true;
+}
+
+inline unsigned int AhoCorasick::Edge(unsigned int node, WCHAR c) const {
+    unsigned int lo = nodes_[node].first_edge;
+    unsigned int end = lo + nodes_[node].edge_count;
+    unsigned int hi = end;
+    while (lo < hi) {
+        unsigned int mid = lo + (hi - lo) / 2;
+        if (labels_[mid] < c) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo != end && labels_[lo] == c ? targets_[lo] : kNone;
+}
+
+inline bool AhoCorasick::Compile() {
+    if (nodes_ != nullptr) {
+        return true;
+    }
+    if (build_size_ == 0 && NewBuildNode(0) == kNone) {
+        return false;
+    }
+
+    // Every node but the root owns one edge.
+    unsigned int count = build_size_;
+    ull bytes = (ull)count * (sizeof(Node) + sizeof(unsigned int) + sizeof(WCHAR))
+        + (ull)patterns_ * sizeof(unsigned int);
+    bytes = (bytes + 7) & ~7ull;
+    void* block = krnl_std::Alloc(bytes, krnl_std::kTrieTag);
+    // Build index and depth of each compiled node, in breadth-first order.
+    unsigned int* order = (unsigned int*)krnl_std::Alloc((ull)count * 2 * sizeof(unsigned int), krnl_std::kTrieTag);
+    if (block == nullptr || order == nullptr) {
+        krnl_std::Free(block);
+        krnl_std::Free(order);
+        return false;
+    }
+    Node* nodes = (Node*)block;
+    unsigned int* targets = (unsigned int*)(nodes + count);
+    unsigned int* lengths = targets + count;
+    WCHAR* labels = (WCHAR*)(lengths + patterns_);
+    unsigned int* depth = order + count;
+
+    // Breadth-first layout, so a node's failure target, which is shallower,
+    // always comes before it.
+    unsigned int queued = 1;
+    unsigned int edges = 0;
+    order[0] = 0;
+    depth[0] = 0;
+    for (unsigned int k = 0; k < queued; k++) {
+        const BuildNode& b = build_[order[k]];
+        nodes[k].first_edge = edges;
+        nodes[k].out = b.pattern;
+        if (b.pattern != kNone) {
+            lengths[b.pattern] = depth[k];
+        }
+        for (unsigned int c = b.first_child; c != kNone; c = build_[c].next_sibling) {
+            labels[edges] = build_[c].label;
+            targets[edges] = queued;
+            ++edges;
+            depth[queued] = depth[k] + 1;
+            order[queued++] = c;
+        }
+        nodes[k].edge_count = edges - nodes[k].first_edge;
+    }
+
+    block_ = block;
+    nodes_ = nodes;
+    targets_ = targets;
+    labels_ = labels;
+    lengths_ = lengths;
+
+    nodes[0].fail = 0;
+    for (unsigned int k = 0; k < queued; k++) {
+        for (unsigned int e = nodes[k].first_edge; e < nodes[k].first_edge + nodes[k].edge_count; e++) {
+            unsigned int child = targets[e];
+            unsigned int fail = 0;
+            if (k != 0) {
+                unsigned int f = nodes[k].fail;
+                for (;;) {
+                    unsigned int next = Edge(f, labels[e]);
+                    if (next != kNone) {
+                        fail = next;
+                        break;
+                    }
+                    if (f == 0) {
+                        break;
+                    }
+                    f = nodes[f].fail;
+                }
+            }
+            nodes[child].fail = fail;
+            if (nodes[child].out == kNone) {
+                nodes[child].out = nodes[fail].out;
+            }
+        }
+    }
+
+    krnl_std::Free(order);
+    krnl_std::Free(build_);
+    build_ = nullptr;
+    build_size_ = 0;
+    build_capacity_ = 0;
+    bytes_ = bytes;
+    return true;
+}
+
+inline size_t AhoCorasick::Find(std::WStringView text, unsigned int* pattern) const {
+    if (nodes_ == nullptr) {
+        return std::WStringView::kNPos;
+    }
+    unsigned int node = 0;
+    for (size_t i = 0; i < text.Size(); i++) {
+        WCHAR c = std::FoldCase(text[i]);
+        for (;;) {
+            unsigned int next = Edge(node, c);
+            if (next != kNone) {
+                node = next;
+                break;
+            }
+            if (node == 0) {
+                break;
+            }
+            node = nodes_[node].fail;
+        }
+        unsigned int out = nodes_[node].out;
+        if (out != kNone) {
+            if (pattern != nullptr) {
+                *pattern = out;
+            }
+            return i + 1 - lengths_[out];
+        }
+    }
+    return std::WStringView::kNPos;
+}
+
+#endif // AHO_CORASICK_H_
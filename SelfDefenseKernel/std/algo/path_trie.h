@@ -0,0 +1,287 @@
+#ifndef PATH_TRIE_H_
+#define PATH_TRIE_H_
+
+// Case-insensitive set of path prefixes and whole paths, for checking every
+// file name an operation touches against a protection or exclusion list.
+// Match costs one step per character of the path (a binary search among the
+// characters that can follow) and stops at the first entry that decides it,
+// however many entries there are.
+//
+// Filled with AddPrefix / AddPath, then Compile()d into a radix tree in a
+// single block: chains of characters with no branch are stored as one run,
+// so thousands of paths under a few directories take little more memory than
+// their distinct tails. A compiled trie is read-only and may be searched by
+// any number of threads; the owner publishes it and frees it when no reader
+// can still hold it.
+//
+// Characters are folded with std::FoldCase, as WString's *Ci comparisons
+// do. Allocation failures are reported, not retried: Add* and Compile return
+// false and the trie then matches nothing.
+
+#include "../memory/memory.h"
+#include "../string/wstring.h"
+
+class PathTrie {
+public:
+    PathTrie();
+    ~PathTrie();
+
+    PathTrie(const PathTrie&) = delete;
+    PathTrie& operator=(const PathTrie&) = delete;
+
+    // Matches paths that start with `prefix` and are longer than it. A
+    // directory entry ends with its separator so that "\dir\" does not
+    // cover "\dir2\".
+    bool AddPrefix(std::WStringView prefix) { return Add(prefix, kPrefixEnd); }
+    // Matches `path` itself only.
+    bool AddPath(std::WStringView path) { return Add(path, kPathEnd); }
+
+    // Freezes the entries added so far; Add* fails afterwards.
+    bool Compile();
+
+    bool Compiled() const { return nodes_ != nullptr; }
+    ull Size() const { return entries_; }
+    // Bytes held by the compiled trie.
+    ull Bytes() const { return bytes_; }
+
+    bool Match(std::WStringView path) const;
+
+private:
+    static constexpr unsigned int kNil = 0xFFFFFFFF;
+    static constexpr unsigned int kPrefixEnd = 1;
+    static constexpr unsigned int kPathEnd = 2;
+
+    // One character per node while entries are added. Children are a list,
+    // kept sorted so Compile emits edges ready for binary search.
+    struct BuildNode {
+        unsigned int first_child;
+        unsigned int next_sibling;
+        WCHAR label;
+        unsigned short flags;
+    };
+
+    // After Compile, a node is reached through an edge labelled with its
+    // first character and then consumes chars_[tail_begin, +tail_size)
+    // before its flags and edges apply.
+    struct Node {
+        unsigned int first_edge;
+        unsigned int edge_count;
+        unsigned int tail_begin;
+        unsigned int tail_size;
+        unsigned int flags;
+    };
+
+    BuildNode* build_;
+    unsigned int build_size_;
+    unsigned int build_capacity_;
+
+    void* block_;
+    Node* nodes_;
+    unsigned int* targets_;
+    WCHAR* labels_;
+    WCHAR* chars_;
+    ull entries_;
+    ull bytes_;
+
+    bool Add(std::WStringView path, unsigned int flag);
+    unsigned int NewBuildNode(WCHAR label);
+    bool IsChainLink(unsigned int b) const;
+};
+
+inline PathTrie::PathTrie()
+    : build_(nullptr), build_size_(0), build_capacity_(0),
+      block_(nullptr), nodes_(nullptr), targets_(nullptr), labels_(nullptr), chars_(nullptr),
+      entries_(0), bytes_(0) {}
+
+inline PathTrie::~PathTrie() {
+    krnl_std::Free(build_);
+    krnl_std::Free(block_);
+}
+
+inline unsigned int PathTrie::NewBuildNode(WCHAR label) {
+    if (build_size_ == build_capacity_) {
+        unsigned int capacity = build_capacity_ < 64 ? 64 : build_capacity_ * 2;
+        if (capacity <= build_capacity_) {
+            return kNil;
+        }
+        BuildNode* nodes = (BuildNode*)krnl_std::Alloc((ull)capacity * sizeof(BuildNode), krnl_std::kTrieTag);
+        if (nodes == nullptr) {
+            return kNil;
+        }
+        if (build_size_ != 0) {
+            memcpy(nodes, build_, (ull)build_size_ * sizeof(BuildNode));
+        }
+        krnl_std::Free(build_);
+        build_ = nodes;
+        build_capacity_ = capacity;
+    }
+    BuildNode& n = build_[build_size_];
+    n.first_child = kNil;
+    n.next_sibling = kNil;
+    n.label = label;
+    n.flags = 0;
+    return build_size_++;
+}
+
+// Nodes a failed Add already linked in stay, flagless, and match nothing.
+inline bool PathTrie::Add(std::WStringView path, unsigned int flag) {
+    if (nodes_ != nullptr) {
+        return false;
+    }
+    if (build_size_ == 0 && NewBuildNode(0) == kNil) {
+        return false;
+    }
+    unsigned int node = 0;
+    for (size_t i = 0; i < path.Size(); i++) {
+        WCHAR c = std::FoldCase(path[i]);
+        unsigned int* link = &build_[node].first_child;
+        while (*link != kNil && build_[*link].label < c) {
+            link = &build_[*link].next_sibling;
+        }
+        if (*link == kNil || build_[*link].label != c) {
+            // NewBuildNode may move build_, so `link` is re-derived.
+            ull offset = (ull)((char*)link - (char*)build_);
+            unsigned int child = NewBuildNode(c);
+            if (child == kNil) {
+                return false;
+            }
+            link = (unsigned int*)((char*)build_ + offset);
+            build_[child].next_sibling = *link;
+            *link = child;
+        }
+        node = *link;
+    }
+    if ((build_[node].flags & flag) == 0) {
+        build_[node].flags |= flag;
+        ++entries_;
+    }
+    return true;
+}
+
+// A node Compile folds into its parent's run: one child and no entry ending
+// on it.
+inline bool PathTrie::IsChainLink(unsigned int b) const {
+    const BuildNode& n = build_[b];
+    return n.flags == 0 && n.first_child != kNil && build_[n.first_child].next_sibling == kNil;
+}
+
+inline bool PathTrie::Compile() {
+    if (nodes_ != nullptr) {
+        return true;
+    }
+    if (build_size_ == 0 && NewBuildNode(0) == kNil) {
+        return false;
+    }
+
+    // Every build node but the root is either an edge label or a run
+    // character, and every compiled node but the root owns one edge.
+    unsigned int count = 1;
+    for (unsigned int b = 1; b < build_size_; b++) {
+        if (!IsChainLink(b)) {
+            ++count;
+        }
+    }
+    ull bytes = (ull)count * (sizeof(Node) + sizeof(unsigned int) + sizeof(WCHAR))
+        + (ull)(build_size_ - count) * sizeof(WCHAR);
+    void* block = krnl_std::Alloc(bytes, krnl_std::kTrieTag);
+    // Build index of each compiled node, in breadth-first order.
+    unsigned int* order = (unsigned int*)krnl_std::Alloc((ull)count * sizeof(unsigned int), krnl_std::kTrieTag);
+    if (block == nullptr || order == nullptr) {
+        krnl_std::Free(block);
+        krnl_std::Free(order);
+        return false;
+    }
+    Node* nodes = (Node*)block;
+    unsigned int* targets = (unsigned int*)(nodes + count);
+    WCHAR* labels = (WCHAR*)(targets + count);
+    WCHAR* chars = labels + count;
+
+    unsigned int queued = 1;
+    unsigned int edges = 0;
+    unsigned int run = 0;
+    order[0] = 0;
+    nodes[0].tail_begin = 0;
+    nodes[0].tail_size = 0;
+    for (unsigned int k = 0; k < queued; k++) {
+        const BuildNode& b = build_[order[k]];
+        nodes[k].first_edge = edges;
+        nodes[k].flags = b.flags;
+        for (unsigned int c = b.first_child; c != kNil; c = build_[c].next_sibling) {
+            labels[edges] = build_[c].label;
+            targets[edges] = queued;
+            ++edges;
+            nodes[queued].tail_begin = run;
+            unsigned int end = c;
+            while (IsChainLink(end)) {
+                end = build_[end].first_child;
+                chars[run++] = build_[end].label;
+            }
+            nodes[queued].tail_size = run - nodes[queued].tail_begin;
+            order[queued++] = end;
+        }
+        nodes[k].edge_count = edges - nodes[k].first_edge;
+    }
+
+    krnl_std::Free(order);
+    krnl_std::Free(build_);
+    build_ = nullptr;
+    build_size_ = 0;
+    build_capacity_ = 0;
+    block_ = block;
+    nodes_ = nodes;
+    targets_ = targets;
+    labels_ = labels;
+    chars_ = chars;
+    bytes_ = bytes;
+    return true;
+}
+
+inline bool PathTrie::Match(std::WStringView path) const {
+    if (nodes_ == nullptr) {
+        return false;
+    }
+    const WCHAR* s = path.Data();
+    ull size = path.Size();
+    ull i = 0;
+    const Node* node = nodes_;
+    for (;;) {
+        // Run characters carry no entries, so a path that stops or differs
+        // inside one matches nothing.
+        if (size - i < node->tail_size) {
+            return false;
+        }
+        const WCHAR* tail = chars_ + node->tail_begin;
+        for (unsigned int t = 0; t < node->tail_size; t++) {
+            if (std::FoldCase(s[i + t]) != tail[t]) {
+                return false;
+            }
+        }
+        i += node->tail_size;
+        if (i == size) {
+            return (node->flags & kPathEnd) != 0;
+        }
+        if ((node->flags & kPrefixEnd) != 0) {
+            return true;
+        }
+
+        WCHAR c = std::FoldCase(s[i]);
+        unsigned int lo = node->first_edge;
+        unsigned int hi = lo + node->edge_count;
+        while (lo < hi) {
+            unsigned int mid = lo + (hi - lo) / 2;
+            if (labels_[mid] < c) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        if (lo == node->first_edge + node->edge_count || labels_[lo] != c) {
+            return false;
+        }
+        node = nodes_ + targets_[lo];
+        ++i;
+    }
+}
+
+#endif // PATH_TRIE_H_
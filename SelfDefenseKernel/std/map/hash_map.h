@@ -0,0 +1,376 @@
+#ifndef HASH_MAP_H_
+#define HASH_MAP_H_
+
+// Open-addressing hash map with the Map interface, for keys looked up far
+// more often than they are ordered: pids, 64-bit path hashes, WStrings.
+//
+// Linear probing over two arrays. hashes_ holds each slot's 64-bit hash
+// with the top bit set (0 is an empty slot), so a probe reads 8 bytes per
+// slot and only compares keys on a full hash match; entries_ holds the keys
+// and values. Erase shifts the following entries back instead of leaving
+// tombstones, so lookups never slow down as keys come and go. The table
+// doubles at 3/4 full.
+//
+// Insert replaces the value of an existing key, as Map::Insert does, and
+// returns (End(), false) when the table cannot grow. There is no
+// Erase(iterator): shifting entries back would move unvisited ones behind
+// the iterator; use EraseIf to drop entries while walking the table.
+// Iterators are invalidated by any Insert or Erase.
+
+#include "../memory/memory.h"
+#include "../memory/pair.h"
+#include "../iterator/iterator.h"
+#include "../algo/hash.h"
+
+// Storage and probing shared by HashMap and HashSet. Entry has a `first`
+// member holding the key, is default-constructible and move-assignable, and
+// gives `new Entry[n]` a nothrow operator new[] with its pool tag; that tag
+// (Entry::kTag) is also used for the hash array.
+template <typename Key, typename Entry, typename Hasher>
+class HashTable {
+public:
+    using size_type = ull;
+
+    class Iterator : public IteratorBase<Entry, ForwardIteratorTag> {
+    private:
+        const ull* hashes_;
+        Entry* entries_;
+        ull index_;
+        ull end_;
+
+        void SkipEmpty() {
+            while (index_ < end_ && hashes_[index_] == 0) {
+                ++index_;
+            }
+        }
+
+    public:
+        Iterator() : hashes_(nullptr), entries_(nullptr), index_(0), end_(0) {}
+        Iterator(const ull* hashes, Entry* entries, ull index, ull end)
+            : hashes_(hashes), entries_(entries), index_(index), end_(end) {
+            SkipEmpty();
+        }
+
+        Entry& operator*() const { return entries_[index_]; }
+        Entry* operator->() const { return &entries_[index_]; }
+
+        Iterator& operator++() { ++index_; SkipEmpty(); return *this; }
+        Iterator operator++(int) { Iterator tmp = *this; ++*this; return tmp; }
+
+        bool operator==(const Iterator& other) const { return index_ == other.index_; }
+        bool operator!=(const Iterator& other) const { return index_ != other.index_; }
+    };
+
+    bool Empty() const { return size_ == 0; }
+    size_type Size() const { return size_; }
+    // Slots allocated; Size() stays below 3/4 of it.
+    size_type Capacity() const { return hashes_ != nullptr ? mask_ + 1 : 0; }
+    // Room for n keys without growing; false if the memory is not available.
+    bool Reserve(size_type n);
+    // Drops every entry and the memory.
+    void Clear();
+
+protected:
+    static constexpr ull kUsed = 1ULL << 63;
+    static constexpr ull kNone = ULL_MAX;
+    static constexpr ull kMinCapacity = 16;
+
+    ull* hashes_;
+    Entry* entries_;
+    ull size_;
+    ull mask_;
+    Hasher hasher_;
+
+    HashTable() : hashes_(nullptr), entries_(nullptr), size_(0), mask_(0), hasher_() {}
+    HashTable(const HashTable& other);
+    HashTable(HashTable&& other);
+    HashTable& operator=(const HashTable& other);
+    HashTable& operator=(HashTable&& other);
+    ~HashTable() { Release(); }
+
+    Iterator At(ull index) const { return Iterator(hashes_, entries_, index, Capacity()); }
+    Iterator EndIterator() const { return Iterator(hashes_, entries_, Capacity(), Capacity()); }
+
+    ull HashOf(const Key& key) const { return hasher_(key) | kUsed; }
+    ull FindIndex(const Key& key) const;
+    // Slot of `key`, claimed (hash set, entry still default) if it was not
+    // there; kNone if the table had to grow and could not.
+    ull ClaimIndex(const Key& key, bool* claimed);
+    void EraseIndex(ull index);
+    bool Rehash(ull capacity);
+    void Release();
+
+    template <typename Pred>
+    size_type EraseWhere(Pred&& pred);
+};
+
+template <typename Key, typename Entry, typename Hasher>
+inline HashTable<Key, Entry, Hasher>::HashTable(const HashTable& other) : HashTable() {
+    hasher_ = other.hasher_;
+    if (other.size_ == 0 || Rehash(other.mask_ + 1) == false) {
+        return;
+    }
+    for (ull i = 0; i <= mask_; i++) {
+        hashes_[i] = other.hashes_[i];
+        if (hashes_[i] != 0) {
+            entries_[i] = other.entries_[i];
+        }
+    }
+    size_ = other.size_;
+}
+
+template <typename Key, typename Entry, typename Hasher>
+inline HashTable<Key, Entry, Hasher>::HashTable(HashTable&& other)
+    : hashes_(other.hashes_), entries_(other.entries_), size_(other.size_), mask_(other.mask_), hasher_(other.hasher_) {
+    other.hashes_ = nullptr;
+    other.entries_ = nullptr;
+    other.size_ = 0;
+    other.mask_ = 0;
+}
+
+template <typename Key, typename Entry, typename Hasher>
+inline HashTable<Key, Entry, Hasher>& HashTable<Key, Entry, Hasher>::operator=(const HashTable& other) {
+    if (this != &other) {
+        HashTable tmp(other);
+        *this = Move(tmp);
+    }
+    return *this;
+}
+
+template <typename Key, typename Entry, typename Hasher>
+inline HashTable<Key, Entry, Hasher>& HashTable<Key, Entry, Hasher>::operator=(HashTable&& other) {
+    if (this != &other) {
+        Release();
+        hashes_ = other.hashes_;
+        entries_ = other.entries_;
+        size_ = other.size_;
+        mask_ = other.mask_;
+        hasher_ = other.hasher_;
+        other.hashes_ = nullptr;
+        other.entries_ = nullptr;
+        other.size_ = 0;
+        other.mask_ = 0;
+    }
+    return *this;
+}
+
+template <typename Key, typename Entry, typename Hasher>
+inline void HashTable<Key, Entry, Hasher>::Release() {
+    krnl_std::Free(hashes_);
+    delete[] entries_;
+    hashes_ = nullptr;
+    entries_ = nullptr;
+    size_ = 0;
+    mask_ = 0;
+}
+
+template <typename Key, typename Entry, typename Hasher>
+inline void HashTable<Key, Entry, Hasher>::Clear() {
+    Release();
+}
+
+template <typename Key, typename Entry, typename Hasher>
+inline bool HashTable<Key, Entry, Hasher>::Reserve(size_type n) {
+    ull capacity = kMinCapacity;
+    while (capacity / 4 * 3 < n) {
+        capacity *= 2;
+    }
+    return capacity <= Capacity() || Rehash(capacity);
+}
+
+// capacity is a power of two holding every entry below the load limit.
+template <typename Key, typename Entry, typename Hasher>
+inline bool HashTable<Key, Entry, Hasher>::Rehash(ull capacity) {
+    ull* hashes = (ull*)krnl_std::Alloc(capacity * sizeof(ull), Entry::kTag);
+    if (hashes == nullptr) {
+        return false;
+    }
+    Entry* entries = new Entry[capacity];
+    if (entries == nullptr) {
+        krnl_std::Free(hashes);
+        return false;
+    }
+    for (ull i = 0; i < capacity; i++) {
+        hashes[i] = 0;
+    }
+
+    ull mask = capacity - 1;
+    for (ull i = 0; hashes_ != nullptr && i <= mask_; i++) {
+        if (hashes_[i] == 0) {
+            continue;
+        }
+        ull j = hashes_[i] & mask;
+        while (hashes[j] != 0) {
+            j = (j + 1) & mask;
+        }
+        hashes[j] = hashes_[i];
+        entries[j] = Move(entries_[i]);
+    }
+
+    ull size = size_;
+    Release();
+    hashes_ = hashes;
+    entries_ = entries;
+    size_ = size;
+    mask_ = mask;
+    return true;
+}
+
+template <typename Key, typename Entry, typename Hasher>
+inline ull HashTable<Key, Entry, Hasher>::FindIndex(const Key& key) const {
+    if (hashes_ == nullptr) {
+        return kNone;
+    }
+    ull h = HashOf(key);
+    for (ull i = h & mask_; hashes_[i] != 0; i = (i + 1) & mask_) {
+        if (hashes_[i] == h && entries_[i].first == key) {
+            return i;
+        }
+    }
+    return kNone;
+}
+
+template <typename Key, typename Entry, typename Hasher>
+inline ull HashTable<Key, Entry, Hasher>::ClaimIndex(const Key& key, bool* claimed) {
+    *claimed = false;
+    ull found = FindIndex(key);
+    if (found != kNone) {
+        return found;
+    }
+    if ((size_ + 1) * 4 > Capacity() * 3 && Rehash(Capacity() < kMinCapacity ? kMinCapacity : Capacity() * 2) == false) {
+        return kNone;
+    }
+    ull h = HashOf(key);
+    ull i = h & mask_;
+    while (hashes_[i] != 0) {
+        i = (i + 1) & mask_;
+    }
+    hashes_[i] = h;
+    ++size_;
+    *claimed = true;
+    return i;
+}
+
+// Backward-shift deletion: every entry after the hole whose probe started
+// at or before the hole moves into it, so no probe chain is broken.
+template <typename Key, typename Entry, typename Hasher>
+inline void HashTable<Key, Entry, Hasher>::EraseIndex(ull index) {
+    ull hole = index;
+    for (ull j = (hole + 1) & mask_; hashes_[j] != 0; j = (j + 1) & mask_) {
+        ull home = hashes_[j] & mask_;
+        // Distance from home to j, against distance from hole to j.
+        if (((j - home) & mask_) >= ((j - hole) & mask_)) {
+            hashes_[hole] = hashes_[j];
+            entries_[hole] = Move(entries_[j]);
+            hole = j;
+        }
+    }
+    hashes_[hole] = 0;
+    // Release what the vacated entry still holds (a WString's buffer).
+    entries_[hole] = Entry();
+    --size_;
+}
+
+// pred sees every entry once, except that an entry shifted back across the
+// end of the array is seen a second time; so it must not have side effects.
+template <typename Key, typename Entry, typename Hasher>
+template <typename Pred>
+inline ull HashTable<Key, Entry, Hasher>::EraseWhere(Pred&& pred) {
+    ull erased = 0;
+    for (ull i = 0; hashes_ != nullptr && i <= mask_; ) {
+        if (hashes_[i] != 0 && pred(entries_[i])) {
+            // The hole may now hold an entry that was after it.
+            EraseIndex(i);
+            erased++;
+        }
+        else {
+            i++;
+        }
+    }
+    return erased;
+}
+
+template <typename Key, typename T>
+struct HashMapEntry {
+    static constexpr unsigned int kTag = krnl_std::kMapTag;
+
+    Key first;
+    T second;
+
+    // noexcept: `new HashMapEntry[n]` yields nullptr instead of constructing into it.
+    static void* operator new[](decltype(sizeof(0)) n) noexcept { return krnl_std::Alloc(n, kTag); }
+    static void operator delete[](void* p) { krnl_std::Free(p); }
+};
+
+template <typename Key, typename T, typename Hasher = Hash<Key>>
+class HashMap : public HashTable<Key, HashMapEntry<Key, T>, Hasher> {
+private:
+    using Base = HashTable<Key, HashMapEntry<Key, T>, Hasher>;
+
+    template <typename K, typename V>
+    Pair<typename Base::Iterator, bool> InsertEntry(K&& key, V&& val);
+
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = HashMapEntry<Key, T>;
+    using size_type = ull;
+    using iterator = typename Base::Iterator;
+    using const_iterator = typename Base::Iterator;
+
+    HashMap() = default;
+    HashMap(const HashMap& other) = default;
+    HashMap(HashMap&& other) = default;
+    HashMap& operator=(const HashMap& other) = default;
+    HashMap& operator=(HashMap&& other) = default;
+
+    // Iterators, in no particular order
+    iterator Begin() const { return this->At(0); }
+    iterator End() const { return this->EndIterator(); }
+
+    // Modifiers
+    Pair<iterator, bool> Insert(const Key& key, const T& val) { return InsertEntry(key, val); }
+    Pair<iterator, bool> Insert(Key&& key, T&& val) { return InsertEntry(Move(key), Move(val)); }
+    size_type Erase(const Key& key);
+    // Erases every entry for which pred(entry) is true; see EraseWhere.
+    template <typename Pred>
+    size_type EraseIf(Pred&& pred) { return this->EraseWhere(pred); }
+
+    // Operations
+    iterator Find(const Key& key) const;
+    size_type Count(const Key& key) const { return this->FindIndex(key) != Base::kNone ? 1 : 0; }
+    bool Contains(const Key& key) const { return this->FindIndex(key) != Base::kNone; }
+};
+
+template <typename Key, typename T, typename Hasher>
+template <typename K, typename V>
+inline Pair<typename HashMap<Key, T, Hasher>::iterator, bool> HashMap<Key, T, Hasher>::InsertEntry(K&& key, V&& val) {
+    bool claimed;
+    ull i = this->ClaimIndex(key, &claimed);
+    if (i == Base::kNone) {
+        return Pair<iterator, bool>(End(), false);
+    }
+    if (claimed) {
+        this->entries_[i].first = static_cast<K&&>(key);
+    }
+    this->entries_[i].second = static_cast<V&&>(val);
+    return Pair<iterator, bool>(this->At(i), claimed);
+}
+
+template <typename Key, typename T, typename Hasher>
+inline typename HashMap<Key, T, Hasher>::size_type HashMap<Key, T, Hasher>::Erase(const Key& key) {
+    ull i = this->FindIndex(key);
+    if (i == Base::kNone) {
+        return 0;
+    }
+    this->EraseIndex(i);
+    return 1;
+}
+
+template <typename Key, typename T, typename Hasher>
+inline typename HashMap<Key, T, Hasher>::iterator HashMap<Key, T, Hasher>::Find(const Key& key) const {
+    ull i = this->FindIndex(key);
+    return i != Base::kNone ? this->At(i) : End();
+}
+
+#endif // HASH_MAP_H_
@@ -0,0 +1,122 @@
+#ifndef PID_FLAGS_H
+#define PID_FLAGS_H
+
+// A few bits per live process, keyed by pid, read without a lock: the
+// verdicts PreObCallback needs on every process and thread handle open
+// (function/self_defense.cpp). Each slot is one word, pid << 8 | flags, so
+// a reader sees a whole entry or none; an entry it cannot find (not there
+// yet, evicted, cleared) only sends the caller down the slow path.
+//
+// Open addressing over a fixed array, probing at most kPidFlagsProbe slots
+// from the pid's home. Writers (Set, Remove, Clear) must be serialized by
+// the caller; readers need nothing. No allocation and no kernel
+// dependencies, so the table is modelled in user mode
+// (EventCollectorDriver/bench/pid_verdict_bench.cpp).
+
+#include "../sync/ring_atomic.h"
+
+namespace krnl_std
+{
+    constexpr unsigned int kPidFlagsSlots = 4096;      // power of two
+    constexpr unsigned int kPidFlagsProbe = 16;
+    constexpr unsigned int kPidFlagsMask = 0x7F;       // the caller's bits
+    constexpr unsigned long long kPidFlagsUsed = 0x80;
+    // A removed entry whose probe run continues past it.
+    constexpr unsigned long long kPidFlagsTombstone = 1;
+
+    struct PidFlagsTable
+    {
+        volatile unsigned long long slot[kPidFlagsSlots];   // 0 = empty
+    };
+
+    inline void InitPidFlags(PidFlagsTable& t)
+    {
+        for (unsigned int i = 0; i < kPidFlagsSlots; i++) {
+            t.slot[i] = 0;
+        }
+    }
+
+    inline unsigned int PidFlagsHome(unsigned long long pid)
+    {
+        // pids are multiples of 4.
+        return (unsigned int)(pid >> 2) & (kPidFlagsSlots - 1);
+    }
+
+    // Lock-free. false when pid has no entry.
+    inline bool FindPidFlags(PidFlagsTable& t, unsigned long long pid, unsigned int* flags)
+    {
+        unsigned int home = PidFlagsHome(pid);
+        for (unsigned int i = 0; i < kPidFlagsProbe; i++) {
+            // A plain read: the word is the whole entry, nothing to order after it.
+            unsigned long long w = ring_atomic::LoadRelaxed(&t.slot[(home + i) & (kPidFlagsSlots - 1)]);
+            if (w == 0) {
+                return false;
+            }
+            if ((w & kPidFlagsUsed) != 0 && (w >> 8) == pid) {
+                *flags = (unsigned int)(w & kPidFlagsMask);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Writers serialized. Replaces pid's entry or adds one; false when the
+    // probe window is full and the pid stays uncached.
+    inline bool SetPidFlags(PidFlagsTable& t, unsigned long long pid, unsigned int flags)
+    {
+        unsigned long long entry = (pid << 8) | kPidFlagsUsed | (flags & kPidFlagsMask);
+        unsigned int home = PidFlagsHome(pid);
+        volatile unsigned long long* free_slot = nullptr;
+        for (unsigned int i = 0; i < kPidFlagsProbe; i++) {
+            volatile unsigned long long* s = &t.slot[(home + i) & (kPidFlagsSlots - 1)];
+            unsigned long long w = *s;
+            if ((w & kPidFlagsUsed) != 0 && (w >> 8) == pid) {
+                ring_atomic::Store(s, entry);
+                return true;
+            }
+            if ((w & kPidFlagsUsed) == 0 && free_slot == nullptr) {
+                free_slot = s;
+            }
+            if (w == 0) {
+                break;
+            }
+        }
+        if (free_slot == nullptr) {
+            return false;
+        }
+        ring_atomic::Store(free_slot, entry);
+        return true;
+    }
+
+    // Writers serialized.
+    inline void RemovePidFlags(PidFlagsTable& t, unsigned long long pid)
+    {
+        unsigned int home = PidFlagsHome(pid);
+        for (unsigned int i = 0; i < kPidFlagsProbe; i++) {
+            unsigned int at = (home + i) & (kPidFlagsSlots - 1);
+            unsigned long long w = t.slot[at];
+            if (w == 0) {
+                return;
+            }
+            if ((w & kPidFlagsUsed) != 0 && (w >> 8) == pid) {
+                // Nothing probes past an empty slot, so the run can end here.
+                bool run_ends = t.slot[(at + 1) & (kPidFlagsSlots - 1)] == 0;
+                ring_atomic::Store(&t.slot[at], run_ends ? 0 : kPidFlagsTombstone);
+                return;
+            }
+        }
+    }
+
+    // Writers serialized. Drops every entry, for when what the flags were
+    // computed from has changed.
+    inline void ClearPidFlags(PidFlagsTable& t)
+    {
+        for (unsigned int i = 0; i < kPidFlagsSlots; i++) {
+            if (t.slot[i] != 0) {
+                ring_atomic::Store(&t.slot[i], 0);
+            }
+        }
+    }
+}
+
+#endif
@@ -59,21 +59,29 @@ ULONG GetUlongAt(ull addr);
 
 namespace krnl_std
 {
-    inline void* Alloc(ull n)
+    // Pool tags, so poolmon can tell the strings and containers apart.
+    constexpr ULONG kPoolTag = 0x22042003;
+    constexpr ULONG kStringTag = 'rtSK';
+    constexpr ULONG kSetTag = 'teSK';
+    constexpr ULONG kMapTag = 'paMK';
+    constexpr ULONG kTrieTag = 'irTK';
+
+    inline void* Alloc(ull n, ULONG tag = kPoolTag)
     {
         void* p = nullptr;
-        p = ExAllocatePool2(POOL_FLAG_NON_PAGED, n, 0x22042003); // Windows 10 2004 above
-        //p = ExAllocatePoolWithTag(NonPagedPool, n, 0x22042003);
+        p = ExAllocatePool2(POOL_FLAG_NON_PAGED, n, tag); // Windows 10 2004 above
+        //p = ExAllocatePoolWithTag(NonPagedPool, n, tag);
         return p;
     }
 
+    // Any tag: ExFreePool does not check it.
     inline void Free(void* p)
     {
         if (p == nullptr)
         {
             return;
         }
-        ExFreePoolWithTag(p, 0x22042003);
+        ExFreePool(p);
     }
 
 }
@@ -0,0 +1,124 @@
+#ifndef HASH_SET_H_
+#define HASH_SET_H_
+
+// Open-addressing hash set with the Set interface; same table as HashMap
+// (std/map/hash_map.h), with the key alone in each entry.
+
+#include "../map/hash_map.h"
+
+template <typename Key>
+struct HashSetEntry {
+    static constexpr unsigned int kTag = krnl_std::kSetTag;
+
+    Key first;
+
+    // noexcept: `new HashSetEntry[n]` yields nullptr instead of constructing into it.
+    static void* operator new[](decltype(sizeof(0)) n) noexcept { return krnl_std::Alloc(n, kTag); }
+    static void operator delete[](void* p) { krnl_std::Free(p); }
+};
+
+template <typename Key, typename Hasher = Hash<Key>>
+class HashSet : public HashTable<Key, HashSetEntry<Key>, Hasher> {
+private:
+    using Base = HashTable<Key, HashSetEntry<Key>, Hasher>;
+
+    template <typename K>
+    Pair<typename Base::Iterator, bool> InsertKey(K&& key);
+
+public:
+    using key_type = Key;
+    using value_type = Key;
+    using size_type = ull;
+
+    // Yields the keys, read-only.
+    class Iterator : public IteratorBase<const Key, ForwardIteratorTag> {
+    private:
+        typename Base::Iterator it_;
+
+    public:
+        Iterator() = default;
+        explicit Iterator(const typename Base::Iterator& it) : it_(it) {}
+
+        const Key& operator*() const { return it_->first; }
+        const Key* operator->() const { return &it_->first; }
+
+        Iterator& operator++() { ++it_; return *this; }
+        Iterator operator++(int) { Iterator tmp = *this; ++it_; return tmp; }
+
+        bool operator==(const Iterator& other) const { return it_ == other.it_; }
+        bool operator!=(const Iterator& other) const { return it_ != other.it_; }
+    };
+
+    using iterator = Iterator;
+    using const_iterator = Iterator;
+
+    HashSet() = default;
+    HashSet(const HashSet& other) = default;
+    HashSet(HashSet&& other) = default;
+    HashSet& operator=(const HashSet& other) = default;
+    HashSet& operator=(HashSet&& other) = default;
+
+    // Iterators, in no particular order
+    iterator Begin() const { return iterator(this->At(0)); }
+    iterator End() const { return iterator(this->EndIterator()); }
+
+    // Modifiers
+    Pair<iterator, bool> Insert(const Key& key);
+    Pair<iterator, bool> Insert(Key&& key);
+    size_type Erase(const Key& key);
+    // Erases every key for which pred(key) is true; pred must not have side
+    // effects (see HashTable::EraseWhere).
+    template <typename Pred>
+    size_type EraseIf(Pred&& pred) {
+        return this->EraseWhere([&](const HashSetEntry<Key>& e) { return pred(e.first); });
+    }
+
+    // Operations
+    iterator Find(const Key& key) const;
+    size_type Count(const Key& key) const { return this->FindIndex(key) != Base::kNone ? 1 : 0; }
+    bool Contains(const Key& key) const { return this->FindIndex(key) != Base::kNone; }
+};
+
+template <typename Key, typename Hasher>
+template <typename K>
+inline Pair<typename HashSet<Key, Hasher>::Base::Iterator, bool> HashSet<Key, Hasher>::InsertKey(K&& key) {
+    bool claimed;
+    ull i = this->ClaimIndex(key, &claimed);
+    if (i == Base::kNone) {
+        return Pair<typename Base::Iterator, bool>(this->EndIterator(), false);
+    }
+    if (claimed) {
+        this->entries_[i].first = static_cast<K&&>(key);
+    }
+    return Pair<typename Base::Iterator, bool>(this->At(i), claimed);
+}
+
+template <typename Key, typename Hasher>
+inline Pair<typename HashSet<Key, Hasher>::iterator, bool> HashSet<Key, Hasher>::Insert(const Key& key) {
+    auto res = InsertKey(key);
+    return Pair<iterator, bool>(iterator(res.first), res.second);
+}
+
+template <typename Key, typename Hasher>
+inline Pair<typename HashSet<Key, Hasher>::iterator, bool> HashSet<Key, Hasher>::Insert(Key&& key) {
+    auto res = InsertKey(Move(key));
+    return Pair<iterator, bool>(iterator(res.first), res.second);
+}
+
+template <typename Key, typename Hasher>
+inline typename HashSet<Key, Hasher>::size_type HashSet<Key, Hasher>::Erase(const Key& key) {
+    ull i = this->FindIndex(key);
+    if (i == Base::kNone) {
+        return 0;
+    }
+    this->EraseIndex(i);
+    return 1;
+}
+
+template <typename Key, typename Hasher>
+inline typename HashSet<Key, Hasher>::iterator HashSet<Key, Hasher>::Find(const Key& key) const {
+    ull i = this->FindIndex(key);
+    return iterator(i != Base::kNone ? this->At(i) : this->EndIterator());
+}
+
+#endif // HASH_SET_H_
@@ -1,10 +1,141 @@
 #include "wstring.h"
+#include "../algo/search.h"
 
 #include <string.h>
-#include <ntstrsafe.h>
 
 namespace std
 {
+	// ============================= Helpers =============================
+
+	static size_t StrLen(const WCHAR* s)
+	{
+		size_t n = 0;
+		while (s[n] != L'\0') {
+			n++;
+		}
+		return n;
+	}
+
+	static bool EqualChars(const WCHAR* a, const WCHAR* b, size_t n)
+	{
+		return n == 0 || memcmp(a, b, n * sizeof(WCHAR)) == 0;
+	}
+
+	static bool EqualCharsCi(const WCHAR* a, const WCHAR* b, size_t n)
+	{
+		for (size_t i = 0; i < n; i++) {
+			if (a[i] != b[i] && FoldCase(a[i]) != FoldCase(b[i])) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// ============================= WStringView =============================
+
+	WStringView::WStringView(const WCHAR* s)
+		: data_(s), size_(s != nullptr ? StrLen(s) : 0)
+	{
+	}
+
+	WStringView::WStringView(const WCHAR* s, size_t n)
+		: data_(s), size_(s != nullptr ? n : 0)
+	{
+	}
+
+	WStringView::WStringView(const UNICODE_STRING& u)
+		: data_(u.Buffer), size_(u.Buffer != nullptr ? u.Length / sizeof(WCHAR) : 0)
+	{
+	}
+
+	WStringView WStringView::Substr(size_t pos, size_t n) const
+	{
+		if (pos >= size_) {
+			return WStringView();
+		}
+		if (n > size_ - pos) {
+			n = size_ - pos;
+		}
+		return WStringView(data_ + pos, n);
+	}
+
+	bool WStringView::HasPrefix(const WStringView& prefix) const
+	{
+		return size_ >= prefix.size_ && EqualChars(data_, prefix.data_, prefix.size_);
+	}
+
+	bool WStringView::HasCiPrefix(const WStringView& prefix) const
+	{
+		return size_ >= prefix.size_ && EqualCharsCi(data_, prefix.data_, prefix.size_);
+	}
+
+	bool WStringView::HasSuffix(const WStringView& suffix) const
+	{
+		return size_ >= suffix.size_ && EqualChars(data_ + (size_ - suffix.size_), suffix.data_, suffix.size_);
+	}
+
+	bool WStringView::HasCiSuffix(const WStringView& suffix) const
+	{
+		return size_ >= suffix.size_ && EqualCharsCi(data_ + (size_ - suffix.size_), suffix.data_, suffix.size_);
+	}
+
+	size_t WStringView::FindFirstOf(const WStringView& pat, size_t begin_pos) const
+	{
+		if (begin_pos > size_) {
+			return kNPos;
+		}
+		unsigned long long at = krnl_std::FindSubstring(data_ + begin_pos, size_ - begin_pos, pat.data_, pat.size_);
+		return at != krnl_std::kSearchNone ? begin_pos + (size_t)at : kNPos;
+	}
+
+	bool WStringView::Contain(const WStringView& pat) const
+	{
+		return FindFirstOf(pat) != kNPos;
+	}
+
+	int WStringView::Compare(const WStringView& o) const
+	{
+		size_t n = size_ < o.size_ ? size_ : o.size_;
+		for (size_t i = 0; i < n; i++) {
+			if (data_[i] != o.data_[i]) {
+				return data_[i] < o.data_[i] ? -1 : 1;
+			}
+		}
+		return size_ == o.size_ ? 0 : (size_ < o.size_ ? -1 : 1);
+	}
+
+	int WStringView::CompareCi(const WStringView& o) const
+	{
+		size_t n = size_ < o.size_ ? size_ : o.size_;
+		for (size_t i = 0; i < n; i++) {
+			if (data_[i] == o.data_[i]) {
+				continue;
+			}
+			WCHAR a = FoldCase(data_[i]);
+			WCHAR b = FoldCase(o.data_[i]);
+			if (a != b) {
+				return a < b ? -1 : 1;
+			}
+		}
+		return size_ == o.size_ ? 0 : (size_ < o.size_ ? -1 : 1);
+	}
+
+	bool WStringView::operator==(const WStringView& o) const
+	{
+		return size_ == o.size_ && EqualChars(data_, o.data_, size_);
+	}
+
+	bool WStringView::operator!=(const WStringView& o) const
+	{
+		return !(*this == o);
+	}
+
+	bool WStringView::EqualCi(const WStringView& o) const
+	{
+		return size_ == o.size_ && EqualCharsCi(data_, o.data_, size_);
+	}
+
+	// ============================= Iterator =============================
 
 	// Constructor: store the pointer to current character
 	WString::iterator::iterator(WCHAR* p)
@@ -44,178 +175,149 @@ namespace std
 		return curr_ != b.curr_;
 	}
 
+	// ============================= Constructors =============================
+
 	// Default constructor
 	WString::WString()
-		: size_(0), capacity_(0), elements_(Allocate(0))
-	{}
+		: size_(0), capacity_(kInlineCapacity), elements_(inline_)
+	{
+		inline_[0] = L'\0';
+	}
 
 	// Construct with size, fill with c
 	WString::WString(size_t size, WCHAR c)
-		: size_(size), capacity_(size), elements_(Allocate(size))
+		: WString()
 	{
-		for (size_t i = 0; i < size_; ++i)
-			elements_[i] = c;
+		Resize(size, c);
 	}
 
 	// Copy constructor
 	WString::WString(const WString& other)
-		: size_(other.size_), capacity_(other.capacity_), elements_(Allocate(other.capacity_))
+		: WString()
 	{
-		// copy including null terminator
-		memcpy(elements_, other.elements_, (size_ + 1) * sizeof(WCHAR));
+		// If other is corrupt (elements_ == nullptr but size_ > 0), treat as empty.
+		if (other.elements_ != nullptr) {
+			Assign(other.elements_, other.size_);
+		}
 	}
 
 	// Construct from C-string
 	WString::WString(const WCHAR* ws)
+		: WString()
 	{
-		if (!ws) {
-			size_ = capacity_ = 0;
-			elements_ = nullptr;
-		}
-		else {
-			size_ = wcslen(ws);
-			capacity_ = size_;
-			elements_ = Allocate(size_);
-			memcpy(elements_, ws, (size_ + 1) * sizeof(WCHAR));
+		if (ws != nullptr) {
+			Assign(ws, StrLen(ws));
 		}
 	}
 
 	// Construct from UNICODE_STRING
 	WString::WString(const UNICODE_STRING& u)
+		: WString()
 	{
-		size_ = u.Length / sizeof(WCHAR);
-		capacity_ = size_;
-		elements_ = Allocate(size_);
-		if (u.Buffer && size_ > 0) {
-			memcpy(elements_, u.Buffer, size_ * sizeof(WCHAR));
-		}
-		elements_[size_] = L'\0';
+		*this = u;
 	}
 
 	// Construct from PUNICODE_STRING
 	WString::WString(const PUNICODE_STRING& pu)
+		: WString()
 	{
-		if (!pu || !pu->Buffer) {
-			size_ = capacity_ = 0;
-			elements_ = Allocate(0);
-		}
-		else {
-			this->WString::WString(*pu);
-		}
+		*this = pu;
+	}
+
+	WString::WString(const WStringView& v)
+		: WString()
+	{
+		Assign(v.Data(), v.Size());
 	}
 
 	// Move constructor
 	WString::WString(WString&& other) noexcept
-		: size_(other.size_), capacity_(other.capacity_), elements_(other.elements_)
+		: WString()
 	{
-		other.elements_ = nullptr;
-		other.size_ = other.capacity_ = 0;
+		*this = Move(other);
 	}
 
+	// ============================= Assignment =============================
+
 	// Copy assignment
 	WString& WString::operator=(const WString& other)
 	{
-		if (this != &other) {
-			if (capacity_ < other.size_) {
-				// Existing buffer too small: deallocate and allocate a new one
-				Deallocate();
-				elements_ = Allocate(other.size_);
-				capacity_ = other.size_;
-			}
-			size_ = other.size_;
-			memcpy(elements_, other.elements_, (size_ + 1) * sizeof(WCHAR));
+		if (this == &other) return *this;
+		if (other.elements_ == nullptr) {
+			Clear();
+			return *this;
 		}
+		Assign(other.elements_, other.size_);
 		return *this;
 	}
 
 	// Copy assignment from C-style wide string
 	WString& WString::operator=(const WCHAR* s)
 	{
-		if (this->elements_ == s)
-		{
-			return *this;
-		}
-		size_t len = s ? wcslen(s) : 0;
-		if (!s) {
-			// Clear this string if the source is null
+		if (s == nullptr) {
 			Clear();
+			return *this;
 		}
-		else
-		{
-			if (capacity_ < len) {
-				// Buffer too small: deallocate and allocate a new one
-				Deallocate();
-				size_ = capacity_ = len;
-				elements_ = Allocate(capacity_);
-				memcpy(elements_, s, (len + 1) * sizeof(WCHAR));
-			}
-			size_ = len;
-			memcpy(elements_, s, (len + 1) * sizeof(WCHAR));
-		}
+		Assign(s, StrLen(s));
 		return *this;
 	}
 
 	// Copy assignment from UNICODE_STRING reference
 	WString& WString::operator=(const UNICODE_STRING& u)
 	{
-		size_t len = u.Buffer ? u.Length / sizeof(WCHAR) : 0;
-		if (u.Length == 0 || u.Buffer == nullptr) {
-			// clear if empty or null buffer
+		if (u.Buffer == nullptr) {
 			Clear();
+			return *this;
 		}
-		else {
-			if (capacity_ < len) {
-				Deallocate();
-				elements_ = Allocate(len);
-				capacity_ = len;
-			}
-			size_ = len;
-			// copy len characters and null-terminate
-			memcpy(elements_, u.Buffer, len * sizeof(WCHAR));
-			elements_[size_] = L'\0';
-		}
+		Assign(u.Buffer, u.Length / sizeof(WCHAR));
 		return *this;
 	}
 
 	// Copy assignment from UNICODE_STRING pointer
 	WString& WString::operator=(const PUNICODE_STRING& pu)
 	{
-		size_t len = (pu && pu->Buffer) ? pu->Length / sizeof(WCHAR) : 0;
-		if (len == 0) {
-			// clear if input is null
+		if (!pu) {
 			Clear();
+			return *this;
 		}
-		else {
-			if (capacity_ < len) {
-				Deallocate();
-				elements_ = Allocate(len);
-				capacity_ = len;
-			}
-			size_ = len;
-			// copy len characters and null-terminate
-			memcpy(elements_, pu->Buffer, len * sizeof(WCHAR));
-			elements_[size_] = L'\0';
-		}
+		return (*this = *pu);
+	}
+
+	WString& WString::operator=(const WStringView& v)
+	{
+		Assign(v.Data(), v.Size());
 		return *this;
 	}
 
 	WString& WString::operator=(WString&& other) noexcept
 	{
-        if (this != &other) {
-            Deallocate();
-            size_ = other.size_;
-            capacity_ = other.capacity_;
-            elements_ = other.elements_;
-            other.elements_ = nullptr;
-            other.size_ = other.capacity_ = 0;
-        }
-        return *this;
+		if (this == &other) {
+			return *this;
+		}
+		if (other.elements_ == nullptr || other.IsInline() == true) {
+			Assign(other.elements_, other.size_);
+			other.Clear();
+			return *this;
+		}
+
+		Reset();
+		size_ = other.size_;
+		capacity_ = other.capacity_;
+		elements_ = other.elements_;
+		// Detach, not Reset: the buffer is ours now.
+		other.elements_ = other.inline_;
+		other.capacity_ = kInlineCapacity;
+		other.size_ = 0;
+		other.inline_[0] = L'\0';
+		return *this;
 	}
 
 	// Destructor
 	WString::~WString()
 	{
-		Deallocate();
+		if (elements_ != nullptr && IsInline() == false) {
+			Deallocate(elements_);
+		}
 	}
 
 	// Return iterator to first element
@@ -233,13 +335,13 @@ namespace std
 	// Return iterator to one past last element
 	WString::iterator WString::End()
 	{
-		return iterator(&elements_[size_]);
+		return iterator(elements_ ? (elements_ + size_) : nullptr);
 	}
 
 	// Return const iterator to one past last element
 	const WString::iterator WString::End() const
 	{
-		return iterator(&elements_[size_]);
+		return iterator(elements_ ? (elements_ + size_) : nullptr);
 	}
 
 	// Return const iterator to first element (alternative naming)
@@ -251,54 +353,68 @@ namespace std
 	// Return const iterator to one past last element (alternative naming)
 	const WString::iterator WString::ConstEnd() const
 	{
-		return iterator(&elements_[size_]);
+		return iterator(elements_ ? (elements_ + size_) : nullptr);
 	}
 
-
-	bool WString::Empty() const { return size_ == 0; }
+	bool WString::Empty() const { return size_ == 0 || elements_ == nullptr; }
 
 	void WString::Reserve(size_t new_cap)
 	{
-		if (new_cap <= capacity_) return;
-		WCHAR* new_buf = Allocate(new_cap);
-		if (elements_) {
-			memcpy(new_buf, elements_, (size_ + 1) * sizeof(WCHAR));
-			Deallocate();
+		Repair();
+		if (new_cap > capacity_) {
+			Grow(new_cap);
 		}
-		elements_ = new_buf;
-		capacity_ = new_cap;
 	}
 
 	void WString::Resize(size_t new_size, WCHAR val)
 	{
-		if (new_size < size_) {
-			size_ = new_size;
-			elements_[size_] = L'\0';
+		Repair();
+		if (new_size > capacity_) {
+			Grow(new_size);
 		}
-		else if (new_size > size_) {
-			Reserve(new_size);
-			for (size_t i = size_; i < new_size; ++i)
-				elements_[i] = val;
-			size_ = new_size;
-			elements_[size_] = L'\0';
+		for (size_t i = size_; i < new_size; ++i) {
+			elements_[i] = val;
 		}
+		size_ = new_size;
+		elements_[size_] = L'\0';
 	}
 
 	size_t WString::Size() const { return size_; }
 
 	size_t WString::Capacity() const { return capacity_; }
 
+	void WString::ShrinkToFit()
+	{
+		Repair();
+		if (IsInline() == true || capacity_ == size_) {
+			return;
+		}
+		WCHAR* old = elements_;
+		if (size_ <= kInlineCapacity) {
+			memcpy(inline_, old, (size_ + 1) * sizeof(WCHAR));
+			elements_ = inline_;
+			capacity_ = kInlineCapacity;
+		}
+		else {
+			elements_ = Allocate(size_);
+			memcpy(elements_, old, (size_ + 1) * sizeof(WCHAR));
+			capacity_ = size_;
+		}
+		Deallocate(old);
+	}
+
 	void WString::Clear()
 	{
+		Repair();
 		size_ = 0;
-		if (elements_) elements_[0] = L'\0';
+		elements_[0] = L'\0';
 	}
 
 	void WString::PushBack(const WCHAR c)
 	{
-		if (size_ + 1 >= capacity_)
-		{
-			Reserve(size_ * 2 + 1);
+		Repair();
+		if (size_ == capacity_) {
+			Grow(capacity_ * 2);
 		}
 		elements_[size_++] = c;
 		elements_[size_] = L'\0';
@@ -306,79 +422,55 @@ namespace std
 
 	void WString::PopBack()
 	{
-		if (size_ == 0) return;
+		Repair();
+		if (Empty() == true) return;
 		elements_[--size_] = L'\0';
 	}
 
-	void WString::Append(const WString& other)
-	{
-		Reserve(size_ + other.size_);
-		memcpy(&elements_[size_], other.elements_, other.size_ * sizeof(WCHAR));
-		size_ += other.size_;
-		elements_[size_] = L'\0';
-	}
-
-	void WString::Append(const WCHAR* s)
-	{
-		if (!s) return;
-		size_t len = wcslen(s);
-		Reserve(size_ + len);
-		memcpy(&elements_[size_], s, len * sizeof(WCHAR));
-		size_ += len;
-		elements_[size_] = L'\0';
-	}
-
-	void WString::Append(const UNICODE_STRING& u)
-	{
-		if (!u.Buffer) return;
-		size_t len = u.Length / sizeof(WCHAR);
-		if (size_ + 1 >= capacity_)
-		{
-			Reserve((size_ + len) * 3 / 2 + 1);
+	void WString::Append(const WStringView& v)
+	{
+		Repair();
+		size_t n = v.Size();
+		if (n == 0) {
+			return;
+		}
+		if (size_ + n > capacity_) {
+			size_t new_cap = capacity_ * 2 > size_ + n ? capacity_ * 2 : size_ + n;
+			// v may point into the current buffer, which Grow frees.
+			WCHAR* old = elements_;
+			bool is_self = v.Data() >= old && v.Data() <= old + size_;
+			size_t offset = is_self == true ? v.Data() - old : 0;
+			Grow(new_cap);
+			if (is_self == true) {
+				memcpy(&elements_[size_], elements_ + offset, n * sizeof(WCHAR));
+				size_ += n;
+				elements_[size_] = L'\0';
+				return;
+			}
 		}
-		memcpy(&elements_[size_], u.Buffer, len * sizeof(WCHAR));
-		size_ += len;
+		memmove(&elements_[size_], v.Data(), n * sizeof(WCHAR));
+		size_ += n;
 		elements_[size_] = L'\0';
 	}
 
-	WString& WString::operator+=(const WString& other)
-	{ 
-		Append(other);
-		return *this; 
-	}
-
-	WString& WString::operator+=(const WCHAR* s)
+	WString& WString::operator+=(const WStringView& v)
 	{
-		Append(s);
+		Append(v);
 		return *this;
 	}
 
-	WString& WString::operator+=(const UNICODE_STRING& u)
+	WString WString::operator+(const WStringView& v) const
 	{
-		Append(u);
-		return *this;
-	}
-
-	WString WString::operator+(const WString& other) {
-		WString tmp(*this);
-		tmp.Append(other);
-		return tmp;
-	}
-
-	WString WString::operator+(const WCHAR* s) {
-		WString tmp(*this);
-		tmp.Append(s);
-		return tmp;
-	}
-
-	WString WString::operator+(const UNICODE_STRING& u) {
-		WString tmp(*this);
-		tmp.Append(u);
+		WString tmp;
+		tmp.Reserve(size_ + v.Size());
+		tmp.Append(View());
+		tmp.Append(v);
 		return tmp;
 	}
 
 	WString& WString::ConverToUpcase()
 	{
+		Repair();
 		for (size_t i = 0; i < size_; ++i)
 			elements_[i] = RtlUpcaseUnicodeChar(elements_[i]);
 		return *this;
@@ -386,35 +478,36 @@ namespace std
 
 	WString& WString::ConverToDowncase()
 	{
+		Repair();
 		for (size_t i = 0; i < size_; ++i)
 			elements_[i] = RtlDowncaseUnicodeChar(elements_[i]);
 		return *this;
 	}
 
-	WString WString::GetUpcase() {
+	WString WString::GetUpcase() const {
 		WString tmp(*this);
 		tmp.ConverToUpcase();
 		return tmp;
 	}
 
-	WString WString::GetDowncase() {
+	WString WString::GetDowncase() const {
 		WString tmp(*this);
 		tmp.ConverToDowncase();
 		return tmp;
 	}
 
 	WCHAR& WString::At(size_t n) {
-		if (n >= size_)
-		{
+		Repair();
+		if (n >= size_) {
 			ExRaiseAccessViolation();
 		}
 		return elements_[n];
 	}
 
 	const WCHAR& WString::At(size_t n) const {
-		if (n >= size_)
-		{
-			return L'\0';
+		static const WCHAR kNull = L'\0';
+		if (n >= size_ || elements_ == nullptr) {
+			return kNull;
 		}
 		return elements_[n];
 	}
@@ -423,35 +516,27 @@ namespace std
 	const WCHAR& WString::operator[](size_t n) const { return At(n); }
 
 	WCHAR& WString::Front() {
-		if (size_ == 0)
-		{
+		Repair();
+		if (Empty() == true) {
 			ExRaiseAccessViolation();
 		}
 		return elements_[0];
 	}
 
 	const WCHAR& WString::Front() const {
-		if (size_ == 0)
-		{
-			return L'\0';
-		}
-		return elements_[0];
+		return At(0);
 	}
 
 	WCHAR& WString::Back() {
-		if (size_ == 0)
-		{
+		Repair();
+		if (Empty() == true) {
 			ExRaiseAccessViolation();
 		}
 		return elements_[size_ - 1];
 	}
 
 	const WCHAR& WString::Back() const {
-		if (size_ == 0)
-		{
-			return L'\0';
-		}
-		return elements_[size_ - 1];
+		return At(size_ - 1);
 	}
 
 	WCHAR* WString::Data() { return elements_; }
@@ -460,268 +545,231 @@ namespace std
 	const UNICODE_STRING WString::UniStr() const
 	{
 		UNICODE_STRING uni_str = { 0 };
-		if (size_ * sizeof(WCHAR) >= UNICODE_STRING_MAX_BYTES)
-		{
+		if (size_ * sizeof(WCHAR) >= UNICODE_STRING_MAX_BYTES) {
 			ExRaiseStatus(STATUS_NAME_TOO_LONG);
 		}
+		if (Empty() == true) {
+			uni_str.Length = 0;
+			uni_str.MaximumLength = 0;
+			uni_str.Buffer = nullptr;
+			return uni_str;
+		}
+		size_t max_bytes = (capacity_ + 1) * sizeof(WCHAR);
 		uni_str.Length = static_cast<USHORT>(size_ * sizeof(WCHAR));
-		uni_str.MaximumLength = static_cast<USHORT>((capacity_ + 1) * sizeof(WCHAR));
+		uni_str.MaximumLength = static_cast<USHORT>(max_bytes < UNICODE_STRING_MAX_BYTES ? max_bytes : UNICODE_STRING_MAX_BYTES);
 		uni_str.Buffer = elements_;
 		return uni_str;
 	}
 
-	bool WString::IsPrefixOf(const WString& other) const {
-		return other.size_ >= size_ &&
-			wcsncmp(other.elements_, elements_, size_) == 0;
-	}
-
-	bool WString::IsCiPrefixOf(const WString& other) const {
-		return other.size_ >= size_ &&
-			_wcsnicmp(other.elements_, elements_, size_) == 0;
-	}
-
-	bool WString::HasPrefix(const WString& prefix) const {
-		return size_ >= prefix.size_ &&
-			wcsncmp(elements_, prefix.elements_, prefix.size_) == 0;
-	}
-
-	bool WString::HasCiPrefix(const WString& prefix) const {
-		return size_ >= prefix.size_ &&
-			_wcsnicmp(elements_, prefix.elements_, prefix.size_) == 0;
+	WStringView WString::View() const
+	{
+		return WStringView(elements_, size_);
 	}
 
-	bool WString::IsSuffixOf(const WString& other) const {
-		return other.size_ >= size_ &&
-			wcsncmp(&other.elements_[other.size_ - size_], elements_, size_) == 0;
+	bool WString::IsPrefixOf(const WStringView& other) const {
+		return other.HasPrefix(View());
 	}
 
-	bool WString::IsCiSuffixOf(const WString& other) const {
-		return other.size_ >= size_ &&
-			_wcsnicmp(&other.elements_[other.size_ - size_], elements_, size_) == 0;
+	bool WString::IsCiPrefixOf(const WStringView& other) const {
+		return other.HasCiPrefix(View());
 	}
 
-	bool WString::HasSuffix(const WString& suffix) const {
-		return size_ >= suffix.size_ &&
-			wcsncmp(&elements_[size_ - suffix.size_], suffix.elements_, suffix.size_) == 0;
+	bool WString::HasPrefix(const WStringView& prefix) const {
+		return View().HasPrefix(prefix);
 	}
 
-	bool WString::HasCiSuffix(const WString& suffix) const {
-		return size_ >= suffix.size_ &&
-			_wcsnicmp(&elements_[size_ - suffix.size_], suffix.elements_, suffix.size_) == 0;
+	bool WString::HasCiPrefix(const WStringView& prefix) const {
+		return View().HasCiPrefix(prefix);
 	}
 
-	size_t WString::FindFirstOf(const WString& pat, size_t begin_pos) const {
-		if (begin_pos > size_) return kNPos;
-		const WCHAR* pos = wcsstr(elements_ + begin_pos, pat.elements_);
-		return pos ? static_cast<size_t>(pos - elements_) : kNPos;
+	bool WString::IsSuffixOf(const WStringView& other) const {
+		return other.HasSuffix(View());
 	}
 
-	size_t WString::FindFirstOf(const WCHAR* s, size_t begin_pos) const {
-		if (!s || begin_pos > size_) return kNPos;
-		const WCHAR* pos = wcsstr(elements_ + begin_pos, s);
-		return pos ? static_cast<size_t>(pos - elements_) : kNPos;
+	bool WString::IsCiSuffixOf(const WStringView& other) const {
+		return other.HasCiSuffix(View());
 	}
 
-	size_t WString::FindFirstOf(const UNICODE_STRING& u, size_t begin_pos) const {
-		if (u.Length == u.MaximumLength)
-		{
-			WString tmp(u);
-			return FindFirstOf(tmp, begin_pos);
-		}
-		else
-		{
-			u.Buffer[u.Length / sizeof(WCHAR)] = L'\0';
-			return FindFirstOf(u.Buffer, begin_pos);
-		}
+	bool WString::HasSuffix(const WStringView& suffix) const {
+		return View().HasSuffix(suffix);
 	}
 
-	bool WString::Contain(const WString& w) const {
-		return FindFirstOf(w) != kNPos;
+	bool WString::HasCiSuffix(const WStringView& suffix) const {
+		return View().HasCiSuffix(suffix);
 	}
 
-	bool WString::Contain(const WCHAR* s) const {
-		return FindFirstOf(s) != kNPos;
+	size_t WString::FindFirstOf(const WStringView& pat, size_t begin_pos) const {
+		return View().FindFirstOf(pat, begin_pos);
 	}
 
-	bool WString::Contain(const UNICODE_STRING& u) const {
-		return FindFirstOf(u) != kNPos;
+	bool WString::Contain(const WStringView& pat) const {
+		return View().Contain(pat);
 	}
 
-	bool WString::operator==(const WString& o) const {
-		return wcscmp(elements_, o.elements_) == 0;
+	bool WString::operator==(const WStringView& o) const {
+		return View() == o;
 	}
 
-	bool WString::operator==(const WCHAR* s) const {
-		return s && wcscmp(elements_, s) == 0;
+	bool WString::EqualCi(const WStringView& o) const {
+		return View().EqualCi(o);
 	}
 
-	bool WString::operator==(const UNICODE_STRING& u) const {
-		if (u.Length == 0) return size_ == 0;
-		size_t ulen = u.Length / sizeof(WCHAR);
-		return size_ == ulen &&
-			memcmp(elements_, u.Buffer, ulen * sizeof(WCHAR)) == 0;
-	}
+	bool WString::operator!=(const WStringView& o) const { return !(*this == o); }
 
-	bool WString::EqualCi(const WString& o) const {
-		return _wcsicmp(elements_, o.elements_) == 0;
+	bool WString::operator>(const WStringView& o) const
+	{
+		return View().Compare(o) > 0;
 	}
 
-	bool WString::EqualCi(const WCHAR* s) const {
-		return s && _wcsicmp(elements_, s) == 0;
+	bool WString::operator<(const WStringView& o) const
+	{
+		return View().Compare(o) < 0;
 	}
 
-	bool WString::EqualCi(const UNICODE_STRING& u) const {
-		if (u.Length == u.MaximumLength)
-		{
-			WString tmp(u);
-			return EqualCi(tmp);
+	WCHAR* WString::Allocate(size_t n)
+	{
+		WCHAR* p = (WCHAR*)krnl_std::Alloc((n + 1) * sizeof(WCHAR), krnl_std::kStringTag);
+		if (p != nullptr) {
+			p[n] = L'\0';
 		}
-		else
-		{
-			u.Buffer[u.Length / sizeof(WCHAR)] = L'\0';
-			return EqualCi(u.Buffer);
+		else {
+			ExRaiseStatus(STATUS_INSUFFICIENT_RESOURCES);
 		}
+		return p;
 	}
 
-	bool WString::operator!=(const WString& o) const { return !(*this == o); }
-	bool WString::operator!=(const WCHAR* s) const { return !(*this == s); }
-	bool WString::operator!=(const UNICODE_STRING& u) const { return !(*this == u); }
-
-	bool WString::operator>(const WString& o) const
+	void WString::Deallocate(PVOID buf)
 	{
-		return wcscmp(elements_, o.elements_) > 0;
+		krnl_std::Free(buf);
 	}
 
-	bool WString::operator>(const WCHAR* s) const
+	// Back to an empty inline string, freeing any heap buffer.
+	void WString::Reset()
 	{
-		return s && wcscmp(elements_, s) > 0;
+		if (elements_ != nullptr && IsInline() == false) {
+			Deallocate(elements_);
+		}
+		elements_ = inline_;
+		capacity_ = kInlineCapacity;
+		size_ = 0;
+		inline_[0] = L'\0';
 	}
 
-	bool WString::operator>(const UNICODE_STRING& u) const
+	void WString::Repair()
 	{
-		if (u.Length == u.MaximumLength)
-		{
-			WString tmp(u);
-			return *this > tmp;
-		}
-		else
-		{
-			u.Buffer[u.Length / sizeof(WCHAR)] = L'\0';
-			return *this > u.Buffer;
+		if (IsInvalid() == true) {
+			Reset();
 		}
 	}
 
-	bool WString::operator<(const WString& o) const
+	// Also true for a zeroed object, which never got its inline buffer.
+	const bool WString::IsInvalid() const
 	{
-		return wcscmp(elements_, o.elements_) < 0;
+		return elements_ == nullptr || size_ > capacity_ || (IsInline() == true && capacity_ != kInlineCapacity);
 	}
 
-	bool WString::operator<(const WCHAR* s) const
+	bool WString::IsInline() const
 	{
-		return s && wcscmp(elements_, s) < 0;
+		return elements_ == inline_;
 	}
 
-	bool WString::operator<(const UNICODE_STRING& u) const
+	void WString::Grow(size_t new_cap)
 	{
-		if (u.Length == u.MaximumLength)
-		{
-			WString tmp(u);
-			return *this < tmp;
+		if (new_cap <= kInlineCapacity) {
+			new_cap = kInlineCapacity + 1;
 		}
-		else
-		{
-			u.Buffer[u.Length / sizeof(WCHAR)] = L'\0';
-			return *this < u.Buffer;
+		WCHAR* new_buf = Allocate(new_cap);
+		memcpy(new_buf, elements_, (size_ + 1) * sizeof(WCHAR));
+		if (IsInline() == false) {
+			Deallocate(elements_);
 		}
+		elements_ = new_buf;
+		capacity_ = new_cap;
 	}
 
-	WCHAR* WString::Allocate(size_t n)
+	// s may point into this WString.
+	void WString::Assign(const WCHAR* s, size_t n)
 	{
-		WCHAR* p = new WCHAR[n + 1];
-		if (p != nullptr)
-		{
-			p[n] = L'\0';
+		Repair();
+		if (s == nullptr || n == 0) {
+			size_ = 0;
+			elements_[0] = L'\0';
+			return;
 		}
-		return p;
+		if (n > capacity_) {
+			WCHAR* new_buf = Allocate(n);
+			memcpy(new_buf, s, n * sizeof(WCHAR));
+			if (IsInline() == false) {
+				Deallocate(elements_);
+			}
+			elements_ = new_buf;
+			capacity_ = n;
+		}
+		else {
+			memmove(elements_, s, n * sizeof(WCHAR));
+		}
+		size_ = n;
+		elements_[size_] = L'\0';
 	}
 
-	void WString::Deallocate()
+	// Digits into a stack buffer, then a single copy.
+	static WString FormatNumber(unsigned long long v, bool negative)
 	{
-		delete[] elements_;
-		elements_ = nullptr;
-		capacity_ = 0;
-		size_ = 0;
+		WCHAR buf[24];
+		size_t pos = sizeof(buf) / sizeof(buf[0]);
+		do {
+			buf[--pos] = (WCHAR)(L'0' + v % 10);
+			v /= 10;
+		} while (v != 0);
+		if (negative == true) {
+			buf[--pos] = L'-';
+		}
+		return WString(WStringView(buf + pos, sizeof(buf) / sizeof(buf[0]) - pos));
+	}
+
+	static WString FormatSigned(long long v)
+	{
+		unsigned long long magnitude = v < 0 ? 0 - (unsigned long long)v : (unsigned long long)v;
+		return FormatNumber(magnitude, v < 0);
 	}
 
 	WString ToWString(short num)
 	{
-        WString str;
-        str.Resize(8);
-        RtlStringCchPrintfW(str.Data(), str.Capacity(), L"%d", num);
-        str.Resize(wcslen(str.Data()));
-        return str;
+		return FormatSigned(num);
 	}
 
-	WString ToWstring(unsigned short num)
+	WString ToWString(unsigned short num)
 	{
-        WString str;
-        str.Resize(8);
-        RtlStringCchPrintfW(str.Data(), str.Capacity(), L"%u", num);
-        str.Resize(wcslen(str.Data()));
-        return str;
+		return FormatNumber(num, false);
 	}
 
-    WString ToWstring(int num)
+    WString ToWString(int num)
     {
-        WString str;
-        str.Resize(16);
-        RtlStringCchPrintfW(str.Data(), str.Capacity(), L"%d", num);
-        str.Resize(wcslen(str.Data()));
-        return str;
+		return FormatSigned(num);
     }
 
-    WString ToWstring(unsigned int num)
+    WString ToWString(unsigned int num)
     {
-        WString str;
-        str.Resize(16);
-        RtlStringCchPrintfW(str.Data(), str.Capacity(), L"%u", num);
-        str.Resize(wcslen(str.Data()));
-        return str;
+		return FormatNumber(num, false);
     }
 
-    WString ToWstring(long num)
+    WString ToWString(long num)
     {
-        WString str;
-        str.Resize(16);
-        RtlStringCchPrintfW(str.Data(), str.Capacity(), L"%ld", num);
-        str.Resize(wcslen(str.Data()));
-        return str;
+		return FormatSigned(num);
     }
 
-    WString ToWstring(unsigned long num)
+    WString ToWString(unsigned long num)
     {
-        WString str;
-        str.Resize(16);
-        RtlStringCchPrintfW(str.Data(), str.Capacity(), L"%lu", num);
-        str.Resize(wcslen(str.Data()));
-        return str;
+		return FormatNumber(num, false);
     }
 
-    WString ToWstring(long long num)
+    WString ToWString(long long num)
     {
-        WString str;
-        str.Resize(32);
-        RtlStringCchPrintfW(str.Data(), str.Capacity(), L"%lld", num);
-        str.Resize(wcslen(str.Data()));
-        return str;
+		return FormatSigned(num);
     }
 
-	WString ToWstring(unsigned long long num)
+	WString ToWString(unsigned long long num)
     {
-        WString str;
-        str.Resize(32);
-        RtlStringCchPrintfW(str.Data(), str.Capacity(), L"%llu", num);
-        str.Resize(wcslen(str.Data()));
-        return str;
+		return FormatNumber(num, false);
     }
 }
@@ -4,6 +4,18 @@ extern "C" {
 #include <ntddk.h>   // or <wdm.h>
 }
 
+// Reader/writer lock over EX_PUSH_LOCK, for read-mostly state: any number of
+// shared holders, or one exclusive holder. Holders run in a critical region
+// (normal kernel APCs disabled), so hold it for lookups and pointer swaps,
+// not for work that can block on I/O.
+//
+// The lock does not remember how it was taken: several threads hold it
+// shared at once, so there is no single mode to store. Release with the call
+// that matches the acquire, or use the guards. Push locks are not recursive;
+// do not acquire the same lock twice in one thread.
+//
+// bench/kstd_shim/wdk/ntddk.h maps the Ex*PushLock* calls onto a user-mode
+// lock so this header can be measured on Linux unchanged.
 class PushLock {
 public:
 	enum class Mode : UCHAR { Shared = 0, Exclusive = 1 };
@@ -24,7 +36,6 @@ public:
 		VOID LockExclusive() noexcept {
 		KeEnterCriticalRegion();
 		ExAcquirePushLockExclusive(&m_lock);
-		m_mode = Mode::Exclusive;
 	}
 
 	// Acquire shared (read) lock
@@ -33,20 +44,19 @@ public:
 		VOID LockShared() noexcept {
 		KeEnterCriticalRegion();
 		ExAcquirePushLockShared(&m_lock);
-		m_mode = Mode::Shared;
 	}
 
-	// Release lock (based on last acquired mode)
 	_IRQL_requires_max_(APC_LEVEL)
-		_Releases_lock_(m_lock)
-		VOID Unlock() noexcept {
-		if (m_mode == Mode::Exclusive) {
-			ExReleasePushLockExclusive(&m_lock);
-		}
-		else {
-			ExReleasePushLockShared(&m_lock);
-		}
-		m_mode = Mode::Shared; // reset default
+		_Releases_exclusive_lock_(m_lock)
+		VOID UnlockExclusive() noexcept {
+		ExReleasePushLockExclusive(&m_lock);
+		KeLeaveCriticalRegion();
+	}
+
+	_IRQL_requires_max_(APC_LEVEL)
+		_Releases_shared_lock_(m_lock)
+		VOID UnlockShared() noexcept {
+		ExReleasePushLockShared(&m_lock);
 		KeLeaveCriticalRegion();
 	}
 
@@ -55,12 +65,11 @@ public:
 		_Releases_lock_(m_lock)
 		VOID Unlock(Mode mode) noexcept {
 		if (mode == Mode::Exclusive) {
-			ExReleasePushLockExclusive(&m_lock);
+			UnlockExclusive();
 		}
 		else {
-			ExReleasePushLockShared(&m_lock);
+			UnlockShared();
 		}
-		KeLeaveCriticalRegion();
 	}
 
 	// Non-copyable
@@ -71,7 +80,9 @@ public:
 	class AutoExclusive {
 	public:
 		explicit AutoExclusive(PushLock& l) : lock(l) { lock.LockExclusive(); }
-		~AutoExclusive() { lock.Unlock(PushLock::Mode::Exclusive); }
+		~AutoExclusive() { lock.UnlockExclusive(); }
+		AutoExclusive(const AutoExclusive&) = delete;
+		AutoExclusive& operator=(const AutoExclusive&) = delete;
 	private:
 		PushLock& lock;
 	};
@@ -80,14 +91,13 @@ public:
 	class AutoShared {
 	public:
 		explicit AutoShared(PushLock& l) : lock(l) { lock.LockShared(); }
-		~AutoShared() { lock.Unlock(PushLock::Mode::Shared); }
+		~AutoShared() { lock.UnlockShared(); }
+		AutoShared(const AutoShared&) = delete;
+		AutoShared& operator=(const AutoShared&) = delete;
 	private:
 		PushLock& lock;
 	};
 
 private:
-	// This mode value is only a per-thread hint to decide which release API to call.
-	// Push locks are not recursive; do not acquire the same lock multiple times in the same thread.
 	EX_PUSH_LOCK m_lock{};
-	Mode m_mode{ Mode::Shared };
 };
@@ -1,5 +1,10 @@
 import os
 import shutil
+import sys
+
+# The collector log is binary (EventCollectorDriver/com/event_record.h).
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'EventCollectorDriver', 'tools', 'evtlog'))
+import evtlog
 
 def count_ransomware_files(source_dir):
     total = 0
@@ -10,14 +15,11 @@ def count_ransomware_files(source_dir):
             total += 1
             file_path = os.path.join(root, name)
             try:
-                with open(file_path, 'r', encoding='utf-16-le') as f:
-                    content = f.read()
-                    if "is ransomware" in content:
-                        count += 1
-                        #print(name)
-                        pass                    
+                if any("is ransomware" in line for line in evtlog.iter_lines(file_path)):
+                    count += 1
+                    #print(name)
 
-            except Exception as e:
+            except OSError as e:
                 print(f"Lỗi khi đọc file {file_path}: {e}")
     return count, total
 
@@ -0,0 +1,194 @@
+"""
+Reader for the columnar scan-result file written by RansomDetectorService
+(manager::ScanResultWriter, default C:\\hieunt_scan_result.rscb).
+
+Layout is documented in include/manager/scan_result_writer.h. Columns are
+plain little-endian arrays, so they are loaded with one frombuffer/frombytes
+call per column instead of parsing text lines.
+
+Usage:
+    python scan_result_reader.py <file.rscb> [legacy_text_log]
+
+With a legacy text log (C:\\hieunt_filetype.log) it also prints the size and
+parse time of both formats.
+"""
+
+import os
+import struct
+import sys
+import time
+from array import array
+
+try:
+    import numpy as np
+except ImportError:
+    np = None
+
+FILE_MAGIC = 0x46435352   # "RSCF"
+BLOCK_MAGIC = 0x42435352  # "RSCB"
+OTHER_TYPE_BIT = 63
+
+# (name, array typecode, numpy dtype) in file order
+COLUMNS = [
+    ("ts_ms", "Q", "<u8"),
+    ("path_id", "Q", "<u8"),
+    ("type_mask", "Q", "<u8"),
+    ("size", "Q", "<u8"),
+    ("pid", "I", "<u4"),
+    ("status", "I", "<u4"),
+    ("validate_us", "I", "<u4"),
+    ("kind", "B", "u1"),
+]
+
+
+def _align8(n: int) -> int:
+    return (n + 7) & ~7
+
+
+def _load_column(buf: memoryview, off: int, rows: int, code: str, dtype: str):
+    width = struct.calcsize(code)
+    raw = buf[off:off + rows * width]
+    if np is not None:
+        col = np.frombuffer(raw, dtype=dtype)
+    else:
+        col = array(code)
+        col.frombytes(raw)
+    return col, off + _align8(rows * width)
+
+
+def ReadScanResults(file_path: str) -> dict:
+    """
+    Returns {
+        "columns": {name: array}  (numpy arrays when numpy is installed),
+        "paths":   {path_id: path},
+        "types":   {bit: type name},
+    }
+    """
+    with open(file_path, "rb") as f:
+        data = f.read()
+    buf = memoryview(data)
+
+    magic, version, _ = struct.unpack_from("<IHH", buf, 0)
+    if magic != FILE_MAGIC:
+        raise ValueError(f"{file_path}: bad file magic {magic:#x}")
+    if version != 1:
+        raise ValueError(f"{file_path}: unsupported version {version}")
+
+    chunks = {name: [] for name, _, _ in COLUMNS}
+    paths = {}
+    types = {}
+
+    off = 8
+    while off + 24 <= len(buf):
+        magic, rows, n_types, n_paths, body_bytes, _ = struct.unpack_from("<6I", buf, off)
+        if magic != BLOCK_MAGIC:
+            raise ValueError(f"{file_path}: bad block magic at {off}")
+        body = off + 24
+        end = body + body_bytes
+        if end > len(buf):
+            break  # Truncated tail (writer still running or killed)
+
+        p = body
+        for _ in range(n_types):
+            bit, name_len = struct.unpack_from("<BH", buf, p)
+            p += 3
+            types[bit] = bytes(buf[p:p + name_len]).decode("utf-8", errors="replace")
+            p += name_len
+        for _ in range(n_paths):
+            path_id, n_chars = struct.unpack_from("<QI", buf, p)
+            p += 12
+            paths[path_id] = bytes(buf[p:p + n_chars * 2]).decode("utf-16-le", errors="replace")
+            p += n_chars * 2
+        p = body + _align8(p - body)
+
+        for name, code, dtype in COLUMNS:
+            col, p = _load_column(buf, p, rows, code, dtype)
+            chunks[name].append(col)
+
+        off = end
+
+    columns = {}
+    for name, code, dtype in COLUMNS:
+        if np is not None:
+            columns[name] = np.concatenate(chunks[name]) if chunks[name] else np.empty(0, dtype=dtype)
+        else:
+            merged = array(code)
+            for c in chunks[name]:
+                merged.extend(c)
+            columns[name] = merged
+
+    return {"columns": columns, "paths": paths, "types": types}
+
+
+def TypeNames(mask: int, types: dict) -> list:
+    names = [types[bit] for bit in sorted(types) if mask & (1 << bit)]
+    if mask & (1 << OTHER_TYPE_BIT):
+        names.append("<other>")
+    return names
+
+
+def ToDataFrame(result: dict):
+    """pandas DataFrame with one row per scan; path is resolved from path_id."""
+    import pandas as pd
+    df = pd.DataFrame({name: result["columns"][name] for name, _, _ in COLUMNS})
+    df["kind"] = df["kind"].map(chr)
+    df["path"] = df["path_id"].map(result["paths"])
+    return df
+
+
+def IterRows(result: dict):
+    """Yields (ts_ms, kind, path, types, status) tuples like the legacy text log."""
+    cols = result["columns"]
+    paths = result["paths"]
+    types = result["types"]
+    for i in range(len(cols["ts_ms"])):
+        yield (
+            int(cols["ts_ms"][i]),
+            chr(cols["kind"][i]),
+            paths.get(int(cols["path_id"][i]), ""),
+            TypeNames(int(cols["type_mask"][i]), types),
+            int(cols["status"][i]),
+        )
+
+
+def ReadLegacyTextLog(file_path: str) -> list:
+    """Parses C:\\hieunt_filetype.log lines: ts,d,path / ts,f,path,(types),status / ts,e,path,status."""
+    rows = []
+    with open(file_path, "r", encoding="utf-16-le", errors="replace") as f:
+        for line in f:
+            line = line.rstrip("\n")
+            parts = line.split(",", 2)
+            if len(parts) < 3:
+                continue
+            ts, kind, rest = parts
+            if kind == "d":
+                rows.append((int(ts), kind, rest, [], 0))
+            elif kind == "f":
+                lp = rest.rfind(",(")
+                rp = rest.rfind("),")
+                if lp == -1 or rp == -1:
+                    continue
+                rows.append((int(ts), kind, rest[:lp], rest[lp + 2:rp].split(","), int(rest[rp + 2:], 16)))
+            elif kind == "e":
+                path, _, status = rest.rpartition(",")
+                rows.append((int(ts), kind, path, [], int(status, 16)))
+    return rows
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+
+    t0 = time.perf_counter()
+    result = ReadScanResults(sys.argv[1])
+    t1 = time.perf_counter()
+    n_rows = len(result["columns"]["ts_ms"])
+    print(f"columnar: {os.path.getsize(sys.argv[1])} bytes, {n_rows} rows, "
+          f"{len(result['paths'])} paths, {len(result['types'])} types, {t1 - t0:.3f}s")
+
+    if len(sys.argv) > 2:
+        t0 = time.perf_counter()
+        legacy = ReadLegacyTextLog(sys.argv[2])
+        t1 = time.perf_counter()
+        print(f"text log: {os.path.getsize(sys.argv[2])} bytes, {len(legacy)} rows, {t1 - t0:.3f}s")